@@ -0,0 +1,10 @@
+include(FindPackageHandleStandardArgs)
+include(ConfigurePackage)
+
+set( CommandLine_BOOST_COMPONENTS filesystem )
+find_prerequests( CommandLine "" Boost GLOG )
+
+find_path( CommandLine_PRIMARY_INCLUDE_DIR  "CommandLine/CommandLine.hpp" ${SOURCE_PATH} )  
+set( CommandLine_LIBRARIES CommandLine )
+
+ConfigurePackage( CommandLine )
\ No newline at end of file
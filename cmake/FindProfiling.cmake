@@ -0,0 +1,9 @@
+include(FindPackageHandleStandardArgs)
+include(ConfigurePackage)
+
+find_prerequests( Profiling "" Boost GLOG Xml ZLIB )
+
+find_path( Profiling_PRIMARY_INCLUDE_DIR  "Profiling/Profile.hpp" ${SOURCE_PATH} )  
+set( Profiling_LIBRARIES Profiling )
+
+ConfigurePackage( Profiling )
\ No newline at end of file
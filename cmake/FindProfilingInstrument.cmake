@@ -0,0 +1,9 @@
+include(FindPackageHandleStandardArgs)
+include(ConfigurePackage)
+
+find_prerequests( ProfilingInstrument "" Boost GLOG Xml Profiling )
+
+find_path( ProfilingInstrument_PRIMARY_INCLUDE_DIR  "ProfilingInstrument/Instrument.hpp" ${SOURCE_PATH} )  
+set( ProfilingInstrument_LIBRARIES ProfilingInstrument )
+
+ConfigurePackage( ProfilingInstrument )
\ No newline at end of file
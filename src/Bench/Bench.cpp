@@ -0,0 +1,122 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <CommandLine/CommandLine.hpp>
+#include "Bench.hpp"
+
+using std::string;
+using namespace burning;
+using namespace burning::bench;
+using namespace burning::commandLine;
+
+Options::Options() : minimalSize( 1024 ),
+                     maximalSize( 16 * 1024 * 1024 ),
+                     arguments( 10000 ),
+                     warmupTime( 0.1 ),
+                     repetitionTime( 0.05 ),
+                     repetitions( 10 ),
+                     filter()
+{
+}
+
+bool bench::selected( const string& name, const Options& options )
+{
+  return name.find( options.filter ) != string::npos;
+}
+
+void bench::run( profiling::Benchmark& benchmark, const Options& options, Profile& results )
+{
+  if( !selected( benchmark.name(), options ) )
+    return;
+
+  benchmark.warmupTime() = options.warmupTime;
+  benchmark.repetitionTime() = options.repetitionTime;
+  benchmark.repetitions() = options.repetitions;
+
+  LOG( INFO ) << "Running " << benchmark.name() << '.';
+  benchmark.run( results );
+}
+
+/*
+ * Generator
+ */
+
+Generator::Generator( unsigned int seed ) : _state( seed )
+{
+}
+
+size_t Generator::next( size_t limit )
+{
+  // Knuth's MMIX linear congruential generator
+  _state = _state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return static_cast< size_t >( _state >> 33 ) % limit;
+}
+
+string Generator::word( size_t length )
+{
+  string ret( length, 'a' );
+  for( size_t i=0; i<length; i++ )
+    ret[ i ] = 'a' + next( 26 );
+
+  return ret;
+}
+
+int main( int argc, const char* argv[] )
+{
+  CommandLine commandLine( "burningBench" );
+  commandLine.arguments() += Key< string >( "output", 'o', "File for results profile in xml. Standard output by default." ),
+                             Key< string >( "filter", 'f', "Runs only benchmarks with names containing filter." ),
+                             Key< size_t >( "min-size", "Size of smallest xml document in bytes. 1024 by default." ),
+                             Key< size_t >( "max-size", "Size of largest xml document in bytes, up to 1073741824. 16777216 by default." ),
+                             Key< size_t >( "arguments", "Count of arguments in parsed command line. 10000 by default." ),
+                             Key< size_t >( "repetitions", 'r', "Count of timed repetitions. 10 by default." ),
+                             Key< double >( "repetition-time", "Minimal time of repetition in seconds. 0.05 by default." ),
+                             Key< double >( "warmup-time", "Time of warmup in seconds. 0.1 by default." );
+  commandLine.parse( argc, argv );
+
+  Options options;
+  if( commandLine[ "filter" ].isSet() )
+    options.filter = commandLine[ "filter" ].as< string >();
+  if( commandLine[ "min-size" ].isSet() )
+    options.minimalSize = commandLine[ "min-size" ].as< size_t >();
+  if( commandLine[ "max-size" ].isSet() )
+    options.maximalSize = commandLine[ "max-size" ].as< size_t >();
+  if( commandLine[ "arguments" ].isSet() )
+    options.arguments = commandLine[ "arguments" ].as< size_t >();
+  if( commandLine[ "repetitions" ].isSet() )
+    options.repetitions = commandLine[ "repetitions" ].as< size_t >();
+  if( commandLine[ "repetition-time" ].isSet() )
+    options.repetitionTime = commandLine[ "repetition-time" ].as< double >();
+  if( commandLine[ "warmup-time" ].isSet() )
+    options.warmupTime = commandLine[ "warmup-time" ].as< double >();
+
+  Profile results;
+  runXmlBenchmarks( options, results );
+  runDecimalBenchmarks( options, results );
+  runCommandLineBenchmarks( options, results );
+  runProfilingBenchmarks( options, results );
+
+  if( commandLine[ "output" ].isSet() )
+  {
+    std::ofstream stream( commandLine[ "output" ].as< string >().c_str() );
+    results.toXml()->write( stream );
+  }
+  else
+    results.toXml()->write( std::cout );
+
+  return EXIT_SUCCESS;
+}
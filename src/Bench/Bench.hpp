@@ -0,0 +1,79 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_BENCH_BENCH_HPP
+#define BURNING_BENCH_BENCH_HPP
+
+#include <string>
+#include <Profiling/Benchmark.hpp>
+
+namespace burning
+{
+  namespace bench
+  {
+    /*! Options of benchmark run */
+    struct Options
+    {
+      Options();
+
+      /*! Size of smallest generated document in bytes */
+      size_t minimalSize;
+      /*! Size of largest generated document in bytes */
+      size_t maximalSize;
+      /*! Count of command line arguments */
+      size_t arguments;
+
+      double warmupTime;
+      double repetitionTime;
+      size_t repetitions;
+
+      /*! Only benchmarks containing filter in name are run */
+      std::string filter;
+    };
+
+    /*! Checks that benchmark is selected by options */
+    bool selected( const std::string& name, const Options& options );
+    /*! Runs benchmark with timing options */
+    void run( profiling::Benchmark& benchmark, const Options& options, Profile& results );
+
+    /*! Deterministic pseudo random generator of benchmark's inputs */
+    class Generator
+    {
+    public:
+      /*! Constructs generator. Same seed gives same sequence. */
+      explicit Generator( unsigned int seed = 1 );
+
+      /*! Next number in [0, limit) */
+      size_t next( size_t limit );
+      /*! Random lower case word */
+      std::string word( size_t length );
+
+    private:
+      unsigned long long _state;
+    };
+
+    /*! Benchmarks Node::parse and Node::write */
+    void runXmlBenchmarks( const Options& options, Profile& results );
+    /*! Benchmarks Decimal conversions */
+    void runDecimalBenchmarks( const Options& options, Profile& results );
+    /*! Benchmarks CommandLine::parse */
+    void runCommandLineBenchmarks( const Options& options, Profile& results );
+    /*! Benchmarks cost of profiling calls */
+    void runProfilingBenchmarks( const Options& options, Profile& results );
+  }
+}
+
+#endif
@@ -0,0 +1,65 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <CommandLine/CommandLine.hpp>
+#include "Bench.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::bench;
+using namespace burning::commandLine;
+
+static void parseCommandLine( const vector< const char* >& argv )
+{
+  CommandLine commandLine( "bench" );
+  commandLine.arguments() += Flag( "flag", 'f' ),
+                             Key< int >( "number", 'n' ),
+                             Key< string >( "name" ),
+                             Key< vector< int > >( "values" );
+
+  commandLine.parse( argv.size(), const_cast< const char** >( &argv[ 0 ] ) );
+  profiling::doNotOptimize( commandLine[ "values" ].isSet() );
+}
+
+void bench::runCommandLineBenchmarks( const Options& options, Profile& results )
+{
+  string name( "command line parse " + boost::lexical_cast< string >( options.arguments ) );
+  if( !selected( name, options ) )
+    return;
+
+  Generator generator( 7 );
+
+  vector< string > arguments;
+  arguments.push_back( "bench" );
+  arguments.push_back( "-f" );
+  arguments.push_back( "--number" );
+  arguments.push_back( "42" );
+  arguments.push_back( "--name" );
+  arguments.push_back( generator.word( 16 ) );
+  arguments.push_back( "--values" );
+  while( arguments.size() < options.arguments )
+    arguments.push_back( boost::lexical_cast< string >( generator.next( 100000 ) ) );
+
+  vector< const char* > argv;
+  for( size_t i=0; i<arguments.size(); i++ )
+    argv.push_back( arguments[ i ].c_str() );
+
+  profiling::Benchmark parse( name, boost::bind( parseCommandLine, boost::cref( argv ) ) );
+  run( parse, options, results );
+}
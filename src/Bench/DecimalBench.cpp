@@ -0,0 +1,94 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Bench.hpp"
+
+using namespace burning;
+using namespace burning::bench;
+
+/*! Converts pregenerated numbers one by one */
+class DecimalConversion
+{
+public:
+  enum Kind
+  {
+    fromInteger,
+    fromDouble,
+    toDouble,
+    compare
+  };
+
+  DecimalConversion( Kind kind ) : _kind( kind ),
+                                   _index( 0 )
+  {
+    Generator generator( 42 );
+    for( size_t i=0; i<size; i++ )
+    {
+      _integers[ i ] = generator.next( 1000000000 );
+      _doubles[ i ] = generator.next( 1000000000 ) / 1000.0;
+      _decimals[ i ] = Decimal( _doubles[ i ] );
+    }
+  }
+
+  void operator()()
+  {
+    _index = ( _index + 1 ) % size;
+    switch( _kind )
+    {
+      case fromInteger:
+      {
+	profiling::doNotOptimize( Decimal( _integers[ _index ] ) );
+      }break;
+      case fromDouble:
+      {
+	profiling::doNotOptimize( Decimal( _doubles[ _index ] ) );
+      }break;
+      case toDouble:
+      {
+	profiling::doNotOptimize( _decimals[ _index ].as< double >() );
+      }break;
+      case compare:
+      {
+	profiling::doNotOptimize( _decimals[ _index ] == _doubles[ _index ] );
+      }break;
+    }
+  }
+
+private:
+  static const size_t size = 1024;
+
+  Kind _kind;
+  size_t _index;
+
+  int _integers[ size ];
+  double _doubles[ size ];
+  Decimal _decimals[ size ];
+};
+
+void bench::runDecimalBenchmarks( const Options& options, Profile& results )
+{
+  profiling::Benchmark fromInteger( "decimal from int", DecimalConversion( DecimalConversion::fromInteger ) );
+  run( fromInteger, options, results );
+
+  profiling::Benchmark fromDouble( "decimal from double", DecimalConversion( DecimalConversion::fromDouble ) );
+  run( fromDouble, options, results );
+
+  profiling::Benchmark toDouble( "decimal to double", DecimalConversion( DecimalConversion::toDouble ) );
+  run( toDouble, options, results );
+
+  profiling::Benchmark compare( "decimal compare", DecimalConversion( DecimalConversion::compare ) );
+  run( compare, options, results );
+}
@@ -0,0 +1,79 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Bench.hpp"
+
+using namespace burning;
+using namespace burning::bench;
+
+/*! Count of profiling calls made on one profile. Profile grows with each call, so benchmarks
+ *  use fresh profile for each batch and time of profile's construction is amortized over it.
+ */
+static const size_t batch = 100;
+
+static void beginEndIteration()
+{
+  Profile profile;
+  profile.beginLoop( "loop" );
+  for( size_t i=0; i<batch; i++ )
+  {
+    profile.beginIteration( i );
+    profile.endIteration();
+  }
+  profile.endLoop();
+  profiling::clobberMemory();
+}
+
+static void beginEndPhase()
+{
+  Profile profile;
+  profile.beginLoop( "loop" );
+  for( size_t i=0; i<batch; i++ )
+  {
+    profile.beginIteration( i );
+    profile.beginPhase( "phase" );
+    profile.endPhase();
+    profile.endIteration();
+  }
+  profile.endLoop();
+  profiling::clobberMemory();
+}
+
+static void addValue()
+{
+  Profile profile;
+  profile.beginLoop( "loop" );
+  for( size_t i=0; i<batch; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addValue( "value", i );
+    profile.endIteration();
+  }
+  profile.endLoop();
+  profiling::clobberMemory();
+}
+
+void bench::runProfilingBenchmarks( const Options& options, Profile& results )
+{
+  profiling::Benchmark iteration( "profiling 100 iterations", beginEndIteration );
+  run( iteration, options, results );
+
+  profiling::Benchmark value( "profiling 100 iterations with value", addValue );
+  run( value, options, results );
+
+  profiling::Benchmark phase( "profiling 100 iterations with phase", beginEndPhase );
+  run( phase, options, results );
+}
@@ -0,0 +1,119 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <Xml/Node.hpp>
+#include "Bench.hpp"
+
+using std::string;
+using boost::lexical_cast;
+using namespace burning;
+using namespace burning::bench;
+
+static string sizeName( size_t size )
+{
+  if( size >= 1024 * 1024 * 1024 && size % ( 1024 * 1024 * 1024 ) == 0 )
+    return lexical_cast< string >( size / ( 1024 * 1024 * 1024 ) ) + "GB";
+  if( size >= 1024 * 1024 && size % ( 1024 * 1024 ) == 0 )
+    return lexical_cast< string >( size / ( 1024 * 1024 ) ) + "MB";
+  if( size >= 1024 && size % 1024 == 0 )
+    return lexical_cast< string >( size / 1024 ) + "KB";
+  return lexical_cast< string >( size ) + "B";
+}
+
+static void appendRecord( Generator& generator, string& text )
+{
+  text += "  <record id=";
+  text += lexical_cast< string >( generator.next( 1000000 ) );
+  text += " weight=";
+  text += lexical_cast< string >( generator.next( 100000 ) / 1000.0 + 0.5 );
+  text += " name=\"";
+  text += generator.word( 4 + generator.next( 12 ) );
+  text += "\">\n";
+
+  size_t items( 1 + generator.next( 4 ) );
+  for( size_t i=0; i<items; i++ )
+  {
+    text += "    <item key=\"";
+    text += generator.word( 3 + generator.next( 8 ) );
+    text += "\" count=";
+    text += lexical_cast< string >( generator.next( 1000 ) );
+    text += "/>\n";
+  }
+
+  text += "  </record>\n";
+}
+
+/*! Generates xml document of about given size */
+static string generateDocument( size_t size )
+{
+  Generator generator( size );
+  string closing( "</document>\n" );
+
+  string ret( "<document>\n" );
+  ret.reserve( size + 256 );
+  while( ret.size() + closing.size() < size )
+    appendRecord( generator, ret );
+  ret += closing;
+
+  return ret;
+}
+
+static void parseDocument( const string& text )
+{
+  std::istringstream stream( text );
+  xml::NodePtr node( xml::Node::parse( stream ) );
+  profiling::doNotOptimize( node );
+}
+
+static void writeDocument( const xml::NodePtr& node )
+{
+  std::ostringstream stream;
+  node->write( stream );
+  profiling::doNotOptimize( stream.tellp() );
+}
+
+void bench::runXmlBenchmarks( const Options& options, Profile& results )
+{
+  for( size_t size = options.minimalSize; size <= options.maximalSize && size > 0; size *= 4 )
+  {
+    string parseName( "xml parse " + sizeName( size ) );
+    string writeName( "xml write " + sizeName( size ) );
+    if( !selected( parseName, options ) && !selected( writeName, options ) )
+      continue;
+
+    string text( generateDocument( size ) );
+
+    profiling::Benchmark parse( parseName, boost::bind( parseDocument, boost::cref( text ) ) );
+    run( parse, options, results );
+
+    if( !selected( writeName, options ) )
+      continue;
+
+    std::istringstream stream( text );
+    xml::NodePtr node( xml::Node::parse( stream ) );
+    if( !node )
+    {
+      LOG( ERROR ) << "Cannot parse generated document.";
+      exit( EXIT_FAILURE );
+    }
+
+    profiling::Benchmark write( writeName, boost::bind( writeDocument, boost::cref( node ) ) );
+    run( write, options, results );
+  }
+}
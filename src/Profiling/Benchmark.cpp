@@ -0,0 +1,286 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <time.h>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <boost/foreach.hpp>
+#include "Statistics.hpp"
+#include "Table.hpp"
+#include "Benchmark.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+Benchmark::Benchmark( const string& name, const Function& function ) : _name( name ),
+                                                                       _function( function ),
+                                                                       _warmupTime( 0.1 ),
+                                                                       _repetitionTime( 0.01 ),
+                                                                       _repetitions( 10 ),
+                                                                       _calls( 1 )
+{
+}
+
+string& Benchmark::name()
+{
+  return _name;
+}
+
+double& Benchmark::warmupTime()
+{
+  return _warmupTime;
+}
+
+double& Benchmark::repetitionTime()
+{
+  return _repetitionTime;
+}
+
+size_t& Benchmark::repetitions()
+{
+  return _repetitions;
+}
+
+size_t Benchmark::calls() const
+{
+  return _calls;
+}
+
+static double elapsed( const timespec& begin, const timespec& end )
+{
+  return ( end.tv_sec - begin.tv_sec ) + ( end.tv_nsec - begin.tv_nsec ) / double( nanoseconds );
+}
+
+double Benchmark::runBatch( size_t calls )
+{
+  timespec begin;
+  timespec end;
+
+  clock_gettime( CLOCK_MONOTONIC, &begin );
+  for( size_t i=0; i<calls; i++ )
+  {
+    _function();
+    clobberMemory();
+  }
+  clock_gettime( CLOCK_MONOTONIC, &end );
+
+  return elapsed( begin, end );
+}
+
+void Benchmark::scaleCalls( double time )
+{
+  if( time >= _repetitionTime )
+    return;
+
+  // Grows count of calls at most ten times at once, so a slow first call does not mislead scaling
+  double factor( 10.0 );
+  if( time > 0.0 )
+    factor = std::min( 10.0, std::max( 2.0, _repetitionTime / time * 1.2 ) );
+
+  _calls = static_cast< size_t >( _calls * factor );
+}
+
+void Benchmark::calibrate()
+{
+  _calls = 1;
+
+  timespec begin;
+  timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &begin );
+  for(;;)
+  {
+    double time( runBatch( _calls ) );
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    bool scaled( time >= _repetitionTime );
+    if( scaled && elapsed( begin, now ) >= _warmupTime )
+      break;
+
+    scaleCalls( time );
+  }
+}
+
+double Benchmark::measure()
+{
+  return runBatch( _calls ) / _calls;
+}
+
+void Benchmark::run( Profile& profile )
+{
+  calibrate();
+
+  profile.beginLoop( _name );
+  for( size_t i=0; i<_repetitions; i++ )
+  {
+    profile.beginIteration( i );
+    double time( measure() );
+
+    profile.addValue( "calls", _calls );
+    profile.addValue( "call time", Value( time * nanoseconds, "ns" ) );
+    profile.endIteration( microseconds );
+  }
+  profile.endLoop();
+}
+
+/*
+ * PairedBenchmark
+ */
+
+PairedBenchmark::PairedBenchmark( const string& name, const Benchmark::Function& first, const Benchmark::Function& second
+                                ) : _first( name, first ),
+                                    _second( name, second ),
+                                    _name( name ),
+                                    _repetitions( 30 ),
+                                    _confidence( 0.95 ),
+                                    _seed( 1 ),
+                                    _result()
+{
+  _result.ratio = 1.0;
+  _result.lower = 1.0;
+  _result.upper = 1.0;
+  _result.significant = false;
+}
+
+string& PairedBenchmark::name()
+{
+  return _name;
+}
+
+double& PairedBenchmark::warmupTime()
+{
+  return _first.warmupTime();
+}
+
+double& PairedBenchmark::repetitionTime()
+{
+  return _first.repetitionTime();
+}
+
+size_t& PairedBenchmark::repetitions()
+{
+  return _repetitions;
+}
+
+double& PairedBenchmark::confidence()
+{
+  return _confidence;
+}
+
+unsigned int& PairedBenchmark::seed()
+{
+  return _seed;
+}
+
+const PairedBenchmark::Result& PairedBenchmark::run( Profile& profile )
+{
+  _second.warmupTime() = _first.warmupTime();
+  _second.repetitionTime() = _first.repetitionTime();
+
+  _first.calibrate();
+  _second.calibrate();
+
+  unsigned int seed( _seed );
+  vector< double > logRatios;
+
+  profile.beginLoop( _name );
+  for( size_t i=0; i<_repetitions; i++ )
+  {
+    profile.beginIteration( i );
+
+    bool firstAhead( rand_r( &seed ) % 2 == 0 );
+    double first;
+    double second;
+    if( firstAhead )
+    {
+      first = _first.measure();
+      second = _second.measure();
+    }
+    else
+    {
+      second = _second.measure();
+      first = _first.measure();
+    }
+
+    profile.addValue( "first time", Value( first * nanoseconds, "ns" ) );
+    profile.addValue( "second time", Value( second * nanoseconds, "ns" ) );
+    profile.addValue( "order", string( firstAhead ? "first" : "second" ) );
+    profile.endIteration( microseconds );
+
+    if( first > 0.0 && second > 0.0 )
+      logRatios.push_back( std::log( second / first ) );
+  }
+  profile.endLoop();
+
+  statistics::Interval interval( statistics::meanInterval( logRatios, _confidence ) );
+  _result.ratio = std::exp( statistics::mean( logRatios ) );
+  _result.lower = std::exp( interval.lower );
+  _result.upper = std::exp( interval.upper );
+  _result.significant = logRatios.size() > 1 && !interval.contains( 0.0 );
+
+  return _result;
+}
+
+const PairedBenchmark::Result& PairedBenchmark::result() const
+{
+  return _result;
+}
+
+void PairedBenchmark::print( std::ostream& ostream )
+{
+  Table table;
+  table.column( 0 ).name() = "benchmark";
+  table.column( 1 ).name() = "ratio";
+  table.column( 2 ).name() = "lower";
+  table.column( 3 ).name() = "upper";
+  table.column( 4 ).name() = "significant";
+
+  Table::RowProxy row( table.newRow() );
+  row.pushBack( _name );
+  row.pushBack( _result.ratio );
+  row.pushBack( _result.lower );
+  row.pushBack( _result.upper );
+  row.pushBack( string( _result.significant ? "yes" : "no" ) );
+
+  table.print( ostream );
+}
+
+/*
+ * BenchmarkSuite
+ */
+
+BenchmarkSuite::BenchmarkSuite() : _benchmarks()
+{
+}
+
+Benchmark& BenchmarkSuite::add( const string& name, const Benchmark::Function& function )
+{
+  _benchmarks.push_back( Benchmark( name, function ) );
+  return _benchmarks.back();
+}
+
+vector< Benchmark >& BenchmarkSuite::benchmarks()
+{
+  return _benchmarks;
+}
+
+void BenchmarkSuite::run( Profile& profile )
+{
+  BOOST_FOREACH( Benchmark& benchmark, _benchmarks )
+    benchmark.run( profile );
+}
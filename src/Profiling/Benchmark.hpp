@@ -0,0 +1,167 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_BENCHMARK_HPP
+#define BURNING_PROFILING_BENCHMARK_HPP
+
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include "Profile.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Prevents compiler from optimizing away computation of value */
+    template< class T >
+    inline void doNotOptimize( const T& value )
+    {
+      asm volatile( "" : : "r,m"( value ) : "memory" );
+    }
+
+    /*! Forces compiler to assume that any memory may be read or written here */
+    inline void clobberMemory()
+    {
+      asm volatile( "" : : : "memory" );
+    }
+
+    /*! A microbenchmark of single function.
+     *  Function is called in batches, count of calls in batch is scaled to reach repetition time.
+     *  Each timed repetition is recorded as an iteration of benchmark's loop phase
+     *  with "calls" and "call time" values.
+     */
+    class Benchmark
+    {
+    public:
+      /*! A benchmarked function */
+      typedef boost::function< void () > Function;
+
+      /*! Constructs benchmark of function */
+      Benchmark( const std::string& name, const Function& function );
+
+      /*! Name of benchmark's loop phase */
+      std::string& name();
+      /*! Time of warmup in seconds. 0.1 by default */
+      double& warmupTime();
+      /*! Minimal time of single repetition in seconds. 0.01 by default */
+      double& repetitionTime();
+      /*! Count of timed repetitions. 10 by default */
+      size_t& repetitions();
+
+      /*! Count of calls in each repetition chosen by last calibration */
+      size_t calls() const;
+
+      /*! Warms function up and chooses count of calls in repetition */
+      void calibrate();
+      /*! Runs one repetition. Returns mean time of call in seconds. */
+      double measure();
+
+      /*! Runs benchmark recording results to profile */
+      void run( Profile& profile );
+
+    private:
+      double runBatch( size_t calls );
+      void scaleCalls( double time );
+
+      std::string _name;
+      Function _function;
+
+      double _warmupTime;
+      double _repetitionTime;
+      size_t _repetitions;
+
+      size_t _calls;
+    };
+
+    /*! Compares two implementations in one process.
+     *  Repetitions of both functions alternate in pseudo random order inside one loop phase,
+     *  so frequency scaling and noisy neighbours affect both of them equally.
+     *  Each iteration gets "first time" and "second time" values with mean call times.
+     */
+    class PairedBenchmark
+    {
+    public:
+      /*! Constructs comparison of second function with first one */
+      PairedBenchmark( const std::string& name, const Benchmark::Function& first, const Benchmark::Function& second );
+
+      /*! Name of benchmark's loop phase */
+      std::string& name();
+      /*! Time of warmup for each function in seconds. 0.1 by default */
+      double& warmupTime();
+      /*! Minimal time of single repetition in seconds. 0.01 by default */
+      double& repetitionTime();
+      /*! Count of repetitions for each function. 30 by default */
+      size_t& repetitions();
+      /*! Confidence level of ratio's interval. 0.95 by default */
+      double& confidence();
+      /*! Seed for order of repetitions */
+      unsigned int& seed();
+
+      /*! Paired comparison of functions */
+      struct Result
+      {
+	/*! Geometric mean of second to first call time ratios */
+	double ratio;
+	/*! Confidence interval for ratio */
+	double lower;
+	double upper;
+	/*! True if interval does not contain 1 */
+	bool significant;
+      };
+
+      /*! Runs benchmark recording results to profile */
+      const Result& run( Profile& profile );
+      /*! Result of last run */
+      const Result& result() const;
+
+      /*! Prints result of last run */
+      void print( std::ostream& ostream = std::cout );
+
+    private:
+      Benchmark _first;
+      Benchmark _second;
+
+      std::string _name;
+      size_t _repetitions;
+      double _confidence;
+      unsigned int _seed;
+
+      Result _result;
+    };
+
+    /*! A collection of benchmarks */
+    class BenchmarkSuite
+    {
+    public:
+      BenchmarkSuite();
+
+      /*! Registers new benchmark. Returns it for setting options, reference is valid until next add. */
+      Benchmark& add( const std::string& name, const Benchmark::Function& function );
+
+      /*! Registered benchmarks */
+      std::vector< Benchmark >& benchmarks();
+
+      /*! Runs all benchmarks recording results to profile */
+      void run( Profile& profile );
+
+    private:
+      std::vector< Benchmark > _benchmarks;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,463 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <vector>
+#include <glog/logging.h>
+#include "ColumnExport.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+namespace
+{
+  /*! Phases sharing a path, their iterations are rows of path's columns */
+  struct PathRows
+  {
+    PathRows() : phases(), parents(), rows( 0 )
+    {
+    }
+    
+    vector< const Phase* > phases;
+    /*! Row of enclosing path each phase belongs to */
+    vector< size_t > parents;
+    size_t rows;
+  };
+  
+  typedef std::map< string, PathRows > PathMap;
+  
+  enum ColumnType
+  {
+    integerColumn,
+    realColumn,
+    textColumn
+  };
+  
+  /*! Cells of a column taken from phases */
+  class Column
+  {
+  public:
+    virtual ~Column()
+    {
+    }
+    
+    /*! Takes cell of phase's iteration and its measure, returns false if it is missing */
+    virtual bool cell( const Phase& phase, size_t iteration, xml::Attribute& cell, const string*& measure ) const = 0;
+  };
+  
+  const string noMeasure;
+  const string nanosecondsMeasure( "ns" );
+  
+  class IterationColumn : public Column
+  {
+  public:
+    bool cell( const Phase& phase, size_t iteration, xml::Attribute& cell, const string*& measure ) const
+    {
+      cell = phase.iterations()[ iteration ];
+      measure = &noMeasure;
+      return true;
+    }
+  };
+  
+  class ValueColumn : public Column
+  {
+  public:
+    ValueColumn( const string& name ) : _name( name )
+    {
+    }
+    
+    bool cell( const Phase& phase, size_t iteration, xml::Attribute& cell, const string*& measure ) const
+    {
+      const Value* found( value( phase, iteration ) );
+      if( found == NULL )
+	return false;
+      
+      cell = found->value();
+      measure = &found->measure();
+      return true;
+    }
+    
+  protected:
+    const Value* value( const Phase& phase, size_t iteration ) const
+    {
+      Phase::ValueMap::const_iterator values( phase.values().find( _name ) );
+      if( values == phase.values().end() || iteration >= values->second.size() )
+	return NULL;
+      return &values->second[ iteration ];
+    }
+    
+  private:
+    string _name;
+  };
+  
+  /*! Durations of iterations converted to nanoseconds */
+  class TimeColumn : public ValueColumn
+  {
+  public:
+    TimeColumn() : ValueColumn( "time" )
+    {
+    }
+    
+    bool cell( const Phase& phase, size_t iteration, xml::Attribute& cell, const string*& measure ) const
+    {
+      const Value* found( value( phase, iteration ) );
+      if( found == NULL || boost::get< Decimal >( &found->rawValue() ) == NULL )
+	return false;
+      
+      double time;
+      if( !convertMeasure( found->value().as< double >(), found->measure(), "ns", time ) )
+	return false;
+      
+      cell = Decimal( static_cast< long >( time + 0.5 ) );
+      measure = &nanosecondsMeasure;
+      return true;
+    }
+  };
+  
+  /*! Cells of a column parsed in one pass. Integers are kept until the first other cell,
+   *  then all numbers are kept as reals, texts are kept only by text columns.
+   */
+  struct ParsedColumn
+  {
+    ParsedColumn() : type( integerColumn ), width( 1 ), measure(), measured( false ), integers(), reals(), texts()
+    {
+    }
+    
+    ColumnType type;
+    size_t width;
+    string measure;
+    bool measured;
+    
+    vector< long long > integers;
+    vector< double > reals;
+    vector< string > texts;
+  };
+}
+
+static void collectPaths( const Phase& phase, const string& path, size_t firstRow, PathMap& paths )
+{
+  for( size_t i=0; i<phase.iterations().size(); i++ )
+    for( Phase::PhaseMap::const_iterator phases = phase.phases().begin(); phases != phase.phases().end(); ++phases )
+    {
+      if( i >= phases->second.size() )
+	continue;
+      
+      string subpath( path.empty() ? phases->first : path + '/' + phases->first );
+      const Phase& subphase( *phases->second[ i ] );
+      
+      PathRows& rows( paths[ subpath ] );
+      rows.phases.push_back( &subphase );
+      rows.parents.push_back( firstRow + i );
+      size_t first( rows.rows );
+      rows.rows += subphase.iterations().size();
+      
+      collectPaths( subphase, subpath, first, paths );
+    }
+}
+
+static bool isDecimal( xml::Attribute& cell )
+{
+  return boost::get< Decimal >( &cell.value() ) != NULL;
+}
+
+static void addText( ParsedColumn& parsed, bool found, xml::Attribute& cell )
+{
+  parsed.texts.push_back( found ? cell.as< string >() : string() );
+  parsed.width = std::max( parsed.width, parsed.texts.back().size() );
+}
+
+static void toReals( ParsedColumn& parsed )
+{
+  parsed.type = realColumn;
+  parsed.reals.assign( parsed.integers.begin(), parsed.integers.end() );
+  vector< long long >().swap( parsed.integers );
+}
+
+// Column turns to text at its first non numeric cell, only cells before it are read again
+static void toTexts( ParsedColumn& parsed, const PathRows& rows, const Column& column, size_t count )
+{
+  parsed.type = textColumn;
+  vector< long long >().swap( parsed.integers );
+  vector< double >().swap( parsed.reals );
+  
+  xml::Attribute cell;
+  const string* measure;
+  for( size_t i=0; i<rows.phases.size() && parsed.texts.size() < count; i++ )
+    for( size_t j=0; j<rows.phases[ i ]->iterations().size() && parsed.texts.size() < count; j++ )
+    {
+      bool found( column.cell( *rows.phases[ i ], j, cell, measure ) );
+      addText( parsed, found, cell );
+    }
+}
+
+// Reads and parses each cell of column once
+static void parseColumn( const PathRows& rows, const Column& column, ParsedColumn& parsed )
+{
+  const double missing( std::numeric_limits< double >::quiet_NaN() );
+  
+  xml::Attribute cell;
+  const string* measure;
+  size_t row( 0 );
+  for( size_t i=0; i<rows.phases.size(); i++ )
+    for( size_t j=0; j<rows.phases[ i ]->iterations().size(); j++, row++ )
+    {
+      bool found( column.cell( *rows.phases[ i ], j, cell, measure ) );
+      if( found && !parsed.measured )
+      {
+	parsed.measure = *measure;
+	parsed.measured = true;
+      }
+      
+      if( parsed.type != textColumn && found && !isDecimal( cell ) )
+	toTexts( parsed, rows, column, row );
+      if( parsed.type == textColumn )
+      {
+	addText( parsed, found, cell );
+	continue;
+      }
+      
+      if( !found )
+      {
+	if( parsed.type == integerColumn )
+	  toReals( parsed );
+	parsed.reals.push_back( missing );
+	continue;
+      }
+      
+      string text( cell.as< string >() );
+      char* end;
+      if( parsed.type == integerColumn )
+      {
+	errno = 0;
+	long long number( strtoll( text.c_str(), &end, 10 ) );
+	if( !text.empty() && *end == '\0' && errno == 0 )
+	{
+	  parsed.integers.push_back( number );
+	  continue;
+	}
+	toReals( parsed );
+      }
+      parsed.reals.push_back( strtod( text.c_str(), &end ) );
+    }
+}
+
+static void writeLittleEndian( std::ostream& stream, uint64_t value, size_t size )
+{
+  char bytes[ 8 ];
+  for( size_t i=0; i<size; i++ )
+  {
+    bytes[ i ] = char( value & 0xff );
+    value >>= 8;
+  }
+  stream.write( bytes, size );
+}
+
+static void writeHeader( std::ostream& stream, const string& type, size_t rows )
+{
+  string header( "{'descr': '" + type + "', 'fortran_order': False, 'shape': (" +
+		 boost::lexical_cast< string >( rows ) + ",), }" );
+  // Magic, version and header's length take 10 bytes, header ends with newline and aligns data to 64 bytes
+  header.append( ( 64 - ( 11 + header.size() ) % 64 ) % 64, ' ' );
+  header += '\n';
+  
+  stream.write( "\x93NUMPY\x01\x00", 8 );
+  writeLittleEndian( stream, header.size(), 2 );
+  stream << header;
+}
+
+// Name usable as file name
+static string fileName( const string& name )
+{
+  string ret( name );
+  std::replace( ret.begin(), ret.end(), '/', '_' );
+  if( ret.empty() || ret == "." || ret == ".." )
+    ret = '_' + ret;
+  return ret;
+}
+
+// Files of values named like generated columns or starting with underscore get underscore prefix,
+// so they never overwrite generated columns nor each other
+static string valueFile( const string& name )
+{
+  if( name == "iteration" || name == "parent" || ( !name.empty() && name[ 0 ] == '_' ) )
+    return '_' + name;
+  return name;
+}
+
+// Directory of path's columns relative to exported directory
+static string pathDirectory( const string& path )
+{
+  string ret;
+  size_t begin( 0 );
+  for(;;)
+  {
+    size_t end( path.find( '/', begin ) );
+    ret += fileName( path.substr( begin, end - begin ) );
+    if( end == string::npos )
+      return ret;
+    
+    ret += '/';
+    begin = end + 1;
+  }
+}
+
+static bool makeDirectory( const string& path )
+{
+  if( mkdir( path.c_str(), 0777 ) == 0 || errno == EEXIST )
+    return true;
+  
+  LOG( ERROR ) << "Cannot create directory " << path << ": " << strerror( errno ) << '.';
+  return false;
+}
+
+static bool openColumn( std::ofstream& stream, const string& directory, const string& name, const string& fileStem,
+			const string& type, const string& measure, const string& path, const PathRows& rows,
+			std::ostream& manifest )
+{
+  string file( pathDirectory( path ) + '/' + fileName( fileStem ) + ".npy" );
+  string fullName( directory + '/' + file );
+  stream.open( fullName.c_str(), std::ios::binary );
+  if( !stream )
+  {
+    LOG( ERROR ) << "Cannot open " << fullName << '.';
+    return false;
+  }
+  
+  writeHeader( stream, type, rows.rows );
+  manifest << path << '\t' << name << '\t' << file << '\t' << type << '\t' << measure << '\t' << rows.rows << '\n';
+  return true;
+}
+
+static void writeReal( std::ostream& stream, double number )
+{
+  uint64_t bits;
+  memcpy( &bits, &number, sizeof( bits ) );
+  writeLittleEndian( stream, bits, 8 );
+}
+
+static bool writeColumn( const string& directory, const string& path, const PathRows& rows, const string& name,
+			 const string& file, const Column& column, std::ostream& manifest )
+{
+  ParsedColumn parsed;
+  parseColumn( rows, column, parsed );
+  
+  string descr( parsed.type == integerColumn ? "<i8" : parsed.type == realColumn ? "<f8" :
+		"|S" + boost::lexical_cast< string >( parsed.width ) );
+  std::ofstream stream;
+  if( !openColumn( stream, directory, name, file, descr, parsed.measure, path, rows, manifest ) )
+    return false;
+  
+  for( size_t i=0; i<parsed.integers.size(); i++ )
+    writeLittleEndian( stream, parsed.integers[ i ], 8 );
+  for( size_t i=0; i<parsed.reals.size(); i++ )
+    writeReal( stream, parsed.reals[ i ] );
+  for( size_t i=0; i<parsed.texts.size(); i++ )
+  {
+    parsed.texts[ i ].resize( parsed.width, '\0' );
+    stream.write( parsed.texts[ i ].data(), parsed.width );
+  }
+  
+  return stream.good();
+}
+
+static bool writeParents( const string& directory, const string& path, const PathRows& rows, std::ostream& manifest )
+{
+  std::ofstream stream;
+  if( !openColumn( stream, directory, "parent", "parent", "<i8", "", path, rows, manifest ) )
+    return false;
+  
+  for( size_t i=0; i<rows.phases.size(); i++ )
+    for( size_t j=0; j<rows.phases[ i ]->iterations().size(); j++ )
+      writeLittleEndian( stream, rows.parents[ i ], 8 );
+  
+  return stream.good();
+}
+
+static bool writePath( const string& directory, const string& path, const PathRows& rows, std::ostream& manifest )
+{
+  string relative( pathDirectory( path ) );
+  for( size_t end=relative.find( '/' ); end != string::npos; end = relative.find( '/', end + 1 ) )
+    if( !makeDirectory( directory + '/' + relative.substr( 0, end ) ) )
+      return false;
+  if( !makeDirectory( directory + '/' + relative ) )
+    return false;
+  
+  if( !writeColumn( directory, path, rows, "iteration", "iteration", IterationColumn(), manifest ) )
+    return false;
+  if( path.find( '/' ) != string::npos && !writeParents( directory, path, rows, manifest ) )
+    return false;
+  
+  // Phases of a path may have different values after merges
+  std::map< string, bool > names;
+  for( size_t i=0; i<rows.phases.size(); i++ )
+    for( Phase::ValueMap::const_iterator value = rows.phases[ i ]->values().begin();
+	 value != rows.phases[ i ]->values().end(); ++value )
+      names[ value->first ] = true;
+  
+  for( std::map< string, bool >::const_iterator name = names.begin(); name != names.end(); ++name )
+  {
+    string file( valueFile( name->first ) );
+    bool written( name->first == "time" ? writeColumn( directory, path, rows, name->first, file, TimeColumn(), manifest )
+		  : writeColumn( directory, path, rows, name->first, file, ValueColumn( name->first ), manifest ) );
+    if( !written )
+      return false;
+  }
+  
+  return true;
+}
+
+ColumnExport::ColumnExport( Profile& profile ) : _profile( profile )
+{
+}
+
+bool ColumnExport::write( const string& directory )
+{
+  if( !makeDirectory( directory ) )
+    return false;
+  
+  string manifestFile( directory + "/columns.tsv" );
+  std::ofstream manifest( manifestFile.c_str() );
+  if( !manifest )
+  {
+    LOG( ERROR ) << "Cannot open " << manifestFile << '.';
+    return false;
+  }
+  manifest << "path\tcolumn\tfile\ttype\tmeasure\trows\n";
+  
+  PathMap paths;
+  collectPaths( _profile.rootPhase(), "", 0, paths );
+  
+  for( PathMap::const_iterator path = paths.begin(); path != paths.end(); ++path )
+    if( !writePath( directory, path->first, path->second, manifest ) )
+      return false;
+  
+  if( manifest.good() )
+    return true;
+  
+  LOG( ERROR ) << "Cannot write " << manifestFile << '.';
+  return false;
+}
@@ -0,0 +1,50 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_COLUMN_EXPORT_HPP
+#define BURNING_PROFILING_COLUMN_EXPORT_HPP
+
+#include <string>
+#include "Profile.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Writes iterations of profile's phases as typed columns in numpy's .npy format.
+     *  Every phase path gets a directory with an "iteration" column of iteration names, a "time" column
+     *  in nanoseconds and a column per value, rows are iterations of all phases with the path in profile's order.
+     *  Nested paths also get a "parent" column with rows of enclosing path's iterations.
+     *  Files of values named "iteration", "parent" or starting with underscore get an underscore prefix.
+     *  Columns of integers are int64, other numeric columns are float64 with NaN for missing values,
+     *  columns with strings are fixed width byte strings. Paths, names, types and measures of columns are
+     *  listed in tab separated "columns.tsv" of the directory.
+     */
+    class ColumnExport
+    {
+    public:
+      ColumnExport( Profile& profile );
+      
+      /*! Writes columns into directory, creating it if needed. Returns false on failure. */
+      bool write( const std::string& directory );
+      
+    private:
+      Profile& _profile;
+    };
+  }
+}
+
+#endif
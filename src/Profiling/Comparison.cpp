@@ -0,0 +1,198 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <boost/foreach.hpp>
+#include "Query.hpp"
+#include "Statistics.hpp"
+#include "Table.hpp"
+#include "Comparison.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+Comparison::Comparison( Profile& base, Profile& current ) : _base( base ),
+                                                            _current( current ),
+                                                            _value( "time" ),
+                                                            _method( mannWhitneyMethod ),
+                                                            _level( 0.05 ),
+                                                            _minimalChange( 0.01 ),
+                                                            _minimalSamples( 8 ),
+                                                            _differences(),
+                                                            _compared( false )
+{
+}
+
+string& Comparison::value()
+{
+  _compared = false;
+  return _value;
+}
+
+Comparison::Method& Comparison::method()
+{
+  _compared = false;
+  return _method;
+}
+
+double& Comparison::level()
+{
+  _compared = false;
+  return _level;
+}
+
+double& Comparison::minimalChange()
+{
+  _compared = false;
+  return _minimalChange;
+}
+
+size_t& Comparison::minimalSamples()
+{
+  _compared = false;
+  return _minimalSamples;
+}
+
+void Comparison::collect( Profile& profile, SampleMap& samples )
+{
+  ProfileIndex index( profile );
+  BOOST_FOREACH( const ProfileIndex::Path& path, index.paths() )
+  {
+    std::map< string, vector< double > >::const_iterator column( path.values.find( _value ) );
+    if( column == path.values.end() )
+      continue;
+
+    Samples& pathSamples( samples[ path.path ] );
+    pathSamples.measure = path.measures.count( _value ) > 0 ? path.measures.find( _value )->second : "";
+    BOOST_FOREACH( double number, column->second )
+      if( !std::isnan( number ) )
+	pathSamples.values.push_back( number );
+  }
+}
+
+void Comparison::compare()
+{
+  SampleMap base;
+  SampleMap current;
+  collect( _base, base );
+  collect( _current, current );
+
+  _differences.clear();
+
+  std::pair< string, Samples > samples;
+  BOOST_FOREACH( samples, base )
+  {
+    SampleMap::iterator currentSamples( current.find( samples.first ) );
+    if( currentSamples == current.end() )
+      continue;
+
+    vector< double >& first( samples.second.values );
+    vector< double >& second( currentSamples->second.values );
+    if( first.size() < _minimalSamples || second.size() < _minimalSamples )
+      continue;
+
+    double scale;
+    if( !convertMeasure( 1.0, currentSamples->second.measure, samples.second.measure, scale ) )
+    {
+      LOG( WARNING ) << "Cannot compare " << samples.first << " measured in " << samples.second.measure
+	             << " and " << currentSamples->second.measure;
+      continue;
+    }
+    BOOST_FOREACH( double& value, second )
+      value *= scale;
+
+    Difference difference;
+    difference.path = samples.first;
+    difference.measure = samples.second.measure;
+    difference.baseSamples = first.size();
+    difference.currentSamples = second.size();
+    difference.baseMedian = statistics::median( first );
+    difference.currentMedian = statistics::median( second );
+    difference.ratio = difference.baseMedian == 0.0 ? 1.0 : difference.currentMedian / difference.baseMedian;
+
+    statistics::RankTest test( statistics::mannWhitney( first, second ) );
+    difference.pValue = test.pValue;
+    difference.confidence = 1.0 - test.pValue;
+    difference.effect = test.effect;
+
+    statistics::Interval interval( statistics::bootstrapMedianRatio( first, second, 1.0 - _level ) );
+    difference.lower = interval.lower;
+    difference.upper = interval.upper;
+
+    bool significant;
+    if( _method == mannWhitneyMethod )
+      significant = test.pValue < _level;
+    else
+      significant = !interval.contains( 1.0 );
+
+    difference.significant = significant && std::fabs( difference.ratio - 1.0 ) >= _minimalChange;
+
+    _differences.push_back( difference );
+  }
+
+  _compared = true;
+}
+
+const Comparison::DifferenceVector& Comparison::differences()
+{
+  if( !_compared )
+    compare();
+
+  return _differences;
+}
+
+Comparison::DifferenceVector Comparison::significantDifferences()
+{
+  DifferenceVector ret;
+  BOOST_FOREACH( const Difference& difference, differences() )
+    if( difference.significant )
+      ret.push_back( difference );
+
+  return ret;
+}
+
+void Comparison::print( std::ostream& ostream, bool significantOnly )
+{
+  Table table;
+  table.column( 0 ).name() = "phase";
+  table.column( 1 ).name() = "base";
+  table.column( 2 ).name() = "current";
+  table.column( 3 ).name() = "ratio";
+  table.column( 4 ).name() = "interval";
+  table.column( 5 ).name() = "p-value";
+  table.column( 6 ).name() = "effect";
+  table.column( 7 ).name() = "significant";
+
+  BOOST_FOREACH( const Difference& difference, differences() )
+  {
+    if( significantOnly && !difference.significant )
+      continue;
+
+    Table::RowProxy row( table.newRow() );
+    row.pushBack( difference.path );
+    row.pushBack( Value( difference.baseMedian, difference.measure ) );
+    row.pushBack( Value( difference.currentMedian, difference.measure ) );
+    row.pushBack( difference.ratio );
+    row.pushBack( boost::lexical_cast< string >( difference.lower ) + " - " + boost::lexical_cast< string >( difference.upper ) );
+    row.pushBack( difference.pValue );
+    row.pushBack( difference.effect );
+    row.pushBack( string( difference.significant ? "yes" : "no" ) );
+  }
+
+  table.print( ostream );
+}
@@ -0,0 +1,127 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_COMPARISON_HPP
+#define BURNING_PROFILING_COMPARISON_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "Profile.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Compares two profiles using statistical tests.
+     *  All samples of a value for phases with the same name path (e.g. "main/loop/parse")
+     *  are collected from both profiles and their distributions are compared.
+     */
+    class Comparison
+    {
+    public:
+      /*! Method used for deciding that change is significant */
+      enum Method
+      {
+	/*! Mann-Whitney U test p-value must be less than significance level */
+	mannWhitneyMethod,
+	/*! Bootstrap confidence interval for medians ratio must not contain 1 */
+	bootstrapMethod
+      };
+
+      /*! Constructs comparison of current profile with base one */
+      Comparison( Profile& base, Profile& current );
+
+      /*! Name of compared value. "time" by default */
+      std::string& value();
+      /*! Method of significance testing */
+      Method& method();
+      /*! Significance level. 0.05 by default */
+      double& level();
+      /*! Minimal relative change of median that is reported. 0.01 by default */
+      double& minimalChange();
+      /*! Minimal count of samples in both profiles needed for comparison. 8 by default */
+      size_t& minimalSamples();
+
+      /*! Result of comparison for a single phase */
+      struct Difference
+      {
+	/*! Name path of phase */
+	std::string path;
+	/*! Measure of compared values */
+	std::string measure;
+
+	size_t baseSamples;
+	size_t currentSamples;
+
+	double baseMedian;
+	double currentMedian;
+
+	/*! Ratio of current median to base median */
+	double ratio;
+	/*! Confidence interval for ratio */
+	double lower;
+	double upper;
+
+	/*! Mann-Whitney test p-value */
+	double pValue;
+	/*! Confidence of change, 1 - pValue */
+	double confidence;
+	/*! Cliff's delta effect size, positive when current values are greater */
+	double effect;
+
+	/*! True if change is statistically meaningful */
+	bool significant;
+      };
+      typedef std::vector< Difference > DifferenceVector;
+
+      /*! Compares profiles. Returns results for all phases having enough samples. */
+      const DifferenceVector& differences();
+      /*! Results for statistically meaningful changes only */
+      DifferenceVector significantDifferences();
+
+      /*! Prints comparison as a table */
+      void print( std::ostream& ostream = std::cout, bool significantOnly = false );
+
+    private:
+      struct Samples
+      {
+	std::vector< double > values;
+	std::string measure;
+      };
+      typedef std::map< std::string, Samples > SampleMap;
+
+      /*! Collects numeric values of profile's paths from its index */
+      void collect( Profile& profile, SampleMap& samples );
+      void compare();
+
+      Profile& _base;
+      Profile& _current;
+
+      std::string _value;
+      Method _method;
+      double _level;
+      double _minimalChange;
+      size_t _minimalSamples;
+
+      DifferenceVector _differences;
+      bool _compared;
+    };
+  }
+}
+
+#endif
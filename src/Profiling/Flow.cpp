@@ -0,0 +1,161 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "Profiling.hpp"
+#include "Flow.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+long profiling::currentThread()
+{
+  return syscall( SYS_gettid );
+}
+
+TaskRecord::TaskRecord() : flow(),
+                           spawner(),
+                           iteration( string( "" ) ),
+                           begun( 0 ),
+                           finished( 0 ),
+                           spawnThread( 0 ),
+                           finishThread( 0 )
+{
+}
+
+long long TaskRecord::duration() const
+{
+  return finished - begun;
+}
+
+/*
+ * FlowLog
+ */
+
+const size_t FlowLog::defaultMaximalTasks;
+
+FlowLog::FlowLog() : _origin( clockNanoseconds( CLOCK_MONOTONIC ) ),
+                     _maximalTasks( defaultMaximalTasks ),
+                     _tasks(),
+                     _dropped()
+{
+  pthread_mutex_init( &_lock, NULL );
+}
+
+FlowLog::~FlowLog()
+{
+  pthread_mutex_destroy( &_lock );
+}
+
+long long FlowLog::now() const
+{
+  return clockNanoseconds( CLOCK_MONOTONIC ) - _origin;
+}
+
+// Called with lock held
+void FlowLog::dropOldest()
+{
+  _dropped[ _tasks.front().flow ]++;
+  _tasks.pop_front();
+}
+
+void FlowLog::setMaximalTasks( size_t count )
+{
+  pthread_mutex_lock( &_lock );
+  _maximalTasks = count;
+  while( _tasks.size() > _maximalTasks )
+    dropOldest();
+  pthread_mutex_unlock( &_lock );
+}
+
+void FlowLog::add( const TaskRecord& task )
+{
+  pthread_mutex_lock( &_lock );
+  _tasks.push_back( task );
+  if( _tasks.size() > _maximalTasks )
+    dropOldest();
+  pthread_mutex_unlock( &_lock );
+}
+
+void FlowLog::addDropped( const string& flow, size_t count )
+{
+  pthread_mutex_lock( &_lock );
+  _dropped[ flow ] += count;
+  pthread_mutex_unlock( &_lock );
+}
+
+vector< TaskRecord > FlowLog::tasks() const
+{
+  pthread_mutex_lock( &_lock );
+  vector< TaskRecord > ret( _tasks.begin(), _tasks.end() );
+  pthread_mutex_unlock( &_lock );
+
+  return ret;
+}
+
+std::map< string, size_t > FlowLog::dropped() const
+{
+  pthread_mutex_lock( &_lock );
+  std::map< string, size_t > ret( _dropped );
+  pthread_mutex_unlock( &_lock );
+
+  return ret;
+}
+
+/*
+ * Task
+ */
+
+struct Task::Pending
+{
+  Pending( const std::tr1::shared_ptr< FlowLog >& log, const TaskRecord& record ) : log( log ),
+                                                                                   record( record ),
+                                                                                   finished( 0 )
+  {
+  }
+
+  std::tr1::shared_ptr< FlowLog > log;
+  TaskRecord record;
+  volatile int finished;
+};
+
+Task::Task() : _pending()
+{
+}
+
+Task::Task( const std::tr1::shared_ptr< FlowLog >& log, const TaskRecord& record ) : _pending( new Pending( log, record ) )
+{
+}
+
+void Task::finish()
+{
+  if( !_pending || !__sync_bool_compare_and_swap( &_pending->finished, 0, 1 ) )
+    return;
+
+  TaskRecord& record( _pending->record );
+  record.finished = _pending->log->now();
+  record.finishThread = currentThread();
+
+  _pending->log->add( record );
+}
+
+bool Task::active() const
+{
+  return _pending && _pending->finished == 0;
+}
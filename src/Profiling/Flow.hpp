@@ -0,0 +1,124 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_FLOW_HPP
+#define BURNING_PROFILING_FLOW_HPP
+
+#include <pthread.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/tr1/memory.hpp>
+#include <Xml/Attribute.hpp>
+
+namespace burning
+{
+  class Profile;
+
+  namespace profiling
+  {
+    /*! Task of a logical flow finished on any thread. Times are in nanoseconds since profile began. */
+    struct TaskRecord
+    {
+      TaskRecord();
+
+      /*! Name of logical flow */
+      std::string flow;
+      /*! Path of phase task was begun in */
+      std::string spawner;
+      /*! Iteration of spawning phase */
+      xml::Attribute iteration;
+
+      long long begun;
+      long long finished;
+      /*! Kernel ids of threads task was begun and finished on */
+      long spawnThread;
+      long finishThread;
+
+      long long duration() const;
+    };
+
+    /*! Tasks finished by threads, shared by profile and its tasks.
+     *  Log keeps at most maximalTasks latest tasks, older ones are dropped and counted by flows,
+     *  so long running services do not grow it without limit.
+     */
+    class FlowLog
+    {
+    public:
+      /*! Count of tasks kept by default */
+      static const size_t defaultMaximalTasks = 100000;
+
+      FlowLog();
+      ~FlowLog();
+
+      /*! Time in nanoseconds since log was created */
+      long long now() const;
+
+      /*! Changes count of kept tasks, dropping oldest ones over it */
+      void setMaximalTasks( size_t count );
+
+      void add( const TaskRecord& task );
+      /*! Counts tasks of flow dropped elsewhere, e.g. by merged profile */
+      void addDropped( const std::string& flow, size_t count );
+
+      /*! Kept tasks from oldest to latest */
+      std::vector< TaskRecord > tasks() const;
+      /*! Counts of dropped tasks by flows */
+      std::map< std::string, size_t > dropped() const;
+
+    private:
+      FlowLog( const FlowLog& );
+      void operator=( const FlowLog& );
+
+      void dropOldest();
+
+      mutable pthread_mutex_t _lock;
+      long long _origin;
+      size_t _maximalTasks;
+      std::deque< TaskRecord > _tasks;
+      std::map< std::string, size_t > _dropped;
+    };
+
+    /*! Handle of task begun by profile. It may be finished on any thread, copies share one task.
+     *  Task keeps its log alive, so it may outlive its profile.
+     */
+    class Task
+    {
+    public:
+      /*! Constructs handle without task */
+      Task();
+
+      /*! Ends task, only first call has effect */
+      void finish();
+      /*! Checks that task was begun and is not finished yet */
+      bool active() const;
+
+    private:
+      friend class burning::Profile;
+
+      struct Pending;
+      Task( const std::tr1::shared_ptr< FlowLog >& log, const TaskRecord& record );
+
+      std::tr1::shared_ptr< Pending > _pending;
+    };
+
+    /*! Kernel id of calling thread */
+    long currentThread();
+  }
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <boost/foreach.hpp>
+#include "Query.hpp"
+#include "Table.hpp"
+#include "Grouping.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+Grouping::Grouping( Profile& profile, const string& key ) : _profile( profile ),
+                                                             _key( key ),
+                                                             _value( "time" ),
+                                                             _path(),
+                                                             _filters(),
+                                                             _groups(),
+                                                             _grouped( false )
+{
+}
+
+string& Grouping::value()
+{
+  _grouped = false;
+  return _value;
+}
+
+string& Grouping::path()
+{
+  _grouped = false;
+  return _path;
+}
+
+void Grouping::filter( const string& key, const string& value )
+{
+  _grouped = false;
+  _filters.push_back( std::make_pair( key, value ) );
+}
+
+void Grouping::group()
+{
+  ProfileIndex index( _profile );
+
+  vector< std::pair< string, size_t > > paths;
+  for( size_t i=0; i<index.paths().size(); i++ )
+    if( _path.empty() || index.paths()[ i ].path == _path )
+      paths.push_back( std::make_pair( index.paths()[ i ].path, i ) );
+  std::sort( paths.begin(), paths.end() );
+
+  Query query( index );
+  query.value( _value );
+  query.groupBy( Query::byLabel, _key );
+  query.aggregate( "count,mean,p50,p90,p99,max" );
+  for( size_t i=0; i<_filters.size(); i++ )
+    query.where( _filters[ i ].first, _filters[ i ].second );
+
+  _groups.clear();
+  for( size_t i=0; i<paths.size(); i++ )
+  {
+    query.select( paths[ i ].first );
+    BOOST_FOREACH( const Query::Result& result, query.run() )
+    {
+      Group group;
+      group.path = paths[ i ].first;
+      group.label = result.group;
+      group.measure = result.measure;
+      group.count = static_cast< size_t >( result.aggregates[ 0 ] );
+      group.mean = result.aggregates[ 1 ];
+      group.median = result.aggregates[ 2 ];
+      group.percentile90 = result.aggregates[ 3 ];
+      group.percentile99 = result.aggregates[ 4 ];
+      group.maximum = result.aggregates[ 5 ];
+
+      _groups.push_back( group );
+    }
+  }
+
+  _grouped = true;
+}
+
+const Grouping::GroupVector& Grouping::groups()
+{
+  if( !_grouped )
+    group();
+
+  return _groups;
+}
+
+void Grouping::toTable( Table* table )
+{
+  table->column( 0 ).name() = "phase";
+  table->column( 1 ).name() = _key;
+  table->column( 2 ).name() = "count";
+  table->column( 3 ).name() = "mean";
+  table->column( 4 ).name() = "median";
+  table->column( 5 ).name() = "p90";
+  table->column( 6 ).name() = "p99";
+  table->column( 7 ).name() = "maximum";
+
+  BOOST_FOREACH( const Group& group, groups() )
+  {
+    Table::RowProxy row( table->newRow() );
+    row.pushBack( group.path );
+    row.pushBack( group.label );
+    row.pushBack( group.count );
+    row.pushBack( Value( group.mean, group.measure ) );
+    row.pushBack( Value( group.median, group.measure ) );
+    row.pushBack( Value( group.percentile90, group.measure ) );
+    row.pushBack( Value( group.percentile99, group.measure ) );
+    row.pushBack( Value( group.maximum, group.measure ) );
+  }
+}
+
+void Grouping::print( std::ostream& ostream, bool html )
+{
+  Table table;
+  toTable( &table );
+
+  if( html )
+    table.printHtml( ostream );
+  else
+    table.print( ostream );
+}
@@ -0,0 +1,91 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_GROUPING_HPP
+#define BURNING_PROFILING_GROUPING_HPP
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "Profile.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Groups samples of a value by phase labels.
+     *  Samples of iterations with the same name path and the same value of grouping label
+     *  form a group, e.g. durations of "requests/query" for tenant 42. Iterations without
+     *  grouping label form a group with empty label value.
+     *  Groups are computed by a Query grouping by label for each path of profile's index.
+     */
+    class Grouping
+    {
+    public:
+      /*! Constructs grouping of profile's phases by label key */
+      Grouping( Profile& profile, const std::string& key );
+
+      /*! Name of grouped value. "time" by default */
+      std::string& value();
+      /*! Name path of grouped phases, e.g. "requests/query". Empty path groups all phases */
+      std::string& path();
+      /*! Keeps only iterations labelled with key and value. Iterations must match all filters. */
+      void filter( const std::string& key, const std::string& value );
+
+      /*! Statistics of a group */
+      struct Group
+      {
+	/*! Name path of phase */
+	std::string path;
+	/*! Value of grouping label */
+	std::string label;
+	/*! Measure of grouped values */
+	std::string measure;
+
+	size_t count;
+	double mean;
+	double median;
+	double percentile90;
+	double percentile99;
+	double maximum;
+      };
+      typedef std::vector< Group > GroupVector;
+
+      /*! Groups ordered by paths and label values */
+      const GroupVector& groups();
+
+      /*! Writes groups to table */
+      void toTable( profiling::Table* table );
+      /*! Prints groups as a table */
+      void print( std::ostream& ostream = std::cout, bool html = false );
+
+    private:
+      void group();
+
+      Profile& _profile;
+      std::string _key;
+
+      std::string _value;
+      std::string _path;
+      std::vector< std::pair< std::string, std::string > > _filters;
+
+      GroupVector _groups;
+      bool _grouped;
+    };
+  }
+}
+
+#endif
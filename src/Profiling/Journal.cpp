@@ -0,0 +1,501 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <glog/logging.h>
+#include "Journal.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+using namespace burning::profiling::journal;
+
+// Offsets of value's name, value and measure in record's text
+static const size_t valueOffset = 48;
+static const size_t measureOffset = 80;
+
+static void copyText( char* destination, const string& source, size_t length )
+{
+  size_t size( std::min( source.size(), length - 1 ) );
+  memcpy( destination, source.data(), size );
+  destination[ size ] = '\0';
+}
+
+static string readText( const char* source, size_t length )
+{
+  return string( source, strnlen( source, length ) );
+}
+
+static bool isDecimal( const xml::Attribute::ValueType& value )
+{
+  return boost::get< Decimal >( &value ) != NULL;
+}
+
+static xml::Attribute::ValueType fromText( const string& text, bool numeric )
+{
+  if( !numeric )
+    return text;
+
+  if( text.find_first_of( ".eE" ) == string::npos )
+    return Decimal( strtol( text.c_str(), NULL, 10 ) );
+  return Decimal( strtod( text.c_str(), NULL ) );
+}
+
+/*
+ * Journal
+ */
+
+Journal::Journal( const string& path, size_t capacity ) : _path( path ),
+                                                          _size( sizeof( Header ) + capacity * sizeof( Record ) ),
+                                                          _header( NULL ),
+                                                          _records( NULL ),
+                                                          _paths()
+{
+  if( capacity == 0 )
+  {
+    LOG( ERROR ) << "Journal " << path << " must have room for records.";
+    exit( EXIT_FAILURE );
+  }
+
+  int descriptor( open( path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 ) );
+  if( descriptor < 0 )
+  {
+    LOG( ERROR ) << "Cannot create journal " << path << '.';
+    exit( EXIT_FAILURE );
+  }
+
+  void* memory( MAP_FAILED );
+  if( ftruncate( descriptor, _size ) == 0 )
+    memory = mmap( NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0 );
+  close( descriptor );
+
+  if( memory == MAP_FAILED )
+  {
+    LOG( ERROR ) << "Cannot map journal " << path << '.';
+    unlink( path.c_str() );
+    exit( EXIT_FAILURE );
+  }
+
+  // File is zero filled by ftruncate
+  _header = static_cast< Header* >( memory );
+  _records = reinterpret_cast< Record* >( _header + 1 );
+
+  _header->version = layoutVersion;
+  _header->capacity = capacity;
+  _header->pid = getpid();
+  __sync_synchronize();
+  _header->magic = magic;
+}
+
+Journal::~Journal()
+{
+  _header->closed = 1;
+  munmap( _header, _size );
+}
+
+const string& Journal::path() const
+{
+  return _path;
+}
+
+Record& Journal::newRecord( RecordType type )
+{
+  Record& ret( _records[ _header->records % _header->capacity ] );
+  ret.sequence = 0;
+  __sync_synchronize();
+
+  ret.time = clockNanoseconds( CLOCK_MONOTONIC );
+  ret.duration = 0;
+  ret.depth = _paths.size();
+  ret.type = type;
+  ret.numeric = 0;
+  ret.reserved = 0;
+  memset( ret.text, 0, textLength );
+
+  return ret;
+}
+
+void Journal::publish( Record& record )
+{
+  __sync_synchronize();
+  record.sequence = _header->records + 1;
+  __sync_synchronize();
+  _header->records++;
+}
+
+void Journal::loopBegan( const Profile& profile, size_t path )
+{
+  string name( profile.pathName( path ) );
+  if( !_paths.empty() )
+  {
+    const string& parent( profile.pathName( _paths.back() ) );
+    if( name.compare( 0, parent.size() + 1, parent + '/' ) == 0 )
+      name = name.substr( parent.size() + 1 );
+  }
+  _paths.push_back( path );
+
+  if( _paths.size() <= maximalDepth )
+  {
+    StackEntry& entry( _header->stack[ _paths.size() - 1 ] );
+    copyText( entry.loop, name, sizeof( entry.loop ) );
+    entry.iteration[ 0 ] = '\0';
+    entry.begin = 0;
+    entry.began = 0;
+    entry.numeric = 0;
+  }
+  __sync_synchronize();
+  _header->depth = _paths.size();
+
+  Record& record( newRecord( loopBegin ) );
+  copyText( record.text, name, textLength );
+  publish( record );
+}
+
+void Journal::iterationBegan( const Profile& profile, size_t )
+{
+  if( _paths.empty() )
+    return;
+
+  xml::Attribute iteration( profile.currentPhase().iterations().back() );
+  string name( iteration.as< string >() );
+  bool numeric( isDecimal( iteration.value() ) );
+
+  Record& record( newRecord( iterationBegin ) );
+  copyText( record.text, name, textLength );
+  record.numeric = numeric;
+
+  if( _paths.size() <= maximalDepth )
+  {
+    StackEntry& entry( _header->stack[ _paths.size() - 1 ] );
+    copyText( entry.iteration, name, sizeof( entry.iteration ) );
+    entry.begin = record.time;
+    entry.numeric = numeric;
+    entry.began = 1;
+  }
+
+  publish( record );
+}
+
+void Journal::valueAdded( const Profile&, size_t, const string& name, const Value& value )
+{
+  Record& record( newRecord( valueAdd ) );
+  copyText( record.text, name, valueOffset );
+  copyText( record.text + valueOffset, value.value().as< string >(), measureOffset - valueOffset );
+  copyText( record.text + measureOffset, value.measure(), textLength - measureOffset );
+  record.numeric = isDecimal( value.rawValue() );
+
+  publish( record );
+}
+
+void Journal::iterationEnded( const Profile&, size_t, long long duration )
+{
+  if( _paths.empty() )
+    return;
+
+  Record& record( newRecord( iterationEnd ) );
+  record.duration = duration;
+
+  if( _paths.size() <= maximalDepth )
+    _header->stack[ _paths.size() - 1 ].began = 0;
+
+  publish( record );
+}
+
+void Journal::loopEnded( const Profile&, size_t )
+{
+  if( _paths.empty() )
+    return;
+
+  publish( newRecord( loopEnd ) );
+
+  _paths.pop_back();
+  _header->depth = _paths.size();
+}
+
+/*
+ * Recovery
+ */
+
+namespace
+{
+  /*! A loop open while journal is replayed */
+  struct OpenLoop
+  {
+    string name;
+    string iteration;
+    long long begin;
+    bool began;
+  };
+
+  /*! Rebuilds profile from journal records */
+  class Replay
+  {
+  public:
+    Replay( const Header& header, const vector< Record >& records );
+
+    ProfilePtr profile() const
+    {
+      return _profile;
+    }
+
+  private:
+    size_t start( const Header& header, const vector< Record >& records );
+    bool apply( const Record& record );
+    void closeIteration( long long end );
+
+    ProfilePtr _profile;
+    vector< OpenLoop > _open;
+    // Depth of loop whose records are skipped, zero if none
+    size_t _skipped;
+  };
+}
+
+Replay::Replay( const Header& header, const vector< Record >& records ) : _profile( new Profile() ),
+                                                                          _open(),
+                                                                          _skipped( 0 )
+{
+  size_t dropped( 0 );
+  for( size_t i=start( header, records ); i<records.size(); i++ )
+    if( !apply( records[ i ] ) )
+      dropped++;
+
+  if( dropped > 0 )
+    LOG( WARNING ) << dropped << " journal records do not match recovered phases.";
+
+  string stack;
+  for( size_t i=0; i<_open.size(); i++ )
+  {
+    stack += ( i > 0 ? "/" : "" ) + _open[ i ].name;
+    if( _open[ i ].began && !_open[ i ].iteration.empty() )
+      stack += '[' + _open[ i ].iteration + ']';
+  }
+
+  long long end( records.empty() ? 0 : records.back().time );
+  while( !_open.empty() )
+  {
+    if( _open.back().began )
+      closeIteration( end );
+
+    _profile->endLoop();
+    _open.pop_back();
+  }
+
+  if( !header.closed )
+    _profile->addValue( "crashed in", stack );
+}
+
+// Opens loops preceding first replayed record and returns its index
+size_t Replay::start( const Header& header, const vector< Record >& records )
+{
+  if( records.empty() || records.front().sequence == 1 )
+    return 0;
+
+  // Loops shallower than earliest record did not change while ring was written, so they are taken from stack
+  uint32_t depth( records.front().depth );
+  for( size_t i=0; i<records.size(); i++ )
+    depth = std::min( depth, records[ i ].depth );
+
+  uint32_t stackDepth( header.depth );
+  stackDepth = std::min( stackDepth, maximalDepth );
+  for( depth = std::max< uint32_t >( depth, 1 ); depth <= stackDepth + 1; depth++ )
+  {
+    size_t first( records.size() );
+    for( size_t i=0; i<records.size() && first == records.size(); i++ )
+      if( records[ i ].depth == depth && records[ i ].type == loopBegin )
+	first = i;
+
+    // Without loop's begin replay starts from its iteration, so loop itself is taken from stack
+    size_t context( depth - 1 );
+    for( size_t i=0; i<records.size() && first == records.size() && depth <= stackDepth; i++ )
+      if( records[ i ].depth == depth && records[ i ].type == iterationBegin )
+      {
+	first = i;
+	context = depth;
+      }
+
+    if( first == records.size() )
+      continue;
+
+    for( size_t i=0; i<context; i++ )
+    {
+      const StackEntry& entry( header.stack[ i ] );
+      OpenLoop loop = { readText( entry.loop, sizeof( entry.loop ) ),
+			readText( entry.iteration, sizeof( entry.iteration ) ), entry.begin, i + 1 < depth };
+
+      _profile->beginLoop( loop.name );
+      if( loop.began )
+	_profile->beginIteration( fromText( loop.iteration, entry.numeric ) );
+      _open.push_back( loop );
+    }
+
+    return first;
+  }
+
+  return records.size();
+}
+
+bool Replay::apply( const Record& record )
+{
+  size_t depth( record.depth );
+  if( _skipped > 0 && depth >= _skipped )
+  {
+    if( depth == _skipped && record.type == loopEnd )
+      _skipped = 0;
+    return true;
+  }
+
+  bool began( _open.empty() || _open.back().began );
+  const Phase& current( _profile->currentPhase() );
+
+  switch( record.type )
+  {
+  case loopBegin:
+  {
+    string name( readText( record.text, textLength ) );
+    Phase::PhaseMap::const_iterator phases( current.phases().find( name ) );
+    size_t count( phases == current.phases().end() ? 0 : phases->second.size() );
+    if( depth != _open.size() + 1 || !began || count + 1 != current.iterations().size() )
+    {
+      _skipped = depth;
+      return false;
+    }
+
+    OpenLoop loop = { name, "", 0, false };
+    _profile->beginLoop( name );
+    _open.push_back( loop );
+    return true;
+  }
+  case iterationBegin:
+    if( depth != _open.size() || began )
+      return false;
+
+    _open.back().iteration = readText( record.text, textLength );
+    _open.back().begin = record.time;
+    _open.back().began = true;
+    _profile->beginIteration( fromText( _open.back().iteration, record.numeric ) );
+    return true;
+  case valueAdd:
+  {
+    string name( readText( record.text, valueOffset ) );
+    Phase::ValueMap::const_iterator values( current.values().find( name ) );
+    size_t count( values == current.values().end() ? 0 : values->second.size() );
+    if( depth != _open.size() || !began || name == "time" || count + 1 != current.iterations().size() )
+      return false;
+
+    _profile->addValue( name, Value( fromText( readText( record.text + valueOffset, measureOffset - valueOffset ),
+					       record.numeric ),
+				     readText( record.text + measureOffset, textLength - measureOffset ) ) );
+    return true;
+  }
+  case iterationEnd:
+    if( depth != _open.size() || _open.empty() || !began )
+      return false;
+
+    _profile->endMeasuredIteration( record.duration, nanoseconds );
+    _open.back().began = false;
+    return true;
+  case loopEnd:
+    if( depth != _open.size() || _open.empty() || began )
+      return false;
+
+    _profile->endLoop();
+    _open.pop_back();
+    return true;
+  }
+
+  return false;
+}
+
+// Ends iteration interrupted by end of journal. Values and subphases it did not reach are left empty.
+void Replay::closeIteration( long long end )
+{
+  const Phase& current( _profile->currentPhase() );
+  size_t iterations( current.iterations().size() );
+
+  for( Phase::ValueMap::const_iterator value = current.values().begin(); value != current.values().end(); ++value )
+    if( value->second.size() < iterations && value->first != "time" )
+      _profile->addValue( value->first, Value( string( "" ), value->second.back().measure() ) );
+
+  vector< string > missed;
+  for( Phase::PhaseMap::const_iterator phase = current.phases().begin(); phase != current.phases().end(); ++phase )
+    if( phase->second.size() < iterations )
+      missed.push_back( phase->first );
+  for( size_t i=0; i<missed.size(); i++ )
+  {
+    _profile->beginLoop( missed[ i ] );
+    _profile->endLoop();
+  }
+
+  _profile->endMeasuredIteration( std::max( 0LL, end - _open.back().begin ), nanoseconds );
+  _open.back().began = false;
+}
+
+ProfilePtr Journal::recover( const string& path )
+{
+  int descriptor( open( path.c_str(), O_RDONLY ) );
+  if( descriptor < 0 )
+  {
+    LOG( ERROR ) << "Cannot open journal " << path << '.';
+    return ProfilePtr();
+  }
+
+  struct stat status;
+  void* memory( MAP_FAILED );
+  if( fstat( descriptor, &status ) == 0 && static_cast< size_t >( status.st_size ) >= sizeof( Header ) )
+    memory = mmap( NULL, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0 );
+  close( descriptor );
+
+  if( memory == MAP_FAILED )
+  {
+    LOG( ERROR ) << path << " is not a journal.";
+    return ProfilePtr();
+  }
+
+  const Header& header( *static_cast< const Header* >( memory ) );
+  if( header.magic != magic || header.version != layoutVersion || header.capacity == 0 ||
+      sizeof( Header ) + header.capacity * sizeof( Record ) > static_cast< size_t >( status.st_size ) )
+  {
+    LOG( ERROR ) << path << " is not a journal of supported layout.";
+    munmap( memory, status.st_size );
+    return ProfilePtr();
+  }
+
+  // Slots overwritten while being read or not published are left out
+  const Record* slots( reinterpret_cast< const Record* >( &header + 1 ) );
+  uint64_t count( header.records );
+  vector< Record > records;
+  for( uint64_t i=( count > header.capacity ? count - header.capacity : 0 ); i<count; i++ )
+  {
+    Record record;
+    memcpy( &record, &slots[ i % header.capacity ], sizeof( Record ) );
+    if( record.sequence == i + 1 )
+      records.push_back( record );
+    else if( !records.empty() )
+      break;
+  }
+
+  ProfilePtr ret( Replay( header, records ).profile() );
+  munmap( memory, status.st_size );
+
+  return ret;
+}
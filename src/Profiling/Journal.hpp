@@ -0,0 +1,150 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_JOURNAL_HPP
+#define BURNING_PROFILING_JOURNAL_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Listener.hpp"
+#include "Profile.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Layout of journal file. Layout is fixed, any change of it must increase layoutVersion. */
+    namespace journal
+    {
+      /*! Identifies journal file */
+      const uint32_t magic = 0x4e524a42;
+      /*! Version of file's layout */
+      const uint32_t layoutVersion = 1;
+      
+      /*! Count of innermost open phases kept in file's stack */
+      const uint32_t maximalDepth = 32;
+      /*! Size of texts in records including terminating zeros */
+      const uint32_t textLength = 96;
+      
+      /*! Kinds of journal records */
+      enum RecordType
+      {
+	loopBegin = 1,
+	iterationBegin,
+	valueAdd,
+	iterationEnd,
+	loopEnd
+      };
+      
+      /*! A profiling event */
+      struct Record
+      {
+	/*! Number of record plus one, zero for empty slot. Written after other fields. */
+	volatile uint64_t sequence;
+	/*! Monotonic clock in nanoseconds */
+	int64_t time;
+	/*! Duration of ended iteration in nanoseconds */
+	int64_t duration;
+	/*! Count of open loops including loop of record */
+	uint32_t depth;
+	uint8_t type;
+	/*! One for numeric iteration names and values */
+	uint8_t numeric;
+	uint16_t reserved;
+	/*! Name of loop or iteration, or name, value and measure of value separated by zeros */
+	char text[ textLength ];
+      };
+      
+      /*! An open loop */
+      struct StackEntry
+      {
+	char loop[ 64 ];
+	char iteration[ 48 ];
+	/*! Begin of current iteration */
+	int64_t begin;
+	/*! Nonzero while iteration is in progress */
+	uint32_t began;
+	uint32_t numeric;
+      };
+      
+      /*! Beginning of journal file, ring of records follows it */
+      struct Header
+      {
+	uint32_t magic;
+	uint32_t version;
+	/*! Count of records in ring */
+	uint32_t capacity;
+	/*! Nonzero if journal was closed by process */
+	volatile uint32_t closed;
+	uint64_t pid;
+	/*! Count of written records */
+	volatile uint64_t records;
+	/*! Count of open loops */
+	volatile uint32_t depth;
+	uint32_t reserved;
+	/*! Open loops from outermost one */
+	StackEntry stack[ maximalDepth ];
+      };
+    }
+    
+    /*! Writes profiling events into a memory mapped file used as a ring buffer.
+     *  File pages are shared with kernel, so written events persist when process crashes or is killed.
+     *  Besides events journal keeps the stack of open loops, so a profile can be recovered
+     *  even if events of outer loops were overwritten.
+     */
+    class Journal : public Listener
+    {
+    public:
+      /*! Creates or truncates journal file with room for given count of records */
+      Journal( const std::string& path, size_t capacity = 65536 );
+      /*! Marks journal closed and unmaps it. File is kept. */
+      ~Journal();
+      
+      const std::string& path() const;
+      
+      void loopBegan( const Profile& profile, size_t path );
+      void iterationBegan( const Profile& profile, size_t path );
+      void valueAdded( const Profile& profile, size_t path, const std::string& name, const Value& value );
+      void iterationEnded( const Profile& profile, size_t path, long long duration );
+      void loopEnded( const Profile& profile, size_t path );
+      
+      /*! Rebuilds profile from journal file. Phases open at the end of journal are ended at its last event
+       *  and, if process did not close journal, listed in "crashed in" value of root phase.
+       *  Times of recovered iterations are in nanoseconds. Returns empty pointer if file is not a journal.
+       */
+      static ProfilePtr recover( const std::string& path );
+      
+    private:
+      Journal( const Journal& );
+      void operator=( const Journal& );
+      
+      journal::Record& newRecord( journal::RecordType type );
+      void publish( journal::Record& record );
+      
+      std::string _path;
+      size_t _size;
+      
+      journal::Header* _header;
+      journal::Record* _records;
+      
+      /*! Path ids of open loops */
+      std::vector< size_t > _paths;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,145 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include "Labels.hpp"
+
+using std::string;
+using namespace burning;
+using namespace burning::profiling;
+
+static pthread_mutex_t labelsLock = PTHREAD_MUTEX_INITIALIZER;
+static std::map< string, LabelId > labelIds;
+static std::deque< string > labelTexts;
+
+LabelId profiling::internLabel( const string& text )
+{
+  pthread_mutex_lock( &labelsLock );
+  
+  std::map< string, LabelId >::const_iterator found( labelIds.find( text ) );
+  LabelId ret;
+  if( found != labelIds.end() )
+    ret = found->second;
+  else
+  {
+    ret = labelTexts.size();
+    labelIds[ text ] = ret;
+    labelTexts.push_back( text );
+  }
+  
+  pthread_mutex_unlock( &labelsLock );
+  return ret;
+}
+
+string profiling::labelText( LabelId label )
+{
+  pthread_mutex_lock( &labelsLock );
+  string ret( label < labelTexts.size() ? labelTexts[ label ] : string() );
+  pthread_mutex_unlock( &labelsLock );
+  
+  return ret;
+}
+
+// Looks for identifier of text without interning it
+static bool findLabel( const string& text, LabelId& label )
+{
+  pthread_mutex_lock( &labelsLock );
+  
+  std::map< string, LabelId >::const_iterator found( labelIds.find( text ) );
+  bool ret( found != labelIds.end() );
+  if( ret )
+    label = found->second;
+  
+  pthread_mutex_unlock( &labelsLock );
+  return ret;
+}
+
+static bool lessKey( const std::pair< LabelId, LabelId >& label, LabelId key )
+{
+  return label.first < key;
+}
+
+LabelSet::LabelVector::const_iterator LabelSet::find( LabelId key ) const
+{
+  LabelVector::const_iterator ret( std::lower_bound( _labels.begin(), _labels.end(), key, lessKey ) );
+  if( ret != _labels.end() && ret->first != key )
+    return _labels.end();
+  
+  return ret;
+}
+
+void LabelSet::set( const string& key, const string& value )
+{
+  LabelId keyId( internLabel( key ) );
+  LabelId valueId( internLabel( value ) );
+  
+  LabelVector::iterator position( std::lower_bound( _labels.begin(), _labels.end(), keyId, lessKey ) );
+  if( position != _labels.end() && position->first == keyId )
+    position->second = valueId;
+  else
+    _labels.insert( position, std::make_pair( keyId, valueId ) );
+}
+
+bool LabelSet::has( const string& key ) const
+{
+  LabelId keyId;
+  return findLabel( key, keyId ) && find( keyId ) != _labels.end();
+}
+
+string LabelSet::value( const string& key ) const
+{
+  LabelId keyId;
+  if( !findLabel( key, keyId ) )
+    return "";
+  
+  LabelVector::const_iterator label( find( keyId ) );
+  if( label == _labels.end() )
+    return "";
+  
+  return labelText( label->second );
+}
+
+bool LabelSet::contains( const LabelSet& labels ) const
+{
+  return std::includes( _labels.begin(), _labels.end(), labels._labels.begin(), labels._labels.end() );
+}
+
+std::vector< std::pair< string, string > > LabelSet::texts() const
+{
+  std::map< string, string > texts;
+  for( LabelVector::const_iterator label = _labels.begin(); label != _labels.end(); ++label )
+    texts[ labelText( label->first ) ] = labelText( label->second );
+  
+  return std::vector< std::pair< string, string > >( texts.begin(), texts.end() );
+}
+
+string LabelSet::toString() const
+{
+  std::vector< std::pair< string, string > > labels( texts() );
+  
+  string ret;
+  for( size_t i=0; i<labels.size(); i++ )
+  {
+    if( i > 0 )
+      ret += ',';
+    ret += labels[ i ].first + '=' + labels[ i ].second;
+  }
+  
+  return ret;
+}
@@ -0,0 +1,87 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_LABELS_HPP
+#define BURNING_PROFILING_LABELS_HPP
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Identifier of interned label key or value */
+    typedef uint32_t LabelId;
+    
+    /*! Returns identifier of text, the same for equal texts. Safe to call from any thread. */
+    LabelId internLabel( const std::string& text );
+    /*! Text of interned identifier */
+    std::string labelText( LabelId label );
+    
+    /*! A small set of key/value labels, e.g. tenant=42. Keys and values are interned,
+     *  so a set costs two integers per label.
+     */
+    class LabelSet
+    {
+    public:
+      /*! Pairs of key and value identifiers ordered by key identifiers */
+      typedef std::vector< std::pair< LabelId, LabelId > > LabelVector;
+      
+      /*! Sets value of key, replacing previous one */
+      void set( const std::string& key, const std::string& value );
+      /*! Checks that set has key */
+      bool has( const std::string& key ) const;
+      /*! Value of key, empty if set has no such key */
+      std::string value( const std::string& key ) const;
+      
+      /*! Checks that set has all labels of other set */
+      bool contains( const LabelSet& labels ) const;
+      
+      bool empty() const
+      {
+	return _labels.empty();
+      }
+      const LabelVector& labels() const
+      {
+	return _labels;
+      }
+      
+      /*! Texts of keys and values ordered by keys */
+      std::vector< std::pair< std::string, std::string > > texts() const;
+      /*! Labels as "key=value" ordered by keys and separated by commas */
+      std::string toString() const;
+      
+      bool operator==( const LabelSet& labels ) const
+      {
+	return _labels == labels._labels;
+      }
+      bool operator<( const LabelSet& labels ) const
+      {
+	return _labels < labels._labels;
+      }
+      
+    private:
+      LabelVector::const_iterator find( LabelId key ) const;
+      
+      LabelVector _labels;
+    };
+  }
+}
+
+#endif
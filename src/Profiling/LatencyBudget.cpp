@@ -0,0 +1,165 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <glog/logging.h>
+#include "Profile.hpp"
+#include "LatencyBudget.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+// Marks paths without budget, so they are not looked up again
+static const long long unlimited = std::numeric_limits< long long >::max();
+
+LatencyBudget::LatencyBudget() : _budgets(),
+                                 _pathBudgets(),
+                                 _callback(),
+                                 _rate( 10.0 ),
+                                 _burst( 10.0 ),
+                                 _tokens( 10.0 ),
+                                 _violations( 0 ),
+                                 _suppressed( 0 )
+{
+  clock_gettime( CLOCK_MONOTONIC, &_lastRefill );
+}
+
+void LatencyBudget::setBudget( const string& phase, double seconds )
+{
+  if( seconds > 0.0 )
+    _budgets[ phase ] = static_cast< long long >( seconds * nanoseconds );
+  else
+    _budgets.erase( phase );
+  
+  _pathBudgets.clear();
+}
+
+void LatencyBudget::setCallback( const Callback& callback )
+{
+  _callback = callback;
+}
+
+double& LatencyBudget::rate()
+{
+  return _rate;
+}
+
+double& LatencyBudget::burst()
+{
+  return _burst;
+}
+
+size_t LatencyBudget::violations() const
+{
+  return _violations;
+}
+
+long long LatencyBudget::lookupBudget( const Profile& profile, size_t path ) const
+{
+  const string& pathName( profile.pathName( path ) );
+  
+  std::map< string, long long >::const_iterator budget( _budgets.find( pathName ) );
+  if( budget != _budgets.end() )
+    return budget->second;
+  
+  budget = _budgets.find( pathName.substr( pathName.rfind( '/' ) + 1 ) );
+  if( budget != _budgets.end() )
+    return budget->second;
+  
+  return unlimited;
+}
+
+void LatencyBudget::iterationEnded( const Profile& profile, size_t path, long long duration )
+{
+  if( path >= _pathBudgets.size() )
+    _pathBudgets.resize( profile.paths(), -1 );
+  
+  long long& budget( _pathBudgets[ path ] );
+  if( budget < 0 )
+    budget = lookupBudget( profile, path );
+  
+  if( duration <= budget )
+    return;
+  
+  _violations++;
+  if( takeToken() )
+    report( profile, path, duration );
+  else
+    _suppressed++;
+}
+
+bool LatencyBudget::takeToken()
+{
+  timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  
+  double elapsed( ( now.tv_sec - _lastRefill.tv_sec ) + ( now.tv_nsec - _lastRefill.tv_nsec ) / double( nanoseconds ) );
+  _tokens = std::min( _burst, _tokens + elapsed * _rate );
+  _lastRefill = now;
+  
+  if( _tokens < 1.0 )
+    return false;
+  
+  _tokens -= 1.0;
+  return true;
+}
+
+static void logViolation( const LatencyBudget::Violation& violation )
+{
+  std::ostringstream values;
+  for( size_t i=0; i<violation.values.size(); i++ )
+  {
+    const Value& value( violation.values[ i ].second );
+    values << ( i > 0 ? ", " : "" ) << violation.values[ i ].first << '=' << value.value();
+    if( !value.measure().empty() )
+      values << ' ' << value.measure();
+  }
+  
+  LOG( WARNING ) << "Phase " << violation.path
+                 << ( violation.iteration.empty() ? "" : " iteration " + violation.iteration )
+                 << " took " << violation.duration / double( nanoseconds / milliseconds ) << " ms"
+                 << " over budget of " << violation.budget / double( nanoseconds / milliseconds ) << " ms."
+                 << " Values: " << values.str() << '.'
+                 << ( violation.suppressed > 0 ? " Suppressed before: " + boost::lexical_cast< string >( violation.suppressed ) : "" );
+}
+
+void LatencyBudget::report( const Profile& profile, size_t path, long long duration )
+{
+  const Phase& phase( profile.currentPhase() );
+  
+  Violation violation;
+  violation.path = profile.pathName( path );
+  violation.duration = duration;
+  violation.budget = _pathBudgets[ path ];
+  violation.suppressed = _suppressed;
+  _suppressed = 0;
+  
+  // Iteration is not yet retained, so it is the last one of phase
+  size_t count( phase.iterations().size() );
+  violation.iteration = phase.iterations().back().as< string >();
+  for( Phase::ValueMap::const_iterator values = phase.values().begin(); values != phase.values().end(); ++values )
+    if( values->second.size() == count )
+      violation.values.push_back( std::make_pair( values->first, values->second.back() ) );
+  
+  if( _callback )
+    _callback( violation );
+  else
+    logViolation( violation );
+}
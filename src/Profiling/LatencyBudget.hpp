@@ -0,0 +1,100 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_LATENCY_BUDGET_HPP
+#define BURNING_PROFILING_LATENCY_BUDGET_HPP
+
+#include <time.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/function.hpp>
+#include "Listener.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Reports iterations lasting longer than their phase's budget.
+     *  Budgets are set by phase names or by paths. Budgets are looked up once for each path,
+     *  so iterations within budget cost a comparison and do not allocate.
+     *  Reports are rate limited with a token bucket, suppressed ones are counted.
+     */
+    class LatencyBudget : public Listener
+    {
+    public:
+      /*! An iteration exceeding its budget */
+      struct Violation
+      {
+	/*! Names of phases from root separated by '/' */
+	std::string path;
+	/*! Name of iteration, empty for single phases */
+	std::string iteration;
+	/*! Duration of iteration in nanoseconds */
+	long long duration;
+	/*! Budget of phase in nanoseconds */
+	long long budget;
+	/*! Values of iteration including its time */
+	std::vector< std::pair< std::string, Value > > values;
+	/*! Count of violations suppressed by rate limit since previous report */
+	size_t suppressed;
+      };
+      
+      /*! Receives reported violations */
+      typedef boost::function< void ( const Violation& ) > Callback;
+      
+      /*! Constructs budget logging violations with glog */
+      LatencyBudget();
+      
+      /*! Sets budget in seconds for phases with given name or path. Zero budget removes it. */
+      void setBudget( const std::string& phase, double seconds );
+      /*! Sets receiver of violations. Empty callback logs them with glog. */
+      void setCallback( const Callback& callback );
+      
+      /*! Count of reports per second allowed in the long run. 10 by default. */
+      double& rate();
+      /*! Count of reports allowed at once. 10 by default. */
+      double& burst();
+      
+      /*! Count of violations seen, including suppressed ones */
+      size_t violations() const;
+      
+      void iterationEnded( const Profile& profile, size_t path, long long duration );
+      
+    private:
+      long long lookupBudget( const Profile& profile, size_t path ) const;
+      bool takeToken();
+      void report( const Profile& profile, size_t path, long long duration );
+      
+      std::map< std::string, long long > _budgets;
+      /*! Budgets by path ids, negative for paths not looked up yet */
+      std::vector< long long > _pathBudgets;
+      
+      Callback _callback;
+      
+      double _rate;
+      double _burst;
+      double _tokens;
+      timespec _lastRefill;
+      
+      size_t _violations;
+      size_t _suppressed;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_LISTENER_HPP
+#define BURNING_PROFILING_LISTENER_HPP
+
+#include <string>
+#include "Value.hpp"
+
+namespace burning
+{
+  class Profile;
+  
+  namespace profiling
+  {
+    /*! Receives profiling events as they are recorded.
+     *  Phases are identified by path ids of profile, Profile::pathName gives their names.
+     *  Single phases are reported as loops with one iteration.
+     *  Listeners are called on recording thread, so they must be cheap.
+     */
+    class Listener
+    {
+    public:
+      virtual ~Listener();
+      
+      /*! Called after loop began */
+      virtual void loopBegan( const Profile& profile, size_t path );
+      /*! Called after iteration of loop began */
+      virtual void iterationBegan( const Profile& profile, size_t path );
+      /*! Called after value was added to current iteration of phase */
+      virtual void valueAdded( const Profile& profile, size_t path, const std::string& name, const Value& value );
+      /*! Called after iteration ended. Duration is in nanoseconds.
+       *  Iteration is still the last one of current phase, its aggregation and retention run after listeners.
+       */
+      virtual void iterationEnded( const Profile& profile, size_t path, long long duration );
+      /*! Called after loop ended */
+      virtual void loopEnded( const Profile& profile, size_t path );
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,332 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <glog/logging.h>
+#include "Profile.hpp"
+#include "LiveStatistics.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+const uint64_t live::bucketBounds[ histogramBuckets - 1 ] = { 1000ULL, 5000ULL,
+                                                                10000ULL, 50000ULL,
+                                                                100000ULL, 500000ULL,
+                                                                1000000ULL, 5000000ULL,
+                                                                10000000ULL, 50000000ULL,
+                                                                100000000ULL, 500000000ULL,
+                                                                1000000000ULL, 5000000000ULL,
+                                                                10000000000ULL };
+
+bool live::read( const Segment& segment, size_t index, PhaseRecord& record )
+{
+  if( index >= segment.phases || index >= segment.capacity )
+    return false;
+  
+  // Writer could die in the middle of update, so reader gives up after a while
+  const size_t maximalAttempts = 1000000;
+  
+  const PhaseRecord& source( segment.records[ index ] );
+  for( size_t i=0; i<maximalAttempts; i++ )
+  {
+    uint32_t sequence( source.sequence );
+    if( sequence % 2 != 0 )
+      continue;
+    __sync_synchronize();
+    
+    memcpy( &record, &source, sizeof( PhaseRecord ) );
+    
+    __sync_synchronize();
+    if( source.sequence == sequence )
+    {
+      record.path[ pathLength - 1 ] = '\0';
+      record.labels[ labelsLength - 2 ] = '\0';
+      record.labels[ labelsLength - 1 ] = '\0';
+      return true;
+    }
+  }
+  
+  return false;
+}
+
+static uint64_t percentile( const vector< uint64_t >& sorted, double quantile )
+{
+  if( sorted.empty() )
+    return 0;
+  
+  size_t index( static_cast< size_t >( quantile * ( sorted.size() - 1 ) + 0.5 ) );
+  return sorted[ std::min( index, sorted.size() - 1 ) ];
+}
+
+string live::Summary::name() const
+{
+  if( labels.empty() )
+    return path;
+  
+  string ret( path + '{' );
+  for( size_t i=0; i<labels.size(); i++ )
+    ret += ( i > 0 ? "," : "" ) + labels[ i ].first + '=' + labels[ i ].second;
+  
+  return ret + '}';
+}
+
+live::Summary live::summarize( const PhaseRecord& record )
+{
+  Summary ret;
+  ret.path = record.path;
+  
+  const char* label( record.labels );
+  while( *label != '\0' )
+  {
+    string key( label );
+    label += key.size() + 1;
+    string value( label );
+    label += value.size() + 1;
+    
+    ret.labels.push_back( std::make_pair( key, value ) );
+  }
+
+  ret.count = record.count;
+  ret.totalTime = record.totalTime;
+  ret.maximalTime = record.maximalTime;
+  
+  size_t samples( std::min< uint64_t >( record.count, recentSamples ) );
+  vector< uint64_t > sorted( record.recent, record.recent + samples );
+  std::sort( sorted.begin(), sorted.end() );
+  
+  ret.median = percentile( sorted, 0.5 );
+  ret.percentile90 = percentile( sorted, 0.9 );
+  ret.percentile99 = percentile( sorted, 0.99 );
+  
+  return ret;
+}
+
+const live::Segment* live::attach( const string& name )
+{
+  int descriptor( shm_open( name.c_str(), O_RDONLY, 0 ) );
+  if( descriptor < 0 )
+  {
+    LOG( ERROR ) << "Cannot open statistics segment " << name << '.';
+    return NULL;
+  }
+  
+  void* memory( mmap( NULL, sizeof( Segment ), PROT_READ, MAP_SHARED, descriptor, 0 ) );
+  close( descriptor );
+  if( memory == MAP_FAILED )
+  {
+    LOG( ERROR ) << "Cannot map statistics segment " << name << '.';
+    return NULL;
+  }
+  
+  const Segment* ret( static_cast< const Segment* >( memory ) );
+  if( ret->magic != magic || ret->version != layoutVersion )
+  {
+    LOG( ERROR ) << "Segment " << name << " has unsupported layout.";
+    detach( ret );
+    return NULL;
+  }
+  
+  return ret;
+}
+
+void live::detach( const Segment* segment )
+{
+  munmap( const_cast< Segment* >( segment ), sizeof( Segment ) );
+}
+
+/*
+ * LiveStatistics
+ */
+
+LiveStatistics::LiveStatistics() : _name(),
+                                   _segment( NULL ),
+                                   _records(),
+                                   _labelSets(),
+                                   _labelledRecords()
+{
+  void* memory( mmap( NULL, sizeof( live::Segment ), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 ) );
+  if( memory == MAP_FAILED )
+  {
+    LOG( ERROR ) << "Cannot allocate statistics segment.";
+    exit( EXIT_FAILURE );
+  }
+  
+  initialize( memory );
+}
+
+LiveStatistics::LiveStatistics( const string& name ) : _name( name ),
+                                                       _segment( NULL ),
+                                                       _records(),
+                                                       _labelSets(),
+                                                       _labelledRecords()
+{
+  int descriptor( shm_open( name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 ) );
+  if( descriptor < 0 )
+  {
+    LOG( ERROR ) << "Cannot create statistics segment " << name << '.';
+    exit( EXIT_FAILURE );
+  }
+  
+  void* memory( MAP_FAILED );
+  if( ftruncate( descriptor, sizeof( live::Segment ) ) == 0 )
+    memory = mmap( NULL, sizeof( live::Segment ), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0 );
+  close( descriptor );
+  
+  if( memory == MAP_FAILED )
+  {
+    LOG( ERROR ) << "Cannot map statistics segment " << name << '.';
+    shm_unlink( name.c_str() );
+    exit( EXIT_FAILURE );
+  }
+  
+  initialize( memory );
+}
+
+LiveStatistics::~LiveStatistics()
+{
+  munmap( _segment, sizeof( live::Segment ) );
+  if( !_name.empty() )
+    shm_unlink( _name.c_str() );
+}
+
+void LiveStatistics::initialize( void* memory )
+{
+  memset( memory, 0, sizeof( live::Segment ) );
+  
+  _segment = static_cast< live::Segment* >( memory );
+  _segment->capacity = live::maximalPhases;
+  _segment->pid = getpid();
+  _segment->version = live::layoutVersion;
+  
+  // Magic is written last, so monitors never see half initialized header
+  __sync_synchronize();
+  _segment->magic = live::magic;
+}
+
+const string& LiveStatistics::name() const
+{
+  return _name;
+}
+
+const live::Segment& LiveStatistics::segment() const
+{
+  return *_segment;
+}
+
+live::PhaseRecord* LiveStatistics::newRecord( const Profile& profile, size_t path, const LabelSet& labels )
+{
+  if( _segment->phases >= _segment->capacity )
+    return NULL;
+  
+  live::PhaseRecord* ret( &_segment->records[ _segment->phases ] );
+  strncpy( ret->path, profile.pathName( path ).c_str(), live::pathLength - 1 );
+  
+  // Labels that do not fit are dropped whole, two last bytes are left for terminating zeros
+  vector< std::pair< string, string > > texts( labels.texts() );
+  size_t length( 0 );
+  for( size_t i=0; i<texts.size(); i++ )
+  {
+    size_t size( texts[ i ].first.size() + texts[ i ].second.size() + 2 );
+    if( texts[ i ].first.empty() || length + size > live::labelsLength - 1 )
+      continue;
+    
+    memcpy( ret->labels + length, texts[ i ].first.c_str(), texts[ i ].first.size() + 1 );
+    memcpy( ret->labels + length + texts[ i ].first.size() + 1, texts[ i ].second.c_str(), texts[ i ].second.size() + 1 );
+    length += size;
+  }
+  
+  // Record is published after its path is written
+  __sync_synchronize();
+  _segment->phases++;
+  
+  return ret;
+}
+
+live::PhaseRecord* LiveStatistics::record( const Profile& profile, size_t path, const LabelSet& labels )
+{
+  if( !labels.empty() )
+  {
+    std::map< LabelSet, size_t >::const_iterator found( _labelSets.find( labels ) );
+    if( found == _labelSets.end() && _segment->phases >= _segment->capacity )
+      return NULL;
+    
+    size_t labelSet( found != _labelSets.end() ? found->second : _labelSets.size() );
+    if( found == _labelSets.end() )
+      _labelSets[ labels ] = labelSet;
+    
+    if( path >= _labelledRecords.size() )
+      _labelledRecords.resize( profile.paths() );
+    vector< live::PhaseRecord* >& records( _labelledRecords[ path ] );
+    if( labelSet < records.size() && records[ labelSet ] != NULL )
+      return records[ labelSet ];
+    
+    live::PhaseRecord* ret( newRecord( profile, path, labels ) );
+    if( ret == NULL )
+      return NULL;
+    
+    if( labelSet >= records.size() )
+      records.resize( labelSet + 1, NULL );
+    records[ labelSet ] = ret;
+    return ret;
+  }
+  
+  if( path < _records.size() && _records[ path ] != NULL )
+    return _records[ path ];
+  
+  live::PhaseRecord* ret( newRecord( profile, path, labels ) );
+  if( ret == NULL )
+    return NULL;
+  
+  if( path >= _records.size() )
+    _records.resize( path + 1, NULL );
+  _records[ path ] = ret;
+  return ret;
+}
+
+void LiveStatistics::iterationEnded( const Profile& profile, size_t path, long long duration )
+{
+  const Phase& phase( profile.currentPhase() );
+  live::PhaseRecord* current( record( profile, path, phase.labels( phase.iterations().size() - 1 ) ) );
+  if( current == NULL )
+  {
+    _segment->dropped++;
+    return;
+  }
+  
+  uint64_t time( duration > 0 ? duration : 0 );
+  const uint64_t* bounds( live::bucketBounds );
+  size_t bucket( std::lower_bound( bounds, bounds + live::histogramBuckets - 1, time ) - bounds );
+  
+  current->sequence++;
+  __sync_synchronize();
+  
+  current->count++;
+  current->totalTime += time;
+  current->maximalTime = std::max( current->maximalTime, time );
+  current->recent[ current->nextSample ] = time;
+  current->nextSample = ( current->nextSample + 1 ) % live::recentSamples;
+  current->buckets[ bucket ]++;
+  
+  __sync_synchronize();
+  current->sequence++;
+}
@@ -0,0 +1,164 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_LIVE_STATISTICS_HPP
+#define BURNING_PROFILING_LIVE_STATISTICS_HPP
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Labels.hpp"
+#include "Listener.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Layout of live statistics segment shared with external monitors.
+     *  Layout is fixed, any change of it must increase layoutVersion.
+     */
+    namespace live
+    {
+      /*! Identifies statistics segment */
+      const uint32_t magic = 0x4e525542;
+      /*! Version of segment's layout */
+      const uint32_t layoutVersion = 4;
+      
+      /*! Count of phase records in segment */
+      const uint32_t maximalPhases = 256;
+      /*! Size of phase's path including terminating zero */
+      const uint32_t pathLength = 128;
+      /*! Size of phase's labels. Each key and value ends with zero, labels end with empty key. */
+      const uint32_t labelsLength = 128;
+      /*! Count of last durations kept for percentiles */
+      const uint32_t recentSamples = 64;
+      /*! Count of histogram buckets, last one counts durations above all bounds */
+      const uint32_t histogramBuckets = 16;
+      /*! Upper bounds of histogram buckets in nanoseconds */
+      extern const uint64_t bucketBounds[ histogramBuckets - 1 ];
+      
+      /*! Aggregates of phase's iterations. Times are in nanoseconds. */
+      struct PhaseRecord
+      {
+	/*! Sequence lock. Odd while record is being written. */
+	volatile uint32_t sequence;
+	/*! Index of next slot in recent durations */
+	uint32_t nextSample;
+	uint64_t count;
+	uint64_t totalTime;
+	uint64_t maximalTime;
+	/*! Last durations, first min( count, recentSamples ) of them are valid */
+	uint64_t recent[ recentSamples ];
+	/*! Count of durations in each bucket, not cumulative */
+	uint64_t buckets[ histogramBuckets ];
+	/*! Names of phases from root separated by '/' */
+	char path[ pathLength ];
+	/*! Labels of iterations counted by record. Iterations with other labels have other records. */
+	char labels[ labelsLength ];
+      };
+      
+      /*! Shared statistics segment */
+      struct Segment
+      {
+	uint32_t magic;
+	uint32_t version;
+	/*! Count of records in segment */
+	uint32_t capacity;
+	/*! Count of used records */
+	volatile uint32_t phases;
+	/*! Process publishing statistics */
+	uint64_t pid;
+	/*! Count of iterations not counted because all records were used */
+	volatile uint64_t dropped;
+	PhaseRecord records[ maximalPhases ];
+      };
+      
+      /*! Reads consistent copy of record. Returns false if record is not published. */
+      bool read( const Segment& segment, size_t index, PhaseRecord& record );
+      
+      /*! Summary of phase record */
+      struct Summary
+      {
+	/*! Path followed by labels in braces, e.g. "query{tenant=42}" */
+	std::string name() const;
+	
+	std::string path;
+	/*! Keys and values of labels ordered by keys */
+	std::vector< std::pair< std::string, std::string > > labels;
+	uint64_t count;
+	uint64_t totalTime;
+	uint64_t maximalTime;
+	/*! Percentiles of recent durations */
+	uint64_t median;
+	uint64_t percentile90;
+	uint64_t percentile99;
+      };
+      
+      /*! Summarizes record */
+      Summary summarize( const PhaseRecord& record );
+      
+      /*! Maps segment published by other process read only. Returns NULL on failure. */
+      const Segment* attach( const std::string& name );
+      /*! Unmaps attached segment */
+      void detach( const Segment* segment );
+    }
+    
+    /*! Publishes aggregates of ended iterations in a live statistics segment.
+     *  Each phase path gets its own record, iterations with labels get a record for each set of labels, updates are protected by a sequence lock,
+     *  so writer never waits and does not make system calls. Sets of labels are interned, so counting an iteration
+     *  of a known phase and labels does not allocate. Iterations that find no free record are counted as dropped.
+     */
+    class LiveStatistics : public Listener
+    {
+    public:
+      /*! Publishes statistics in anonymous memory readable only by this process */
+      LiveStatistics();
+      /*! Publishes statistics in POSIX shared memory object with given name, for example "/burning.1234" */
+      explicit LiveStatistics( const std::string& name );
+      /*! Unmaps segment and removes shared memory object */
+      ~LiveStatistics();
+      
+      /*! Name of shared memory object, empty for anonymous segment */
+      const std::string& name() const;
+      /*! Published segment */
+      const live::Segment& segment() const;
+      
+      void iterationEnded( const Profile& profile, size_t path, long long duration );
+      
+    private:
+      LiveStatistics( const LiveStatistics& );
+      void operator=( const LiveStatistics& );
+      
+      void initialize( void* memory );
+      live::PhaseRecord* record( const Profile& profile, size_t path, const LabelSet& labels );
+      live::PhaseRecord* newRecord( const Profile& profile, size_t path, const LabelSet& labels );
+      
+      std::string _name;
+      live::Segment* _segment;
+      
+      /*! Records by path ids */
+      std::vector< live::PhaseRecord* > _records;
+      /*! Identifiers of sets of labels seen in iterations */
+      std::map< LabelSet, size_t > _labelSets;
+      /*! Records of labelled iterations by path ids and identifiers of their labels */
+      std::vector< std::vector< live::PhaseRecord* > > _labelledRecords;
+    };
+  }
+}
+
+#endif
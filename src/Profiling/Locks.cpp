@@ -0,0 +1,407 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <map>
+#include <glog/logging.h>
+#include "Profile.hpp"
+#include "Table.hpp"
+#include "Locks.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Counters shared by locks with same name, updated atomically */
+    struct LockRecord
+    {
+      LockRecord() : acquisitions( 0 ),
+                     contended( 0 ),
+                     waitTime( 0 ),
+                     maximalWait( 0 ),
+                     holdTime( 0 )
+      {
+      }
+
+      volatile long long acquisitions;
+      volatile long long contended;
+      volatile long long waitTime;
+      volatile long long maximalWait;
+      volatile long long holdTime;
+    };
+  }
+}
+
+LockStatistics::LockStatistics() : name(),
+                                   acquisitions( 0 ),
+                                   contended( 0 ),
+                                   waitTime( 0 ),
+                                   maximalWait( 0 ),
+                                   holdTime( 0 )
+{
+}
+
+// Records live as long as the process, so locks keep plain pointers to them
+static pthread_mutex_t recordsLock = PTHREAD_MUTEX_INITIALIZER;
+static std::map< string, LockRecord* > records;
+
+static LockRecord* record( const string& name )
+{
+  pthread_mutex_lock( &recordsLock );
+  LockRecord*& ret( records[ name ] );
+  if( ret == NULL )
+    ret = new LockRecord();
+  pthread_mutex_unlock( &recordsLock );
+
+  return ret;
+}
+
+vector< LockStatistics > profiling::lockStatistics()
+{
+  vector< LockStatistics > ret;
+
+  pthread_mutex_lock( &recordsLock );
+  for( std::map< string, LockRecord* >::const_iterator record = records.begin(); record != records.end(); ++record )
+  {
+    LockStatistics statistics;
+    statistics.name = record->first;
+    statistics.acquisitions = record->second->acquisitions;
+    statistics.contended = record->second->contended;
+    statistics.waitTime = record->second->waitTime;
+    statistics.maximalWait = record->second->maximalWait;
+    statistics.holdTime = record->second->holdTime;
+    ret.push_back( statistics );
+  }
+  pthread_mutex_unlock( &recordsLock );
+
+  return ret;
+}
+
+void profiling::resetLockStatistics()
+{
+  pthread_mutex_lock( &recordsLock );
+  for( std::map< string, LockRecord* >::iterator record = records.begin(); record != records.end(); ++record )
+    *record->second = LockRecord();
+  pthread_mutex_unlock( &recordsLock );
+}
+
+void profiling::locksToTable( Table* table )
+{
+  vector< LockStatistics > statistics( lockStatistics() );
+  if( statistics.empty() )
+    return;
+
+  table->column( 0 ).name() = "lock";
+  table->column( 1 ).name() = "acquisitions";
+  table->column( 2 ).name() = "contended";
+  table->column( 3 ).name() = "total wait";
+  table->column( 4 ).name() = "maximal wait";
+  table->column( 5 ).name() = "total hold";
+
+  for( size_t i=0; i<statistics.size(); i++ )
+  {
+    Table::RowProxy row( table->newRow() );
+    row.pushBack( statistics[ i ].name );
+    row.pushBack( static_cast< double >( statistics[ i ].acquisitions ) );
+    row.pushBack( static_cast< double >( statistics[ i ].contended ) );
+    row.pushBack( Value( static_cast< double >( statistics[ i ].waitTime ), "ns" ) );
+    row.pushBack( Value( static_cast< double >( statistics[ i ].maximalWait ), "ns" ) );
+    row.pushBack( Value( static_cast< double >( statistics[ i ].holdTime ), "ns" ) );
+  }
+}
+
+static long long elapsed( const timespec& begin, const timespec& end )
+{
+  return ( end.tv_sec - begin.tv_sec ) * static_cast< long long >( nanoseconds ) + end.tv_nsec - begin.tv_nsec;
+}
+
+static long long elapsed( const timespec& begin )
+{
+  timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+
+  return elapsed( begin, now );
+}
+
+static void attribute( const string& name, long long time )
+{
+  Profile* profile( Profile::attached() );
+  if( profile != NULL )
+    profile->accumulateValue( name, Value( static_cast< double >( time ), "ns" ) );
+}
+
+static void recordWait( LockRecord* record, long long wait, bool contended )
+{
+  __sync_fetch_and_add( &record->acquisitions, 1 );
+  if( !contended )
+    return;
+
+  __sync_fetch_and_add( &record->contended, 1 );
+  __sync_fetch_and_add( &record->waitTime, wait );
+
+  long long maximal( record->maximalWait );
+  while( wait > maximal )
+  {
+    long long previous( __sync_val_compare_and_swap( &record->maximalWait, maximal, wait ) );
+    if( previous == maximal )
+      break;
+    maximal = previous;
+  }
+}
+
+static string valueName( const string& kind, const string& name, const string& time )
+{
+  return kind + ' ' + name + ' ' + time;
+}
+
+/*
+ * Mutex
+ */
+
+Mutex::Mutex( const string& name ) : _record( record( name ) ),
+                                     _waitValue( valueName( "lock", name, "wait" ) ),
+                                     _holdValue( valueName( "lock", name, "hold" ) )
+{
+  pthread_mutex_init( &_mutex, NULL );
+}
+
+Mutex::~Mutex()
+{
+  pthread_mutex_destroy( &_mutex );
+}
+
+void Mutex::lock()
+{
+  timespec begin;
+  clock_gettime( CLOCK_MONOTONIC, &begin );
+
+  bool contended( pthread_mutex_trylock( &_mutex ) == EBUSY );
+  if( contended )
+    pthread_mutex_lock( &_mutex );
+
+  acquired( begin, contended );
+}
+
+bool Mutex::try_lock()
+{
+  timespec begin;
+  clock_gettime( CLOCK_MONOTONIC, &begin );
+
+  if( pthread_mutex_trylock( &_mutex ) != 0 )
+    return false;
+
+  acquired( begin, false );
+  return true;
+}
+
+void Mutex::unlock()
+{
+  long long hold( elapsed( _acquired ) );
+  pthread_mutex_unlock( &_mutex );
+
+  held( hold );
+}
+
+void Mutex::acquired( const timespec& begin, bool contended )
+{
+  clock_gettime( CLOCK_MONOTONIC, &_acquired );
+
+  long long wait( elapsed( begin, _acquired ) );
+  recordWait( _record, wait, contended );
+  if( contended )
+    attribute( _waitValue, wait );
+}
+
+void Mutex::held( long long hold )
+{
+  __sync_fetch_and_add( &_record->holdTime, hold );
+  attribute( _holdValue, hold );
+}
+
+Mutex::Lock::Lock( Mutex& mutex ) : _mutex( mutex )
+{
+  _mutex.lock();
+}
+
+Mutex::Lock::~Lock()
+{
+  _mutex.unlock();
+}
+
+/*
+ * SharedMutex
+ */
+
+SharedMutex::SharedMutex( const string& name ) : _record( record( name ) ),
+                                                 _waitValue( valueName( "lock", name, "wait" ) ),
+                                                 _holdValue( valueName( "lock", name, "hold" ) )
+{
+  pthread_rwlock_init( &_lock, NULL );
+}
+
+SharedMutex::~SharedMutex()
+{
+  pthread_rwlock_destroy( &_lock );
+}
+
+void SharedMutex::acquired( const timespec& begin, bool contended )
+{
+  timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+
+  long long wait( elapsed( begin, now ) );
+  recordWait( _record, wait, contended );
+  if( contended )
+    attribute( _waitValue, wait );
+}
+
+void SharedMutex::lock()
+{
+  timespec begin;
+  clock_gettime( CLOCK_MONOTONIC, &begin );
+
+  bool contended( pthread_rwlock_trywrlock( &_lock ) == EBUSY );
+  if( contended )
+    pthread_rwlock_wrlock( &_lock );
+
+  acquired( begin, contended );
+  clock_gettime( CLOCK_MONOTONIC, &_acquired );
+}
+
+bool SharedMutex::try_lock()
+{
+  timespec begin;
+  clock_gettime( CLOCK_MONOTONIC, &begin );
+
+  if( pthread_rwlock_trywrlock( &_lock ) != 0 )
+    return false;
+
+  acquired( begin, false );
+  clock_gettime( CLOCK_MONOTONIC, &_acquired );
+  return true;
+}
+
+void SharedMutex::unlock()
+{
+  long long hold( elapsed( _acquired ) );
+  pthread_rwlock_unlock( &_lock );
+
+  __sync_fetch_and_add( &_record->holdTime, hold );
+  attribute( _holdValue, hold );
+}
+
+void SharedMutex::lock_shared()
+{
+  timespec begin;
+  clock_gettime( CLOCK_MONOTONIC, &begin );
+
+  bool contended( pthread_rwlock_tryrdlock( &_lock ) == EBUSY );
+  if( contended )
+    pthread_rwlock_rdlock( &_lock );
+
+  acquired( begin, contended );
+}
+
+bool SharedMutex::try_lock_shared()
+{
+  timespec begin;
+  clock_gettime( CLOCK_MONOTONIC, &begin );
+
+  if( pthread_rwlock_tryrdlock( &_lock ) != 0 )
+    return false;
+
+  acquired( begin, false );
+  return true;
+}
+
+void SharedMutex::unlock_shared()
+{
+  pthread_rwlock_unlock( &_lock );
+}
+
+/*
+ * ConditionVariable
+ */
+
+ConditionVariable::ConditionVariable( const string& name ) : _record( record( name ) ),
+                                                             _waitValue( valueName( "condition", name, "wait" ) )
+{
+  pthread_condattr_t attributes;
+  pthread_condattr_init( &attributes );
+  pthread_condattr_setclock( &attributes, CLOCK_MONOTONIC );
+  pthread_cond_init( &_condition, &attributes );
+  pthread_condattr_destroy( &attributes );
+}
+
+ConditionVariable::~ConditionVariable()
+{
+  pthread_cond_destroy( &_condition );
+}
+
+void ConditionVariable::waited( const timespec& begin )
+{
+  long long wait( elapsed( begin ) );
+
+  recordWait( _record, wait, true );
+  attribute( _waitValue, wait );
+}
+
+void ConditionVariable::wait( Mutex& mutex )
+{
+  mutex.held( elapsed( mutex._acquired ) );
+
+  timespec begin;
+  clock_gettime( CLOCK_MONOTONIC, &begin );
+  pthread_cond_wait( &_condition, &mutex._mutex );
+
+  waited( begin );
+  clock_gettime( CLOCK_MONOTONIC, &mutex._acquired );
+}
+
+bool ConditionVariable::timedWait( Mutex& mutex, double seconds )
+{
+  mutex.held( elapsed( mutex._acquired ) );
+
+  timespec begin;
+  clock_gettime( CLOCK_MONOTONIC, &begin );
+
+  long long deadline( begin.tv_nsec + static_cast< long long >( seconds * nanoseconds ) );
+  timespec until;
+  until.tv_sec = begin.tv_sec + deadline / nanoseconds;
+  until.tv_nsec = deadline % nanoseconds;
+
+  int result( pthread_cond_timedwait( &_condition, &mutex._mutex, &until ) );
+
+  waited( begin );
+  clock_gettime( CLOCK_MONOTONIC, &mutex._acquired );
+
+  return result != ETIMEDOUT;
+}
+
+void ConditionVariable::notifyOne()
+{
+  pthread_cond_signal( &_condition );
+}
+
+void ConditionVariable::notifyAll()
+{
+  pthread_cond_broadcast( &_condition );
+}
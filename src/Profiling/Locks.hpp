@@ -0,0 +1,163 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_LOCKS_HPP
+#define BURNING_PROFILING_LOCKS_HPP
+
+#include <pthread.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+namespace burning
+{
+  namespace profiling
+  {
+    class Table;
+    struct LockRecord;
+
+    /*! Contention of locks with same name. Times are in nanoseconds. */
+    struct LockStatistics
+    {
+      LockStatistics();
+
+      std::string name;
+      long long acquisitions;
+      /*! Acquisitions that had to wait */
+      long long contended;
+      long long waitTime;
+      long long maximalWait;
+      long long holdTime;
+    };
+
+    /*! Statistics of all named locks sorted by name */
+    std::vector< LockStatistics > lockStatistics();
+    /*! Clears statistics of all named locks */
+    void resetLockStatistics();
+    /*! Saves statistics of all named locks in table */
+    void locksToTable( Table* table );
+
+    /*! A mutex measuring time spent waiting for and holding it.
+     *  Provides lock, try_lock and unlock, so it can replace boost::mutex in boost's lock guards.
+     *  Times are added as "lock <name> wait" and "lock <name> hold" values of current phase
+     *  of profile attached to calling thread, and are gathered in statistics of locks with same name.
+     */
+    class Mutex
+    {
+    public:
+      explicit Mutex( const std::string& name );
+      ~Mutex();
+
+      void lock();
+      bool try_lock();
+      void unlock();
+
+      /*! Locks mutex for lifetime of object */
+      class Lock
+      {
+      public:
+	explicit Lock( Mutex& mutex );
+	~Lock();
+
+      private:
+	Lock( const Lock& );
+	void operator=( const Lock& );
+
+	Mutex& _mutex;
+      };
+
+    private:
+      friend class ConditionVariable;
+
+      Mutex( const Mutex& );
+      void operator=( const Mutex& );
+
+      void acquired( const timespec& begin, bool contended );
+      void held( long long hold );
+
+      pthread_mutex_t _mutex;
+      LockRecord* _record;
+      timespec _acquired;
+
+      std::string _waitValue;
+      std::string _holdValue;
+    };
+
+    /*! A readers-writer lock measuring time spent waiting for it.
+     *  Provides interface of boost::shared_mutex without upgrade ownership.
+     *  Hold time is measured for exclusive ownership only.
+     */
+    class SharedMutex
+    {
+    public:
+      explicit SharedMutex( const std::string& name );
+      ~SharedMutex();
+
+      void lock();
+      bool try_lock();
+      void unlock();
+
+      void lock_shared();
+      bool try_lock_shared();
+      void unlock_shared();
+
+    private:
+      SharedMutex( const SharedMutex& );
+      void operator=( const SharedMutex& );
+
+      void acquired( const timespec& begin, bool contended );
+
+      pthread_rwlock_t _lock;
+      LockRecord* _record;
+      timespec _acquired;
+
+      std::string _waitValue;
+      std::string _holdValue;
+    };
+
+    /*! A condition variable measuring time spent waiting for it.
+     *  Waits are added as "condition <name> wait" values and gathered in statistics of its name,
+     *  time mutex is released while waiting is not counted as its hold time.
+     */
+    class ConditionVariable
+    {
+    public:
+      explicit ConditionVariable( const std::string& name );
+      ~ConditionVariable();
+
+      /*! Waits for notification. Mutex must be locked by calling thread. */
+      void wait( Mutex& mutex );
+      /*! Waits for notification at most given time in seconds. Returns false on timeout. */
+      bool timedWait( Mutex& mutex, double seconds );
+
+      void notifyOne();
+      void notifyAll();
+
+    private:
+      ConditionVariable( const ConditionVariable& );
+      void operator=( const ConditionVariable& );
+
+      void waited( const timespec& begin );
+
+      pthread_cond_t _condition;
+      LockRecord* _record;
+
+      std::string _waitValue;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,397 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <glog/logging.h>
+#include "MetricsExporter.hpp"
+
+using std::string;
+using namespace burning;
+using namespace burning::profiling;
+
+MetricsExporter::MetricsExporter( const live::Segment& segment ) : _segment( segment ),
+                                                                   _socket( -1 ),
+                                                                   _socketPath(),
+                                                                   _port( 0 ),
+                                                                   _thread(),
+                                                                   _running( false )
+{
+  _stopPipe[ 0 ] = -1;
+  _stopPipe[ 1 ] = -1;
+}
+
+MetricsExporter::~MetricsExporter()
+{
+  stop();
+}
+
+bool MetricsExporter::listen( const string& socketPath )
+{
+  sockaddr_un address;
+  memset( &address, 0, sizeof( address ) );
+  address.sun_family = AF_UNIX;
+  if( socketPath.size() >= sizeof( address.sun_path ) )
+  {
+    LOG( ERROR ) << "Socket path " << socketPath << " is too long.";
+    return false;
+  }
+  strcpy( address.sun_path, socketPath.c_str() );
+  
+  int descriptor( socket( AF_UNIX, SOCK_STREAM, 0 ) );
+  if( descriptor < 0 )
+  {
+    LOG( ERROR ) << "Cannot create metrics socket.";
+    return false;
+  }
+  
+  unlink( socketPath.c_str() );
+  if( bind( descriptor, reinterpret_cast< sockaddr* >( &address ), sizeof( address ) ) != 0 )
+  {
+    LOG( ERROR ) << "Cannot bind metrics socket to " << socketPath << '.';
+    close( descriptor );
+    return false;
+  }
+  
+  if( !start( descriptor ) )
+  {
+    unlink( socketPath.c_str() );
+    return false;
+  }
+  
+  _socketPath = socketPath;
+  _port = 0;
+  return true;
+}
+
+bool MetricsExporter::listen( unsigned short port )
+{
+  sockaddr_in address;
+  memset( &address, 0, sizeof( address ) );
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+  address.sin_port = htons( port );
+  
+  int descriptor( socket( AF_INET, SOCK_STREAM, 0 ) );
+  if( descriptor < 0 )
+  {
+    LOG( ERROR ) << "Cannot create metrics socket.";
+    return false;
+  }
+  
+  int reuse( 1 );
+  setsockopt( descriptor, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof( reuse ) );
+  
+  socklen_t size( sizeof( address ) );
+  if( bind( descriptor, reinterpret_cast< sockaddr* >( &address ), sizeof( address ) ) != 0 ||
+      getsockname( descriptor, reinterpret_cast< sockaddr* >( &address ), &size ) != 0 )
+  {
+    LOG( ERROR ) << "Cannot bind metrics socket to port " << port << '.';
+    close( descriptor );
+    return false;
+  }
+  
+  if( !start( descriptor ) )
+    return false;
+  
+  _socketPath.clear();
+  _port = ntohs( address.sin_port );
+  return true;
+}
+
+unsigned short MetricsExporter::port() const
+{
+  return _port;
+}
+
+bool MetricsExporter::start( int descriptor )
+{
+  if( _running )
+  {
+    LOG( ERROR ) << "Metrics exporter is already serving.";
+    close( descriptor );
+    return false;
+  }
+  
+  if( ::listen( descriptor, 16 ) != 0 || pipe( _stopPipe ) != 0 )
+  {
+    LOG( ERROR ) << "Cannot listen on metrics socket.";
+    close( descriptor );
+    return false;
+  }
+  
+  _socket = descriptor;
+  if( pthread_create( &_thread, NULL, serve, this ) != 0 )
+  {
+    LOG( ERROR ) << "Cannot start metrics exporter.";
+    close( _socket );
+    close( _stopPipe[ 0 ] );
+    close( _stopPipe[ 1 ] );
+    return false;
+  }
+  
+  _running = true;
+  return true;
+}
+
+void MetricsExporter::stop()
+{
+  if( !_running )
+    return;
+  
+  char stop( 0 );
+  if( write( _stopPipe[ 1 ], &stop, 1 ) != 1 )
+    LOG( ERROR ) << "Cannot stop metrics exporter.";
+  pthread_join( _thread, NULL );
+  
+  close( _socket );
+  close( _stopPipe[ 0 ] );
+  close( _stopPipe[ 1 ] );
+  if( !_socketPath.empty() )
+    unlink( _socketPath.c_str() );
+  
+  _running = false;
+}
+
+void* MetricsExporter::serve( void* data )
+{
+  MetricsExporter& exporter( *static_cast< MetricsExporter* >( data ) );
+  
+  pollfd descriptors[ 2 ];
+  descriptors[ 0 ].fd = exporter._socket;
+  descriptors[ 0 ].events = POLLIN;
+  descriptors[ 1 ].fd = exporter._stopPipe[ 0 ];
+  descriptors[ 1 ].events = POLLIN;
+  
+  for(;;)
+  {
+    if( poll( descriptors, 2, -1 ) < 0 )
+    {
+      if( errno == EINTR )
+	continue;
+      
+      LOG( ERROR ) << "Metrics exporter failed to wait for connections.";
+      break;
+    }
+    
+    if( descriptors[ 1 ].revents != 0 )
+      break;
+    
+    if( descriptors[ 0 ].revents & POLLIN )
+    {
+      int connection( accept( exporter._socket, NULL, NULL ) );
+      if( connection >= 0 )
+      {
+	exporter.respond( connection );
+	close( connection );
+      }
+    }
+  }
+  
+  return NULL;
+}
+
+static void sendAll( int connection, const string& data )
+{
+  size_t sent( 0 );
+  while( sent < data.size() )
+  {
+    ssize_t size( send( connection, data.data() + sent, data.size() - sent, MSG_NOSIGNAL ) );
+    if( size < 0 && errno == EINTR )
+      continue;
+    if( size <= 0 )
+      return;
+    
+    sent += size;
+  }
+}
+
+static string response( const string& status, const string& contentType, const string& body )
+{
+  std::ostringstream ret;
+  ret << "HTTP/1.0 " << status << "\r\n";
+  ret << "Content-Type: " << contentType << "\r\n";
+  ret << "Content-Length: " << body.size() << "\r\n";
+  ret << "Connection: close\r\n\r\n";
+  ret << body;
+  
+  return ret.str();
+}
+
+void MetricsExporter::respond( int connection ) const
+{
+  // Scrapers send short requests, anything longer or slower is cut off
+  const size_t maximalRequest = 8192;
+  const int requestTimeout = 1000;
+  
+  string request;
+  char buffer[ 1024 ];
+  while( request.find( "\r\n\r\n" ) == string::npos && request.find( "\n\n" ) == string::npos &&
+         request.size() < maximalRequest )
+  {
+    pollfd descriptor;
+    descriptor.fd = connection;
+    descriptor.events = POLLIN;
+    if( poll( &descriptor, 1, requestTimeout ) <= 0 )
+      break;
+    
+    ssize_t size( recv( connection, buffer, sizeof( buffer ), 0 ) );
+    if( size <= 0 )
+      break;
+    request.append( buffer, size );
+  }
+  
+  if( request.compare( 0, 4, "GET " ) != 0 )
+  {
+    sendAll( connection, response( "405 Method Not Allowed", "text/plain", "Only GET is supported.\n" ) );
+    return;
+  }
+  
+  string path( request.substr( 4, request.find_first_of( " ?\r\n", 4 ) - 4 ) );
+  if( path != "/" && path != "/metrics" )
+  {
+    sendAll( connection, response( "404 Not Found", "text/plain", "Metrics are served on /metrics.\n" ) );
+    return;
+  }
+  
+  std::ostringstream body;
+  writeMetrics( body );
+  sendAll( connection, response( "200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8", body.str() ) );
+}
+
+/*
+ * OpenMetrics text
+ */
+
+static string escapeLabel( const string& value )
+{
+  string ret;
+  for( size_t i=0; i<value.size(); i++ )
+  {
+    if( value[ i ] == '\\' )
+      ret += "\\\\";
+    else if( value[ i ] == '"' )
+      ret += "\\\"";
+    else if( value[ i ] == '\n' )
+      ret += "\\n";
+    else
+      ret += value[ i ];
+  }
+  
+  return ret;
+}
+
+// Writes nanoseconds as exact decimal seconds
+static string seconds( uint64_t time )
+{
+  char buffer[ 32 ];
+  snprintf( buffer, sizeof( buffer ), "%llu.%09llu", static_cast< unsigned long long >( time / 1000000000ULL ),
+            static_cast< unsigned long long >( time % 1000000000ULL ) );
+  return buffer;
+}
+
+static void writeFamily( std::ostream& ostream, const string& name, const string& type, const string& help )
+{
+  ostream << "# TYPE " << name << ' ' << type << '\n';
+  ostream << "# UNIT " << name << " seconds\n";
+  ostream << "# HELP " << name << ' ' << help << '\n';
+}
+
+// Makes valid OpenMetrics label name of label key
+static string labelName( const string& key )
+{
+  string ret( key );
+  for( size_t i=0; i<ret.size(); i++ )
+    if( !isalnum( static_cast< unsigned char >( ret[ i ] ) ) && ret[ i ] != '_' )
+      ret[ i ] = '_';
+  
+  // Names used by exporter itself and names starting with digit get a prefix
+  if( ret.empty() || isdigit( static_cast< unsigned char >( ret[ 0 ] ) ) || ret == "phase" || ret == "le" || ret == "quantile" )
+    ret = "label_" + ret;
+  
+  return ret;
+}
+
+// Labels identifying metric of phase summary
+static string phaseLabels( const live::Summary& summary )
+{
+  string ret( "phase=\"" + escapeLabel( summary.path ) + "\"" );
+  for( size_t i=0; i<summary.labels.size(); i++ )
+    ret += ',' + labelName( summary.labels[ i ].first ) + "=\"" + escapeLabel( summary.labels[ i ].second ) + "\"";
+  
+  return ret;
+}
+
+void MetricsExporter::writeMetrics( std::ostream& ostream ) const
+{
+  std::vector< live::PhaseRecord > records;
+  std::vector< live::Summary > summaries;
+  live::PhaseRecord record;
+  for( size_t i=0; i<_segment.phases; i++ )
+    if( live::read( _segment, i, record ) )
+    {
+      records.push_back( record );
+      summaries.push_back( live::summarize( record ) );
+    }
+  
+  const string duration( "burning_phase_duration_seconds" );
+  writeFamily( ostream, duration, "histogram", "Duration of iterations of profiled phases." );
+  for( size_t i=0; i<records.size(); i++ )
+  {
+    string phase( phaseLabels( summaries[ i ] ) );
+    
+    uint64_t cumulative( 0 );
+    for( size_t j=0; j<live::histogramBuckets - 1; j++ )
+    {
+      cumulative += records[ i ].buckets[ j ];
+      ostream << duration << "_bucket{" << phase << ",le=\"" << live::bucketBounds[ j ] / 1e9 << "\"} " << cumulative << '\n';
+    }
+    cumulative += records[ i ].buckets[ live::histogramBuckets - 1 ];
+    ostream << duration << "_bucket{" << phase << ",le=\"+Inf\"} " << cumulative << '\n';
+    
+    ostream << duration << "_count{" << phase << "} " << cumulative << '\n';
+    ostream << duration << "_sum{" << phase << "} " << seconds( records[ i ].totalTime ) << '\n';
+  }
+  
+  const string maximal( "burning_phase_maximal_duration_seconds" );
+  writeFamily( ostream, maximal, "gauge", "Longest iteration of profiled phases." );
+  for( size_t i=0; i<records.size(); i++ )
+    ostream << maximal << '{' << phaseLabels( summaries[ i ] ) << "} " << seconds( records[ i ].maximalTime ) << '\n';
+  
+  const string recent( "burning_phase_recent_duration_seconds" );
+  writeFamily( ostream, recent, "gauge", "Percentiles of recent iterations of profiled phases." );
+  for( size_t i=0; i<summaries.size(); i++ )
+  {
+    const live::Summary& summary( summaries[ i ] );
+    string phase( phaseLabels( summary ) );
+    
+    ostream << recent << '{' << phase << ",quantile=\"0.5\"} " << seconds( summary.median ) << '\n';
+    ostream << recent << '{' << phase << ",quantile=\"0.9\"} " << seconds( summary.percentile90 ) << '\n';
+    ostream << recent << '{' << phase << ",quantile=\"0.99\"} " << seconds( summary.percentile99 ) << '\n';
+  }
+  
+  ostream << "# EOF\n";
+}
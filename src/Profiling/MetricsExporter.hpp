@@ -0,0 +1,76 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_METRICS_EXPORTER_HPP
+#define BURNING_PROFILING_METRICS_EXPORTER_HPP
+
+#include <pthread.h>
+#include <ostream>
+#include <string>
+#include "LiveStatistics.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Serves live statistics over http in OpenMetrics text format.
+     *  Exporter listens on a Unix domain socket or a loopback tcp port and reads
+     *  segment in its own thread, so recording threads are never involved in scraping.
+     */
+    class MetricsExporter
+    {
+    public:
+      /*! Constructs exporter of segment. Segment must outlive exporter. */
+      explicit MetricsExporter( const live::Segment& segment );
+      /*! Stops serving */
+      ~MetricsExporter();
+      
+      /*! Starts serving on Unix domain socket. Returns false on failure. */
+      bool listen( const std::string& socketPath );
+      /*! Starts serving on loopback tcp port, 0 chooses free port. Returns false on failure. */
+      bool listen( unsigned short port );
+      
+      /*! Tcp port exporter listens on, 0 for Unix domain socket */
+      unsigned short port() const;
+      
+      /*! Stops serving and removes socket file */
+      void stop();
+      
+      /*! Writes current statistics in OpenMetrics text format */
+      void writeMetrics( std::ostream& ostream ) const;
+      
+    private:
+      MetricsExporter( const MetricsExporter& );
+      void operator=( const MetricsExporter& );
+      
+      bool start( int socket );
+      static void* serve( void* exporter );
+      void respond( int connection ) const;
+      
+      const live::Segment& _segment;
+      
+      int _socket;
+      std::string _socketPath;
+      unsigned short _port;
+      
+      pthread_t _thread;
+      int _stopPipe[ 2 ];
+      bool _running;
+    };
+  }
+}
+
+#endif
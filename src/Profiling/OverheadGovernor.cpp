@@ -0,0 +1,203 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <glog/logging.h>
+#include "OverheadGovernor.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+// Mean count of calls per timed call, timing every call would double its cost
+static const size_t timedCallInterval = 16;
+
+const char* profiling::detailLevelName( DetailLevel level )
+{
+  static const char* names[] = { "full", "sampled", "aggregated", "off" };
+  return names[ level ];
+}
+
+OverheadGovernor::OverheadGovernor( Profile& profile, double budget, double window, size_t sampling
+                                  ) : _profile( profile ),
+                                      _budget( budget ),
+                                      _window( static_cast< long long >( window * nanoseconds ) ),
+                                      _sampling( std::max< size_t >( sampling, 1 ) ),
+                                      _level( fullDetail ),
+                                      _overhead( 0.0 ),
+                                      _hot(),
+                                      _calls( 0 ),
+                                      _untilTimedCall( timedCallInterval ),
+                                      _random( 2463534242u ),
+                                      _timedCalls( 0 ),
+                                      _timedTime( 0 ),
+                                      _windowBegin( clockNanoseconds( CLOCK_MONOTONIC ) ),
+                                      _windowProcessorTime( clockNanoseconds( CLOCK_THREAD_CPUTIME_ID ) ),
+                                      _iterations(),
+                                      _windowIterations( 0 ),
+                                      _sampled(),
+                                      _changes(),
+                                      _skipped(),
+                                      _ended( false )
+{
+  _profile.setGovernor( this );
+}
+
+OverheadGovernor::~OverheadGovernor()
+{
+  if( !_ended )
+    end();
+}
+
+void OverheadGovernor::setBudget( double budget )
+{
+  _budget = budget;
+}
+
+long long OverheadGovernor::callBegan()
+{
+  _calls++;
+  if( --_untilTimedCall > 0 )
+    return 0;
+  
+  // Random stride keeps timed calls independent of call pattern of loops,
+  // with fixed one a loop of two calls per iteration would time only one kind of them
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  _untilTimedCall = 1 + _random % ( 2 * timedCallInterval - 1 );
+  
+  return clockNanoseconds( CLOCK_MONOTONIC );
+}
+
+void OverheadGovernor::callEnded( long long begin )
+{
+  if( begin == 0 )
+    return;
+  
+  long long now( clockNanoseconds( CLOCK_MONOTONIC ) );
+  _timedCalls++;
+  _timedTime += now - begin;
+  
+  if( now - _windowBegin >= _window )
+    decide( now );
+}
+
+IterationDetail OverheadGovernor::iterationDetail( size_t path )
+{
+  if( path >= _iterations.size() )
+  {
+    _iterations.resize( path + 1, 0 );
+    _sampled.resize( path + 1, 0 );
+  }
+  _iterations[ path ]++;
+  _windowIterations++;
+  
+  if( _level == fullDetail || path >= _hot.size() || !_hot[ path ] )
+    return recordIteration;
+  
+  if( _level == sampledDetail && _sampled[ path ]++ % _sampling == 0 )
+    return sampleIteration;
+  if( _level == aggregatedDetail )
+    return aggregateIteration;
+  
+  _skipped.back()++;
+  return skipIteration;
+}
+
+void OverheadGovernor::decide( long long now )
+{
+  long long processorTime( clockNanoseconds( CLOCK_THREAD_CPUTIME_ID ) );
+  long long used( processorTime - _windowProcessorTime );
+  
+  if( used > 0 && _timedCalls > 0 )
+  {
+    _overhead = double( _timedTime ) / _timedCalls * _calls / used;
+    
+    DetailLevel level( _level );
+    if( _overhead > _budget && _level != noDetail )
+      level = DetailLevel( _level + 1 );
+    else if( _overhead < _budget / 2 && _level != fullDetail )
+      level = DetailLevel( _level - 1 );
+    
+    // Window without iterations keeps hot loops of previous one
+    vector< bool > hot( _hot );
+    if( _windowIterations > 0 )
+    {
+      hot.assign( _iterations.size(), false );
+      for( size_t i=0; i<_iterations.size(); i++ )
+	hot[ i ] = _iterations[ i ] > 0 && _iterations[ i ] * 10 >= _windowIterations;
+    }
+    
+    if( level != _level || ( level != fullDetail && hot != _hot ) )
+    {
+      DetailChange change;
+      change.time = _profile.elapsed();
+      change.level = level;
+      change.overhead = _overhead;
+      if( level != fullDetail )
+	for( size_t i=0; i<hot.size(); i++ )
+	  if( hot[ i ] )
+	    change.loops.push_back( i );
+      
+      _changes.push_back( change );
+      _skipped.push_back( 0 );
+    }
+    
+    _level = level;
+    _hot.swap( hot );
+  }
+  
+  _calls = 0;
+  _timedCalls = 0;
+  _timedTime = 0;
+  _iterations.assign( _iterations.size(), 0 );
+  _windowIterations = 0;
+  _windowBegin = now;
+  _windowProcessorTime = processorTime;
+}
+
+void OverheadGovernor::end()
+{
+  if( _ended )
+  {
+    LOG( ERROR ) << "Overhead governor ended twice.";
+    exit( EXIT_FAILURE );
+  }
+  _ended = true;
+  _profile.setGovernor( NULL );
+  
+  _profile.beginLoop( "detail levels" );
+  for( size_t i=0; i<_changes.size(); i++ )
+  {
+    const DetailChange& change( _changes[ i ] );
+    long long end( i + 1 < _changes.size() ? _changes[ i + 1 ].time : _profile.elapsed() );
+    
+    string loops;
+    for( size_t j=0; j<change.loops.size(); j++ )
+      loops += ( j > 0 ? ", " : "" ) + _profile.pathName( change.loops[ j ] );
+    
+    Phase::ValueList values;
+    values.push_back( std::make_pair( string( "level" ), Value( string( detailLevelName( change.level ) ) ) ) );
+    values.push_back( std::make_pair( string( "overhead" ), Value( change.overhead * 100.0, "%" ) ) );
+    values.push_back( std::make_pair( string( "loops" ), Value( loops ) ) );
+    values.push_back( std::make_pair( string( "skipped" ), Value( _skipped[ i ] ) ) );
+    
+    _profile.addIteration( static_cast< long >( change.time ), end - change.time, values );
+  }
+  _profile.endLoop();
+}
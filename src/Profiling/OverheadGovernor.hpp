@@ -0,0 +1,160 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_OVERHEAD_GOVERNOR_HPP
+#define BURNING_PROFILING_OVERHEAD_GOVERNOR_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Profile.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Detail recorded for hot loops, each level is cheaper than previous one */
+    enum DetailLevel
+    {
+      /*! Every iteration is recorded */
+      fullDetail,
+      /*! One of every sampling iterations is recorded with value "sampled" of 1, others are skipped.
+       *  Other iterations of the loop get "sampled" of 0.
+       */
+      sampledDetail,
+      /*! Iterations are timed and aggregated, their subphases are skipped */
+      aggregatedDetail,
+      /*! Iterations are skipped */
+      noDetail
+    };
+    
+    /*! Name of detail level in profile */
+    const char* detailLevelName( DetailLevel level );
+    
+    /*! How profile records next iteration */
+    enum IterationDetail
+    {
+      recordIteration,
+      sampleIteration,
+      aggregateIteration,
+      skipIteration
+    };
+    
+    /*! A change of detail level */
+    struct DetailChange
+    {
+      /*! Time in nanoseconds since profile began */
+      long long time;
+      DetailLevel level;
+      /*! Overhead measured in window before change */
+      double overhead;
+      /*! Paths of loops the level applies to */
+      std::vector< size_t > loops;
+    };
+    
+    /*! Keeps overhead of profiling below budget by lowering detail of hot loops.
+     *  Profile reports its recording calls to governor, which times one of every 16 calls on average
+     *  with random stride and estimates time spent in profiling from them. At end of each window the estimate
+     *  is compared with processor time used by recording thread in the window: over budget detail is lowered
+     *  by one level, below half of budget it is raised by one level. Levels apply to hot loops, loops with at least a tenth
+     *  of iterations begun in the window, other loops keep full detail.
+     *  Governor must be used on profile's thread.
+     */
+    class OverheadGovernor
+    {
+    public:
+      /*! Starts governing profile.
+       *\param budget Allowed fraction of processor time spent in profiling
+       *\param window Seconds between decisions
+       *\param sampling Iterations of hot loops per recorded one at sampled level
+       */
+      OverheadGovernor( Profile& profile, double budget = 0.01, double window = 1.0, size_t sampling = 16 );
+      /*! Ends governor if it was not ended */
+      ~OverheadGovernor();
+      
+      /*! Changes allowed fraction of processor time */
+      void setBudget( double budget );
+      
+      /*! Current detail level of hot loops */
+      DetailLevel level() const
+      {
+	return _level;
+      }
+      /*! Overhead measured in last window */
+      double overhead() const
+      {
+	return _overhead;
+      }
+      /*! Changes of detail level so far */
+      const std::vector< DetailChange >& changes() const
+      {
+	return _changes;
+      }
+      
+      /*! Called by profile at begin of its recording call, returns value passed to callEnded */
+      long long callBegan();
+      /*! Called by profile at end of its recording call */
+      void callEnded( long long begin );
+      /*! Called by profile before iteration of loop begins */
+      IterationDetail iterationDetail( size_t path );
+      
+      /*! Stops governing and adds changes as iterations of loop "detail levels" in profile's current phase.
+       *  Iterations are named by time of change in nanoseconds since profile began and last until next change.
+       *  They have "level", "overhead" in window before change, "loops" the level applies to
+       *  and count of iterations "skipped" by governor until next change.
+       */
+      void end();
+      
+    private:
+      OverheadGovernor( const OverheadGovernor& );
+      void operator=( const OverheadGovernor& );
+      
+      void decide( long long now );
+      
+      Profile& _profile;
+      double _budget;
+      long long _window;
+      size_t _sampling;
+      
+      DetailLevel _level;
+      double _overhead;
+      /*! Hot loops are marked by their paths */
+      std::vector< bool > _hot;
+      
+      size_t _calls;
+      /*! Calls till next timed one, strides are random with mean of 16 calls */
+      size_t _untilTimedCall;
+      /*! State of xorshift generator of strides */
+      uint32_t _random;
+      size_t _timedCalls;
+      long long _timedTime;
+      long long _windowBegin;
+      long long _windowProcessorTime;
+      
+      /*! Iterations begun in window by paths */
+      std::vector< size_t > _iterations;
+      size_t _windowIterations;
+      /*! Iterations of paths seen at sampled level */
+      std::vector< size_t > _sampled;
+      
+      std::vector< DetailChange > _changes;
+      std::vector< size_t > _skipped;
+      bool _ended;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,228 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <glog/logging.h>
+#include <boost/foreach.hpp>
+#include "ParallelLoop.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Iterations recorded by one worker */
+    struct WorkerBuffer
+    {
+      struct Iteration
+      {
+	Iteration( const xml::Attribute::ValueType& name, long long begin ) : name( name ),
+	                                                                        begin( begin ),
+	                                                                        end( 0 ),
+	                                                                        values()
+	{
+	}
+
+	xml::Attribute::ValueType name;
+	long long begin;
+	long long end;
+	Phase::ValueList values;
+      };
+
+      WorkerBuffer() : iterations(), began( false )
+      {
+      }
+
+      std::vector< Iteration > iterations;
+      bool began;
+      // Keeps buffers of different workers on different cache lines
+      char padding[ 64 ];
+    };
+  }
+}
+
+LoadBalance::LoadBalance() : maximum( 0.0 ),
+                             mean( 0.0 ),
+                             deviation( 0.0 )
+{
+}
+
+double LoadBalance::imbalance() const
+{
+  return mean > 0.0 ? maximum / mean : 1.0;
+}
+
+ParallelLoop::ParallelLoop( Profile& profile, const string& name, size_t workers, TimeMeasure measure
+                          ) : _profile( profile ),
+                              _name( name ),
+                              _measure( measure ),
+                              _buffers(),
+                              _ended( false ),
+                              _loadBalance()
+{
+  for( size_t i=0; i<workers; i++ )
+    _buffers.push_back( new WorkerBuffer() );
+
+  _profile.beginLoop( name );
+}
+
+ParallelLoop::~ParallelLoop()
+{
+  if( !_ended )
+    end();
+
+  for( size_t i=0; i<_buffers.size(); i++ )
+    delete _buffers[ i ];
+}
+
+size_t ParallelLoop::workers() const
+{
+  return _buffers.size();
+}
+
+WorkerBuffer& ParallelLoop::buffer( size_t worker )
+{
+  if( worker >= _buffers.size() )
+  {
+    LOG( ERROR ) << "Parallel loop " << _name << " has no worker " << worker << '.';
+    exit( EXIT_FAILURE );
+  }
+
+  return *_buffers[ worker ];
+}
+
+void ParallelLoop::beginIteration( size_t worker, const xml::Attribute::ValueType& name )
+{
+  WorkerBuffer& current( buffer( worker ) );
+  if( current.began )
+  {
+    LOG( ERROR ) << "Worker " << worker << " of " << _name << " began iteration twice.";
+    exit( EXIT_FAILURE );
+  }
+
+  current.began = true;
+  current.iterations.push_back( WorkerBuffer::Iteration( name, clockNanoseconds( CLOCK_MONOTONIC ) ) );
+}
+
+void ParallelLoop::addValue( size_t worker, const string& name, const Value& value )
+{
+  WorkerBuffer& current( buffer( worker ) );
+  if( !current.began )
+  {
+    LOG( ERROR ) << "Worker " << worker << " of " << _name << " added value without iteration.";
+    exit( EXIT_FAILURE );
+  }
+
+  current.iterations.back().values.push_back( std::make_pair( name, value ) );
+}
+
+void ParallelLoop::endIteration( size_t worker )
+{
+  long long end( clockNanoseconds( CLOCK_MONOTONIC ) );
+
+  WorkerBuffer& current( buffer( worker ) );
+  if( !current.began )
+  {
+    LOG( ERROR ) << "Worker " << worker << " of " << _name << " ended unstarted iteration.";
+    exit( EXIT_FAILURE );
+  }
+
+  current.began = false;
+  current.iterations.back().end = end;
+}
+
+// Begin time, worker and index of iteration
+typedef std::pair< long long, std::pair< size_t, size_t > > IterationOrder;
+
+void ParallelLoop::end()
+{
+  if( _ended )
+  {
+    LOG( ERROR ) << "Parallel loop " << _name << " ended twice.";
+    exit( EXIT_FAILURE );
+  }
+  _ended = true;
+
+  vector< IterationOrder > order;
+  vector< double > busy( _buffers.size(), 0.0 );
+  for( size_t worker=0; worker<_buffers.size(); worker++ )
+  {
+    if( _buffers[ worker ]->began )
+      LOG( WARNING ) << "Worker " << worker << " of " << _name << " did not end its iteration.";
+
+    const vector< WorkerBuffer::Iteration >& iterations( _buffers[ worker ]->iterations );
+    for( size_t i=0; i<iterations.size(); i++ )
+    {
+      if( iterations[ i ].end == 0 )
+	continue;
+
+      order.push_back( IterationOrder( iterations[ i ].begin, std::make_pair( worker, i ) ) );
+      busy[ worker ] += iterations[ i ].end - iterations[ i ].begin;
+    }
+  }
+  std::sort( order.begin(), order.end() );
+
+  for( size_t i=0; i<order.size(); i++ )
+  {
+    size_t worker( order[ i ].second.first );
+    const WorkerBuffer::Iteration& iteration( _buffers[ worker ]->iterations[ order[ i ].second.second ] );
+
+    Phase::ValueList values( iteration.values );
+    values.push_back( std::make_pair( string( "worker" ), Value( worker ) ) );
+    _profile.addIteration( iteration.name, iteration.end - iteration.begin, values, _measure );
+  }
+
+  if( busy.empty() )
+  {
+    _profile.endLoop();
+    return;
+  }
+
+  Aggregate busyTime;
+  busyTime.measure = "ns";
+  BOOST_FOREACH( double time, busy )
+    busyTime.add( time );
+
+  _loadBalance.maximum = busyTime.maximum;
+  _loadBalance.mean = busyTime.sum / busyTime.count;
+
+  double squares( 0.0 );
+  for( size_t i=0; i<busy.size(); i++ )
+    squares += ( busy[ i ] - _loadBalance.mean ) * ( busy[ i ] - _loadBalance.mean );
+  _loadBalance.deviation = std::sqrt( squares / busy.size() );
+
+  // Deviation and imbalance are single numbers, so they are aggregates of one sample
+  Aggregate deviation;
+  deviation.measure = "ns";
+  deviation.add( _loadBalance.deviation );
+  Aggregate imbalance;
+  imbalance.add( _loadBalance.imbalance() );
+
+  _profile.setAggregate( "worker busy", busyTime );
+  _profile.setAggregate( "worker busy deviation", deviation );
+  _profile.setAggregate( "worker imbalance", imbalance );
+  _profile.endLoop();
+}
+
+const LoadBalance& ParallelLoop::loadBalance() const
+{
+  return _loadBalance;
+}
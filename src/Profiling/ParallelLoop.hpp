@@ -0,0 +1,96 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_PARALLEL_LOOP_HPP
+#define BURNING_PROFILING_PARALLEL_LOOP_HPP
+
+#include <string>
+#include <vector>
+#include "Profile.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    struct WorkerBuffer;
+
+    /*! Busy time of workers of parallel loop in nanoseconds */
+    struct LoadBalance
+    {
+      LoadBalance();
+
+      double maximum;
+      double mean;
+      double deviation;
+
+      /*! Maximal to mean busy time, 1 for perfectly balanced loop */
+      double imbalance() const;
+    };
+
+    /*! A loop whose iterations are run by several worker threads.
+     *  Loop is opened in profile by constructing thread, each worker records its iterations
+     *  into its own buffer, so workers do not synchronize. Worker must not be shared by threads.
+     *  At end iterations are merged into the loop ordered by begin time, each with a "worker" value,
+     *  and busy times of workers in nanoseconds are summarized in "worker busy" aggregate of the loop.
+     *  Their standard deviation and imbalance are kept as "worker busy deviation" and "worker imbalance"
+     *  aggregates of one sample, so they are printed and saved with the loop.
+     *  Like other loops, a parallel loop with given name can run once per iteration of enclosing phase.
+     */
+    class ParallelLoop
+    {
+    public:
+      /*! Begins loop in profile's current phase */
+      ParallelLoop( Profile& profile, const std::string& name, size_t workers,
+		    TimeMeasure measure = milliseconds );
+      /*! Ends loop if it was not ended */
+      ~ParallelLoop();
+
+      /*! Count of workers */
+      size_t workers() const;
+
+      /*! Begins iteration of worker */
+      void beginIteration( size_t worker, const xml::Attribute::ValueType& name );
+      /*! Adds value to current iteration of worker */
+      void addValue( size_t worker, const std::string& name, const Value& value );
+      /*! Ends iteration of worker */
+      void endIteration( size_t worker );
+
+      /*! Merges iterations of workers into loop and ends it. Must be called by constructing thread
+       *  after workers are finished.
+       */
+      void end();
+
+      /*! Busy time of workers computed by end */
+      const LoadBalance& loadBalance() const;
+
+    private:
+      ParallelLoop( const ParallelLoop& );
+      void operator=( const ParallelLoop& );
+
+      WorkerBuffer& buffer( size_t worker );
+
+      Profile& _profile;
+      std::string _name;
+      TimeMeasure _measure;
+
+      std::vector< WorkerBuffer* > _buffers;
+      bool _ended;
+      LoadBalance _loadBalance;
+    };
+  }
+}
+
+#endif
@@ -14,8 +14,16 @@
    this library. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <boost/assign/std/map.hpp>
 #include <boost/foreach.hpp>
+#include "Statistics.hpp"
 #include "Table.hpp"
 #include "Phase.hpp"
 
@@ -25,26 +33,156 @@ using std::vector;
 using namespace boost::assign;
 using namespace burning::profiling;
 
+Aggregate::Aggregate() : count( 0 ),
+                         sum( 0.0 ),
+                         minimum( 0.0 ),
+                         maximum( 0.0 ),
+                         measure()
+{
+}
+
+void Aggregate::add( double value )
+{
+  minimum = count == 0 ? value : std::min( minimum, value );
+  maximum = count == 0 ? value : std::max( maximum, value );
+  sum += value;
+  count++;
+}
+
 Phase::Phase() : _values(),
                  _phases(),
-                 _began( false )
+                 _labels(),
+                 _lastDuration( 0 ),
+                 _began( false ),
+                 _retention( retainAll ),
+                 _slowestCount( 0 ),
+                 _slowest(),
+                 _aggregating( false ),
+                 _aggregates(),
+                 _accumulated(),
+                 _cpuTracking( false ),
+                 _beginCpu( -1 ),
+                 _lastCpu( -1 ),
+                 _migrations( 0 ),
+                 _steadyWindow( 0 ),
+                 _steadyTolerance( 0.0 ),
+                 _stopDetail( false ),
+                 _steady( false ),
+                 _detailStopped( false ),
+                 _detailPaused( false ),
+                 _recent(),
+                 _warmupTime(),
+                 _steadyTime()
 {
 }
 
 Phase::Phase( const Phase& phase 
             ) : _values( phase._values ),
 		_phases( phase._phases ),
+                _iterations( phase._iterations ),
+                _labels( phase._labels ),
                 _beginTime( phase._beginTime ),
-                _began( phase._began )
+                _lastDuration( phase._lastDuration ),
+                _began( phase._began ),
+                _retention( phase._retention ),
+                _slowestCount( phase._slowestCount ),
+                _slowest( phase._slowest ),
+                _aggregating( phase._aggregating ),
+                _aggregates( phase._aggregates ),
+                _accumulated( phase._accumulated ),
+                _cpuTracking( phase._cpuTracking ),
+                _beginCpu( phase._beginCpu ),
+                _lastCpu( phase._lastCpu ),
+                _migrations( phase._migrations ),
+                _steadyWindow( phase._steadyWindow ),
+                _steadyTolerance( phase._steadyTolerance ),
+                _stopDetail( phase._stopDetail ),
+                _steady( phase._steady ),
+                _detailStopped( phase._detailStopped ),
+                _detailPaused( phase._detailPaused ),
+                _recent( phase._recent ),
+                _warmupTime( phase._warmupTime ),
+                _steadyTime( phase._steadyTime )
 {
 }
 
+Phase::Phase( const Phase& phase, size_t first, size_t last
+            ) : _values(),
+		_phases(),
+                _iterations(),
+                _labels(),
+                _beginTime( phase._beginTime ),
+                _lastDuration( phase._lastDuration ),
+                _began( phase._began ),
+                _retention( phase._retention ),
+                _slowestCount( phase._slowestCount ),
+                _slowest( phase._slowest ),
+                _aggregating( phase._aggregating ),
+                _aggregates( phase._aggregates ),
+                _accumulated( phase._accumulated ),
+                _cpuTracking( phase._cpuTracking ),
+                _beginCpu( phase._beginCpu ),
+                _lastCpu( phase._lastCpu ),
+                _migrations( phase._migrations ),
+                _steadyWindow( phase._steadyWindow ),
+                _steadyTolerance( phase._steadyTolerance ),
+                _stopDetail( phase._stopDetail ),
+                _steady( phase._steady ),
+                _detailStopped( phase._detailStopped ),
+                _detailPaused( phase._detailPaused ),
+                _recent( phase._recent ),
+                _warmupTime( phase._warmupTime ),
+                _steadyTime( phase._steadyTime )
+{
+  last = std::min( last, phase._iterations.size() );
+  _iterations.assign( phase._iterations.begin() + first, phase._iterations.begin() + last );
+  
+  if( first < phase._labels.size() )
+    _labels.assign( phase._labels.begin() + first, phase._labels.begin() + std::min( last, phase._labels.size() ) );
+  
+  // Values and subphases of unfinished iteration can be missing
+  for( ValueMap::const_iterator value = phase._values.begin(); value != phase._values.end(); ++value )
+    if( std::min( last, value->second.size() ) > first )
+      _values[ value->first ].assign( value->second.begin() + first, value->second.begin() + std::min( last, value->second.size() ) );
+  
+  for( PhaseMap::const_iterator subphase = phase._phases.begin(); subphase != phase._phases.end(); ++subphase )
+    if( std::min( last, subphase->second.size() ) > first )
+      _phases[ subphase->first ].assign( subphase->second.begin() + first, subphase->second.begin() + std::min( last, subphase->second.size() ) );
+  
+  // Slots of kept slowest iterations refer to the whole loop
+  if( first > 0 )
+    _slowest.clear();
+}
+
+
 void Phase::operator=( const Phase& phase )
 {
   _values = phase._values;
   _phases = phase._phases;
+  _iterations = phase._iterations;
+  _labels = phase._labels;
   _beginTime = phase._beginTime;
+  _lastDuration = phase._lastDuration;
   _began = phase._began;
+  _retention = phase._retention;
+  _slowestCount = phase._slowestCount;
+  _slowest = phase._slowest;
+  _aggregating = phase._aggregating;
+  _aggregates = phase._aggregates;
+  _accumulated = phase._accumulated;
+  _cpuTracking = phase._cpuTracking;
+  _beginCpu = phase._beginCpu;
+  _lastCpu = phase._lastCpu;
+  _migrations = phase._migrations;
+  _steadyWindow = phase._steadyWindow;
+  _steadyTolerance = phase._steadyTolerance;
+  _stopDetail = phase._stopDetail;
+  _steady = phase._steady;
+  _detailStopped = phase._detailStopped;
+  _detailPaused = phase._detailPaused;
+  _recent = phase._recent;
+  _warmupTime = phase._warmupTime;
+  _steadyTime = phase._steadyTime;
 }
 
 const Phase::ValueMap& Phase::values() const
@@ -68,6 +206,55 @@ void Phase::addValue( const string& name, const Value& value )
   _values[ name ].push_back( value );
 }
 
+void Phase::addLabel( const string& key, const string& value )
+{
+  if( !_began )
+  {
+    LOG( ERROR ) << "Tried to add label without related iteration.";
+    exit( EXIT_FAILURE );
+  }
+  
+  if( _labels.size() < _iterations.size() )
+    _labels.resize( _iterations.size() );
+  _labels[ _iterations.size() - 1 ].set( key, value );
+}
+
+const LabelSet& Phase::labels( size_t iteration ) const
+{
+  static const LabelSet none;
+  
+  return iteration < _labels.size() ? _labels[ iteration ] : none;
+}
+
+bool Phase::labelled() const
+{
+  BOOST_FOREACH( const LabelSet& labels, _labels )
+    if( !labels.empty() )
+      return true;
+  
+  return false;
+}
+
+void Phase::accumulateValue( const string& name, const Value& value )
+{
+  if( !_began )
+  {
+    LOG( ERROR ) << "Tried to accumulate value without related iteration.";
+    exit( EXIT_FAILURE );
+  }
+  
+  vector< Value >& values( _values[ name ] );
+  while( values.size() + 1 < _iterations.size() )
+    values.push_back( Value( 0, value.measure() ) );
+  
+  if( values.size() < _iterations.size() )
+    values.push_back( value );
+  else
+    values.back() = Value( values.back().value().as< double >() + value.value().as< double >(), value.measure() );
+  
+  _accumulated[ name ] = value.measure();
+}
+
 const Phase::PhaseMap& Phase::phases() const
 {
   return _phases;
@@ -88,6 +275,385 @@ void Phase::addPhase( const string& name, const PhasePtr& phase )
   _phases[ name ].push_back( phase );
 }
 
+bool Phase::haveSameStructure( const Phase& phase ) const
+{
+  std::pair< string, vector< Value > > value;
+  BOOST_FOREACH( value, _values )
+    if( value.first != "source" && phase._values.count( value.first ) == 0 )
+      return false;
+  BOOST_FOREACH( value, phase._values )
+    if( value.first != "source" && _values.count( value.first ) == 0 )
+      return false;
+  
+  std::pair< string, vector< PhasePtr > > subphase;
+  BOOST_FOREACH( subphase, _phases )
+    if( phase._phases.count( subphase.first ) == 0 )
+      return false;
+  BOOST_FOREACH( subphase, phase._phases )
+    if( _phases.count( subphase.first ) == 0 )
+      return false;
+  
+  return true;
+}
+
+vector< Value > Phase::sourceValues( size_t offset ) const
+{
+  ValueMap::const_iterator sources( _values.find( "source" ) );
+  if( sources == _values.end() )
+    return vector< Value >( _iterations.size(), Value( offset ) );
+  
+  vector< Value > ret;
+  BOOST_FOREACH( const Value& source, sources->second )
+    ret.push_back( Value( source.value().as< size_t >() + offset ) );
+  
+  return ret;
+}
+
+void Phase::shiftSources( size_t offset )
+{
+  _values[ "source" ] = sourceValues( offset );
+}
+
+size_t Phase::sources() const
+{
+  ValueMap::const_iterator sources( _values.find( "source" ) );
+  if( sources == _values.end() )
+    return 1;
+  
+  size_t ret( 1 );
+  BOOST_FOREACH( const Value& source, sources->second )
+    ret = std::max( ret, source.value().as< size_t >() + 1 );
+  
+  return ret;
+}
+
+bool Phase::append( const Phase& phase, size_t offset )
+{
+  if( _began || phase._began )
+  {
+    LOG( ERROR ) << "Cannot merge unfinished phases.";
+    return false;
+  }
+  if( !haveSameStructure( phase ) )
+  {
+    LOG( ERROR ) << "Cannot merge phases with different values or subphases.";
+    return false;
+  }
+  
+  if( _values.count( "source" ) == 0 )
+    shiftSources( 0 );
+  
+  vector< Value > sources( phase.sourceValues( offset ) );
+  _values[ "source" ].insert( _values[ "source" ].end(), sources.begin(), sources.end() );
+  
+  std::pair< string, vector< Value > > value;
+  BOOST_FOREACH( value, phase._values )
+  {
+    if( value.first == "source" )
+      continue;
+    
+    vector< Value >& values( _values[ value.first ] );
+    values.insert( values.end(), value.second.begin(), value.second.end() );
+  }
+  
+  std::pair< string, vector< PhasePtr > > subphase;
+  BOOST_FOREACH( subphase, phase._phases )
+  {
+    vector< PhasePtr >& phases( _phases[ subphase.first ] );
+    phases.insert( phases.end(), subphase.second.begin(), subphase.second.end() );
+  }
+  
+  if( !phase._labels.empty() )
+  {
+    _labels.resize( _iterations.size() );
+    _labels.insert( _labels.end(), phase._labels.begin(), phase._labels.end() );
+  }
+  
+  _iterations.insert( _iterations.end(), phase._iterations.begin(), phase._iterations.end() );
+  return true;
+}
+
+// Time value in nanoseconds, values without time measure are taken as nanoseconds
+static long long timeInNanoseconds( const Value& time )
+{
+  double value( time.value().as< double >() );
+  double converted;
+  
+  if( !convertMeasure( value, time.measure(), "ns", converted ) )
+    return static_cast< long long >( value );
+  return static_cast< long long >( converted );
+}
+
+// Min-heap ordering of kept iterations
+static bool slower( const std::pair< long long, size_t >& left, const std::pair< long long, size_t >& right )
+{
+  return left > right;
+}
+
+void Phase::setAggregate( const string& name, const Aggregate& aggregate )
+{
+  if( _values.count( name ) > 0 )
+  {
+    LOG( ERROR ) << "Aggregate " << name << " conflicts with value of same name.";
+    exit( EXIT_FAILURE );
+  }
+  
+  _aggregates[ name ] = aggregate;
+}
+
+void Phase::setRetention( Retention retention, size_t slowest )
+{
+  if( _began )
+  {
+    LOG( ERROR ) << "Cannot change retention during iteration.";
+    exit( EXIT_FAILURE );
+  }
+  
+  if( !_aggregating && retention != retainAll )
+  {
+    _aggregating = true;
+    for( size_t i=0; i<_iterations.size(); i++ )
+      aggregateIteration( i );
+  }
+  
+  _retention = retention;
+  _slowestCount = slowest;
+  _slowest.clear();
+  if( retention == retainAll )
+    return;
+  
+  // Completed iterations are evicted as if they were recorded with new retention
+  ValueMap::const_iterator times( _values.find( "time" ) );
+  vector< std::pair< long long, size_t > > durations;
+  for( size_t i=0; i<_iterations.size(); i++ )
+  {
+    bool timed( times != _values.end() && i < times->second.size() );
+    durations.push_back( std::make_pair( timed ? timeInNanoseconds( times->second[ i ] ) : 0, i ) );
+  }
+  
+  size_t kept( retention == retainSlowest ? std::min( slowest, durations.size() ) : 0 );
+  std::sort( durations.begin(), durations.end(), slower );
+  
+  vector< bool > keep( _iterations.size(), false );
+  for( size_t i=0; i<kept; i++ )
+    keep[ durations[ i ].second ] = true;
+  
+  for( size_t i=_iterations.size(); i>0; i-- )
+    if( !keep[ i - 1 ] )
+      removeIteration( i - 1 );
+  
+  if( times == _values.end() )
+    return;
+  
+  for( size_t i=0; i<_iterations.size() && i < times->second.size(); i++ )
+    _slowest.push_back( std::make_pair( timeInNanoseconds( times->second[ i ] ), i ) );
+  std::make_heap( _slowest.begin(), _slowest.end(), slower );
+}
+
+void Phase::aggregateIteration( size_t index )
+{
+  for( ValueMap::const_iterator value = _values.begin(); value != _values.end(); ++value )
+  {
+    if( index >= value->second.size() )
+      continue;
+    
+    const Value& current( value->second[ index ] );
+    if( boost::get< Decimal >( &current.rawValue() ) == NULL )
+      continue;
+    
+    Aggregate& aggregate( _aggregates[ value->first ] );
+    if( aggregate.count == 0 )
+      aggregate.measure = current.measure();
+    aggregate.add( current.value().as< double >() );
+  }
+}
+
+void Phase::removeIteration( size_t index )
+{
+  // Last iteration takes place of removed one, so removal does not shift other iterations
+  size_t count( _iterations.size() );
+  
+  for( ValueMap::iterator value = _values.begin(); value != _values.end(); ++value )
+    if( value->second.size() == count )
+    {
+      value->second[ index ] = value->second.back();
+      value->second.pop_back();
+    }
+  
+  for( PhaseMap::iterator phase = _phases.begin(); phase != _phases.end(); ++phase )
+    if( phase->second.size() == count )
+    {
+      phase->second[ index ] = phase->second.back();
+      phase->second.pop_back();
+    }
+  
+  if( _labels.size() == count )
+  {
+    _labels[ index ] = _labels.back();
+    _labels.pop_back();
+  }
+  else if( index < _labels.size() )
+    _labels[ index ] = LabelSet();
+  
+  _iterations[ index ] = _iterations.back();
+  _iterations.pop_back();
+}
+
+void Phase::retainIteration( long long duration )
+{
+  size_t index( _iterations.size() - 1 );
+  if( _retention == retainNone )
+  {
+    removeIteration( index );
+    return;
+  }
+  
+  if( _slowest.size() < _slowestCount )
+  {
+    _slowest.push_back( std::make_pair( duration, index ) );
+    std::push_heap( _slowest.begin(), _slowest.end(), slower );
+    return;
+  }
+  
+  if( _slowest.empty() || duration <= _slowest.front().first )
+  {
+    removeIteration( index );
+    return;
+  }
+  
+  // New iteration overwrites the fastest kept one
+  std::pop_heap( _slowest.begin(), _slowest.end(), slower );
+  size_t slot( _slowest.back().second );
+  removeIteration( slot );
+  
+  _slowest.back() = std::make_pair( duration, slot );
+  std::push_heap( _slowest.begin(), _slowest.end(), slower );
+}
+
+PhasePtr Phase::snapshot( size_t maximalIterations, const Phase* active, const PhasePtr& activeSnapshot ) const
+{
+  // Loop between iterations is copied like completed part of running one
+  if( !_began )
+  {
+    size_t count( _iterations.size() );
+    return PhasePtr( new Phase( *this, count > maximalIterations ? count - maximalIterations : 0, count ) );
+  }
+  
+  bool single( _iterations.size() == 1 && _iterations[ 0 ] == string( "" ) );
+  if( single )
+  {
+    PhasePtr ret( new Phase( *this ) );
+    for( PhaseMap::iterator phase = ret->_phases.begin(); phase != ret->_phases.end(); ++phase )
+      if( !phase->second.empty() && phase->second.back().get() == active )
+	phase->second.back() = activeSnapshot;
+    
+    ret->endIteration();
+    return ret;
+  }
+  
+  // Values can be added after iteration's end, so completed part ends with the shortest value
+  size_t completed( _iterations.size() - 1 );
+  for( ValueMap::const_iterator value = _values.begin(); value != _values.end(); ++value )
+    if( !value->second.empty() )
+      completed = std::min( completed, value->second.size() );
+  
+  size_t first( completed > maximalIterations ? completed - maximalIterations : 0 );
+  PhasePtr ret( new Phase( *this, first, completed ) );
+  ret->_began = false;
+  
+  return ret;
+}
+
+static vector< int > cpuNodes;
+static pthread_once_t cpuNodesRead = PTHREAD_ONCE_INIT;
+
+// Parses cpu list like "0-3,8" from sysfs
+static void readCpuList( const string& path, int node )
+{
+  std::ifstream stream( path.c_str() );
+  
+  int first;
+  while( stream >> first )
+  {
+    int last( first );
+    if( stream.peek() == '-' )
+    {
+      stream.get();
+      stream >> last;
+    }
+    
+    for( int cpu = first; cpu <= last && cpu >= 0; cpu++ )
+    {
+      if( cpuNodes.size() <= size_t( cpu ) )
+	cpuNodes.resize( cpu + 1, -1 );
+      cpuNodes[ cpu ] = node;
+    }
+    
+    if( stream.peek() == ',' )
+      stream.get();
+  }
+}
+
+static void readCpuNodes()
+{
+  string root( "/sys/devices/system/node/" );
+  DIR* directory( opendir( root.c_str() ) );
+  if( directory == NULL )
+    return;
+  
+  while( dirent* entry = readdir( directory ) )
+  {
+    int node;
+    char tail;
+    if( sscanf( entry->d_name, "node%d%c", &node, &tail ) == 1 )
+      readCpuList( root + entry->d_name + "/cpulist", node );
+  }
+  closedir( directory );
+}
+
+// NUMA node of processor or -1 if it is unknown
+static int cpuNode( int cpu )
+{
+  pthread_once( &cpuNodesRead, readCpuNodes );
+  
+  if( cpu < 0 || size_t( cpu ) >= cpuNodes.size() )
+    return -1;
+  return cpuNodes[ cpu ];
+}
+
+void Phase::setCpuTracking( bool tracking )
+{
+  if( tracking != _cpuTracking && ( !_iterations.empty() || _began ) )
+  {
+    LOG( ERROR ) << "Cannot change cpu tracking of phase with iterations.";
+    exit( EXIT_FAILURE );
+  }
+  
+  _cpuTracking = tracking;
+}
+
+void Phase::observeCpu( int cpu )
+{
+  if( !_cpuTracking || !_began || cpu < 0 )
+    return;
+  
+  if( _beginCpu < 0 )
+    _beginCpu = cpu;
+  else if( cpu != _lastCpu )
+    _migrations++;
+  
+  _lastCpu = cpu;
+}
+
+void Phase::addCpuValues()
+{
+  _values[ "begin cpu" ].push_back( _beginCpu );
+  _values[ "end cpu" ].push_back( _lastCpu );
+  _values[ "migrations" ].push_back( _migrations );
+  _values[ "begin node" ].push_back( cpuNode( _beginCpu ) );
+  _values[ "end node" ].push_back( cpuNode( _lastCpu ) );
+}
+
 void Phase::beginIteration( const xml::Attribute::ValueType& name )
 {
   if( _began )
@@ -99,14 +665,26 @@ void Phase::beginIteration( const xml::Attribute::ValueType& name )
     _began = true;
         
   _iterations.push_back( name );
+  
+  if( _cpuTracking )
+  {
+    _beginCpu = -1;
+    _lastCpu = -1;
+    _migrations = 0;
+    observeCpu( sched_getcpu() );
+  }
+  
   clock_gettime( CLOCK_MONOTONIC, &_beginTime );
 }
 
-void Phase::endIteration( TimeMeasure measure )
+void Phase::endIteration( TimeMeasure measure, bool retain )
 {
   timespec endTime;
   clock_gettime( CLOCK_MONOTONIC, &endTime );
   
+  if( _cpuTracking )
+    observeCpu( sched_getcpu() );
+  
   if( !_began )
   {
     LOG( ERROR ) << "Tried to end unstarted phase.";
@@ -115,11 +693,65 @@ void Phase::endIteration( TimeMeasure measure )
   else
     _began = false;
   
+  _lastDuration = ( endTime.tv_sec - _beginTime.tv_sec ) * static_cast< long long >( nanoseconds );
+  _lastDuration += endTime.tv_nsec - _beginTime.tv_nsec;
+  
   long time = endTime.tv_sec - _beginTime.tv_sec;
   time *= measure;
   
   time +=( endTime.tv_nsec - _beginTime.tv_nsec ) / ( nanoseconds / measure );
   
+  finishIteration( time, measure, retain );
+}
+
+void Phase::endMeasuredIteration( long long duration, TimeMeasure measure, bool retain )
+{
+  if( !_began )
+  {
+    LOG( ERROR ) << "Tried to end unstarted phase.";
+    exit( EXIT_FAILURE );
+  }
+  _began = false;
+  
+  _lastDuration = duration;
+  finishIteration( static_cast< long >( duration / ( nanoseconds / measure ) ), measure, retain );
+}
+
+void Phase::beginMeasuredIteration( const xml::Attribute::ValueType& name )
+{
+  if( _began )
+  {
+    LOG( ERROR ) << "Cannot start phase twice.";
+    exit( EXIT_FAILURE );
+  }
+  _began = true;
+  
+  _iterations.push_back( name );
+  
+  if( _cpuTracking )
+  {
+    _beginCpu = -1;
+    _lastCpu = -1;
+    _migrations = 0;
+  }
+}
+
+void Phase::addIteration( const xml::Attribute::ValueType& name, long long duration, const ValueList& values, TimeMeasure measure )
+{
+  if( _began )
+  {
+    LOG( ERROR ) << "Cannot add iteration while other one is in progress.";
+    exit( EXIT_FAILURE );
+  }
+  
+  beginMeasuredIteration( name );
+  for( ValueList::const_iterator value = values.begin(); value != values.end(); ++value )
+    addValue( value->first, value->second );
+  endMeasuredIteration( duration, measure );
+}
+
+void Phase::finishIteration( long time, TimeMeasure measure, bool retain )
+{
   string measureName;
   switch( measure )
   {
@@ -142,6 +774,122 @@ void Phase::endIteration( TimeMeasure measure )
   }
   
   _values[ "time" ].push_back( Value( time, measureName ) );
+  
+  if( _cpuTracking )
+    addCpuValues();
+  
+  for( map< string, string >::const_iterator accumulated = _accumulated.begin(); accumulated != _accumulated.end(); ++accumulated )
+  {
+    vector< Value >& values( _values[ accumulated->first ] );
+    if( values.size() < _iterations.size() )
+      values.push_back( Value( 0, accumulated->second ) );
+  }
+  
+  if( retain )
+    settleIteration();
+}
+
+void Phase::settleIteration()
+{
+  // Iteration that completes steady windows is kept even if detail stops with it
+  bool detailStopped( _detailStopped );
+  if( _steadyWindow > 0 )
+    observeDuration( _lastDuration );
+  
+  if( _aggregating )
+    aggregateIteration( _iterations.size() - 1 );
+  if( detailStopped || _detailPaused )
+    removeIteration( _iterations.size() - 1 );
+  else if( _retention != retainAll )
+    retainIteration( _lastDuration );
+}
+
+void Phase::pauseDetail( bool paused )
+{
+  if( _began )
+  {
+    LOG( ERROR ) << "Cannot pause detail during iteration.";
+    exit( EXIT_FAILURE );
+  }
+  
+  if( paused && !_aggregating )
+  {
+    _aggregating = true;
+    for( size_t i=0; i<_iterations.size(); i++ )
+      aggregateIteration( i );
+  }
+  _detailPaused = paused;
+}
+
+void Phase::setSteadyStateDetection( size_t window, double tolerance, bool stopDetail )
+{
+  _steadyWindow = window;
+  _steadyTolerance = tolerance;
+  _stopDetail = stopDetail;
+  _steady = false;
+  _detailStopped = false;
+  _recent.clear();
+  _warmupTime = Aggregate();
+  _steadyTime = Aggregate();
+  _warmupTime.measure = "ns";
+  _steadyTime.measure = "ns";
+}
+
+// Compares two adjacent windows of durations, older window first
+static bool steadyWindows( const std::deque< long long >& recent, size_t window, double tolerance )
+{
+  vector< double > older( recent.begin(), recent.begin() + window );
+  vector< double > newer( recent.begin() + window, recent.end() );
+  
+  double olderMean( statistics::mean( older ) );
+  double newerMean( statistics::mean( newer ) );
+  double olderDeviation( window > 1 ? statistics::standardDeviation( older ) : 0.0 );
+  double newerDeviation( window > 1 ? statistics::standardDeviation( newer ) : 0.0 );
+  
+  // Warmup outliers inflate variance of older window
+  if( olderDeviation * olderDeviation > 4.0 * newerDeviation * newerDeviation )
+    return false;
+  
+  double shift( std::fabs( olderMean - newerMean ) );
+  double standardError( std::sqrt( ( olderDeviation * olderDeviation + newerDeviation * newerDeviation ) / window ) );
+  
+  return shift <= tolerance * newerMean || ( standardError > 0.0 && shift <= 2.0 * standardError );
+}
+
+void Phase::observeDuration( long long duration )
+{
+  if( _steady )
+  {
+    _steadyTime.add( duration );
+    return;
+  }
+  
+  _recent.push_back( duration );
+  if( _recent.size() > 2 * _steadyWindow )
+  {
+    _warmupTime.add( _recent.front() );
+    _recent.pop_front();
+  }
+  
+  if( _recent.size() < 2 * _steadyWindow || !steadyWindows( _recent, _steadyWindow, _steadyTolerance ) )
+    return;
+  
+  _steady = true;
+  BOOST_FOREACH( long long recent, _recent )
+    _steadyTime.add( recent );
+  _recent.clear();
+  
+  if( !_stopDetail )
+    return;
+  
+  // Iterations recorded so far are aggregated like on retention change
+  _detailStopped = true;
+  if( !_aggregating )
+  {
+    _aggregating = true;
+    for( size_t i=0; i+1<_iterations.size(); i++ )
+      aggregateIteration( i );
+  }
 }
 
 burning::xml::NodePtr Phase::iterationToXml( size_t index )
@@ -182,15 +930,57 @@ burning::xml::NodePtr Phase::iterationToXml( size_t index )
     ret->childs() += subxml;
   }
   
+  const LabelSet::LabelVector& labelVector( labels( index ).labels() );
+  for( LabelSet::LabelVector::const_iterator label = labelVector.begin(); label != labelVector.end(); ++label )
+  {
+    xml::NodePtr labelNode( xml::Node::create( "label" ) );
+    labelNode->attr( "key" ) = labelText( label->first );
+    labelNode->attr( "value" ) = labelText( label->second );
+    ret->childs() += labelNode;
+  }
+  
   return ret;
 }
 
+static burning::xml::NodePtr aggregateToXml( const string& name, const Aggregate& aggregate )
+{
+  burning::xml::NodePtr node( burning::xml::Node::create( "aggregate" ) );
+  node->attr( "name" ) = name;
+  node->attr( "count" ) = aggregate.count;
+  node->attr( "sum" ) = aggregate.sum;
+  node->attr( "minimum" ) = aggregate.minimum;
+  node->attr( "maximum" ) = aggregate.maximum;
+  if( aggregate.measure != "" )
+    node->attr( "measure" ) = aggregate.measure;
+  
+  return node;
+}
+
+static bool readAggregate( burning::xml::Node& node, Aggregate& aggregate )
+{
+  if( !node.attr( "name" ).isSet() || !node.attr( "count" ).isSet() )
+  {
+    LOG( ERROR ) << "Name and count attributes for aggregate must be set.";
+    return false;
+  }
+  
+  aggregate.count = node.attr( "count" ).as< size_t >();
+  aggregate.sum = node.attr( "sum" ).as< double >();
+  aggregate.minimum = node.attr( "minimum" ).as< double >();
+  aggregate.maximum = node.attr( "maximum" ).as< double >();
+  if( node.attr( "measure" ).isSet() )
+    aggregate.measure = node.attr( "measure" ).as< string >();
+  
+  return true;
+}
+
 burning::xml::NodePtr Phase::toXml()
 {
-  if( _iterations.size() == 0 )
+  bool retained( _retention != retainAll || !_aggregates.empty() || _steadyWindow > 0 );
+  if( _iterations.size() == 0 && !retained )
     return xml::Node::create( "phase" );
   
-  if( _iterations.size() == 1 && _iterations[ 0 ] == string( "" ) )
+  if( _iterations.size() == 1 && _iterations[ 0 ] == string( "" ) && !retained )
   {
     xml::NodePtr iter( iterationToXml( 0 ) );
     iter->name() = "phase";
@@ -206,9 +996,70 @@ burning::xml::NodePtr Phase::toXml()
     ret->childs() += newNode;
   } 
   
+  if( _retention == retainSlowest )
+  {
+    ret->attr( "retention" ) = "slowest";
+    ret->attr( "slowest" ) = _slowestCount;
+  }
+  else if( _retention == retainNone )
+    ret->attr( "retention" ) = "none";
+  
+  std::pair< string, Aggregate > aggregate;
+  BOOST_FOREACH( aggregate, _aggregates )
+    ret->childs() += aggregateToXml( aggregate.first, aggregate.second );
+  
+  if( _steadyWindow > 0 )
+  {
+    xml::NodePtr node( xml::Node::create( "steady-state" ) );
+    node->attr( "window" ) = _steadyWindow;
+    node->attr( "tolerance" ) = _steadyTolerance;
+    node->attr( "state" ) = _steady ? "steady" : "warmup";
+    if( _stopDetail )
+      node->attr( "detail" ) = "stopped";
+    
+    node->childs() += aggregateToXml( "warmup", _warmupTime );
+    node->childs() += aggregateToXml( "steady", _steadyTime );
+    ret->childs() += node;
+  }
+  
   return ret;
 }
 
+void Phase::aggregateFromXml( xml::Node& node )
+{
+  Aggregate aggregate;
+  if( !readAggregate( node, aggregate ) )
+    return;
+  
+  _aggregates[ node.attr( "name" ).as< string >() ] = aggregate;
+  _aggregating = true;
+}
+
+void Phase::steadyStateFromXml( xml::Node& node )
+{
+  if( !node.attr( "window" ).isSet() )
+  {
+    LOG( ERROR ) << "Window attribute for steady state must be set.";
+    return;
+  }
+  
+  setSteadyStateDetection( node.attr( "window" ).as< size_t >(), node.attr( "tolerance" ).as< double >(),
+			   node.attr( "detail" ).isSet() && node.attr( "detail" ).as< string >() == "stopped" );
+  _steady = node.attr( "state" ).isSet() && node.attr( "state" ).as< string >() == "steady";
+  _detailStopped = _steady && _stopDetail;
+  
+  BOOST_FOREACH( xml::NodePtr aggregate, node.childs( "aggregate" ) )
+  {
+    if( !aggregate->attr( "name" ).isSet() )
+      continue;
+    
+    if( aggregate->attr( "name" ).as< string >() == "warmup" )
+      readAggregate( *aggregate, _warmupTime );
+    else if( aggregate->attr( "name" ).as< string >() == "steady" )
+      readAggregate( *aggregate, _steadyTime );
+  }
+}
+
 void Phase::setValueFromXml( const xml::NodePtr& node )
 {
   assert( node->name() == "value" );
@@ -253,6 +1104,17 @@ void Phase::iterationFromXml( xml::Node& node )
     subphaseFromXml( *child );
   BOOST_FOREACH( xml::NodePtr child, node.childs( "loop" ) )
     subphaseFromXml( *child );
+  BOOST_FOREACH( xml::NodePtr child, node.childs( "label" ) )
+  {
+    if( !child->attr( "key" ).isSet() || !child->attr( "value" ).isSet() )
+    {
+      LOG( ERROR ) << "Key and value attributes for label must be set.";
+      continue;
+    }
+    
+    _labels.resize( _iterations.size() );
+    _labels.back().set( child->attr( "key" ).as< string >(), child->attr( "value" ).as< string >() );
+  }
     
   if( _values[ "time" ].size() < _iterations.size() )
     LOG( ERROR ) << "Time value must be set for each iteration.";
@@ -272,9 +1134,18 @@ PhasePtr Phase::fromXml( xml::Node& node )
     PhasePtr ret( new Phase() );
     BOOST_FOREACH( xml::NodePtr iter, node.childs( "iteration" ) )
       ret->iterationFromXml( *iter );
+    BOOST_FOREACH( xml::NodePtr aggregate, node.childs( "aggregate" ) )
+      ret->aggregateFromXml( *aggregate );
+    BOOST_FOREACH( xml::NodePtr steadyState, node.childs( "steady-state" ) )
+      ret->steadyStateFromXml( *steadyState );
       
-    if( node.childs( "iteration" ).count() != node.childs().count() )
-      LOG( ERROR ) << "Loop xml nodes can have only iteration childs.";
+    if( node.childs( "iteration" ).count() + node.childs( "aggregate" ).count() + node.childs( "steady-state" ).count() != node.childs().count() )
+      LOG( ERROR ) << "Loop xml nodes can have only iteration, aggregate and steady state childs.";
+    
+    if( node.attr( "retention" ).isSet() && node.attr( "retention" ).as< string >() == "none" )
+      ret->setRetention( retainNone );
+    else if( node.attr( "retention" ).isSet() && node.attr( "retention" ).as< string >() == "slowest" )
+      ret->setRetention( retainSlowest, node.attr( "slowest" ).as< size_t >() );
     
     return ret;
   }
@@ -300,6 +1171,15 @@ void Phase::toTable( Table* table )
       column.pushBack( val );
   }
   
+  if( labelled() )
+  {
+    Table::ColumnProxy column( table->newColumn() );
+    column.name() = "labels";
+    
+    for( size_t i=0; i<_iterations.size(); i++ )
+      column.pushBack( labels( i ).toString() );
+  }
+  
   std::pair< string, vector< PhasePtr > > phaseVec;
   BOOST_FOREACH( phaseVec, _phases )
   {
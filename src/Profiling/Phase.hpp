@@ -17,12 +17,14 @@
 #ifndef BURNING_PROFILING_PHASE_HPP
 #define BURNING_PROFILING_PHASE_HPP
 
+#include <deque>
 #include <iostream>
 #include <map>
 #include <glog/logging.h>
 #include <boost/lexical_cast.hpp>
 #include <boost/tr1/memory.hpp>
 #include <Xml/Node.hpp>
+#include "Labels.hpp"
 #include "Value.hpp"
 #include "Profiling.hpp"
 
@@ -34,6 +36,21 @@ namespace burning
     class Phase;
     typedef std::tr1::shared_ptr< Phase > PhasePtr;
     
+    /*! Aggregate of numeric value over iterations */
+    struct Aggregate
+    {
+      Aggregate();
+      
+      /*! Adds value to aggregate */
+      void add( double value );
+      
+      size_t count;
+      double sum;
+      double minimum;
+      double maximum;
+      std::string measure;
+    };
+    
     /*! A phase of program execution */
     class Phase
     {
@@ -81,11 +98,150 @@ namespace burning
       
       /*! Adds new value to current iteration */
       void addValue( const std::string& name, const profiling::Value& value );
+      /*! Adds numeric value to sum of values with same name in current iteration.
+       *  Iterations without accumulated value get zero.
+       */
+      void accumulateValue( const std::string& name, const profiling::Value& value );
+      
+      /*! Labels current iteration with key and value, replacing previous value of key */
+      void addLabel( const std::string& key, const std::string& value );
+      /*! Labels of iteration, empty set for unlabelled one */
+      const LabelSet& labels( size_t iteration ) const;
+      /*! Checks that some iteration has labels */
+      bool labelled() const;
+      
+      /*! Appends iterations of an other phase to this one.
+       *  Each iteration is marked with a "source" value. Iterations of this phase
+       *  without it get source 0, sources of appended iterations are shifted by offset.
+       *  Returns false if phases have different values or subphases.
+       */
+      bool append( const Phase& phase, size_t offset );
+      /*! Marks iterations with a "source" value or shifts existing sources by offset */
+      void shiftSources( size_t offset );
+      /*! Count of sources phase's iterations came from */
+      size_t sources() const;
+      
+      /*! Sets iterations kept by loop. Completed iterations are aggregated and evicted accordingly.
+       *  Aggregates are kept for all iterations since retention other than retainAll was set first time,
+       *  values added after iteration's end are not aggregated.
+       *\param slowest Count of iterations kept by retainSlowest
+       */
+      void setRetention( Retention retention, size_t slowest = 0 );
+      /*! Iterations kept by loop */
+      Retention retention() const
+      {
+	return _retention;
+      }
+      /*! Count of iterations kept by retainSlowest */
+      size_t slowest() const
+      {
+	return _slowestCount;
+      }
+      
+      /*! A collection of aggregates by value names */
+      typedef std::map< std::string, Aggregate > AggregateMap;
+      /*! Aggregates of numeric values */
+      const AggregateMap& aggregates() const
+      {
+	return _aggregates;
+      }
+      /*! Sets aggregate computed elsewhere, for example over workers of a parallel loop.
+       *  Its name must differ from names of values.
+       */
+      void setAggregate( const std::string& name, const Aggregate& aggregate );
+      
+      /*! Records processors iterations run on. Each iteration gets "begin cpu", "end cpu" and "migrations" values,
+       *  "begin node" and "end node" values with NUMA nodes from sysfs. Unknown processors and nodes are -1.
+       *  Cannot be changed after first iteration.
+       */
+      void setCpuTracking( bool tracking );
+      /*! Checks that processors of iterations are recorded */
+      bool cpuTracking() const
+      {
+	return _cpuTracking;
+      }
+      /*! Notes processor current iteration runs on. Each change of processor counts as migration. */
+      void observeCpu( int cpu );
+      
+      /*! Pauses or resumes keeping of iterations, e.g. to lower overhead of profiling.
+       *  Iterations ended while detail is paused are only aggregated, kept iterations stay.
+       */
+      void pauseDetail( bool paused );
+      /*! Checks that detail is paused */
+      bool detailPaused() const
+      {
+	return _detailPaused;
+      }
+      
+      /*! Detects when durations of iterations reach steady state.
+       *  After each iteration two adjacent windows of latest iterations are compared. Loop is steady when
+       *  their mean durations differ by at most tolerance of newer mean or by two standard errors, and older
+       *  window's variance is at most four times newer one's. Iterations before the windows are warmup.
+       *  Detection starts anew from the next iteration, zero window disables it.
+       *\param stopDetail Iterations ended after steady state is reached are only aggregated
+       */
+      void setSteadyStateDetection( size_t window, double tolerance = 0.05, bool stopDetail = false );
+      /*! Size of windows compared by steady state detection, zero if detection is disabled */
+      size_t steadyStateWindow() const
+      {
+	return _steadyWindow;
+      }
+      /*! Checks that steady state was reached */
+      bool steady() const
+      {
+	return _steady;
+      }
+      /*! Durations of warmup iterations in nanoseconds */
+      const Aggregate& warmupTime() const
+      {
+	return _warmupTime;
+      }
+      /*! Durations of steady state iterations in nanoseconds */
+      const Aggregate& steadyTime() const
+      {
+	return _steadyTime;
+      }
+      
+      /*! Copies completed part of phase.
+       *  Subphases are shared with this phase except the active one, which is replaced with its snapshot.
+       *  Unfinished iteration of a loop is dropped, unfinished single phase is ended with time elapsed so far.
+       *  Only last maximalIterations completed iterations of a loop are copied, whether its iteration
+       *  is running or not, so cost is bounded by maximalIterations times count of values and subphases.
+       */
+      PhasePtr snapshot( size_t maximalIterations, const Phase* active = NULL, const PhasePtr& activeSnapshot = PhasePtr() ) const;
+      
+      /*! A list of named values */
+      typedef std::vector< std::pair< std::string, profiling::Value > > ValueList;
+      /*! Adds completed iteration measured elsewhere, for example by a worker thread.
+       *  Processors of such iterations are unknown and recorded as -1 by tracked phases.
+       *\param duration Duration of iteration in nanoseconds
+       */
+      void addIteration( const xml::Attribute::ValueType& name, long long duration, const ValueList& values,
+			 TimeMeasure measure = milliseconds );
       
       /*! Begins new iteration */
       void beginIteration( const xml::Attribute::ValueType& name );
-      /*! End current iteration */
-      void endIteration( TimeMeasure timeMeasure = milliseconds );
+      /*! End current iteration.
+       *\param retain If false, aggregation and retention of iteration wait for settleIteration,
+       *              so it can still be read as last iteration of phase
+       */
+      void endIteration( TimeMeasure timeMeasure = milliseconds, bool retain = true );
+      /*! Begins iteration whose duration is measured elsewhere and given to endMeasuredIteration.
+       *  Processors of such iterations are unknown and recorded as -1 by tracked phases.
+       */
+      void beginMeasuredIteration( const xml::Attribute::ValueType& name );
+      /*! Ends current iteration with duration measured elsewhere, for example replayed from journal.
+       *\param duration Duration of iteration in nanoseconds
+       */
+      void endMeasuredIteration( long long duration, TimeMeasure measure = milliseconds, bool retain = true );
+      /*! Aggregates and retains iteration ended without retention */
+      void settleIteration();
+      
+      /*! Duration of last ended iteration in nanoseconds */
+      long long lastDuration() const
+      {
+	return _lastDuration;
+      }
       
       /*! Checks that there is not iterations currently in progress */
       bool finished()
@@ -105,6 +261,9 @@ namespace burning
       void toTable( Table* table );
       
     private:
+      /*! Copies iterations from first to last, settings are copied as is */
+      Phase( const Phase& phase, size_t first, size_t last );
+      
       xml::NodePtr iterationToXml( size_t index );
       
       void setValueFromXml( const xml::NodePtr& value );
@@ -113,12 +272,54 @@ namespace burning
       
       void iterationsToTable( Table* table );
       
+      void aggregateIteration( size_t index );
+      void retainIteration( long long duration );
+      void removeIteration( size_t index );
+      void aggregateFromXml( xml::Node& node );
+      
+      void addCpuValues();
+      void observeDuration( long long duration );
+      void steadyStateFromXml( xml::Node& node );
+      void finishIteration( long time, TimeMeasure measure, bool retain );
+      
+      bool haveSameStructure( const Phase& phase ) const;
+      std::vector< Value > sourceValues( size_t offset ) const;
+      
       ValueMap _values;
       PhaseMap _phases;
       IterationVector _iterations;
+      /*! Labels of iterations, iterations past its end have none */
+      std::vector< LabelSet > _labels;
       
       timespec _beginTime;
+      long long _lastDuration;
       bool _began;
+      
+      Retention _retention;
+      size_t _slowestCount;
+      /*! Min-heap of durations and indexes of iterations kept by retainSlowest */
+      std::vector< std::pair< long long, size_t > > _slowest;
+      bool _aggregating;
+      AggregateMap _aggregates;
+      
+      /*! Measures of accumulated values by their names */
+      std::map< std::string, std::string > _accumulated;
+      
+      bool _cpuTracking;
+      int _beginCpu;
+      int _lastCpu;
+      size_t _migrations;
+      
+      size_t _steadyWindow;
+      double _steadyTolerance;
+      bool _stopDetail;
+      bool _steady;
+      bool _detailStopped;
+      bool _detailPaused;
+      /*! Durations of iterations in compared windows, older first */
+      std::deque< long long > _recent;
+      Aggregate _warmupTime;
+      Aggregate _steadyTime;
     };
   }
 }
@@ -0,0 +1,331 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <limits>
+#include <glog/logging.h>
+#include "Table.hpp"
+#include "Pipeline.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Counters of stage updated atomically */
+    struct StageRecord
+    {
+      StageRecord( size_t workers ) : workers( workers ),
+                                      items( 0 ),
+                                      serviceTime( 0 ),
+                                      maximalService( 0 ),
+                                      queueTime( 0 ),
+                                      maximalQueueTime( 0 ),
+                                      queueLength( 0 ),
+                                      maximalQueueLength( 0 ),
+                                      firstDequeue( std::numeric_limits< long long >::max() ),
+                                      lastFinish( 0 )
+      {
+      }
+
+      size_t workers;
+
+      volatile long long items;
+      volatile long long serviceTime;
+      volatile long long maximalService;
+      volatile long long queueTime;
+      volatile long long maximalQueueTime;
+      volatile long long queueLength;
+      volatile long long maximalQueueLength;
+      volatile long long firstDequeue;
+      volatile long long lastFinish;
+    };
+  }
+}
+
+StageStatistics::StageStatistics() : name(),
+                                     workers( 1 ),
+                                     items( 0 ),
+                                     serviceTime( 0 ),
+                                     maximalService( 0 ),
+                                     queueTime( 0 ),
+                                     maximalQueueTime( 0 ),
+                                     maximalQueueLength( 0 ),
+                                     elapsed( 0 )
+{
+}
+
+double StageStatistics::throughput() const
+{
+  if( elapsed <= 0 )
+    return 0.0;
+
+  return double( items ) * nanoseconds / elapsed;
+}
+
+double StageStatistics::utilization() const
+{
+  if( elapsed <= 0 || workers == 0 )
+    return 0.0;
+
+  return double( serviceTime ) / ( double( elapsed ) * workers );
+}
+
+static void updateMaximum( volatile long long& maximum, long long value )
+{
+  long long current( maximum );
+  while( value > current )
+  {
+    long long previous( __sync_val_compare_and_swap( &maximum, current, value ) );
+    if( previous == current )
+      break;
+    current = previous;
+  }
+}
+
+static void updateMinimum( volatile long long& minimum, long long value )
+{
+  long long current( minimum );
+  while( value < current )
+  {
+    long long previous( __sync_val_compare_and_swap( &minimum, current, value ) );
+    if( previous == current )
+      break;
+    current = previous;
+  }
+}
+
+Pipeline::Stamp::Stamp() : stage( 0 ),
+                           enqueued( 0 ),
+                           dequeued( 0 )
+{
+}
+
+Pipeline::Pipeline( const string& name ) : _name( name ),
+                                           _stageNames(),
+                                           _stages()
+{
+}
+
+Pipeline::~Pipeline()
+{
+  for( size_t i=0; i<_stages.size(); i++ )
+    delete _stages[ i ];
+}
+
+const string& Pipeline::name() const
+{
+  return _name;
+}
+
+size_t Pipeline::addStage( const string& name, size_t workers )
+{
+  _stageNames.push_back( name );
+  _stages.push_back( new StageRecord( workers ) );
+
+  return _stages.size() - 1;
+}
+
+size_t Pipeline::stages() const
+{
+  return _stages.size();
+}
+
+StageRecord& Pipeline::stage( size_t index ) const
+{
+  if( index >= _stages.size() )
+  {
+    LOG( ERROR ) << "Pipeline " << _name << " has no stage " << index << '.';
+    exit( EXIT_FAILURE );
+  }
+
+  return *_stages[ index ];
+}
+
+void Pipeline::enqueue( Stamp& stamp, size_t index )
+{
+  StageRecord& record( stage( index ) );
+
+  stamp.stage = index;
+  stamp.enqueued = clockNanoseconds( CLOCK_MONOTONIC );
+  stamp.dequeued = 0;
+
+  updateMaximum( record.maximalQueueLength, __sync_add_and_fetch( &record.queueLength, 1 ) );
+}
+
+void Pipeline::dequeue( Stamp& stamp )
+{
+  StageRecord& record( stage( stamp.stage ) );
+  stamp.dequeued = clockNanoseconds( CLOCK_MONOTONIC );
+
+  if( stamp.enqueued == 0 )
+  {
+    LOG( ERROR ) << "Item dequeued from stage " << _stageNames[ stamp.stage ] << " without enqueue.";
+    exit( EXIT_FAILURE );
+  }
+
+  long long delay( stamp.dequeued - stamp.enqueued );
+  __sync_fetch_and_sub( &record.queueLength, 1 );
+  __sync_fetch_and_add( &record.queueTime, delay );
+  updateMaximum( record.maximalQueueTime, delay );
+  updateMinimum( record.firstDequeue, stamp.dequeued );
+}
+
+void Pipeline::finish( Stamp& stamp )
+{
+  StageRecord& record( stage( stamp.stage ) );
+  long long finished( clockNanoseconds( CLOCK_MONOTONIC ) );
+
+  if( stamp.dequeued == 0 )
+  {
+    LOG( ERROR ) << "Item finished in stage " << _stageNames[ stamp.stage ] << " without dequeue.";
+    exit( EXIT_FAILURE );
+  }
+
+  long long service( finished - stamp.dequeued );
+  __sync_fetch_and_add( &record.items, 1 );
+  __sync_fetch_and_add( &record.serviceTime, service );
+  updateMaximum( record.maximalService, service );
+  updateMaximum( record.lastFinish, finished );
+}
+
+void Pipeline::pass( Stamp& stamp, size_t stage )
+{
+  finish( stamp );
+  enqueue( stamp, stage );
+}
+
+vector< StageStatistics > Pipeline::statistics() const
+{
+  // Stages share window of whole pipeline, so their utilizations are comparable
+  long long firstDequeue( std::numeric_limits< long long >::max() );
+  long long lastFinish( 0 );
+  for( size_t i=0; i<_stages.size(); i++ )
+    if( _stages[ i ]->items > 0 )
+    {
+      long long dequeued( _stages[ i ]->firstDequeue );
+      long long finished( _stages[ i ]->lastFinish );
+      firstDequeue = std::min( firstDequeue, dequeued );
+      lastFinish = std::max( lastFinish, finished );
+    }
+
+  vector< StageStatistics > ret;
+  for( size_t i=0; i<_stages.size(); i++ )
+  {
+    const StageRecord& record( *_stages[ i ] );
+
+    StageStatistics statistics;
+    statistics.name = _stageNames[ i ];
+    statistics.workers = record.workers;
+    statistics.items = record.items;
+    statistics.serviceTime = record.serviceTime;
+    statistics.maximalService = record.maximalService;
+    statistics.queueTime = record.queueTime;
+    statistics.maximalQueueTime = record.maximalQueueTime;
+    statistics.maximalQueueLength = record.maximalQueueLength;
+    if( lastFinish > 0 )
+      statistics.elapsed = lastFinish - firstDequeue;
+
+    ret.push_back( statistics );
+  }
+
+  return ret;
+}
+
+size_t Pipeline::bottleneck() const
+{
+  vector< StageStatistics > stages( statistics() );
+
+  size_t ret( 0 );
+  for( size_t i=1; i<stages.size(); i++ )
+  {
+    double utilization( stages[ i ].utilization() );
+    double bestUtilization( stages[ ret ].utilization() );
+    if( utilization > bestUtilization || ( utilization == bestUtilization && stages[ i ].queueTime > stages[ ret ].queueTime ) )
+      ret = i;
+  }
+
+  return ret;
+}
+
+static double mean( long long sum, long long count )
+{
+  return count > 0 ? double( sum ) / count : 0.0;
+}
+
+void Pipeline::record( Profile& profile ) const
+{
+  vector< StageStatistics > stages( statistics() );
+  size_t slowest( bottleneck() );
+
+  profile.beginLoop( _name );
+  for( size_t i=0; i<stages.size(); i++ )
+  {
+    const StageStatistics& stage( stages[ i ] );
+
+    Phase::ValueList values;
+    values.push_back( std::make_pair( string( "workers" ), Value( stage.workers ) ) );
+    values.push_back( std::make_pair( string( "items" ), Value( static_cast< double >( stage.items ) ) ) );
+    values.push_back( std::make_pair( string( "throughput" ), Value( stage.throughput(), "items/s" ) ) );
+    values.push_back( std::make_pair( string( "utilization" ), Value( stage.utilization() ) ) );
+    values.push_back( std::make_pair( string( "mean service" ), Value( mean( stage.serviceTime, stage.items ), "ns" ) ) );
+    values.push_back( std::make_pair( string( "maximal service" ), Value( static_cast< double >( stage.maximalService ), "ns" ) ) );
+    values.push_back( std::make_pair( string( "mean queueing" ), Value( mean( stage.queueTime, stage.items ), "ns" ) ) );
+    values.push_back( std::make_pair( string( "maximal queueing" ), Value( static_cast< double >( stage.maximalQueueTime ), "ns" ) ) );
+    values.push_back( std::make_pair( string( "maximal queue length" ), Value( static_cast< double >( stage.maximalQueueLength ) ) ) );
+    values.push_back( std::make_pair( string( "bottleneck" ), Value( string( i == slowest ? "yes" : "no" ) ) ) );
+    profile.addIteration( stage.name, stage.serviceTime, values, microseconds );
+  }
+  profile.endLoop();
+}
+
+void Pipeline::print( std::ostream& ostream ) const
+{
+  vector< StageStatistics > stages( statistics() );
+
+  Table table;
+  table.column( 0 ).name() = "stage";
+  table.column( 1 ).name() = "workers";
+  table.column( 2 ).name() = "items";
+  table.column( 3 ).name() = "throughput";
+  table.column( 4 ).name() = "utilization";
+  table.column( 5 ).name() = "mean service";
+  table.column( 6 ).name() = "mean queueing";
+  table.column( 7 ).name() = "maximal queue length";
+
+  for( size_t i=0; i<stages.size(); i++ )
+  {
+    const StageStatistics& stage( stages[ i ] );
+
+    Table::RowProxy row( table.newRow() );
+    row.pushBack( stage.name );
+    row.pushBack( stage.workers );
+    row.pushBack( static_cast< double >( stage.items ) );
+    row.pushBack( Value( stage.throughput(), "items/s" ) );
+    row.pushBack( stage.utilization() );
+    row.pushBack( Value( mean( stage.serviceTime, stage.items ), "ns" ) );
+    row.pushBack( Value( mean( stage.queueTime, stage.items ), "ns" ) );
+    row.pushBack( static_cast< double >( stage.maximalQueueLength ) );
+  }
+
+  table.print( ostream );
+  if( !stages.empty() )
+    ostream << "Bottleneck: " << stages[ bottleneck() ].name << std::endl;
+}
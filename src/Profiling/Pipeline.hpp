@@ -0,0 +1,118 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_PIPELINE_HPP
+#define BURNING_PROFILING_PIPELINE_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Profile.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    struct StageRecord;
+
+    /*! Statistics of pipeline's stage. Times are in nanoseconds. */
+    struct StageStatistics
+    {
+      StageStatistics();
+
+      std::string name;
+      size_t workers;
+
+      /*! Count of served items */
+      long long items;
+      long long serviceTime;
+      long long maximalService;
+      /*! Time items spent in stage's queue */
+      long long queueTime;
+      long long maximalQueueTime;
+      /*! Largest count of items waiting in queue */
+      long long maximalQueueLength;
+      /*! Time from first dequeue in any stage to last item served by pipeline */
+      long long elapsed;
+
+      /*! Served items per second */
+      double throughput() const;
+      /*! Share of workers' time spent serving items */
+      double utilization() const;
+    };
+
+    /*! Measures stages of producer/consumer pipeline.
+     *  Work items carry stamps with time they were enqueued and dequeued by a stage.
+     *  Stamps may be passed between threads, statistics are updated atomically.
+     *  Stages must be added before items are stamped.
+     */
+    class Pipeline
+    {
+    public:
+      /*! Times of work item in its current stage */
+      struct Stamp
+      {
+	Stamp();
+
+	size_t stage;
+	long long enqueued;
+	long long dequeued;
+      };
+
+      explicit Pipeline( const std::string& name );
+      ~Pipeline();
+
+      /*! Name of pipeline's loop phase */
+      const std::string& name() const;
+
+      /*! Adds stage served by given count of threads. Returns index of stage. */
+      size_t addStage( const std::string& name, size_t workers = 1 );
+      /*! Count of stages */
+      size_t stages() const;
+
+      /*! Puts item into queue of stage */
+      void enqueue( Stamp& stamp, size_t stage );
+      /*! Takes item from queue of its stage and begins serving it */
+      void dequeue( Stamp& stamp );
+      /*! Ends serving item in its stage */
+      void finish( Stamp& stamp );
+      /*! Ends serving item and puts it into queue of next stage */
+      void pass( Stamp& stamp, size_t stage );
+
+      /*! Statistics of stages in order they were added */
+      std::vector< StageStatistics > statistics() const;
+      /*! Index of stage with highest utilization. Stages with longer queueing break ties. */
+      size_t bottleneck() const;
+
+      /*! Records stages as iterations of pipeline's loop in profile. Time of iteration is total service time of stage. */
+      void record( Profile& profile ) const;
+      /*! Prints statistics of stages and the bottleneck */
+      void print( std::ostream& ostream = std::cout ) const;
+
+    private:
+      Pipeline( const Pipeline& );
+      void operator=( const Pipeline& );
+
+      StageRecord& stage( size_t index ) const;
+
+      std::string _name;
+      std::vector< std::string > _stageNames;
+      std::vector< StageRecord* > _stages;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,409 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <zlib.h>
+#include <cmath>
+#include <map>
+#include <vector>
+#include <glog/logging.h>
+#include "Pprof.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+namespace
+{
+  /*! Protocol buffers message encoded into memory */
+  class Message
+  {
+  public:
+    void varint( uint32_t field, uint64_t value )
+    {
+      key( field, 0 );
+      raw( value );
+    }
+    
+    void bytes( uint32_t field, const string& value )
+    {
+      key( field, 2 );
+      raw( value.size() );
+      _data += value;
+    }
+    
+    void message( uint32_t field, const Message& value )
+    {
+      bytes( field, value._data );
+    }
+    
+    void packed( uint32_t field, const vector< uint64_t >& values )
+    {
+      Message data;
+      for( size_t i=0; i<values.size(); i++ )
+	data.raw( values[ i ] );
+      bytes( field, data._data );
+    }
+    
+    const string& data() const
+    {
+      return _data;
+    }
+    
+  private:
+    void key( uint32_t field, uint32_t type )
+    {
+      raw( ( field << 3 ) | type );
+    }
+
+    void raw( uint64_t value )
+    {
+      while( value >= 0x80 )
+      {
+	_data += char( ( value & 0x7f ) | 0x80 );
+	value >>= 7;
+      }
+      _data += char( value );
+    }
+    
+    string _data;
+  };
+  
+  /*! Compresses written data with gzip into stream */
+  class GzipWriter
+  {
+  public:
+    GzipWriter( std::ostream& ostream ) : _ostream( ostream ), _failed( false )
+    {
+      _stream.zalloc = Z_NULL;
+      _stream.zfree = Z_NULL;
+      _stream.opaque = Z_NULL;
+      // Window bits above 15 select gzip header
+      _failed = deflateInit2( &_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY ) != Z_OK;
+    }
+    
+    ~GzipWriter()
+    {
+      if( !_failed )
+	deflateEnd( &_stream );
+    }
+    
+    void write( const string& data )
+    {
+      _stream.next_in = reinterpret_cast< Bytef* >( const_cast< char* >( data.data() ) );
+      _stream.avail_in = data.size();
+      deflateAll( Z_NO_FLUSH );
+    }
+    
+    /*! Ends compressed stream, returns false if compression failed */
+    bool finish()
+    {
+      _stream.next_in = Z_NULL;
+      _stream.avail_in = 0;
+      deflateAll( Z_FINISH );
+      
+      return !_failed && _ostream;
+    }
+    
+  private:
+    void deflateAll( int flush )
+    {
+      if( _failed )
+	return;
+      
+      int result;
+      do
+      {
+	_stream.next_out = _buffer;
+	_stream.avail_out = sizeof( _buffer );
+	result = deflate( &_stream, flush );
+	if( result == Z_STREAM_ERROR )
+	{
+	  _failed = true;
+	  return;
+	}
+	_ostream.write( reinterpret_cast< char* >( _buffer ), sizeof( _buffer ) - _stream.avail_out );
+      }
+      while( _stream.avail_out == 0 || ( flush == Z_FINISH && result != Z_STREAM_END ) );
+    }
+    
+    std::ostream& _ostream;
+    z_stream _stream;
+    Bytef _buffer[ 16384 ];
+    bool _failed;
+  };
+  
+  // Fields of messages of profile.proto
+  enum ProfileField
+  {
+    sampleTypeField = 1,
+    sampleField = 2,
+    locationField = 4,
+    functionField = 5,
+    stringTableField = 6,
+    durationField = 10,
+    defaultSampleTypeField = 14
+  };
+  
+  /*! Encodes phases of profile as samples */
+  class Encoder
+  {
+  public:
+    Encoder( GzipWriter& output ) : _output( output ),
+                                    _strings(),
+                                    _locations(),
+                                    _values()
+    {
+      stringIndex( "" );
+    }
+    
+    /*! Collects names and units of numeric values of phases */
+    void collectValues( const Phase& phase );
+    /*! Writes types of sample values */
+    void writeSampleTypes();
+    /*! Writes samples of iterations of phase and its subphases */
+    void writeSamples( const Phase& phase, const string& path, vector< uint64_t >& stack );
+    
+    void writeDuration( long long duration );
+    
+  private:
+    uint64_t stringIndex( const string& text );
+    uint64_t location( const string& path, const string& name );
+    void writeSample( const Phase& phase, size_t iteration, const vector< uint64_t >& stack );
+    void label( Message& sample, const string& key, const xml::Attribute& value );
+    
+    GzipWriter& _output;
+    std::map< string, uint64_t > _strings;
+    std::map< string, uint64_t > _locations;
+    /*! Numeric values with their units */
+    std::map< string, string > _values;
+  };
+}
+
+static bool isDecimal( const Value& value )
+{
+  return boost::get< Decimal >( &value.rawValue() ) != NULL;
+}
+
+// Time of phase's iteration in nanoseconds
+static double iterationTime( const Phase& phase, size_t iteration )
+{
+  Phase::ValueMap::const_iterator time( phase.values().find( "time" ) );
+  if( time == phase.values().end() || time->second.size() <= iteration || !isDecimal( time->second[ iteration ] ) )
+    return 0.0;
+  
+  double scale( timeMeasureScale( time->second[ iteration ].measure() ) );
+  if( scale == 0.0 )
+    return 0.0;
+  return time->second[ iteration ].value().as< double >() * nanoseconds / scale;
+}
+
+static double phaseTime( const Phase& phase )
+{
+  double ret( 0.0 );
+  for( size_t i=0; i<phase.iterations().size(); i++ )
+    ret += iterationTime( phase, i );
+  return ret;
+}
+
+uint64_t Encoder::stringIndex( const string& text )
+{
+  std::map< string, uint64_t >::const_iterator found( _strings.find( text ) );
+  if( found != _strings.end() )
+    return found->second;
+  
+  uint64_t ret( _strings.size() );
+  _strings[ text ] = ret;
+  
+  Message message;
+  message.bytes( stringTableField, text );
+  _output.write( message.data() );
+  
+  return ret;
+}
+
+uint64_t Encoder::location( const string& path, const string& name )
+{
+  std::map< string, uint64_t >::const_iterator found( _locations.find( path ) );
+  if( found != _locations.end() )
+    return found->second;
+  
+  uint64_t ret( _locations.size() + 1 );
+  _locations[ path ] = ret;
+  
+  Message function;
+  function.varint( 1, ret );
+  function.varint( 2, stringIndex( name ) );
+  function.varint( 3, stringIndex( path ) );
+  
+  Message line;
+  line.varint( 1, ret );
+  Message location;
+  location.varint( 1, ret );
+  location.message( 4, line );
+  
+  Message message;
+  message.message( functionField, function );
+  message.message( locationField, location );
+  _output.write( message.data() );
+  
+  return ret;
+}
+
+void Encoder::collectValues( const Phase& phase )
+{
+  for( Phase::ValueMap::const_iterator value = phase.values().begin(); value != phase.values().end(); ++value )
+    if( value->first != "time" && _values.count( value->first ) == 0 )
+      for( size_t i=0; i<value->second.size(); i++ )
+	if( isDecimal( value->second[ i ] ) )
+	{
+	  _values[ value->first ] = value->second[ i ].measure().empty() ? "count" : value->second[ i ].measure();
+	  break;
+	}
+  
+  for( Phase::PhaseMap::const_iterator phases = phase.phases().begin(); phases != phase.phases().end(); ++phases )
+    for( size_t i=0; i<phases->second.size(); i++ )
+      collectValues( *phases->second[ i ] );
+}
+
+void Encoder::writeSampleTypes()
+{
+  Message message;
+  
+  Message time;
+  time.varint( 1, stringIndex( "time" ) );
+  time.varint( 2, stringIndex( "nanoseconds" ) );
+  message.message( sampleTypeField, time );
+  
+  for( std::map< string, string >::const_iterator value = _values.begin(); value != _values.end(); ++value )
+  {
+    Message type;
+    type.varint( 1, stringIndex( value->first ) );
+    type.varint( 2, stringIndex( value->second ) );
+    message.message( sampleTypeField, type );
+  }
+  message.varint( defaultSampleTypeField, stringIndex( "time" ) );
+  
+  _output.write( message.data() );
+}
+
+void Encoder::label( Message& sample, const string& key, const xml::Attribute& value )
+{
+  Message label;
+  label.varint( 1, stringIndex( key ) );
+  if( boost::get< Decimal >( &xml::Attribute( value ).value() ) != NULL )
+    label.varint( 3, static_cast< int64_t >( value.as< double >() ) );
+  else
+    label.varint( 2, stringIndex( value.as< string >() ) );
+  
+  sample.message( 3, label );
+}
+
+void Encoder::writeSample( const Phase& phase, size_t iteration, const vector< uint64_t >& stack )
+{
+  double time( iterationTime( phase, iteration ) );
+  for( Phase::PhaseMap::const_iterator phases = phase.phases().begin(); phases != phase.phases().end(); ++phases )
+    if( iteration < phases->second.size() )
+      time -= phaseTime( *phases->second[ iteration ] );
+  
+  vector< uint64_t > values( 1, static_cast< int64_t >( std::max( time, 0.0 ) + 0.5 ) );
+  for( std::map< string, string >::const_iterator name = _values.begin(); name != _values.end(); ++name )
+  {
+    Phase::ValueMap::const_iterator value( phase.values().find( name->first ) );
+    double number( 0.0 );
+    if( value != phase.values().end() && iteration < value->second.size() && isDecimal( value->second[ iteration ] ) )
+      number = value->second[ iteration ].value().as< double >();
+    values.push_back( static_cast< int64_t >( floor( number + 0.5 ) ) );
+  }
+  
+  // Stack of sample starts from its leaf
+  Message sample;
+  sample.packed( 1, vector< uint64_t >( stack.rbegin(), stack.rend() ) );
+  sample.packed( 2, values );
+  
+  xml::Attribute name( phase.iterations()[ iteration ] );
+  if( phase.iterations().size() > 1 || !( name == string( "" ) ) )
+    label( sample, "iteration", name );
+  
+  const LabelSet::LabelVector& labels( phase.labels( iteration ).labels() );
+  for( LabelSet::LabelVector::const_iterator pair = labels.begin(); pair != labels.end(); ++pair )
+    label( sample, labelText( pair->first ), xml::Attribute( labelText( pair->second ) ) );
+  
+  Message message;
+  message.message( sampleField, sample );
+  _output.write( message.data() );
+}
+
+void Encoder::writeSamples( const Phase& phase, const string& path, vector< uint64_t >& stack )
+{
+  for( size_t i=0; i<phase.iterations().size(); i++ )
+  {
+    if( !stack.empty() )
+      writeSample( phase, i, stack );
+    
+    for( Phase::PhaseMap::const_iterator phases = phase.phases().begin(); phases != phase.phases().end(); ++phases )
+    {
+      if( i >= phases->second.size() )
+	continue;
+      
+      string subpath( path.empty() ? phases->first : path + '/' + phases->first );
+      stack.push_back( location( subpath, phases->first ) );
+      writeSamples( *phases->second[ i ], subpath, stack );
+      stack.pop_back();
+    }
+  }
+}
+
+void Encoder::writeDuration( long long duration )
+{
+  Message message;
+  message.varint( durationField, duration );
+  _output.write( message.data() );
+}
+
+/*
+ * Pprof
+ */
+
+Pprof::Pprof( Profile& profile ) : _profile( profile )
+{
+}
+
+bool Pprof::write( std::ostream& ostream )
+{
+  GzipWriter output( ostream );
+  Encoder encoder( output );
+  
+  const Phase& root( _profile.rootPhase() );
+  encoder.collectValues( root );
+  encoder.writeSampleTypes();
+  
+  vector< uint64_t > stack;
+  encoder.writeSamples( root, "", stack );
+  
+  double duration( 0.0 );
+  for( Phase::PhaseMap::const_iterator phases = root.phases().begin(); phases != root.phases().end(); ++phases )
+    for( size_t i=0; i<phases->second.size(); i++ )
+      duration += phaseTime( *phases->second[ i ] );
+  encoder.writeDuration( static_cast< long long >( duration ) );
+  
+  if( output.finish() )
+    return true;
+  
+  LOG( ERROR ) << "Cannot compress pprof profile.";
+  return false;
+}
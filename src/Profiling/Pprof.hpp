@@ -0,0 +1,48 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_PPROF_HPP
+#define BURNING_PROFILING_PPROF_HPP
+
+#include <iostream>
+#include "Profile.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Writes profile in pprof's profile.proto format compressed with gzip.
+     *  Every phase path is a synthetic function with its own location, every retained iteration is a sample
+     *  whose stack is the iteration's path. Sample values are self time in nanoseconds, time of iteration
+     *  without its subphases, so pprof sums them to totals of phases, and all numeric values of phases.
+     *  Iteration names and labels of iterations are labels of samples.
+     *  Profile is encoded while its phases are walked, only strings and paths are kept in memory.
+     */
+    class Pprof
+    {
+    public:
+      Pprof( Profile& profile );
+      
+      /*! Writes encoded profile, returns false if it cannot be compressed */
+      bool write( std::ostream& ostream );
+      
+    private:
+      Profile& _profile;
+    };
+  }
+}
+
+#endif
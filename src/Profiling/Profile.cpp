@@ -14,7 +14,16 @@
    this library. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <sched.h>
 #include <time.h>
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <boost/foreach.hpp>
+#include "Locks.hpp"
+#include "OverheadGovernor.hpp"
+#include "Pprof.hpp"
+#include "Scaling.hpp"
 #include "Table.hpp"
 #include "Profile.hpp"
 
@@ -23,27 +32,144 @@ using std::vector;
 using namespace burning;
 using namespace burning::profiling;
 
-Profile::Profile() : _rootPhase( new Phase() ), _current()
+Profile::Profile() : _rootPhase( new Phase() ),
+                     _current(),
+                     _currentPaths( 1, 0 ),
+                     _pathNames( 1, "" ),
+                     _childPaths( 1 ),
+                     _listeners(),
+                     _governor( NULL ),
+                     _pausedLoops( 1, false ),
+                     _skippedDepth( 0 ),
+                     _skippedIteration( false ),
+                     _cpuTracking( false ),
+                     _flows( new FlowLog() )
 {
-  _current.push( _rootPhase.get() );
+  _current.push_back( _rootPhase.get() );
   
   _rootPhase->beginIteration( "" );
 }
 
+static __thread Profile* attachedProfile = NULL;
+
+/*! Reports recording call to overhead governor */
+class GovernedCall
+{
+public:
+  GovernedCall( OverheadGovernor* governor ) : _governor( governor ),
+                                               _begin( governor != NULL ? governor->callBegan() : 0 )
+  {
+  }
+  
+  ~GovernedCall()
+  {
+    if( _governor != NULL )
+      _governor->callEnded( _begin );
+  }
+  
+private:
+  OverheadGovernor* _governor;
+  long long _begin;
+};
+
+Profile::~Profile()
+{
+  if( attachedProfile == this )
+    attachedProfile = NULL;
+}
+
+void Profile::attach()
+{
+  attachedProfile = this;
+}
+
+void Profile::detach()
+{
+  attachedProfile = NULL;
+}
+
+Profile* Profile::attached()
+{
+  return attachedProfile;
+}
+
+void Profile::accumulateValue( const string& name, const Value& value )
+{
+  GovernedCall call( _governor );
+  if( _skippedDepth > 0 )
+    return;
+  
+  for( size_t i = _current.size(); i > 0; i-- )
+    if( !_current[ i - 1 ]->finished() )
+    {
+      _current[ i - 1 ]->accumulateValue( name, value );
+      return;
+    }
+}
+
+Task Profile::beginTask( const string& flow )
+{
+  TaskRecord record;
+  record.flow = flow;
+  record.spawner = pathName( currentPath() );
+  if( !_current.back()->iterations().empty() )
+    record.iteration = _current.back()->iterations().back();
+  record.begun = _flows->now();
+  record.spawnThread = currentThread();
+  
+  return Task( _flows, record );
+}
+
+vector< TaskRecord > Profile::tasks() const
+{
+  return _flows->tasks();
+}
+
+std::map< string, size_t > Profile::droppedTasks() const
+{
+  return _flows->dropped();
+}
+
+void Profile::setMaximalTasks( size_t count )
+{
+  _flows->setMaximalTasks( count );
+}
+
+long long Profile::elapsed() const
+{
+  return _flows->now();
+}
+
 void Profile::addValue( const std::string& name, const Value& value )
 {
-  _current.top()->addValue( name, value );
+  GovernedCall call( _governor );
+  if( _skippedDepth > 0 )
+    return;
+  
+  _current.back()->addValue( name, value );
+  
+  BOOST_FOREACH( Listener* listener, _listeners )
+    listener->valueAdded( *this, _currentPaths.back(), name, value );
+}
+
+void Profile::addLabel( const string& key, const string& value )
+{
+  GovernedCall call( _governor );
+  if( _skippedDepth > 0 )
+    return;
+  
+  _current.back()->addLabel( key, value );
 }
 
 void Profile::beginPhase( const std::string& name )
 {
   beginLoop( name );
-  _current.top()->beginIteration( "" );
+  beginIteration( "" );
 }
 
 void Profile::endPhase( TimeMeasure measure )
 {
-  _current.top()->endIteration( measure );
+  endIteration( measure );
   endLoop();
 }
 
@@ -55,36 +181,308 @@ Profile& Profile::global()
 
 void Profile::beginIteration( const xml::Attribute::ValueType& name )
 {
-  _current.top()->beginIteration( xml::Attribute::ValueType( name ) );
+  GovernedCall call( _governor );
+  if( _skippedDepth > 0 )
+    return;
+  
+  // Single phases follow their enclosing iteration and first iteration of loop is always kept,
+  // so governed loops never end up empty
+  Phase& phase( *_current.back() );
+  bool governed( _governor != NULL && !( name == xml::Attribute::ValueType( string( "" ) ) ) &&
+                 ( !phase.iterations().empty() || phase.detailPaused() ) );
+  IterationDetail detail( governed ? _governor->iterationDetail( _currentPaths.back() ) : recordIteration );
+  if( detail == skipIteration )
+  {
+    _skippedDepth = 1;
+    _skippedIteration = true;
+    return;
+  }
+  
+  bool paused( detail == aggregateIteration );
+  if( paused != _pausedLoops.back() )
+  {
+    _current.back()->pauseDetail( paused );
+    _pausedLoops.back() = paused;
+  }
+  
+  _current.back()->beginIteration( xml::Attribute::ValueType( name ) );
+  // Sampling is marked by a value, so it does not mix with user labels nor split live series
+  if( detail == sampleIteration )
+    _current.back()->accumulateValue( "sampled", Value( 1 ) );
+  observeCpu();
+  
+  BOOST_FOREACH( Listener* listener, _listeners )
+    listener->iterationBegan( *this, _currentPaths.back() );
 }
     
+bool Profile::skipIterationEnd()
+{
+  if( _skippedDepth == 0 )
+    return false;
+  
+  if( _skippedDepth == 1 && _skippedIteration )
+    _skippedDepth = 0;
+  return true;
+}
+
 void Profile::endIteration( TimeMeasure measure )
 {
-  _current.top()->endIteration( measure );
+  GovernedCall call( _governor );
+  if( skipIterationEnd() )
+    return;
+  
+  // Listeners read ended iteration as last one of phase, before retention may remove or move it
+  observeCpu();
+  Phase& phase( *_current.back() );
+  phase.endIteration( measure, false );
+  
+  BOOST_FOREACH( Listener* listener, _listeners )
+    listener->iterationEnded( *this, _currentPaths.back(), phase.lastDuration() );
+  phase.settleIteration();
+}
+
+void Profile::endMeasuredIteration( long long duration, TimeMeasure measure )
+{
+  GovernedCall call( _governor );
+  if( skipIterationEnd() )
+    return;
+  
+  Phase& phase( *_current.back() );
+  phase.endMeasuredIteration( duration, measure, false );
+  
+  BOOST_FOREACH( Listener* listener, _listeners )
+    listener->iterationEnded( *this, _currentPaths.back(), duration );
+  phase.settleIteration();
+}
+
+void Profile::addIteration( const xml::Attribute::ValueType& name, long long duration, const Phase::ValueList& values,
+			    TimeMeasure measure )
+{
+  if( _skippedDepth > 0 )
+    return;
+  
+  Phase& phase( *_current.back() );
+  phase.beginMeasuredIteration( name );
+  BOOST_FOREACH( Listener* listener, _listeners )
+    listener->iterationBegan( *this, _currentPaths.back() );
+  
+  for( Phase::ValueList::const_iterator value = values.begin(); value != values.end(); ++value )
+  {
+    phase.addValue( value->first, value->second );
+    BOOST_FOREACH( Listener* listener, _listeners )
+      listener->valueAdded( *this, _currentPaths.back(), value->first, value->second );
+  }
+  
+  phase.endMeasuredIteration( duration, measure, false );
+  BOOST_FOREACH( Listener* listener, _listeners )
+    listener->iterationEnded( *this, _currentPaths.back(), duration );
+  phase.settleIteration();
+}
+
+void Profile::setRetention( Retention retention, size_t slowest )
+{
+  _current.back()->setRetention( retention, slowest );
+}
+
+void Profile::setAggregate( const string& name, const Aggregate& aggregate )
+{
+  if( _skippedDepth > 0 )
+    return;
+  
+  _current.back()->setAggregate( name, aggregate );
+}
+
+void Profile::setSteadyStateDetection( size_t window, double tolerance, bool stopDetail )
+{
+  _current.back()->setSteadyStateDetection( window, tolerance, stopDetail );
+}
+
+void Profile::setCpuTracking( bool tracking )
+{
+  _cpuTracking = tracking;
+}
+
+void Profile::observeCpu()
+{
+  if( !_cpuTracking )
+    return;
+  
+  int cpu( sched_getcpu() );
+  BOOST_FOREACH( Phase* phase, _current )
+    phase->observeCpu( cpu );
 }
 
 void Profile::beginLoop( const string& name )
 {
+  GovernedCall call( _governor );
+  if( _skippedDepth > 0 )
+  {
+    _skippedDepth++;
+    return;
+  }
+  
+  // Subphases of aggregated iteration would be dropped with it
+  if( _pausedLoops.back() && !_current.back()->finished() )
+  {
+    _skippedDepth = 1;
+    _skippedIteration = false;
+    return;
+  }
+  
   PhasePtr newPhase( new Phase() );
-  _current.top()->addPhase( name, newPhase );
+  newPhase->setCpuTracking( _cpuTracking );
+  _current.back()->addPhase( name, newPhase );
+  
+  _current.push_back( newPhase.get() );
+  _currentPaths.push_back( internPath( name ) );
+  _pausedLoops.push_back( false );
   
-  _current.push( newPhase.get() );
+  BOOST_FOREACH( Listener* listener, _listeners )
+    listener->loopBegan( *this, _currentPaths.back() );
 }
 
 void Profile::endLoop()
 {
-  if( !_current.top()->finished() )
+  GovernedCall call( _governor );
+  if( _skippedDepth > 0 )
+  {
+    _skippedDepth--;
+    return;
+  }
+  
+  if( !_current.back()->finished() )
   {
     LOG( INFO ) << "Iteration's end missing.";
     exit( EXIT_FAILURE );
   }
-  _current.pop();
+  size_t path( _currentPaths.back() );
+  _current.pop_back();
+  _currentPaths.pop_back();
+  _pausedLoops.pop_back();
   
   if( _current.empty() )
   {
     LOG( ERROR ) << "Phase's begin missing.";
     exit( EXIT_FAILURE );
   }
+  
+  BOOST_FOREACH( Listener* listener, _listeners )
+    listener->loopEnded( *this, path );
+}
+
+size_t Profile::internPath( const string& name )
+{
+  size_t parent( _currentPaths.back() );
+  std::map< string, size_t >::const_iterator path( _childPaths[ parent ].find( name ) );
+  if( path != _childPaths[ parent ].end() )
+    return path->second;
+  
+  size_t ret( _pathNames.size() );
+  _childPaths[ parent ][ name ] = ret;
+  _childPaths.push_back( std::map< string, size_t >() );
+  _pathNames.push_back( parent == 0 ? name : _pathNames[ parent ] + '/' + name );
+  
+  return ret;
+}
+
+void Profile::addListener( Listener* listener )
+{
+  _listeners.push_back( listener );
+}
+
+void Profile::removeListener( Listener* listener )
+{
+  _listeners.erase( std::remove( _listeners.begin(), _listeners.end(), listener ), _listeners.end() );
+}
+
+void Profile::setGovernor( OverheadGovernor* governor )
+{
+  _governor = governor;
+}
+
+size_t Profile::currentPath() const
+{
+  return _currentPaths.back();
+}
+
+const string& Profile::pathName( size_t path ) const
+{
+  return _pathNames[ path ];
+}
+
+size_t Profile::paths() const
+{
+  return _pathNames.size();
+}
+
+size_t Profile::sources() const
+{
+  size_t ret( 1 );
+  
+  std::pair< string, vector< PhasePtr > > phases;
+  BOOST_FOREACH( phases, _rootPhase->phases() )
+    BOOST_FOREACH( const PhasePtr& phase, phases.second )
+      ret = std::max( ret, phase->sources() );
+  
+  return ret;
+}
+
+void Profile::merge( const Profile& profile )
+{
+  if( profile._current.size() > 1 )
+  {
+    LOG( ERROR ) << "Tried to merge uncomplete profile.";
+    exit( EXIT_FAILURE );
+  }
+  
+  size_t offset( sources() );
+  const Phase::PhaseMap& phases( _rootPhase->phases() );
+  
+  std::pair< string, vector< PhasePtr > > other;
+  BOOST_FOREACH( other, profile._rootPhase->phases() )
+  {
+    Phase::PhaseMap::const_iterator phase( phases.find( other.first ) );
+    if( phase != phases.end() && !phase->second.empty() && !other.second.empty() )
+    {
+      if( !phase->second[ 0 ]->append( *other.second[ 0 ], offset ) )
+        LOG( WARNING ) << "Phase " << other.first << " was not merged.";
+    }
+    else if( phase == phases.end() && !other.second.empty() )
+    {
+      PhasePtr copy( new Phase( *other.second[ 0 ] ) );
+      copy->shiftSources( offset );
+      _rootPhase->addPhase( other.first, copy );
+    }
+  }
+  
+  std::pair< string, vector< Value > > value;
+  BOOST_FOREACH( value, profile._rootPhase->values() )
+    if( value.first != "time" && _rootPhase->values().count( value.first ) == 0 && !value.second.empty() )
+      _rootPhase->addValue( value.first, value.second[ 0 ] );
+  
+  BOOST_FOREACH( const TaskRecord& task, profile.tasks() )
+    _flows->add( task );
+  std::pair< string, size_t > dropped;
+  BOOST_FOREACH( dropped, profile.droppedTasks() )
+    _flows->addDropped( dropped.first, dropped.second );
+}
+
+ProfilePtr Profile::snapshot( size_t maximalIterations ) const
+{
+  PhasePtr root;
+  for( size_t i = _current.size(); i > 0; i-- )
+  {
+    const Phase* active( i < _current.size() ? _current[ i ] : NULL );
+    root = _current[ i - 1 ]->snapshot( maximalIterations, active, root );
+  }
+  
+  ProfilePtr ret( new Profile() );
+  ret->_rootPhase = root;
+  ret->_current.clear();
+  ret->_current.push_back( root.get() );
+  ret->_flows = _flows;
+  
+  return ret;
 }
 
 xml::NodePtr Profile::toXml()
@@ -102,9 +500,67 @@ xml::NodePtr Profile::toXml()
   xml::NodePtr ret( _rootPhase->toXml() );
   ret->name() = "profile";
   
+  std::map< string, xml::NodePtr > flows;
+  BOOST_FOREACH( const TaskRecord& task, tasks() )
+  {
+    xml::NodePtr& flow( flows[ task.flow ] );
+    if( !flow )
+    {
+      flow = xml::Node::create( "flow" );
+      flow->attr( "name" ) = task.flow;
+      ret->childs() += flow;
+    }
+    
+    xml::NodePtr node( xml::Node::create( "task" ) );
+    node->attr( "spawner" ) = task.spawner;
+    node->attr( "iteration" ) = xml::Attribute( task.iteration ).value();
+    node->attr( "begun" ) = static_cast< long >( task.begun );
+    node->attr( "finished" ) = static_cast< long >( task.finished );
+    node->attr( "spawn-thread" ) = task.spawnThread;
+    node->attr( "finish-thread" ) = task.finishThread;
+    flow->childs() += node;
+  }
+  
+  std::pair< string, size_t > dropped;
+  BOOST_FOREACH( dropped, droppedTasks() )
+  {
+    xml::NodePtr& flow( flows[ dropped.first ] );
+    if( !flow )
+    {
+      flow = xml::Node::create( "flow" );
+      flow->attr( "name" ) = dropped.first;
+      ret->childs() += flow;
+    }
+    flow->attr( "dropped" ) = dropped.second;
+  }
+  
   return ret;
 }
 
+void Profile::flowsFromXml( xml::Node& node )
+{
+  BOOST_FOREACH( xml::NodePtr flow, node.childs( "flow" ) )
+  {
+    if( flow->attr( "dropped" ).isSet() )
+      _flows->addDropped( flow->attr( "name" ).as< string >(), flow->attr( "dropped" ).as< size_t >() );
+    
+    BOOST_FOREACH( xml::NodePtr child, flow->childs( "task" ) )
+    {
+      TaskRecord task;
+      task.flow = flow->attr( "name" ).as< string >();
+      task.spawner = child->attr( "spawner" ).isSet() ? child->attr( "spawner" ).as< string >() : string();
+      if( child->attr( "iteration" ).isSet() )
+	task.iteration = child->attr( "iteration" ).value();
+      task.begun = child->attr( "begun" ).as< long >();
+      task.finished = child->attr( "finished" ).as< long >();
+      task.spawnThread = child->attr( "spawn-thread" ).as< long >();
+      task.finishThread = child->attr( "finish-thread" ).as< long >();
+      
+      _flows->add( task );
+    }
+  }
+}
+
 ProfilePtr Profile::fromXml( xml::Node& node )
 {
   if( node.name() != "profile" )
@@ -121,6 +577,9 @@ ProfilePtr Profile::fromXml( xml::Node& node )
   
   ProfilePtr ret( new Profile() );
   ret->_rootPhase = root;
+  ret->_current.clear();
+  ret->_current.push_back( root.get() );
+  ret->flowsFromXml( node );
   
   return ret;
 }
@@ -180,6 +639,12 @@ void Profile::print( std::ostream& ostream )
     ostream << std::endl;
     printed = true;
   }
+  
+  printRetained( ostream, false );
+  printSteadyState( ostream, false );
+  printCpus( ostream, false );
+  printLocks( ostream, false );
+  printFlows( ostream, false );
 }
 
 void Profile::printHtml( std::ostream& ostream )
@@ -201,4 +666,442 @@ void Profile::printHtml( std::ostream& ostream )
     ostream << std::endl;
     printed = true;
   }
+  
+  printRetained( ostream, true );
+  printSteadyState( ostream, true );
+  printCpus( ostream, true );
+  printLocks( ostream, true );
+  printFlows( ostream, true );
+}
+
+typedef std::pair< string, const Phase* > NamedPhase;
+
+static void findSubphases( const Phase& phase, const string& path, vector< NamedPhase >& subphases )
+{
+  for( Phase::PhaseMap::const_iterator phases = phase.phases().begin(); phases != phase.phases().end(); ++phases )
+  {
+    string childPath( path.empty() ? phases->first : path + '/' + phases->first );
+    BOOST_FOREACH( const PhasePtr& child, phases->second )
+    {
+      subphases.push_back( NamedPhase( childPath, child.get() ) );
+      findSubphases( *child, childPath, subphases );
+    }
+  }
+}
+
+// Orders kept iterations by time, slowest first
+class SlowerIteration
+{
+public:
+  SlowerIteration( const vector< Value >& times ) : _times( times )
+  {
+  }
+  
+  bool operator()( size_t left, size_t right ) const
+  {
+    return _times[ left ].value().as< double >() > _times[ right ].value().as< double >();
+  }
+  
+private:
+  const vector< Value >& _times;
+};
+
+static void printTitle( std::ostream& ostream, const string& title, bool html )
+{
+  if( html )
+    ostream << "<h3>" << title << "</h3>" << std::endl;
+  else
+    ostream << std::endl << title << std::endl;
+}
+
+static void printTable( std::ostream& ostream, Table& table, bool html )
+{
+  if( html )
+    table.printHtml( ostream );
+  else
+    table.print( ostream );
+}
+
+static void printSlowest( std::ostream& ostream, const string& path, const Phase& phase, bool html )
+{
+  Phase::ValueMap::const_iterator times( phase.values().find( "time" ) );
+  if( times == phase.values().end() || times->second.size() != phase.iterations().size() )
+    return;
+  
+  vector< size_t > order;
+  for( size_t i=0; i<phase.iterations().size(); i++ )
+    order.push_back( i );
+  std::sort( order.begin(), order.end(), SlowerIteration( times->second ) );
+  
+  Table table;
+  table.column( 0 ).name() = "iteration";
+  size_t column( 1 );
+  for( Phase::ValueMap::const_iterator value = phase.values().begin(); value != phase.values().end(); ++value )
+    table.column( column++ ).name() = value->first;
+  
+  BOOST_FOREACH( size_t index, order )
+  {
+    Table::RowProxy row( table.newRow() );
+    xml::Attribute iteration( phase.iterations()[ index ] );
+    row.pushBack( Value( iteration.value() ) );
+    for( Phase::ValueMap::const_iterator value = phase.values().begin(); value != phase.values().end(); ++value )
+      if( index < value->second.size() )
+	row.pushBack( value->second[ index ] );
+      else
+	row.pushBack( string( "" ) );
+  }
+  
+  printTitle( ostream, "Slowest iterations of " + path, html );
+  printTable( ostream, table, html );
+}
+
+static void printAggregates( std::ostream& ostream, const string& path, const Phase& phase, bool html )
+{
+  Table table;
+  table.column( 0 ).name() = "value";
+  table.column( 1 ).name() = "count";
+  table.column( 2 ).name() = "sum";
+  table.column( 3 ).name() = "minimum";
+  table.column( 4 ).name() = "maximum";
+  table.column( 5 ).name() = "mean";
+  
+  for( Phase::AggregateMap::const_iterator aggregate = phase.aggregates().begin(); aggregate != phase.aggregates().end(); ++aggregate )
+  {
+    const Aggregate& current( aggregate->second );
+    
+    Table::RowProxy row( table.newRow() );
+    row.pushBack( aggregate->first );
+    row.pushBack( current.count );
+    row.pushBack( Value( current.sum, current.measure ) );
+    row.pushBack( Value( current.minimum, current.measure ) );
+    row.pushBack( Value( current.maximum, current.measure ) );
+    row.pushBack( Value( current.count > 0 ? current.sum / current.count : 0.0, current.measure ) );
+  }
+  
+  printTitle( ostream, "Aggregates of " + path, html );
+  printTable( ostream, table, html );
+}
+
+void Profile::printRetained( std::ostream& ostream, bool html )
+{
+  vector< NamedPhase > subphases;
+  findSubphases( *_rootPhase, "", subphases );
+  
+  BOOST_FOREACH( const NamedPhase& phase, subphases )
+  {
+    if( phase.second->retention() == retainSlowest )
+      printSlowest( ostream, phase.first, *phase.second, html );
+    if( !phase.second->aggregates().empty() )
+      printAggregates( ostream, phase.first, *phase.second, html );
+  }
+}
+
+// Processors and nodes a loop ran on
+struct CpuSummary
+{
+  CpuSummary() : iterations( 0 ), migrations( 0 ), migrated( 0 )
+  {
+  }
+  
+  size_t iterations;
+  size_t migrations;
+  size_t migrated;
+  std::set< int > cpus;
+  std::set< int > nodes;
+};
+
+static void collectNumbers( const Phase& phase, const string& name, std::set< int >& numbers )
+{
+  Phase::ValueMap::const_iterator values( phase.values().find( name ) );
+  if( values == phase.values().end() )
+    return;
+  
+  BOOST_FOREACH( const Value& value, values->second )
+    if( value.value().as< int >() >= 0 )
+      numbers.insert( value.value().as< int >() );
+}
+
+// Formats set of numbers as ranges like "0-3,8"
+static string numberRanges( const std::set< int >& numbers )
+{
+  std::ostringstream ret;
+  for( std::set< int >::const_iterator number = numbers.begin(); number != numbers.end(); )
+  {
+    int first( *number );
+    int last( first );
+    while( ++number != numbers.end() && *number == last + 1 )
+      last++;
+    
+    if( first != *numbers.begin() )
+      ret << ',';
+    ret << first;
+    if( last != first )
+      ret << '-' << last;
+  }
+  
+  return ret.str();
+}
+
+void Profile::cpusToTable( Table* table )
+{
+  vector< NamedPhase > subphases;
+  findSubphases( *_rootPhase, "", subphases );
+  
+  std::map< string, CpuSummary > summaries;
+  BOOST_FOREACH( const NamedPhase& phase, subphases )
+  {
+    Phase::ValueMap::const_iterator migrations( phase.second->values().find( "migrations" ) );
+    if( migrations == phase.second->values().end() )
+      continue;
+    
+    CpuSummary& summary( summaries[ phase.first ] );
+    summary.iterations += migrations->second.size();
+    BOOST_FOREACH( const Value& value, migrations->second )
+    {
+      size_t count( value.value().as< size_t >() );
+      summary.migrations += count;
+      if( count > 0 )
+	summary.migrated++;
+    }
+    
+    collectNumbers( *phase.second, "begin cpu", summary.cpus );
+    collectNumbers( *phase.second, "end cpu", summary.cpus );
+    collectNumbers( *phase.second, "begin node", summary.nodes );
+    collectNumbers( *phase.second, "end node", summary.nodes );
+  }
+  
+  if( summaries.empty() )
+    return;
+  
+  table->column( 0 ).name() = "loop";
+  table->column( 1 ).name() = "iterations";
+  table->column( 2 ).name() = "cpus";
+  table->column( 3 ).name() = "nodes";
+  table->column( 4 ).name() = "migrations";
+  table->column( 5 ).name() = "migrated iterations";
+  
+  for( std::map< string, CpuSummary >::const_iterator summary = summaries.begin(); summary != summaries.end(); ++summary )
+  {
+    Table::RowProxy row( table->newRow() );
+    row.pushBack( summary->first );
+    row.pushBack( summary->second.iterations );
+    row.pushBack( numberRanges( summary->second.cpus ) );
+    row.pushBack( numberRanges( summary->second.nodes ) );
+    row.pushBack( summary->second.migrations );
+    row.pushBack( summary->second.migrated );
+  }
+}
+
+void Profile::printCpus( std::ostream& ostream, bool html )
+{
+  Table table;
+  cpusToTable( &table );
+  if( table.rows() == 0 )
+    return;
+  
+  printTitle( ostream, "Processors of loops", html );
+  printTable( ostream, table, html );
+}
+
+// Steady state detection of loops with the same path
+struct SteadyStateSummary
+{
+  SteadyStateSummary() : loops( 0 ), steady( 0 ), window( 0 ), warmup(), steadyTime()
+  {
+  }
+  
+  size_t loops;
+  size_t steady;
+  size_t window;
+  Aggregate warmup;
+  Aggregate steadyTime;
+};
+
+static void mergeAggregate( Aggregate& aggregate, const Aggregate& other )
+{
+  if( other.count == 0 )
+    return;
+  
+  aggregate.minimum = aggregate.count == 0 ? other.minimum : std::min( aggregate.minimum, other.minimum );
+  aggregate.maximum = aggregate.count == 0 ? other.maximum : std::max( aggregate.maximum, other.maximum );
+  aggregate.sum += other.sum;
+  aggregate.count += other.count;
+}
+
+static Value aggregateMean( const Aggregate& aggregate )
+{
+  return Value( aggregate.count > 0 ? aggregate.sum / aggregate.count : 0.0, "ns" );
+}
+
+void Profile::steadyStateToTable( Table* table )
+{
+  vector< NamedPhase > subphases;
+  findSubphases( *_rootPhase, "", subphases );
+  
+  std::map< string, SteadyStateSummary > summaries;
+  BOOST_FOREACH( const NamedPhase& phase, subphases )
+  {
+    if( phase.second->steadyStateWindow() == 0 )
+      continue;
+    
+    SteadyStateSummary& summary( summaries[ phase.first ] );
+    summary.loops++;
+    if( phase.second->steady() )
+      summary.steady++;
+    summary.window = phase.second->steadyStateWindow();
+    mergeAggregate( summary.warmup, phase.second->warmupTime() );
+    mergeAggregate( summary.steadyTime, phase.second->steadyTime() );
+  }
+  
+  table->column( 0 ).name() = "loop";
+  table->column( 1 ).name() = "window";
+  table->column( 2 ).name() = "steady loops";
+  table->column( 3 ).name() = "warmup";
+  table->column( 4 ).name() = "warmup mean";
+  table->column( 5 ).name() = "warmup maximum";
+  table->column( 6 ).name() = "steady";
+  table->column( 7 ).name() = "steady mean";
+  table->column( 8 ).name() = "steady minimum";
+  table->column( 9 ).name() = "steady maximum";
+  
+  for( std::map< string, SteadyStateSummary >::const_iterator summary = summaries.begin(); summary != summaries.end(); ++summary )
+  {
+    const SteadyStateSummary& current( summary->second );
+    
+    Table::RowProxy row( table->newRow() );
+    row.pushBack( summary->first );
+    row.pushBack( current.window );
+    row.pushBack( boost::lexical_cast< string >( current.steady ) + " of " + boost::lexical_cast< string >( current.loops ) );
+    row.pushBack( current.warmup.count );
+    row.pushBack( aggregateMean( current.warmup ) );
+    row.pushBack( Value( current.warmup.maximum, "ns" ) );
+    row.pushBack( current.steadyTime.count );
+    row.pushBack( aggregateMean( current.steadyTime ) );
+    row.pushBack( Value( current.steadyTime.minimum, "ns" ) );
+    row.pushBack( Value( current.steadyTime.maximum, "ns" ) );
+  }
+}
+
+void Profile::printSteadyState( std::ostream& ostream, bool html )
+{
+  Table table;
+  steadyStateToTable( &table );
+  if( table.rows() == 0 )
+    return;
+  
+  printTitle( ostream, "Steady state of loops", html );
+  printTable( ostream, table, html );
+}
+
+void Profile::printLocks( std::ostream& ostream, bool html )
+{
+  Table table;
+  locksToTable( &table );
+  if( table.rows() == 0 )
+    return;
+  
+  printTitle( ostream, "Lock contention", html );
+  printTable( ostream, table, html );
+}
+
+// Tasks of logical flow
+struct FlowSummary
+{
+  FlowSummary() : tasks( 0 ), crossThread( 0 ), duration( 0 ), maximalDuration( 0 )
+  {
+  }
+  
+  size_t tasks;
+  size_t crossThread;
+  long long duration;
+  long long maximalDuration;
+  std::set< string > spawners;
+};
+
+void Profile::flowsToTable( Table* table )
+{
+  std::map< string, FlowSummary > flows;
+  BOOST_FOREACH( const TaskRecord& task, tasks() )
+  {
+    FlowSummary& flow( flows[ task.flow ] );
+    flow.tasks++;
+    if( task.spawnThread != task.finishThread )
+      flow.crossThread++;
+    flow.duration += task.duration();
+    flow.maximalDuration = std::max( flow.maximalDuration, task.duration() );
+    flow.spawners.insert( task.spawner.empty() ? string( "/" ) : task.spawner );
+  }
+  
+  std::map< string, size_t > dropped( droppedTasks() );
+  if( flows.empty() && dropped.empty() )
+    return;
+  
+  table->column( 0 ).name() = "flow";
+  table->column( 1 ).name() = "tasks";
+  table->column( 2 ).name() = "cross-thread";
+  table->column( 3 ).name() = "mean duration";
+  table->column( 4 ).name() = "maximal duration";
+  table->column( 5 ).name() = "spawned in";
+  if( !dropped.empty() )
+    table->column( 6 ).name() = "dropped";
+  
+  // Flows with only dropped tasks are listed too
+  std::pair< string, size_t > droppedFlow;
+  BOOST_FOREACH( droppedFlow, dropped )
+    flows[ droppedFlow.first ];
+  
+  for( std::map< string, FlowSummary >::const_iterator flow = flows.begin(); flow != flows.end(); ++flow )
+  {
+    string spawners;
+    BOOST_FOREACH( const string& spawner, flow->second.spawners )
+      spawners += ( spawners.empty() ? "" : ", " ) + spawner;
+    
+    Table::RowProxy row( table->newRow() );
+    row.pushBack( flow->first );
+    row.pushBack( flow->second.tasks );
+    row.pushBack( flow->second.crossThread );
+    row.pushBack( Value( flow->second.tasks > 0 ? double( flow->second.duration ) / flow->second.tasks : 0.0, "ns" ) );
+    row.pushBack( Value( static_cast< double >( flow->second.maximalDuration ), "ns" ) );
+    row.pushBack( spawners );
+    if( !dropped.empty() )
+      row.pushBack( dropped.count( flow->first ) > 0 ? dropped.find( flow->first )->second : 0 );
+  }
+}
+
+void Profile::printFlows( std::ostream& ostream, bool html )
+{
+  Table table;
+  flowsToTable( &table );
+  if( table.rows() == 0 )
+    return;
+  
+  printTitle( ostream, "Flows", html );
+  printTable( ostream, table, html );
+}
+
+void Profile::write( std::ostream& ostream, OutputFormat format )
+{
+  switch( format )
+  {
+    case xmlFormat:
+    {
+      toXml()->write( ostream );
+    }break;
+    case tableFormat:
+    {
+      print( ostream );
+    }break;
+    case htmlFormat:
+    {
+      printHtml( ostream );
+    }break;
+    case scalingFormat:
+    {
+      profiling::Scaling( *this ).print( ostream );
+    }break;
+    case pprofFormat:
+    {
+      profiling::Pprof( *this ).write( ostream );
+    }break;
+  }
 }
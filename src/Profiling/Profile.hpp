@@ -17,13 +17,20 @@
 #ifndef BURNING_PROFILING_PROFILE_HPP
 #define BURNING_PROFILING_PROFILE_HPP
 
+#include <map>
 #include <string>
-#include <stack>
 #include <vector>
+#include "Flow.hpp"
+#include "Listener.hpp"
 #include "Phase.hpp"
 
 namespace burning
 {
+  namespace profiling
+  {
+    class OverheadGovernor;
+  }
+  
   class Profile;
   typedef std::tr1::shared_ptr< Profile > ProfilePtr;
   
@@ -32,9 +39,15 @@ namespace burning
   {
   public:
     Profile();
+    ~Profile();
     
     /*! Adds new attribute to profile */
     void addValue( const std::string& name, const profiling::Value& value );
+    /*! Adds numeric value to sum of values with same name in innermost iteration in progress */
+    void accumulateValue( const std::string& name, const profiling::Value& value );
+    
+    /*! Labels current iteration of current phase with key and value, e.g. "tenant" and "42" */
+    void addLabel( const std::string& key, const std::string& value );
     
     /*! Begins recording of a loop */
     void beginLoop( const std::string& name );
@@ -46,20 +59,101 @@ namespace burning
     //! Ends current phase of timing
     void endPhase( profiling::TimeMeasure measure = profiling::milliseconds );
     
+    /*! Begins task of named logical flow in current phase. Task may be finished on any thread. */
+    profiling::Task beginTask( const std::string& flow );
+    /*! Finished tasks of logical flows, at most maximal count of latest ones */
+    std::vector< profiling::TaskRecord > tasks() const;
+    /*! Counts of finished tasks dropped by flows, see setMaximalTasks */
+    std::map< std::string, size_t > droppedTasks() const;
+    /*! Changes count of kept finished tasks, FlowLog::defaultMaximalTasks by default.
+     *  Older tasks are dropped and only counted.
+     */
+    void setMaximalTasks( size_t count );
+    /*! Time in nanoseconds since profile began. Tasks and resource samples are placed on this timeline. */
+    long long elapsed() const;
+    /*! Summarizes durations of kept tasks by flows, with counts of dropped ones if there are any */
+    void flowsToTable( profiling::Table* table );
+    
+    /*! Sets iterations kept by current loop */
+    void setRetention( profiling::Retention retention, size_t slowest = 0 );
+    
+    /*! Sets aggregate of current loop computed elsewhere. See Phase::setAggregate. */
+    void setAggregate( const std::string& name, const profiling::Aggregate& aggregate );
+    
+    /*! Detects steady state of current loop's iteration durations. See Phase::setSteadyStateDetection. */
+    void setSteadyStateDetection( size_t window, double tolerance = 0.05, bool stopDetail = false );
+    
+    /*! Records processors and NUMA nodes of iterations of loops begun afterwards.
+     *  Processor is also sampled at each iteration boundary of their subphases to count migrations.
+     */
+    void setCpuTracking( bool tracking );
+    
     /*! Begins recording of iteration */
     void beginIteration( const xml::Attribute::ValueType& name );
     /*! Ends recording of iteration */
     void endIteration( profiling::TimeMeasure measure = profiling::milliseconds );
+    /*! Ends iteration with duration in nanoseconds measured elsewhere */
+    void endMeasuredIteration( long long duration, profiling::TimeMeasure measure = profiling::milliseconds );
+    /*! Adds completed iteration with given duration in nanoseconds and values to current loop */
+    void addIteration( const xml::Attribute::ValueType& name, long long duration, const profiling::Phase::ValueList& values,
+		       profiling::TimeMeasure measure = profiling::milliseconds );
     
     //! Global object used for storing information
     static Profile& global();
     
+    /*! Makes profile receive values measured on calling thread, like times of instrumented locks */
+    void attach();
+    /*! Detaches profile attached to calling thread */
+    static void detach();
+    /*! Profile attached to calling thread or NULL */
+    static Profile* attached();
+    
     /*! A phase object representing whole measured program */
     const profiling::Phase& rootPhase()
     {
       return *_rootPhase;
     }
     
+    /*! Registers listener of profiling events. Listener is not owned by profile. */
+    void addListener( profiling::Listener* listener );
+    /*! Unregisters listener */
+    void removeListener( profiling::Listener* listener );
+    
+    /*! Lets governor lower detail of hot loops to keep overhead in budget, NULL stops governing.
+     *  Governor is not owned by profile. See OverheadGovernor.
+     */
+    void setGovernor( profiling::OverheadGovernor* governor );
+    
+    /*! Phase currently recorded */
+    const profiling::Phase& currentPhase() const
+    {
+      return *_current.back();
+    }
+    
+    /*! Path id of current phase. Root phase has id 0, each path from root gets its own id. */
+    size_t currentPath() const;
+    /*! Names of phases on path from root separated by '/' */
+    const std::string& pathName( size_t path ) const;
+    /*! Count of known paths */
+    size_t paths() const;
+    
+    /*! Merges other profile into this one.
+     *  Subphases of the root phase are matched by name and their iterations are concatenated.
+     *  Every iteration gets a "source" value: 0 for this profile, next numbers for merged ones.
+     *  Root values of merged profile are added only if this profile does not have them.
+     */
+    void merge( const Profile& profile );
+    /*! Count of profiles merged into this one */
+    size_t sources() const;
+    
+    /*! Copies completed iterations of profile while recording continues.
+     *  Completed subphases are shared with this profile, only phases in progress are copied.
+     *  Loops in progress keep their last maximalIterations completed iterations,
+     *  which bounds time the recording thread spends in snapshot for long running loops.
+     *  Must be called from the thread recording the profile.
+     */
+    ProfilePtr snapshot( size_t maximalIterations = 10000 ) const;
+    
     /*! Converts profiling result to xml */
     xml::NodePtr toXml();
     /*! Restored profiling result from xml */
@@ -69,13 +163,46 @@ namespace burning
     void print( std::ostream& ostream = std::cout );
     /*! Prints profiling result in html format */
     void printHtml( std::ostream& ostream = std::cout );
+    /*! Summarizes processors and NUMA nodes each loop with tracked processors ran on */
+    void cpusToTable( profiling::Table* table );
+    /*! Summarizes warmup and steady state iterations of loops with steady state detection */
+    void steadyStateToTable( profiling::Table* table );
+    /*! Writes profiling result in given format */
+    void write( std::ostream& ostream, profiling::OutputFormat format );
     
   private:
     static Profile& _global;
     bool preparePrint( profiling::Table* table, profiling::PhasePtr& root, bool printed = false );
+    void printRetained( std::ostream& ostream, bool html );
+    void printCpus( std::ostream& ostream, bool html );
+    void printSteadyState( std::ostream& ostream, bool html );
+    void printLocks( std::ostream& ostream, bool html );
+    void printFlows( std::ostream& ostream, bool html );
+    void flowsFromXml( xml::Node& node );
+    void observeCpu();
+    bool skipIterationEnd();
+    
+    size_t internPath( const std::string& name );
     
     profiling::PhasePtr _rootPhase;
-    std::stack< profiling::Phase* > _current;
+    std::vector< profiling::Phase* > _current;
+    
+    std::vector< size_t > _currentPaths;
+    std::vector< std::string > _pathNames;
+    std::vector< std::map< std::string, size_t > > _childPaths;
+    
+    std::vector< profiling::Listener* > _listeners;
+    
+    profiling::OverheadGovernor* _governor;
+    /*! Loops of current phases whose detail was paused by governor */
+    std::vector< bool > _pausedLoops;
+    /*! Depth of skipped scope, calls are ignored until it ends */
+    size_t _skippedDepth;
+    /*! Skipped scope is an iteration rather than a loop */
+    bool _skippedIteration;
+    
+    bool _cpuTracking;
+    std::tr1::shared_ptr< profiling::FlowLog > _flows;
   };
   
 }
@@ -14,67 +14,427 @@
    this library. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <pthread.h>
+#include <signal.h>
+#include <cstdio>
+#include <fstream>
+#include "Journal.hpp"
+#include "LatencyBudget.hpp"
+#include "LiveStatistics.hpp"
+#include "MetricsExporter.hpp"
+#include "OverheadGovernor.hpp"
 #include "Profile.hpp"
 #include "Profiling.hpp"
+#include "ResourceSampler.hpp"
 
+using std::string;
 using namespace burning;
 
 static bool useProfiling = false;
 
+double profiling::timeMeasureScale( const string& measure )
+{
+  if( measure == "s" )
+    return seconds;
+  if( measure == "ms" )
+    return milliseconds;
+  if( measure == "mcs" )
+    return microseconds;
+  if( measure == "ns" )
+    return nanoseconds;
+  return 0.0;
+}
+
+bool profiling::convertMeasure( double number, const string& from, const string& to, double& result )
+{
+  if( from == to )
+  {
+    result = number;
+    return true;
+  }
+
+  double fromScale( timeMeasureScale( from ) );
+  double toScale( timeMeasureScale( to ) );
+  if( fromScale == 0.0 || toScale == 0.0 )
+    return false;
+
+  result = number / fromScale * toScale;
+  return true;
+}
+
+long long profiling::clockNanoseconds( clockid_t clock )
+{
+  timespec time;
+  clock_gettime( clock, &time );
+
+  return time.tv_sec * static_cast< long long >( nanoseconds ) + time.tv_nsec;
+}
+
+/*
+ * Snapshots
+ */
+
+static volatile sig_atomic_t snapshotRequested = 0;
+
+static pthread_mutex_t snapshotLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t snapshotTaken = PTHREAD_COND_INITIALIZER;
+static pthread_t snapshotWriter;
+static struct sigaction previousAction;
+
+static bool snapshotsEnabled = false;
+static bool stopWriter = false;
+static string snapshotPath;
+static profiling::OutputFormat snapshotFormat = profiling::xmlFormat;
+static ProfilePtr pendingSnapshot;
+
+static void writeSnapshot( Profile& snapshot, const string& path, profiling::OutputFormat format )
+{
+  string temporary( path + ".tmp" );
+  
+  std::ofstream stream( temporary.c_str() );
+  snapshot.write( stream, format );
+  stream.close();
+  
+  if( !stream )
+  {
+    LOG( ERROR ) << "Cannot write snapshot to " << temporary << '.';
+    return;
+  }
+  if( rename( temporary.c_str(), path.c_str() ) != 0 )
+    LOG( ERROR ) << "Cannot rename snapshot to " << path << '.';
+}
+
+static void* writeSnapshots( void* )
+{
+  pthread_mutex_lock( &snapshotLock );
+  for(;;)
+  {
+    while( !pendingSnapshot && !stopWriter )
+      pthread_cond_wait( &snapshotTaken, &snapshotLock );
+    
+    if( !pendingSnapshot )
+      break;
+    
+    ProfilePtr snapshot;
+    snapshot.swap( pendingSnapshot );
+    string path( snapshotPath );
+    profiling::OutputFormat format( snapshotFormat );
+    
+    pthread_mutex_unlock( &snapshotLock );
+    writeSnapshot( *snapshot, path, format );
+    snapshot.reset();
+    pthread_mutex_lock( &snapshotLock );
+  }
+  pthread_mutex_unlock( &snapshotLock );
+  
+  return NULL;
+}
+
+static void requestOnSignal( int )
+{
+  snapshotRequested = 1;
+}
+
+// Called after each profiling call, so only a flag check is paid while no snapshot is requested
+static void takeRequestedSnapshot()
+{
+  if( !snapshotRequested )
+    return;
+  snapshotRequested = 0;
+  
+  ProfilePtr snapshot( Profile::global().snapshot() );
+  
+  pthread_mutex_lock( &snapshotLock );
+  if( snapshotsEnabled )
+  {
+    pendingSnapshot.swap( snapshot );
+    pthread_cond_signal( &snapshotTaken );
+  }
+  pthread_mutex_unlock( &snapshotLock );
+}
+
 void profiling::beginPhase( const std::string& name )
 {
   if( useProfiling )
+  {
     Profile::global().beginPhase( name );
+    takeRequestedSnapshot();
+  }
 }
 
 void profiling::endPhase( TimeMeasure measure )
 {
   if( useProfiling )
+  {
     Profile::global().endPhase( measure );
+    takeRequestedSnapshot();
+  }
 }
     
 void profiling::addValue( const std::string& name, const xml::Attribute::ValueType& value )
 {
   if( useProfiling )
+  {
     Profile::global().addValue( name, value );
+    takeRequestedSnapshot();
+  }
 }
 
 void profiling::addValue( const std::string& name, const xml::Attribute::ValueType& value, const std::string& measure )
 {
   if( useProfiling )
+  {
     Profile::global().addValue( name, profiling::Value( value, measure ) );
+    takeRequestedSnapshot();
+  }
+}
+
+void profiling::setRetention( Retention retention, size_t slowest )
+{
+  if( useProfiling )
+    Profile::global().setRetention( retention, slowest );
+}
+
+void profiling::addLabel( const std::string& key, const std::string& value )
+{
+  if( useProfiling )
+    Profile::global().addLabel( key, value );
+}
+
+void profiling::setSteadyStateDetection( size_t window, double tolerance, bool stopDetail )
+{
+  if( useProfiling )
+    Profile::global().setSteadyStateDetection( window, tolerance, stopDetail );
+}
+
+profiling::Task profiling::beginTask( const std::string& flow )
+{
+  if( !useProfiling )
+    return Task();
+  
+  return Profile::global().beginTask( flow );
+}
+
+void profiling::setCpuTracking( bool tracking )
+{
+  Profile::global().setCpuTracking( tracking );
 }
 
 void profiling::beginLoop( const std::string& name )
 {
   if( useProfiling )
+  {
     Profile::global().beginLoop( name );
+    takeRequestedSnapshot();
+  }
 }
 
 void profiling::endLoop()
 {
   if( useProfiling )
+  {
     Profile::global().endLoop();
+    takeRequestedSnapshot();
+  }
 }
 
 void profiling::beginIteration( const xml::Attribute::ValueType& name )
 {
   if( useProfiling )
+  {
     Profile::global().beginIteration( name );
+    takeRequestedSnapshot();
+  }
 }
 
 void profiling::endIteration( TimeMeasure measure )
 {
   if( useProfiling )
+  {
     Profile::global().endIteration( measure );
+    takeRequestedSnapshot();
+  }
 }
 
 void profiling::beginProfiling()
 {
   useProfiling = true;
+  Profile::global().attach();
 }
 
 void profiling::endProfiling()
 {
   useProfiling = false;
+  if( Profile::attached() == &Profile::global() )
+    Profile::detach();
+}
+
+void profiling::enableSnapshots( const string& path, OutputFormat format )
+{
+  pthread_mutex_lock( &snapshotLock );
+  snapshotPath = path;
+  snapshotFormat = format;
+  
+  bool started( snapshotsEnabled );
+  snapshotsEnabled = true;
+  stopWriter = false;
+  pthread_mutex_unlock( &snapshotLock );
+  
+  if( started )
+    return;
+  
+  if( pthread_create( &snapshotWriter, NULL, writeSnapshots, NULL ) != 0 )
+  {
+    LOG( ERROR ) << "Cannot start snapshot writer.";
+    exit( EXIT_FAILURE );
+  }
+  
+  struct sigaction action;
+  action.sa_handler = requestOnSignal;
+  sigemptyset( &action.sa_mask );
+  action.sa_flags = SA_RESTART;
+  sigaction( SIGUSR1, &action, &previousAction );
+}
+
+void profiling::disableSnapshots()
+{
+  pthread_mutex_lock( &snapshotLock );
+  bool started( snapshotsEnabled );
+  snapshotsEnabled = false;
+  stopWriter = true;
+  pthread_cond_signal( &snapshotTaken );
+  pthread_mutex_unlock( &snapshotLock );
+  
+  if( !started )
+    return;
+  
+  sigaction( SIGUSR1, &previousAction, NULL );
+  pthread_join( snapshotWriter, NULL );
+}
+
+void profiling::requestSnapshot()
+{
+  snapshotRequested = 1;
+}
+
+static profiling::LiveStatistics* liveStatistics = NULL;
+static profiling::MetricsExporter* metricsExporter = NULL;
+
+void profiling::enableLiveStatistics( const string& name )
+{
+  disableLiveStatistics();
+  
+  liveStatistics = new LiveStatistics( name );
+  Profile::global().addListener( liveStatistics );
+}
+
+void profiling::disableLiveStatistics()
+{
+  disableMetricsExporter();
+  if( liveStatistics == NULL )
+    return;
+  
+  Profile::global().removeListener( liveStatistics );
+  delete liveStatistics;
+  liveStatistics = NULL;
+}
+
+static profiling::MetricsExporter& createMetricsExporter()
+{
+  profiling::disableMetricsExporter();
+  
+  if( liveStatistics == NULL )
+  {
+    liveStatistics = new profiling::LiveStatistics();
+    Profile::global().addListener( liveStatistics );
+  }
+  
+  metricsExporter = new profiling::MetricsExporter( liveStatistics->segment() );
+  return *metricsExporter;
+}
+
+bool profiling::enableMetricsExporter( const string& socketPath )
+{
+  if( createMetricsExporter().listen( socketPath ) )
+    return true;
+  
+  disableMetricsExporter();
+  return false;
+}
+
+bool profiling::enableMetricsExporter( unsigned short port )
+{
+  if( createMetricsExporter().listen( port ) )
+    return true;
+  
+  disableMetricsExporter();
+  return false;
+}
+
+void profiling::disableMetricsExporter()
+{
+  delete metricsExporter;
+  metricsExporter = NULL;
+}
+
+void profiling::setLatencyBudget( const string& phase, double seconds )
+{
+  static LatencyBudget* budget = NULL;
+  if( budget == NULL )
+  {
+    budget = new LatencyBudget();
+    Profile::global().addListener( budget );
+  }
+  
+  budget->setBudget( phase, seconds );
+}
+
+static profiling::Journal* profileJournal = NULL;
+
+void profiling::enableJournal( const string& path, size_t capacity )
+{
+  disableJournal();
+  
+  profileJournal = new Journal( path, capacity );
+  Profile::global().addListener( profileJournal );
+}
+
+void profiling::disableJournal()
+{
+  if( profileJournal == NULL )
+    return;
+  
+  Profile::global().removeListener( profileJournal );
+  delete profileJournal;
+  profileJournal = NULL;
+}
+
+static profiling::ResourceSampler* resourceSampler = NULL;
+
+void profiling::enableResourceSampling( double interval, size_t maximalBuckets )
+{
+  disableResourceSampling();
+  
+  resourceSampler = new ResourceSampler( Profile::global(), interval, maximalBuckets );
+}
+
+void profiling::disableResourceSampling()
+{
+  delete resourceSampler;
+  resourceSampler = NULL;
+}
+
+static profiling::OverheadGovernor* overheadGovernor = NULL;
+
+void profiling::enableOverheadGovernor( double budget, double window )
+{
+  disableOverheadGovernor();
+  
+  overheadGovernor = new OverheadGovernor( Profile::global(), budget, window );
+}
+
+void profiling::disableOverheadGovernor()
+{
+  delete overheadGovernor;
+  overheadGovernor = NULL;
 }
@@ -51,8 +51,10 @@
 
 #endif
 
+#include <time.h>
 #include <string>
 #include <Xml/Attribute.hpp>
+#include "Flow.hpp"
 
 namespace burning
 {
@@ -66,6 +68,36 @@ namespace burning
       nanoseconds = 1000000000
     };
     
+    /*! Count of units of measure like "ms" in second, zero for non time measures */
+    double timeMeasureScale( const std::string& measure );
+    /*! Converts number in measure from to measure to. Returns false if measures differ and are not both time measures. */
+    bool convertMeasure( double number, const std::string& from, const std::string& to, double& result );
+    /*! Current time of clock like CLOCK_MONOTONIC or CLOCK_THREAD_CPUTIME_ID in nanoseconds */
+    long long clockNanoseconds( clockid_t clock );
+    
+    /*! Iterations kept by a loop */
+    enum Retention
+    {
+      /*! All iterations are kept */
+      retainAll,
+      /*! Only the slowest iterations are kept */
+      retainSlowest,
+      /*! Iterations are only aggregated */
+      retainNone
+    };
+    
+    /*! Formats of written profile */
+    enum OutputFormat
+    {
+      xmlFormat,
+      tableFormat,
+      htmlFormat,
+      /*! Scaling curves of loops keyed by problem size */
+      scalingFormat,
+      /*! Gzip compressed profile.proto of pprof */
+      pprofFormat
+    };
+    
     void beginPhase( const std::string& name );
     void endPhase( TimeMeasure measure );
     
@@ -78,8 +110,75 @@ namespace burning
     void addValue( const std::string& name, const burning::xml::Attribute::ValueType& value );
     void addValue( const std::string& name, const burning::xml::Attribute::ValueType& value, const std::string& measure );
     
+    /*! Labels current iteration of current phase of global profile, e.g. with "tenant" and "42" */
+    void addLabel( const std::string& key, const std::string& value );
+    
+    /*! Begins task of logical flow in current phase of global profile. Task may be finished on any thread. */
+    Task beginTask( const std::string& flow );
+    
+    /*! Sets iterations kept by current loop */
+    void setRetention( Retention retention, size_t slowest = 0 );
+    
+    /*! Detects steady state of current loop of global profile. See Phase::setSteadyStateDetection. */
+    void setSteadyStateDetection( size_t window, double tolerance = 0.05, bool stopDetail = false );
+    
+    /*! Records processors and NUMA nodes of iterations of global profile's loops begun afterwards */
+    void setCpuTracking( bool tracking );
+    
     void beginProfiling();
     void endProfiling();
+    
+    /*! Enables live snapshots of global profile.
+     *  Snapshot is requested with SIGUSR1 or requestSnapshot and taken at next profiling call,
+     *  it is written to path in background thread. File is replaced atomically.
+     *  Loops in progress are written with their last 10000 completed iterations, see Profile::snapshot.
+     */
+    void enableSnapshots( const std::string& path, OutputFormat format = xmlFormat );
+    /*! Waits for pending snapshot and disables snapshots */
+    void disableSnapshots();
+    /*! Requests snapshot of global profile. Safe to call from any thread and from signal handlers. */
+    void requestSnapshot();
+    
+    /*! Publishes live statistics of global profile in POSIX shared memory object with given name */
+    void enableLiveStatistics( const std::string& name );
+    /*! Stops publishing and removes shared memory object. Disables metrics exporter too. */
+    void disableLiveStatistics();
+    
+    /*! Serves live statistics of global profile in OpenMetrics format on Unix domain socket.
+     *  Statistics are kept in anonymous memory if live statistics are not enabled.
+     *  Returns false if socket cannot be created.
+     */
+    bool enableMetricsExporter( const std::string& socketPath );
+    /*! Serves live statistics of global profile in OpenMetrics format on loopback tcp port */
+    bool enableMetricsExporter( unsigned short port );
+    /*! Stops serving metrics */
+    void disableMetricsExporter();
+    
+    /*! Logs iterations of global profile's phases with given name or path lasting longer than seconds.
+     *  Zero budget removes it.
+     */
+    void setLatencyBudget( const std::string& phase, double seconds );
+    
+    /*! Writes events of global profile into memory mapped journal file with room for given count of records.
+     *  Journal survives crash of process, Journal::recover or burning-profrecover rebuild profile from it.
+     */
+    void enableJournal( const std::string& path, size_t capacity = 65536 );
+    /*! Closes journal. File is kept. */
+    void disableJournal();
+    
+    /*! Samples resources of process every interval seconds while global profile is recorded.
+     *  See ResourceSampler.
+     */
+    void enableResourceSampling( double interval = 1.0, size_t maximalBuckets = 1024 );
+    /*! Stops sampling and adds samples as loop "resources" to current phase of global profile */
+    void disableResourceSampling();
+    
+    /*! Keeps time spent in recording global profile below budget fraction of processor time by lowering
+     *  detail of hot loops. See OverheadGovernor.
+     */
+    void enableOverheadGovernor( double budget = 0.01, double window = 1.0 );
+    /*! Stops governing and adds changes of detail as loop "detail levels" to current phase of global profile */
+    void disableOverheadGovernor();
   }
 }
 
@@ -0,0 +1,388 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fnmatch.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <boost/foreach.hpp>
+#include "Statistics.hpp"
+#include "Table.hpp"
+#include "Query.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+static vector< string > split( const string& text, char separator )
+{
+  vector< string > ret;
+  size_t begin( 0 );
+  for(;;)
+  {
+    size_t end( text.find( separator, begin ) );
+    ret.push_back( text.substr( begin, end - begin ) );
+    if( end == string::npos )
+      return ret;
+    begin = end + 1;
+  }
+}
+
+/*
+ * ProfileIndex
+ */
+
+ProfileIndex::ProfileIndex( Profile& profile ) : _paths(),
+                                                 _ids(),
+                                                 _labelSets( 1, LabelSet() ),
+                                                 _labelSetIds()
+{
+  _labelSetIds[ LabelSet() ] = 0;
+  index( profile.rootPhase(), "" );
+}
+
+void ProfileIndex::index( const Phase& phase, const string& path )
+{
+  for( size_t i=0; i<phase.iterations().size(); i++ )
+    for( Phase::PhaseMap::const_iterator phases = phase.phases().begin(); phases != phase.phases().end(); ++phases )
+    {
+      if( i >= phases->second.size() )
+	continue;
+      
+      string subpath( path.empty() ? phases->first : path + '/' + phases->first );
+      std::map< string, size_t >::const_iterator found( _ids.find( subpath ) );
+      size_t id( found == _ids.end() ? _paths.size() : found->second );
+      if( found == _ids.end() )
+      {
+	_ids[ subpath ] = id;
+	_paths.push_back( Path() );
+	_paths.back().path = subpath;
+	_paths.back().components = split( subpath, '/' );
+      }
+      
+      indexValues( _paths[ id ], *phases->second[ i ] );
+      index( *phases->second[ i ], subpath );
+    }
+}
+
+void ProfileIndex::indexValues( Path& path, const Phase& phase )
+{
+  const double missing( std::numeric_limits< double >::quiet_NaN() );
+  
+  size_t first( path.iterations.size() );
+  size_t count( phase.iterations().size() );
+  for( size_t i=0; i<count; i++ )
+    path.iterations.push_back( Iteration( &phase, i ) );
+  
+  path.labels.resize( first + count, 0 );
+  if( phase.labelled() )
+    for( size_t i=0; i<count; i++ )
+    {
+      const LabelSet& labels( phase.labels( i ) );
+      std::map< LabelSet, size_t >::const_iterator found( _labelSetIds.find( labels ) );
+      if( found != _labelSetIds.end() )
+	path.labels[ first + i ] = found->second;
+      else
+      {
+	path.labels[ first + i ] = _labelSets.size();
+	_labelSetIds[ labels ] = _labelSets.size();
+	_labelSets.push_back( labels );
+      }
+    }
+  
+  for( Phase::ValueMap::const_iterator values = phase.values().begin(); values != phase.values().end(); ++values )
+  {
+    vector< double >& column( path.values[ values->first ] );
+    column.resize( first, missing );
+    
+    for( size_t i=0; i<count; i++ )
+    {
+      double number( missing );
+      if( i < values->second.size() && boost::get< Decimal >( &values->second[ i ].rawValue() ) != NULL )
+      {
+	const string& measure( values->second[ i ].measure() );
+	number = values->second[ i ].value().as< double >();
+	
+	std::map< string, string >::const_iterator known( path.measures.find( values->first ) );
+	if( known == path.measures.end() )
+	  path.measures[ values->first ] = measure;
+	else if( !convertMeasure( number, measure, known->second, number ) )
+	  number = missing;
+      }
+      column.push_back( number );
+    }
+  }
+  
+  // Values missing in this phase
+  for( std::map< string, vector< double > >::iterator column = path.values.begin(); column != path.values.end(); ++column )
+    column->second.resize( first + count, missing );
+}
+
+static bool matchComponents( const vector< string >& pattern, size_t patternIndex,
+			     const vector< string >& components, size_t index )
+{
+  if( patternIndex == pattern.size() )
+    return index == components.size();
+  
+  if( pattern[ patternIndex ] == "**" )
+  {
+    for( size_t skipped=index; skipped<=components.size(); skipped++ )
+      if( matchComponents( pattern, patternIndex + 1, components, skipped ) )
+	return true;
+    return false;
+  }
+  
+  return index < components.size() &&
+         fnmatch( pattern[ patternIndex ].c_str(), components[ index ].c_str(), FNM_NOESCAPE ) == 0 &&
+         matchComponents( pattern, patternIndex + 1, components, index + 1 );
+}
+
+vector< size_t > ProfileIndex::match( const string& pattern ) const
+{
+  vector< size_t > ret;
+  
+  if( pattern.find_first_of( "*?[" ) == string::npos )
+  {
+    std::map< string, size_t >::const_iterator found( _ids.find( pattern ) );
+    if( found != _ids.end() )
+      ret.push_back( found->second );
+    return ret;
+  }
+  
+  vector< string > components( split( pattern, '/' ) );
+  for( size_t i=0; i<_paths.size(); i++ )
+    if( matchComponents( components, 0, _paths[ i ].components, 0 ) )
+      ret.push_back( i );
+  
+  return ret;
+}
+
+/*
+ * Query
+ */
+
+/*! Numeric values of a group */
+struct Query::Samples
+{
+  vector< double > values;
+  string measure;
+};
+
+Query::Query( const ProfileIndex& index ) : _index( index ),
+                                            _pattern( "**" ),
+                                            _filter(),
+                                            _grouping( byPath ),
+                                            _key(),
+                                            _value( "time" ),
+                                            _functions(),
+                                            _quantiles()
+{
+  aggregate( "count,sum,mean,p50,p99" );
+}
+
+Query& Query::select( const string& pattern )
+{
+  _pattern = pattern;
+  return *this;
+}
+
+Query& Query::where( const string& key, const string& value )
+{
+  _filter.set( key, value );
+  return *this;
+}
+
+Query& Query::groupBy( Grouping grouping, const string& key )
+{
+  _grouping = grouping;
+  _key = key;
+  return *this;
+}
+
+Query& Query::value( const string& name )
+{
+  _value = name;
+  return *this;
+}
+
+bool Query::aggregate( const string& functions )
+{
+  vector< string > parsed;
+  vector< double > quantiles;
+  
+  BOOST_FOREACH( string function, split( functions, ',' ) )
+  {
+    function.erase( 0, function.find_first_not_of( ' ' ) );
+    function.erase( function.find_last_not_of( ' ' ) + 1 );
+    
+    double quantile( -1.0 );
+    if( function.size() > 1 && function[ 0 ] == 'p' )
+    {
+      try
+      {
+	quantile = boost::lexical_cast< double >( function.substr( 1 ) ) / 100.0;
+      }
+      catch( const boost::bad_lexical_cast& )
+      {
+      }
+    }
+    
+    if( ( quantile < 0.0 || quantile > 1.0 ) &&
+	function != "count" && function != "sum" && function != "mean" && function != "min" && function != "max" )
+    {
+      LOG( ERROR ) << "Unknown aggregate function " << function << '.';
+      return false;
+    }
+    
+    parsed.push_back( function );
+    quantiles.push_back( quantile );
+  }
+  
+  _functions.swap( parsed );
+  _quantiles.swap( quantiles );
+  return true;
+}
+
+string Query::groupName( const ProfileIndex::Path& path, size_t iteration, const vector< string >& labelValues ) const
+{
+  const ProfileIndex::Iteration& current( path.iterations[ iteration ] );
+  
+  switch( _grouping )
+  {
+    case byName:
+      return path.components.back();
+    case byIteration:
+      return current.first->iterations()[ current.second ].as< string >();
+    case byLabel:
+      return labelValues[ path.labels[ iteration ] ];
+    default:
+      return path.path;
+  }
+}
+
+Query::ResultVector Query::run() const
+{
+  std::map< string, Samples > groups;
+  
+  // Filters and label values are resolved once per label set
+  const vector< LabelSet >& labelSets( _index.labelSets() );
+  vector< bool > matching( labelSets.size(), true );
+  vector< string > labelValues( _grouping == byLabel ? labelSets.size() : 0 );
+  for( size_t i=0; i<labelSets.size(); i++ )
+  {
+    if( !_filter.empty() )
+      matching[ i ] = labelSets[ i ].contains( _filter );
+    if( _grouping == byLabel )
+      labelValues[ i ] = labelSets[ i ].value( _key );
+  }
+  
+  BOOST_FOREACH( size_t id, _index.match( _pattern ) )
+  {
+    const ProfileIndex::Path& path( _index.paths()[ id ] );
+    std::map< string, vector< double > >::const_iterator column( path.values.find( _value ) );
+    if( column == path.values.end() )
+      continue;
+    
+    std::map< string, string >::const_iterator found( path.measures.find( _value ) );
+    string measure( found == path.measures.end() ? "" : found->second );
+    
+    for( size_t i=0; i<column->second.size(); i++ )
+    {
+      double number( column->second[ i ] );
+      if( std::isnan( number ) )
+	continue;
+      
+      if( !matching[ path.labels[ i ] ] )
+	continue;
+      
+      Samples& samples( groups[ groupName( path, i, labelValues ) ] );
+      if( samples.values.empty() )
+	samples.measure = measure;
+      else if( !convertMeasure( number, measure, samples.measure, number ) )
+      {
+	LOG( WARNING ) << "Skipping value " << _value << " of phase " << path.path << " with unexpected measure " << measure;
+	continue;
+      }
+      samples.values.push_back( number );
+    }
+  }
+  
+  ResultVector ret;
+  for( std::map< string, Samples >::const_iterator group = groups.begin(); group != groups.end(); ++group )
+  {
+    const vector< double >& values( group->second.values );
+    
+    Result result;
+    result.group = group->first;
+    result.measure = group->second.measure;
+    
+    for( size_t i=0; i<_functions.size(); i++ )
+    {
+      const string& function( _functions[ i ] );
+      if( _quantiles[ i ] >= 0.0 )
+	result.aggregates.push_back( statistics::quantile( values, _quantiles[ i ] ) );
+      else if( function == "count" )
+	result.aggregates.push_back( values.size() );
+      else if( function == "sum" )
+	result.aggregates.push_back( std::accumulate( values.begin(), values.end(), 0.0 ) );
+      else if( function == "mean" )
+	result.aggregates.push_back( statistics::mean( values ) );
+      else if( function == "min" )
+	result.aggregates.push_back( *std::min_element( values.begin(), values.end() ) );
+      else
+	result.aggregates.push_back( *std::max_element( values.begin(), values.end() ) );
+    }
+    
+    ret.push_back( result );
+  }
+  
+  return ret;
+}
+
+void Query::toTable( Table* table ) const
+{
+  if( _grouping == byLabel )
+    table->column( 0 ).name() = _key;
+  else
+    table->column( 0 ).name() = _grouping == byIteration ? "iteration" : "phase";
+  
+  for( size_t i=0; i<_functions.size(); i++ )
+    table->column( i + 1 ).name() = _functions[ i ];
+  
+  BOOST_FOREACH( const Result& result, run() )
+  {
+    Table::RowProxy row( table->newRow() );
+    row.pushBack( result.group );
+    for( size_t i=0; i<_functions.size(); i++ )
+      if( _functions[ i ] == "count" )
+	row.pushBack( static_cast< size_t >( result.aggregates[ i ] ) );
+      else
+	row.pushBack( Value( result.aggregates[ i ], result.measure ) );
+  }
+}
+
+void Query::print( std::ostream& ostream, bool html ) const
+{
+  Table table;
+  toTable( &table );
+  
+  if( html )
+    table.printHtml( ostream );
+  else
+    table.print( ostream );
+}
@@ -0,0 +1,164 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_QUERY_HPP
+#define BURNING_PROFILING_QUERY_HPP
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "Profile.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    class Table;
+    
+    /*! Iterations of profile's phases indexed by name paths, e.g. "main/requests/parse".
+     *  Index is built once and then shared by queries. Numeric values of iterations are converted
+     *  to doubles while indexing, time values of a path are converted to the measure first seen.
+     *  Label sets of iterations are indexed too, so queries filter and group by labels per set, not per iteration.
+     *  Profile must not change while index is used.
+     */
+    class ProfileIndex
+    {
+    public:
+      explicit ProfileIndex( Profile& profile );
+      
+      /*! An iteration of a phase */
+      typedef std::pair< const Phase*, size_t > Iteration;
+      
+      /*! Indexed iterations of a path */
+      struct Path
+      {
+	std::string path;
+	std::vector< std::string > components;
+	std::vector< Iteration > iterations;
+	/*! Label sets of iterations as indexes in ProfileIndex::labelSets */
+	std::vector< size_t > labels;
+	/*! Values of iterations by names, NaN for missing and non numeric values */
+	std::map< std::string, std::vector< double > > values;
+	/*! Measures of values by names */
+	std::map< std::string, std::string > measures;
+      };
+      typedef std::vector< Path > PathVector;
+      
+      /*! Indexed paths in order of their first iterations */
+      const PathVector& paths() const
+      {
+	return _paths;
+      }
+      
+      /*! Distinct label sets of indexed iterations, the first one is empty set of unlabelled iterations */
+      const std::vector< LabelSet >& labelSets() const
+      {
+	return _labelSets;
+      }
+      
+      /*! Indexes of paths matching pattern. Components of pattern are separated by slashes and matched
+       *  by shell wildcards, component "**" matches any count of components. E.g. pattern of components
+       *  main, * and parse matches parse phases two levels below main, pattern of ** and parse matches
+       *  parse phases at any depth.
+       */
+      std::vector< size_t > match( const std::string& pattern ) const;
+      
+    private:
+      void index( const Phase& phase, const std::string& path );
+      void indexValues( Path& path, const Phase& phase );
+      
+      PathVector _paths;
+      std::map< std::string, size_t > _ids;
+      std::vector< LabelSet > _labelSets;
+      std::map< LabelSet, size_t > _labelSetIds;
+    };
+    
+    /*! Aggregating query over indexed profile.
+     *  Query selects iterations of matching paths which have all filtering labels, splits them into groups
+     *  and aggregates numeric value of each group. Non numeric values are skipped.
+     */
+    class Query
+    {
+    public:
+      /*! Constructs query of all paths aggregating "time" of each path with count, sum, mean, p50 and p99 */
+      explicit Query( const ProfileIndex& index );
+      
+      /*! What splits iterations into groups */
+      enum Grouping
+      {
+	/*! Full name paths */
+	byPath,
+	/*! Names of phases, the last components of paths */
+	byName,
+	/*! Names of iterations */
+	byIteration,
+	/*! Values of a label */
+	byLabel
+      };
+      
+      /*! Selects paths matching pattern, see ProfileIndex::match */
+      Query& select( const std::string& pattern );
+      /*! Keeps iterations labelled with key and value. Iterations must match all filters. */
+      Query& where( const std::string& key, const std::string& value );
+      /*! Groups iterations, label key is used only by byLabel grouping */
+      Query& groupBy( Grouping grouping, const std::string& key = "" );
+      /*! Name of aggregated value */
+      Query& value( const std::string& name );
+      /*! Replaces aggregate functions with comma separated list of count, sum, mean, min, max
+       *  and percentiles like p50 or p99.9. On unknown function logs error, keeps previous functions
+       *  and returns false.
+       */
+      bool aggregate( const std::string& functions );
+      
+      /*! Aggregates of a group */
+      struct Result
+      {
+	std::string group;
+	std::string measure;
+	/*! Aggregates in order of functions */
+	std::vector< double > aggregates;
+      };
+      typedef std::vector< Result > ResultVector;
+      
+      /*! Runs query, results are ordered by groups */
+      ResultVector run() const;
+      
+      /*! Writes results to table */
+      void toTable( Table* table ) const;
+      /*! Prints results as a table */
+      void print( std::ostream& ostream = std::cout, bool html = false ) const;
+      
+    private:
+      struct Samples;
+      std::string groupName( const ProfileIndex::Path& path, size_t iteration, const std::vector< std::string >& labelValues ) const;
+      
+      const ProfileIndex& _index;
+      
+      std::string _pattern;
+      LabelSet _filter;
+      Grouping _grouping;
+      std::string _key;
+      std::string _value;
+      
+      std::vector< std::string > _functions;
+      /*! Quantiles of percentile functions, negative for other functions */
+      std::vector< double > _quantiles;
+    };
+  }
+}
+
+#endif
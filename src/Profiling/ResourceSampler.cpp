@@ -0,0 +1,368 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <dirent.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <glog/logging.h>
+#include "ResourceSampler.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+const char* profiling::resourceName( Resource resource )
+{
+  static const char* names[ resourceCount ] = { "resident", "heap", "descriptors", "cpu", "read", "written" };
+  return names[ resource ];
+}
+
+const char* profiling::resourceMeasure( Resource resource )
+{
+  static const char* measures[ resourceCount ] = { "bytes", "bytes", "", "cores", "bytes/s", "bytes/s" };
+  return measures[ resource ];
+}
+
+// Cumulative resources are sampled as rates
+static bool cumulative( size_t resource )
+{
+  return resource == cpuUsage || resource == readRate || resource == writeRate;
+}
+
+/*
+ * Reading of /proc
+ */
+
+static void readMemory( double* values, bool* available )
+{
+  std::ifstream stream( "/proc/self/statm" );
+  
+  unsigned long size, resident, shared, text, library, data;
+  if( !( stream >> size >> resident >> shared >> text >> library >> data ) )
+    return;
+  
+  double page( sysconf( _SC_PAGESIZE ) );
+  values[ residentSize ] = resident * page;
+  values[ heapSize ] = data * page;
+  available[ residentSize ] = available[ heapSize ] = true;
+}
+
+static void readDescriptors( double* values, bool* available )
+{
+  DIR* directory( opendir( "/proc/self/fd" ) );
+  if( directory == NULL )
+    return;
+  
+  size_t count( 0 );
+  while( dirent* entry = readdir( directory ) )
+    if( entry->d_name[ 0 ] != '.' )
+      count++;
+  closedir( directory );
+  
+  // Descriptor of directory itself is not counted
+  values[ openDescriptors ] = count - 1;
+  available[ openDescriptors ] = true;
+}
+
+static void readCpu( double* values, bool* available )
+{
+  std::ifstream stream( "/proc/self/stat" );
+  string stat;
+  std::getline( stream, stat );
+  
+  // Name of executable may contain spaces, fields are counted after its closing bracket
+  size_t name( stat.rfind( ')' ) );
+  if( name == string::npos )
+    return;
+  
+  std::istringstream fields( stat.substr( name + 1 ) );
+  string field;
+  for( int i=3; i<14; i++ )
+    fields >> field;
+  
+  unsigned long user, system;
+  if( !( fields >> user >> system ) )
+    return;
+  
+  values[ cpuUsage ] = double( user + system ) / sysconf( _SC_CLK_TCK );
+  available[ cpuUsage ] = true;
+}
+
+static void readIo( double* values, bool* available )
+{
+  std::ifstream stream( "/proc/self/io" );
+  
+  string name;
+  double value;
+  while( stream >> name >> value )
+    if( name == "read_bytes:" )
+    {
+      values[ readRate ] = value;
+      available[ readRate ] = true;
+    }
+    else if( name == "write_bytes:" )
+    {
+      values[ writeRate ] = value;
+      available[ writeRate ] = true;
+    }
+}
+
+// Reads current values of resources, cumulative ones are read as totals
+static void readResources( double* values, bool* available )
+{
+  std::fill( values, values + resourceCount, 0.0 );
+  std::fill( available, available + resourceCount, false );
+  
+  readMemory( values, available );
+  readDescriptors( values, available );
+  readCpu( values, available );
+  readIo( values, available );
+}
+
+/*
+ * ResourceBucket
+ */
+
+ResourceBucket::ResourceBucket( const ResourceSample& sample, long long begin ) : begin( begin ),
+                                                                                 samples( 1 ),
+                                                                                 path( sample.path )
+{
+  std::copy( sample.values, sample.values + resourceCount, minimum );
+  std::copy( sample.values, sample.values + resourceCount, maximum );
+  std::copy( sample.values, sample.values + resourceCount, last );
+}
+
+void ResourceBucket::add( const ResourceSample& sample )
+{
+  merge( ResourceBucket( sample, begin ) );
+}
+
+void ResourceBucket::merge( const ResourceBucket& bucket )
+{
+  for( size_t i=0; i<resourceCount; i++ )
+  {
+    minimum[ i ] = std::min( minimum[ i ], bucket.minimum[ i ] );
+    maximum[ i ] = std::max( maximum[ i ], bucket.maximum[ i ] );
+    last[ i ] = bucket.last[ i ];
+  }
+  
+  samples += bucket.samples;
+  path = bucket.path;
+}
+
+/*
+ * ResourceSampler
+ */
+
+ResourceSampler::ResourceSampler( Profile& profile, double interval, size_t maximalBuckets
+                                ) : _profile( profile ),
+                                    _interval( static_cast< long long >( interval * nanoseconds ) ),
+                                    _maximalBuckets( std::max< size_t >( maximalBuckets, 1 ) ),
+                                    _counted( profile.elapsed() ),
+                                    _running( 1, profile.currentPath() ),
+                                    _currentPath( profile.currentPath() ),
+                                    _bucketWidth( 0 ),
+                                    _buckets(),
+                                    _stop( false ),
+                                    _ended( false )
+{
+  if( _interval <= 0 )
+  {
+    LOG( ERROR ) << "Interval of resource sampling must be positive.";
+    exit( EXIT_FAILURE );
+  }
+  _bucketWidth = _interval;
+  
+  readResources( _counters, _available );
+  
+  pthread_mutex_init( &_lock, NULL );
+  pthread_cond_init( &_stopRequested, NULL );
+  
+  _profile.addListener( this );
+  if( pthread_create( &_thread, NULL, run, this ) != 0 )
+  {
+    LOG( ERROR ) << "Cannot create resource sampling thread.";
+    exit( EXIT_FAILURE );
+  }
+}
+
+ResourceSampler::~ResourceSampler()
+{
+  if( !_ended )
+    end();
+  
+  pthread_cond_destroy( &_stopRequested );
+  pthread_mutex_destroy( &_lock );
+}
+
+void* ResourceSampler::run( void* data )
+{
+  ResourceSampler& sampler( *static_cast< ResourceSampler* >( data ) );
+  
+  for(;;)
+  {
+    timespec deadline;
+    clock_gettime( CLOCK_REALTIME, &deadline );
+    long long nanosecond( deadline.tv_nsec + sampler._interval );
+    deadline.tv_sec += nanosecond / nanoseconds;
+    deadline.tv_nsec = nanosecond % nanoseconds;
+    
+    pthread_mutex_lock( &sampler._lock );
+    while( !sampler._stop && pthread_cond_timedwait( &sampler._stopRequested, &sampler._lock, &deadline ) != ETIMEDOUT )
+      ;
+    bool stop( sampler._stop );
+    pthread_mutex_unlock( &sampler._lock );
+    
+    if( stop )
+      break;
+    sampler.sample();
+  }
+  
+  return NULL;
+}
+
+void ResourceSampler::sample()
+{
+  ResourceSample sample;
+  bool available[ resourceCount ];
+  readResources( sample.values, available );
+  sample.time = _profile.elapsed();
+  sample.path = _currentPath;
+  
+  pthread_mutex_lock( &_lock );
+  
+  double seconds( double( sample.time - _counted ) / nanoseconds );
+  for( size_t i=0; i<resourceCount; i++ )
+    if( cumulative( i ) )
+    {
+      double total( sample.values[ i ] );
+      sample.values[ i ] = seconds > 0.0 ? std::max( total - _counters[ i ], 0.0 ) / seconds : 0.0;
+      _counters[ i ] = total;
+    }
+  _counted = sample.time;
+  
+  long long begin( sample.time - sample.time % _bucketWidth );
+  if( !_buckets.empty() && _buckets.back().begin == begin )
+    _buckets.back().add( sample );
+  else
+    _buckets.push_back( ResourceBucket( sample, begin ) );
+  
+  while( _buckets.size() > _maximalBuckets )
+  {
+    _bucketWidth *= 2;
+    
+    vector< ResourceBucket > merged;
+    for( size_t i=0; i<_buckets.size(); i++ )
+    {
+      long long begin( _buckets[ i ].begin - _buckets[ i ].begin % _bucketWidth );
+      if( !merged.empty() && merged.back().begin == begin )
+	merged.back().merge( _buckets[ i ] );
+      else
+      {
+	merged.push_back( _buckets[ i ] );
+	merged.back().begin = begin;
+      }
+    }
+    _buckets.swap( merged );
+  }
+  
+  pthread_mutex_unlock( &_lock );
+}
+
+bool ResourceSampler::available( Resource resource ) const
+{
+  return _available[ resource ];
+}
+
+long long ResourceSampler::bucketWidth() const
+{
+  pthread_mutex_lock( &_lock );
+  long long ret( _bucketWidth );
+  pthread_mutex_unlock( &_lock );
+  
+  return ret;
+}
+
+vector< ResourceBucket > ResourceSampler::buckets() const
+{
+  pthread_mutex_lock( &_lock );
+  vector< ResourceBucket > ret( _buckets );
+  pthread_mutex_unlock( &_lock );
+  
+  return ret;
+}
+
+void ResourceSampler::end()
+{
+  if( _ended )
+  {
+    LOG( ERROR ) << "Resource sampler ended twice.";
+    exit( EXIT_FAILURE );
+  }
+  _ended = true;
+  
+  pthread_mutex_lock( &_lock );
+  _stop = true;
+  pthread_cond_signal( &_stopRequested );
+  pthread_mutex_unlock( &_lock );
+  pthread_join( _thread, NULL );
+  
+  _profile.removeListener( this );
+  sample();
+  
+  _profile.beginLoop( "resources" );
+  for( size_t i=0; i<_buckets.size(); i++ )
+  {
+    const ResourceBucket& bucket( _buckets[ i ] );
+    
+    Phase::ValueList values;
+    values.push_back( std::make_pair( string( "phase" ), Value( _profile.pathName( bucket.path ) ) ) );
+    values.push_back( std::make_pair( string( "samples" ), Value( bucket.samples ) ) );
+    for( size_t j=0; j<resourceCount; j++ )
+    {
+      if( !_available[ j ] )
+	continue;
+      
+      string name( resourceName( Resource( j ) ) );
+      string measure( resourceMeasure( Resource( j ) ) );
+      values.push_back( std::make_pair( name + " minimum", Value( bucket.minimum[ j ], measure ) ) );
+      values.push_back( std::make_pair( name + " maximum", Value( bucket.maximum[ j ], measure ) ) );
+      values.push_back( std::make_pair( name + " last", Value( bucket.last[ j ], measure ) ) );
+    }
+    
+    _profile.addIteration( static_cast< long >( bucket.begin ), _bucketWidth, values );
+  }
+  _profile.endLoop();
+}
+
+void ResourceSampler::iterationBegan( const Profile&, size_t path )
+{
+  _running.push_back( path );
+  _currentPath = path;
+}
+
+void ResourceSampler::iterationEnded( const Profile&, size_t, long long )
+{
+  if( _running.size() > 1 )
+    _running.pop_back();
+  _currentPath = _running.back();
+}
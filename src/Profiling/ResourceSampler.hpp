@@ -0,0 +1,152 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_RESOURCE_SAMPLER_HPP
+#define BURNING_PROFILING_RESOURCE_SAMPLER_HPP
+
+#include <pthread.h>
+#include <vector>
+#include "Listener.hpp"
+#include "Profile.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Resources of process observed by sampler */
+    enum Resource
+    {
+      /*! Resident set size in bytes */
+      residentSize,
+      /*! Size of data segment including heap in bytes */
+      heapSize,
+      /*! Count of open file descriptors */
+      openDescriptors,
+      /*! Processor time used per second of wall time */
+      cpuUsage,
+      /*! Bytes read from storage per second */
+      readRate,
+      /*! Bytes written to storage per second */
+      writeRate,
+      resourceCount
+    };
+    
+    /*! Name of resource in values of samples */
+    const char* resourceName( Resource resource );
+    /*! Measure of resource */
+    const char* resourceMeasure( Resource resource );
+    
+    /*! A sample of resources */
+    struct ResourceSample
+    {
+      /*! Time in nanoseconds since profile began */
+      long long time;
+      /*! Path id of innermost phase with iteration in progress */
+      size_t path;
+      double values[ resourceCount ];
+    };
+    
+    /*! Samples of resources falling into an interval of profile's timeline */
+    struct ResourceBucket
+    {
+      /*! Bucket for first sample */
+      ResourceBucket( const ResourceSample& sample, long long begin );
+      
+      void add( const ResourceSample& sample );
+      /*! Adds samples of later bucket */
+      void merge( const ResourceBucket& bucket );
+      
+      /*! Begin of interval in nanoseconds since profile began */
+      long long begin;
+      size_t samples;
+      /*! Path id of phase running at last sample */
+      size_t path;
+      
+      double minimum[ resourceCount ];
+      double maximum[ resourceCount ];
+      double last[ resourceCount ];
+    };
+    
+    /*! Samples resident size, heap, open descriptors, processor and storage usage of process in background thread.
+     *  Samples are read from /proc/self at given interval and kept downsampled in buckets: when there are more
+     *  buckets than allowed neighbouring ones are merged and bucket width doubles, so memory is bounded for any run.
+     *  Sampler listens to profile to know the innermost phase whose iteration is in progress, so samples taken
+     *  between iterations of a loop belong to the enclosing phase like on phase timelines.
+     */
+    class ResourceSampler : public Listener
+    {
+    public:
+      /*! Starts sampling thread.
+       *\param interval Interval between samples in seconds
+       *\param maximalBuckets Count of kept buckets
+       */
+      ResourceSampler( Profile& profile, double interval = 1.0, size_t maximalBuckets = 1024 );
+      /*! Ends sampler if it was not ended */
+      ~ResourceSampler();
+      
+      /*! Takes sample immediately */
+      void sample();
+      
+      /*! True if resource can be read on this system. Unavailable resources are not recorded. */
+      bool available( Resource resource ) const;
+      /*! Width of buckets in nanoseconds */
+      long long bucketWidth() const;
+      /*! Downsampled samples ordered by time */
+      std::vector< ResourceBucket > buckets() const;
+      
+      /*! Stops sampling and adds buckets as iterations of loop "resources" in profile's current phase.
+       *  Iterations are named by begin of bucket in nanoseconds since profile began, like times of tasks,
+       *  and have minimal, maximal and last values of resources and the phase sampled last.
+       *  Must be called on profile's thread.
+       */
+      void end();
+      
+      void iterationBegan( const Profile& profile, size_t path );
+      void iterationEnded( const Profile& profile, size_t path, long long duration );
+      
+    private:
+      ResourceSampler( const ResourceSampler& );
+      void operator=( const ResourceSampler& );
+      
+      static void* run( void* sampler );
+      
+      Profile& _profile;
+      long long _interval;
+      size_t _maximalBuckets;
+      
+      bool _available[ resourceCount ];
+      /*! Processor time and transferred bytes at previous sample for rates */
+      double _counters[ resourceCount ];
+      long long _counted;
+      
+      /*! Paths of phases with iterations in progress, changed only by profile's thread */
+      std::vector< size_t > _running;
+      /*! Last of running paths published for sampling thread */
+      volatile size_t _currentPath;
+      
+      long long _bucketWidth;
+      std::vector< ResourceBucket > _buckets;
+      
+      mutable pthread_mutex_t _lock;
+      pthread_cond_t _stopRequested;
+      pthread_t _thread;
+      bool _stop;
+      bool _ended;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,292 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <boost/foreach.hpp>
+#include "Query.hpp"
+#include "Statistics.hpp"
+#include "Table.hpp"
+#include "Scaling.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+string Scaling::complexityName( Complexity complexity )
+{
+  switch( complexity )
+  {
+    case constantComplexity:
+      return "O(1)";
+    case logarithmicComplexity:
+      return "O(log n)";
+    case linearComplexity:
+      return "O(n)";
+    case linearithmicComplexity:
+      return "O(n log n)";
+    case quadraticComplexity:
+      return "O(n^2)";
+    case cubicComplexity:
+      return "O(n^3)";
+  }
+
+  return "";
+}
+
+static double binaryLogarithm( double value )
+{
+  return std::log( value ) / std::log( 2.0 );
+}
+
+double Scaling::complexityFunction( Complexity complexity, double size )
+{
+  switch( complexity )
+  {
+    case constantComplexity:
+      return 1.0;
+    case logarithmicComplexity:
+      return binaryLogarithm( size );
+    case linearComplexity:
+      return size;
+    case linearithmicComplexity:
+      return size * binaryLogarithm( size );
+    case quadraticComplexity:
+      return size * size;
+    case cubicComplexity:
+      return size * size * size;
+  }
+
+  return 0.0;
+}
+
+Scaling::Fit Scaling::fit( const vector< double >& sizes, const vector< double >& values, Complexity complexity )
+{
+  Fit ret;
+  ret.complexity = complexity;
+  ret.factor = 0.0;
+  ret.error = 0.0;
+
+  // Minimizes sum of ( ( value - factor * f ) / value )^2
+  double numerator( 0.0 );
+  double denominator( 0.0 );
+  for( size_t i=0; i<sizes.size(); i++ )
+  {
+    double ratio( complexityFunction( complexity, sizes[ i ] ) / values[ i ] );
+    numerator += ratio;
+    denominator += ratio * ratio;
+  }
+  if( denominator > 0.0 )
+    ret.factor = numerator / denominator;
+
+  double squares( 0.0 );
+  for( size_t i=0; i<sizes.size(); i++ )
+  {
+    double residual( ( values[ i ] - ret.factor * complexityFunction( complexity, sizes[ i ] ) ) / values[ i ] );
+    ret.residuals.push_back( residual );
+    squares += residual * residual;
+  }
+  if( !sizes.empty() )
+    ret.error = std::sqrt( squares / sizes.size() );
+
+  return ret;
+}
+
+const Scaling::Fit& Scaling::Curve::bestFit() const
+{
+  return fits[ best ];
+}
+
+Scaling::Scaling( Profile& profile ) : _profile( profile ),
+                                       _value( "time" ),
+                                       _minimalSizes( 3 ),
+                                       _curves(),
+                                       _fitted( false )
+{
+}
+
+string& Scaling::value()
+{
+  _fitted = false;
+  return _value;
+}
+
+size_t& Scaling::minimalSizes()
+{
+  _fitted = false;
+  return _minimalSizes;
+}
+
+void Scaling::collect( PathMap& samples )
+{
+  ProfileIndex index( _profile );
+  BOOST_FOREACH( const ProfileIndex::Path& path, index.paths() )
+  {
+    std::map< string, vector< double > >::const_iterator column( path.values.find( _value ) );
+    if( column == path.values.end() )
+      continue;
+
+    // Rows of a loop are consecutive, its sizes are used only if all its iterations are numbered
+    for( size_t first=0, last=0; first<path.iterations.size(); first=last )
+    {
+      const Phase& phase( *path.iterations[ first ].first );
+      for( last=first; last<path.iterations.size() && path.iterations[ last ].first == &phase; last++ )
+	;
+
+      vector< double > sizes;
+      try
+      {
+	for( size_t i=first; i<last; i++ )
+	  sizes.push_back( phase.iterations()[ path.iterations[ i ].second ].as< double >() );
+      }
+      catch( const boost::bad_lexical_cast& )
+      {
+	continue;
+      }
+
+      Samples& pathSamples( samples[ path.path ] );
+      pathSamples.measure = path.measures.count( _value ) > 0 ? path.measures.find( _value )->second : "";
+      for( size_t i=first; i<last; i++ )
+      {
+	double number( column->second[ i ] );
+	if( sizes[ i - first ] > 0.0 && number > 0.0 )
+	  pathSamples.values[ sizes[ i - first ] ].push_back( number );
+      }
+    }
+  }
+}
+
+void Scaling::fitCurves()
+{
+  PathMap samples;
+  collect( samples );
+
+  _curves.clear();
+
+  for( PathMap::const_iterator path = samples.begin(); path != samples.end(); ++path )
+  {
+    if( path->second.values.size() < _minimalSizes || path->second.values.empty() )
+      continue;
+
+    Curve curve;
+    curve.path = path->first;
+    curve.measure = path->second.measure;
+    for( SampleMap::const_iterator size = path->second.values.begin(); size != path->second.values.end(); ++size )
+    {
+      curve.sizes.push_back( size->first );
+      curve.values.push_back( statistics::median( size->second ) );
+    }
+
+    curve.best = 0;
+    for( int complexity = constantComplexity; complexity <= cubicComplexity; complexity++ )
+    {
+      curve.fits.push_back( fit( curve.sizes, curve.values, static_cast< Complexity >( complexity ) ) );
+      if( curve.fits.back().error < curve.fits[ curve.best ].error )
+	curve.best = curve.fits.size() - 1;
+    }
+
+    _curves.push_back( curve );
+  }
+
+  _fitted = true;
+}
+
+const Scaling::CurveVector& Scaling::curves()
+{
+  if( !_fitted )
+    fitCurves();
+
+  return _curves;
+}
+
+void Scaling::toTable( Table* table )
+{
+  table->column( 0 ).name() = "loop";
+  table->column( 1 ).name() = "sizes";
+  table->column( 2 ).name() = "complexity";
+  table->column( 3 ).name() = "factor";
+  table->column( 4 ).name() = "error";
+  table->column( 5 ).name() = "next";
+  table->column( 6 ).name() = "next error";
+
+  BOOST_FOREACH( const Curve& curve, curves() )
+  {
+    const Fit& best( curve.bestFit() );
+
+    // The second best model shows how clearly the best one wins
+    size_t next( curve.best == 0 ? 1 : 0 );
+    for( size_t i=0; i<curve.fits.size(); i++ )
+      if( i != curve.best && curve.fits[ i ].error < curve.fits[ next ].error )
+	next = i;
+
+    Table::RowProxy row( table->newRow() );
+    row.pushBack( curve.path );
+    row.pushBack( curve.sizes.size() );
+    row.pushBack( complexityName( best.complexity ) );
+    row.pushBack( Value( best.factor, curve.measure ) );
+    row.pushBack( best.error );
+    row.pushBack( complexityName( curve.fits[ next ].complexity ) );
+    row.pushBack( curve.fits[ next ].error );
+  }
+}
+
+static void printTitle( std::ostream& ostream, const string& title, bool html )
+{
+  if( html )
+    ostream << "<h3>" << title << "</h3>" << std::endl;
+  else
+    ostream << std::endl << title << std::endl;
+}
+
+static void printTable( std::ostream& ostream, Table& table, bool html )
+{
+  if( html )
+    table.printHtml( ostream );
+  else
+    table.print( ostream );
+}
+
+void Scaling::print( std::ostream& ostream, bool html )
+{
+  Table table;
+  toTable( &table );
+
+  printTitle( ostream, "Scaling of loops", html );
+  printTable( ostream, table, html );
+
+  BOOST_FOREACH( const Curve& curve, curves() )
+  {
+    const Fit& best( curve.bestFit() );
+
+    Table residuals;
+    residuals.column( 0 ).name() = "size";
+    residuals.column( 1 ).name() = _value;
+    residuals.column( 2 ).name() = "fitted";
+    residuals.column( 3 ).name() = "residual";
+
+    for( size_t i=0; i<curve.sizes.size(); i++ )
+    {
+      Table::RowProxy row( residuals.newRow() );
+      row.pushBack( curve.sizes[ i ] );
+      row.pushBack( Value( curve.values[ i ], curve.measure ) );
+      row.pushBack( Value( best.factor * complexityFunction( best.complexity, curve.sizes[ i ] ), curve.measure ) );
+      row.pushBack( best.residuals[ i ] );
+    }
+
+    printTitle( ostream, "Residuals of " + curve.path + " by " + complexityName( best.complexity ), html );
+    printTable( ostream, residuals, html );
+  }
+}
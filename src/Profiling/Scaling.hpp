@@ -0,0 +1,132 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_SCALING_HPP
+#define BURNING_PROFILING_SCALING_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "Profile.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Fits scaling curves of loops keyed by problem size.
+     *  Loops whose iteration names are all numbers are treated as curves with iteration names
+     *  on x-axis. Samples of a value (time by default) with the same size are reduced to their median
+     *  and fitted against complexity models as value = factor * f( size ).
+     *  Factor is chosen to minimize relative residuals so small and large sizes weight equally.
+     */
+    class Scaling
+    {
+    public:
+      /*! Candidate complexity models */
+      enum Complexity
+      {
+	constantComplexity,
+	logarithmicComplexity,
+	linearComplexity,
+	linearithmicComplexity,
+	quadraticComplexity,
+	cubicComplexity
+      };
+
+      /*! Name of complexity model like "O(n log n)" */
+      static std::string complexityName( Complexity complexity );
+      /*! Value of complexity model's function for size */
+      static double complexityFunction( Complexity complexity, double size );
+
+      /*! Fit of a curve by one model */
+      struct Fit
+      {
+	Complexity complexity;
+	/*! Constant factor of model */
+	double factor;
+	/*! Root mean square of relative residuals */
+	double error;
+	/*! Relative residuals (value - fitted) / value for every size */
+	std::vector< double > residuals;
+      };
+
+      /*! Fits values measured for sizes by complexity model. Values must be positive. */
+      static Fit fit( const std::vector< double >& sizes, const std::vector< double >& values, Complexity complexity );
+
+      /*! Scaling curve of a loop */
+      struct Curve
+      {
+	/*! Name path of loop */
+	std::string path;
+	/*! Measure of fitted values */
+	std::string measure;
+
+	/*! Distinct sizes in increasing order */
+	std::vector< double > sizes;
+	/*! Median value for every size */
+	std::vector< double > values;
+
+	/*! Fits by all models in order of Complexity */
+	std::vector< Fit > fits;
+	/*! Index of fit with the least error */
+	size_t best;
+
+	const Fit& bestFit() const;
+      };
+      typedef std::vector< Curve > CurveVector;
+
+      /*! Constructs analysis of profile's loops */
+      Scaling( Profile& profile );
+
+      /*! Name of fitted value. "time" by default */
+      std::string& value();
+      /*! Minimal count of distinct sizes needed for fitting. 3 by default */
+      size_t& minimalSizes();
+
+      /*! Fits curves of all loops having enough numeric sizes */
+      const CurveVector& curves();
+
+      /*! Writes best fits of curves to table */
+      void toTable( profiling::Table* table );
+      /*! Prints best fits and residuals of curves */
+      void print( std::ostream& ostream = std::cout, bool html = false );
+
+    private:
+      typedef std::map< double, std::vector< double > > SampleMap;
+      struct Samples
+      {
+	SampleMap values;
+	std::string measure;
+      };
+      typedef std::map< std::string, Samples > PathMap;
+
+      /*! Collects numeric values of loops with numeric iterations from profile's index */
+      void collect( PathMap& samples );
+      void fitCurves();
+
+      Profile& _profile;
+
+      std::string _value;
+      size_t _minimalSizes;
+
+      CurveVector _curves;
+      bool _fitted;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,325 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <boost/foreach.hpp>
+#include "Statistics.hpp"
+
+using std::vector;
+using namespace burning::profiling;
+using namespace burning::profiling::statistics;
+
+vector< double > statistics::toDoubles( const vector< Value >& values )
+{
+  vector< double > ret;
+  ret.reserve( values.size() );
+
+  BOOST_FOREACH( const Value& value, values )
+  {
+    try
+    {
+      ret.push_back( value.value().as< double >() );
+    }
+    catch( const boost::bad_lexical_cast& )
+    {
+    }
+  }
+
+  return ret;
+}
+
+double statistics::mean( const vector< double >& values )
+{
+  if( values.empty() )
+    return 0.0;
+
+  double sum( 0.0 );
+  BOOST_FOREACH( double value, values )
+    sum += value;
+
+  return sum / values.size();
+}
+
+double statistics::standardDeviation( const vector< double >& values )
+{
+  if( values.size() < 2 )
+    return 0.0;
+
+  double average( mean( values ) );
+  double sum( 0.0 );
+  BOOST_FOREACH( double value, values )
+    sum += ( value - average ) * ( value - average );
+
+  return std::sqrt( sum / ( values.size() - 1 ) );
+}
+
+double statistics::median( vector< double > values )
+{
+  return quantile( values, 0.5 );
+}
+
+double statistics::quantile( vector< double > values, double q )
+{
+  if( values.empty() )
+    return 0.0;
+
+  q = std::max( 0.0, std::min( 1.0, q ) );
+
+  double position( q * ( values.size() - 1 ) );
+  size_t lower( static_cast< size_t >( std::floor( position ) ) );
+  size_t upper( static_cast< size_t >( std::ceil( position ) ) );
+
+  std::nth_element( values.begin(), values.begin() + lower, values.end() );
+  double lowerValue( values[ lower ] );
+  if( lower == upper )
+    return lowerValue;
+
+  double upperValue( *std::min_element( values.begin() + upper, values.end() ) );
+  return lowerValue + ( upperValue - lowerValue ) * ( position - lower );
+}
+
+double statistics::normalCdf( double x )
+{
+  return 0.5 * erfc( -x / std::sqrt( 2.0 ) );
+}
+
+double statistics::normalQuantile( double p )
+{
+  // Acklam's rational approximation, relative error is less than 1.15e-9
+  static const double a[] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+			      1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+  static const double b[] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+			      6.680131188771972e+01, -1.328068155288572e+01 };
+  static const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+			      -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+  static const double d[] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+			      3.754408661907416e+00 };
+
+  if( p <= 0.0 )
+    return -HUGE_VAL;
+  if( p >= 1.0 )
+    return HUGE_VAL;
+
+  if( p < 0.02425 )
+  {
+    double q( std::sqrt( -2 * std::log( p ) ) );
+    return ( ( ( ( ( c[ 0 ] * q + c[ 1 ] ) * q + c[ 2 ] ) * q + c[ 3 ] ) * q + c[ 4 ] ) * q + c[ 5 ] ) /
+           ( ( ( ( d[ 0 ] * q + d[ 1 ] ) * q + d[ 2 ] ) * q + d[ 3 ] ) * q + 1 );
+  }
+  if( p > 1 - 0.02425 )
+    return -normalQuantile( 1 - p );
+
+  double q( p - 0.5 );
+  double r( q * q );
+  return ( ( ( ( ( a[ 0 ] * r + a[ 1 ] ) * r + a[ 2 ] ) * r + a[ 3 ] ) * r + a[ 4 ] ) * r + a[ 5 ] ) * q /
+         ( ( ( ( ( b[ 0 ] * r + b[ 1 ] ) * r + b[ 2 ] ) * r + b[ 3 ] ) * r + b[ 4 ] ) * r + 1 );
+}
+
+// Continued fraction of regularized incomplete beta function, evaluated by modified Lentz's method
+static double betaFraction( double a, double b, double x )
+{
+  static const double tiny( 1e-300 );
+
+  double c( 1.0 );
+  double d( 1.0 - ( a + b ) * x / ( a + 1.0 ) );
+  d = 1.0 / ( std::fabs( d ) < tiny ? tiny : d );
+  double ret( d );
+
+  for( int m=1; m<=300; m++ )
+  {
+    double even( m * ( b - m ) * x / ( ( a + 2 * m - 1 ) * ( a + 2 * m ) ) );
+    d = 1.0 + even * d;
+    d = 1.0 / ( std::fabs( d ) < tiny ? tiny : d );
+    c = 1.0 + even / c;
+    c = std::fabs( c ) < tiny ? tiny : c;
+    ret *= d * c;
+
+    double odd( -( a + m ) * ( a + b + m ) * x / ( ( a + 2 * m ) * ( a + 2 * m + 1 ) ) );
+    d = 1.0 + odd * d;
+    d = 1.0 / ( std::fabs( d ) < tiny ? tiny : d );
+    c = 1.0 + odd / c;
+    c = std::fabs( c ) < tiny ? tiny : c;
+    double delta( d * c );
+    ret *= delta;
+
+    if( std::fabs( delta - 1.0 ) < 1e-15 )
+      break;
+  }
+
+  return ret;
+}
+
+// Regularized incomplete beta function
+static double incompleteBeta( double a, double b, double x )
+{
+  if( x <= 0.0 )
+    return 0.0;
+  if( x >= 1.0 )
+    return 1.0;
+
+  double front( std::exp( lgamma( a + b ) - lgamma( a ) - lgamma( b ) + a * std::log( x ) + b * std::log( 1.0 - x ) ) );
+  if( x < ( a + 1.0 ) / ( a + b + 2.0 ) )
+    return front * betaFraction( a, b, x ) / a;
+
+  return 1.0 - front * betaFraction( b, a, 1.0 - x ) / b;
+}
+
+double statistics::studentCdf( double t, double degrees )
+{
+  double tail( 0.5 * incompleteBeta( degrees / 2, 0.5, degrees / ( degrees + t * t ) ) );
+  return t > 0.0 ? 1.0 - tail : tail;
+}
+
+double statistics::studentQuantile( double p, double degrees )
+{
+  if( p <= 0.0 )
+    return -HUGE_VAL;
+  if( p >= 1.0 )
+    return HUGE_VAL;
+
+  // Bisection, t distribution is wider than normal one
+  double lower( -1.0 );
+  double upper( 1.0 );
+  while( studentCdf( lower, degrees ) > p )
+    lower *= 2;
+  while( studentCdf( upper, degrees ) < p )
+    upper *= 2;
+
+  for( int i=0; i<200 && upper - lower > 1e-12 * std::max( 1.0, std::fabs( upper ) ); i++ )
+  {
+    double middle( ( lower + upper ) / 2 );
+    if( studentCdf( middle, degrees ) < p )
+      lower = middle;
+    else
+      upper = middle;
+  }
+
+  return ( lower + upper ) / 2;
+}
+
+RankTest statistics::mannWhitney( const vector< double >& first, const vector< double >& second )
+{
+  RankTest ret;
+  ret.u = 0.0;
+  ret.z = 0.0;
+  ret.pValue = 1.0;
+  ret.effect = 0.0;
+
+  size_t n1( first.size() );
+  size_t n2( second.size() );
+  if( n1 == 0 || n2 == 0 )
+    return ret;
+
+  // Pairs of value and sample number
+  vector< std::pair< double, int > > all;
+  all.reserve( n1 + n2 );
+  BOOST_FOREACH( double value, first )
+    all.push_back( std::make_pair( value, 0 ) );
+  BOOST_FOREACH( double value, second )
+    all.push_back( std::make_pair( value, 1 ) );
+  std::sort( all.begin(), all.end() );
+
+  double secondRanks( 0.0 );
+  double ties( 0.0 );
+  for( size_t i=0; i<all.size(); )
+  {
+    size_t j( i );
+    while( j < all.size() && all[ j ].first == all[ i ].first )
+      j++;
+
+    double rank( ( i + 1 + j ) / 2.0 );
+    for( size_t k=i; k<j; k++ )
+      if( all[ k ].second == 1 )
+	secondRanks += rank;
+
+    double count( j - i );
+    ties += count * count * count - count;
+    i = j;
+  }
+
+  double n( n1 + n2 );
+  ret.u = secondRanks - n2 * ( n2 + 1 ) / 2.0;
+  ret.effect = 2.0 * ret.u / ( double( n1 ) * n2 ) - 1.0;
+
+  double sigma( std::sqrt( n1 * double( n2 ) / 12.0 * ( n + 1 - ties / ( n * ( n - 1 ) ) ) ) );
+  if( sigma == 0.0 )
+    return ret;
+
+  double difference( ret.u - n1 * double( n2 ) / 2.0 );
+  // Continuity correction
+  if( difference > 0.5 )
+    difference -= 0.5;
+  else if( difference < -0.5 )
+    difference += 0.5;
+  else
+    difference = 0.0;
+
+  ret.z = difference / sigma;
+  ret.pValue = std::min( 1.0, 2.0 * normalCdf( -std::fabs( ret.z ) ) );
+  return ret;
+}
+
+static void resample( const vector< double >& values, vector< double >& sample, unsigned int& seed )
+{
+  for( size_t i=0; i<sample.size(); i++ )
+    sample[ i ] = values[ rand_r( &seed ) % values.size() ];
+}
+
+Interval statistics::bootstrapMedianRatio( const vector< double >& first, const vector< double >& second,
+					   double confidence, size_t resamples, unsigned int seed )
+{
+  Interval ret;
+  if( first.empty() || second.empty() || resamples == 0 )
+    return ret;
+
+  vector< double > ratios;
+  ratios.reserve( resamples );
+
+  vector< double > firstSample( first.size() );
+  vector< double > secondSample( second.size() );
+  for( size_t i=0; i<resamples; i++ )
+  {
+    resample( first, firstSample, seed );
+    resample( second, secondSample, seed );
+
+    double base( median( firstSample ) );
+    if( base != 0.0 )
+      ratios.push_back( median( secondSample ) / base );
+  }
+
+  ret.lower = quantile( ratios, ( 1.0 - confidence ) / 2 );
+  ret.upper = quantile( ratios, ( 1.0 + confidence ) / 2 );
+  return ret;
+}
+
+Interval statistics::meanInterval( const vector< double >& values, double confidence )
+{
+  Interval ret;
+  if( values.empty() )
+    return ret;
+
+  double average( mean( values ) );
+  double width( 0.0 );
+  if( values.size() > 1 )
+    width = studentQuantile( ( 1.0 + confidence ) / 2, values.size() - 1.0 ) * standardDeviation( values ) /
+            std::sqrt( double( values.size() ) );
+
+  ret.lower = average - width;
+  ret.upper = average + width;
+  return ret;
+}
@@ -0,0 +1,101 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_STATISTICS_HPP
+#define BURNING_PROFILING_STATISTICS_HPP
+
+#include <vector>
+#include "Value.hpp"
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Statistical functions used for analysis of profiling results */
+    namespace statistics
+    {
+      /*! Converts numeric values to doubles. Non numeric values are skipped. */
+      std::vector< double > toDoubles( const std::vector< Value >& values );
+
+      /*! Arithmetic mean of values */
+      double mean( const std::vector< double >& values );
+      /*! Sample standard deviation of values */
+      double standardDeviation( const std::vector< double >& values );
+      /*! Median of values */
+      double median( std::vector< double > values );
+      /*! Quantile of values, q is in [0, 1] */
+      double quantile( std::vector< double > values, double q );
+
+      /*! Standard normal cumulative distribution function */
+      double normalCdf( double x );
+      /*! Inverse of standard normal cumulative distribution function */
+      double normalQuantile( double p );
+      /*! Cumulative distribution function of Student's t distribution with given degrees of freedom */
+      double studentCdf( double t, double degrees );
+      /*! Inverse of cumulative distribution function of Student's t distribution */
+      double studentQuantile( double p, double degrees );
+
+      /*! A confidence interval */
+      struct Interval
+      {
+	Interval() : lower( 0.0 ),
+	             upper( 0.0 )
+	{
+	}
+
+	/*! Checks that interval contains value */
+	bool contains( double value ) const
+	{
+	  return lower <= value && value <= upper;
+	}
+
+	double lower;
+	double upper;
+      };
+
+      /*! Result of Mann-Whitney U test */
+      struct RankTest
+      {
+	/*! U statistic for second sample */
+	double u;
+	/*! Normal approximation of U statistic */
+	double z;
+	/*! Two sided p-value */
+	double pValue;
+	/*! Cliff's delta. Positive when second sample tends to be greater */
+	double effect;
+      };
+
+      /*! Mann-Whitney U test with tie correction */
+      RankTest mannWhitney( const std::vector< double >& first, const std::vector< double >& second );
+
+      /*! Bootstrap confidence interval for ratio of second sample median to first sample median.
+       *\param confidence A confidence level of interval, e.g. 0.95
+       *\param resamples A count of bootstrap resamples
+       *\param seed A seed of pseudo random generator, same seed gives same interval
+       */
+      Interval bootstrapMedianRatio( const std::vector< double >& first, const std::vector< double >& second,
+				     double confidence = 0.95, size_t resamples = 1000, unsigned int seed = 1 );
+
+      /*! Confidence interval for mean of values using Student's t distribution with n-1 degrees of freedom.
+       *  Less than two values give an empty interval at their mean.
+       */
+      Interval meanInterval( const std::vector< double >& values, double confidence = 0.95 );
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,104 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+#include <Profiling/Benchmark.hpp>
+
+using namespace burning;
+using namespace burning::profiling;
+
+static int counter = 0;
+
+static void increment()
+{
+  counter++;
+  doNotOptimize( counter );
+}
+
+class BenchmarkTest : public testing::Test
+{
+public:
+  void SetUp();
+  
+  Profile profile;
+  BenchmarkSuite suite;
+};
+
+void BenchmarkTest::SetUp()
+{
+  counter = 0;
+}
+
+TEST_F( BenchmarkTest, Run )
+{
+  Benchmark& benchmark( suite.add( "increment", increment ) );
+  benchmark.warmupTime() = 0.001;
+  benchmark.repetitionTime() = 0.001;
+  benchmark.repetitions() = 3;
+  
+  suite.run( profile );
+  
+  ASSERT_EQ( profile.rootPhase().phases().count( "increment" ), 1 );
+  const Phase& loop( *profile.rootPhase().phases().find( "increment" )->second[ 0 ] );
+  
+  EXPECT_EQ( loop.iterations().size(), 3 );
+  ASSERT_EQ( loop.values().count( "calls" ), 1 );
+  ASSERT_EQ( loop.values().count( "call time" ), 1 );
+  EXPECT_EQ( loop.values().find( "call time" )->second[ 0 ].measure(), "ns" );
+  EXPECT_EQ( loop.values().find( "calls" )->second[ 0 ].value(), suite.benchmarks()[ 0 ].calls() );
+}
+
+TEST_F( BenchmarkTest, CallsScaling )
+{
+  Benchmark benchmark( "increment", increment );
+  benchmark.warmupTime() = 0.0;
+  benchmark.repetitionTime() = 0.002;
+  benchmark.repetitions() = 1;
+  
+  benchmark.run( profile );
+  
+  EXPECT_GT( benchmark.calls(), 1 );
+  EXPECT_GE( counter, benchmark.calls() );
+}
+
+static void slowIncrement()
+{
+  for( int i=0; i<20; i++ )
+  {
+    counter++;
+    doNotOptimize( counter );
+  }
+}
+
+TEST_F( BenchmarkTest, Paired )
+{
+  PairedBenchmark benchmark( "paired", increment, slowIncrement );
+  benchmark.warmupTime() = 0.001;
+  benchmark.repetitionTime() = 0.001;
+  benchmark.repetitions() = 10;
+  
+  const PairedBenchmark::Result& result( benchmark.run( profile ) );
+  
+  const Phase& loop( *profile.rootPhase().phases().find( "paired" )->second[ 0 ] );
+  EXPECT_EQ( loop.iterations().size(), 10 );
+  EXPECT_EQ( loop.values().count( "first time" ), 1 );
+  EXPECT_EQ( loop.values().count( "second time" ), 1 );
+  EXPECT_EQ( loop.values().count( "order" ), 1 );
+  
+  EXPECT_GT( result.ratio, 1.0 );
+  EXPECT_LE( result.lower, result.ratio );
+  EXPECT_GE( result.upper, result.ratio );
+}
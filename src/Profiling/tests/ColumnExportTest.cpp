@@ -0,0 +1,296 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <gtest/gtest.h>
+#include <boost/lexical_cast.hpp>
+#include <Profiling/ColumnExport.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+/*! Column read back from .npy file */
+struct Npy
+{
+  string type;
+  size_t rows;
+  string data;
+  
+  int64_t integer( size_t row ) const
+  {
+    int64_t ret;
+    memcpy( &ret, data.data() + row * 8, 8 );
+    return ret;
+  }
+  
+  double real( size_t row ) const
+  {
+    double ret;
+    memcpy( &ret, data.data() + row * 8, 8 );
+    return ret;
+  }
+  
+  string text( size_t row ) const
+  {
+    size_t width( data.size() / rows );
+    string ret( data.substr( row * width, width ) );
+    return ret.substr( 0, ret.find( '\0' ) );
+  }
+};
+
+class ColumnExportTest : public testing::Test
+{
+public:
+  ColumnExportTest() : directory( "/tmp/burningColumnExportTest." + boost::lexical_cast< string >( getpid() ) )
+  {
+  }
+  
+  ~ColumnExportTest();
+  
+  Npy read( const string& file );
+  vector< vector< string > > manifest();
+  
+  Profile profile;
+  string directory;
+};
+
+ColumnExportTest::~ColumnExportTest()
+{
+  vector< vector< string > > lines( manifest() );
+  vector< string > directories;
+  for( size_t i=1; i<lines.size(); i++ )
+  {
+    unlink( ( directory + '/' + lines[ i ][ 2 ] ).c_str() );
+    directories.push_back( lines[ i ][ 2 ].substr( 0, lines[ i ][ 2 ].rfind( '/' ) ) );
+  }
+  
+  // Deeper directories are longer
+  std::sort( directories.begin(), directories.end() );
+  for( size_t i=directories.size(); i>0; i-- )
+    rmdir( ( directory + '/' + directories[ i - 1 ] ).c_str() );
+  
+  unlink( ( directory + "/columns.tsv" ).c_str() );
+  rmdir( directory.c_str() );
+}
+
+Npy ColumnExportTest::read( const string& file )
+{
+  std::ifstream stream( ( directory + '/' + file ).c_str(), std::ios::binary );
+  std::ostringstream content;
+  content << stream.rdbuf();
+  string bytes( content.str() );
+  
+  Npy ret;
+  ret.rows = 0;
+  EXPECT_GE( bytes.size(), 10 );
+  if( bytes.size() < 10 )
+    return ret;
+  
+  EXPECT_EQ( bytes.substr( 0, 8 ), string( "\x93NUMPY\x01\x00", 8 ) );
+  size_t headerSize( static_cast< unsigned char >( bytes[ 8 ] ) + 256 * static_cast< unsigned char >( bytes[ 9 ] ) );
+  EXPECT_EQ( ( 10 + headerSize ) % 64, 0 );
+  
+  string header( bytes.substr( 10, headerSize ) );
+  EXPECT_EQ( header[ header.size() - 1 ], '\n' );
+  
+  size_t type( header.find( "'descr': '" ) + 10 );
+  ret.type = header.substr( type, header.find( '\'', type ) - type );
+  size_t shape( header.find( "'shape': (" ) + 10 );
+  ret.rows = boost::lexical_cast< size_t >( header.substr( shape, header.find( ',', shape ) - shape ) );
+  ret.data = bytes.substr( 10 + headerSize );
+  
+  return ret;
+}
+
+vector< vector< string > > ColumnExportTest::manifest()
+{
+  vector< vector< string > > ret;
+  
+  std::ifstream stream( ( directory + "/columns.tsv" ).c_str() );
+  string line;
+  while( std::getline( stream, line ) )
+  {
+    vector< string > fields;
+    std::istringstream fieldStream( line );
+    string field;
+    while( std::getline( fieldStream, field, '\t' ) )
+      fields.push_back( field );
+    ret.push_back( fields );
+  }
+  
+  return ret;
+}
+
+TEST_F( ColumnExportTest, TypedColumns )
+{
+  profile.beginLoop( "requests" );
+  for( int i=0; i<3; i++ )
+  {
+    profile.beginIteration( i == 1 ? string( "post" ) : string( "get" ) );
+    profile.addValue( "bytes", Value( 100 * i, "B" ) );
+    profile.addValue( "ratio", Value( i / 2.0 ) );
+    profile.endMeasuredIteration( 1000 * ( i + 1 ), nanoseconds );
+  }
+  profile.endLoop();
+  
+  ASSERT_TRUE( ColumnExport( profile ).write( directory ) );
+  
+  Npy names( read( "requests/iteration.npy" ) );
+  EXPECT_EQ( names.type, "|S4" );
+  ASSERT_EQ( names.rows, 3 );
+  EXPECT_EQ( names.text( 0 ), "get" );
+  EXPECT_EQ( names.text( 1 ), "post" );
+  
+  Npy bytes( read( "requests/bytes.npy" ) );
+  EXPECT_EQ( bytes.type, "<i8" );
+  ASSERT_EQ( bytes.data.size(), 24 );
+  EXPECT_EQ( bytes.integer( 2 ), 200 );
+  
+  Npy ratio( read( "requests/ratio.npy" ) );
+  EXPECT_EQ( ratio.type, "<f8" );
+  ASSERT_EQ( ratio.data.size(), 24 );
+  EXPECT_DOUBLE_EQ( ratio.real( 1 ), 0.5 );
+  
+  Npy time( read( "requests/time.npy" ) );
+  EXPECT_EQ( time.type, "<i8" );
+  ASSERT_EQ( time.data.size(), 24 );
+  EXPECT_EQ( time.integer( 0 ), 1000 );
+  EXPECT_EQ( time.integer( 2 ), 3000 );
+  
+  vector< vector< string > > lines( manifest() );
+  ASSERT_EQ( lines.size(), 5 );
+  EXPECT_EQ( lines[ 0 ][ 0 ], "path" );
+  EXPECT_EQ( lines[ 1 ][ 1 ], "iteration" );
+  EXPECT_EQ( lines[ 2 ][ 1 ], "bytes" );
+  EXPECT_EQ( lines[ 2 ][ 2 ], "requests/bytes.npy" );
+  EXPECT_EQ( lines[ 2 ][ 4 ], "B" );
+  EXPECT_EQ( lines[ 2 ][ 5 ], "3" );
+  EXPECT_EQ( lines[ 4 ][ 4 ], "ns" );
+}
+
+TEST_F( ColumnExportTest, NestedLoops )
+{
+  profile.beginLoop( "outer" );
+  for( int i=0; i<2; i++ )
+  {
+    profile.beginIteration( i );
+    profile.beginLoop( "inner" );
+    for( int j=0; j<=i; j++ )
+    {
+      profile.beginIteration( j );
+      profile.endIteration();
+    }
+    profile.endLoop();
+    profile.endIteration();
+  }
+  profile.endLoop();
+  
+  ASSERT_TRUE( ColumnExport( profile ).write( directory ) );
+  
+  Npy outer( read( "outer/iteration.npy" ) );
+  EXPECT_EQ( outer.type, "<i8" );
+  EXPECT_EQ( outer.rows, 2 );
+  
+  Npy inner( read( "outer/inner/iteration.npy" ) );
+  ASSERT_EQ( inner.rows, 3 );
+  EXPECT_EQ( inner.integer( 0 ), 0 );
+  EXPECT_EQ( inner.integer( 2 ), 1 );
+  
+  Npy parents( read( "outer/inner/parent.npy" ) );
+  ASSERT_EQ( parents.rows, 3 );
+  EXPECT_EQ( parents.integer( 0 ), 0 );
+  EXPECT_EQ( parents.integer( 1 ), 1 );
+  EXPECT_EQ( parents.integer( 2 ), 1 );
+}
+
+TEST_F( ColumnExportTest, MixedValues )
+{
+  Profile other;
+  profile.beginLoop( "loop" );
+  profile.beginIteration( 0 );
+  profile.addValue( "size", 1 );
+  profile.endIteration();
+  profile.endLoop();
+  
+  other.beginLoop( "loop" );
+  other.beginIteration( 1 );
+  other.addValue( "size", "unknown" );
+  other.endIteration();
+  other.endLoop();
+  profile.merge( other );
+  
+  ASSERT_TRUE( ColumnExport( profile ).write( directory ) );
+  
+  Npy size( read( "loop/size.npy" ) );
+  EXPECT_EQ( size.type, "|S7" );
+  ASSERT_EQ( size.rows, 2 );
+  EXPECT_EQ( size.text( 0 ), "1" );
+  EXPECT_EQ( size.text( 1 ), "unknown" );
+}
+
+TEST_F( ColumnExportTest, ReservedNames )
+{
+  profile.beginLoop( "outer" );
+  profile.beginIteration( "first" );
+  profile.beginLoop( "inner" );
+  for( int i=0; i<2; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addValue( "iteration", Value( 10 + i ) );
+    profile.addValue( "parent", Value( 0.5 ) );
+    profile.addValue( "_parent", Value( "text" ) );
+    profile.endIteration();
+  }
+  profile.endLoop();
+  profile.endIteration();
+  profile.endLoop();
+  
+  ASSERT_TRUE( ColumnExport( profile ).write( directory ) );
+  
+  Npy iterations( read( "outer/inner/iteration.npy" ) );
+  EXPECT_EQ( iterations.type, "<i8" );
+  ASSERT_EQ( iterations.rows, 2 );
+  EXPECT_EQ( iterations.integer( 1 ), 1 );
+  
+  Npy parents( read( "outer/inner/parent.npy" ) );
+  EXPECT_EQ( parents.type, "<i8" );
+  ASSERT_EQ( parents.rows, 2 );
+  EXPECT_EQ( parents.integer( 1 ), 0 );
+  
+  Npy iterationValues( read( "outer/inner/_iteration.npy" ) );
+  ASSERT_EQ( iterationValues.rows, 2 );
+  EXPECT_EQ( iterationValues.integer( 1 ), 11 );
+  
+  Npy parentValues( read( "outer/inner/_parent.npy" ) );
+  EXPECT_EQ( parentValues.type, "<f8" );
+  
+  Npy underscored( read( "outer/inner/__parent.npy" ) );
+  EXPECT_EQ( underscored.type, "|S4" );
+  
+  bool listed( false );
+  vector< vector< string > > lines( manifest() );
+  for( size_t i=1; i<lines.size(); i++ )
+    if( lines[ i ][ 1 ] == "parent" && lines[ i ][ 2 ] == "outer/inner/_parent.npy" )
+      listed = true;
+  EXPECT_TRUE( listed );
+}
@@ -0,0 +1,190 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <sstream>
+#include <gtest/gtest.h>
+#include <Profiling/Statistics.hpp>
+#include <Profiling/Comparison.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+class ComparisonTest : public testing::Test
+{
+public:
+  void fill( Profile& profile, const string& name, double shift, int iterations = 50 );
+
+  Profile base;
+  Profile current;
+};
+
+void ComparisonTest::fill( Profile& profile, const string& name, double shift, int iterations )
+{
+  profile.beginLoop( name );
+  for( int i=0; i<iterations; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addValue( "cost", Value( 100 + ( i * 7 ) % 13 + shift, "ms" ) );
+    profile.endIteration();
+  }
+  profile.endLoop();
+}
+
+TEST_F( ComparisonTest, Median )
+{
+  vector< double > values;
+  values.push_back( 3 );
+  values.push_back( 1 );
+  values.push_back( 2 );
+  values.push_back( 4 );
+
+  EXPECT_DOUBLE_EQ( statistics::median( values ), 2.5 );
+  EXPECT_DOUBLE_EQ( statistics::quantile( values, 0.0 ), 1.0 );
+  EXPECT_DOUBLE_EQ( statistics::quantile( values, 1.0 ), 4.0 );
+}
+
+TEST_F( ComparisonTest, StudentQuantile )
+{
+  EXPECT_NEAR( statistics::studentQuantile( 0.975, 1 ), 12.7062, 1e-3 );
+  EXPECT_NEAR( statistics::studentQuantile( 0.975, 4 ), 2.7764, 1e-4 );
+  EXPECT_NEAR( statistics::studentQuantile( 0.975, 29 ), 2.0452, 1e-4 );
+  EXPECT_NEAR( statistics::studentQuantile( 0.025, 29 ), -2.0452, 1e-4 );
+  EXPECT_NEAR( statistics::studentQuantile( 0.995, 1e6 ), statistics::normalQuantile( 0.995 ), 1e-4 );
+  EXPECT_DOUBLE_EQ( statistics::studentCdf( 0.0, 5 ), 0.5 );
+}
+
+TEST_F( ComparisonTest, MeanInterval )
+{
+  vector< double > values;
+  values.push_back( 1 );
+  values.push_back( 2 );
+  values.push_back( 3 );
+
+  // Mean 2, standard error 1 / sqrt( 3 ), t quantile with 2 degrees of freedom is 4.3027
+  statistics::Interval interval( statistics::meanInterval( values ) );
+  EXPECT_NEAR( interval.lower, 2.0 - 4.3027 / std::sqrt( 3.0 ), 1e-3 );
+  EXPECT_NEAR( interval.upper, 2.0 + 4.3027 / std::sqrt( 3.0 ), 1e-3 );
+
+  values.resize( 1 );
+  interval = statistics::meanInterval( values );
+  EXPECT_EQ( interval.lower, 1.0 );
+  EXPECT_EQ( interval.upper, 1.0 );
+}
+
+TEST_F( ComparisonTest, MannWhitneyEqualSamples )
+{
+  vector< double > first( 20, 1.0 );
+  vector< double > second( 20, 1.0 );
+
+  statistics::RankTest test( statistics::mannWhitney( first, second ) );
+  EXPECT_DOUBLE_EQ( test.pValue, 1.0 );
+  EXPECT_DOUBLE_EQ( test.effect, 0.0 );
+}
+
+TEST_F( ComparisonTest, MannWhitneyShiftedSamples )
+{
+  vector< double > first;
+  vector< double > second;
+  for( int i=0; i<30; i++ )
+  {
+    first.push_back( i );
+    second.push_back( i + 30 );
+  }
+
+  statistics::RankTest test( statistics::mannWhitney( first, second ) );
+  EXPECT_LT( test.pValue, 0.001 );
+  EXPECT_DOUBLE_EQ( test.effect, 1.0 );
+}
+
+TEST_F( ComparisonTest, NoChange )
+{
+  fill( base, "loop", 0 );
+  fill( current, "loop", 0 );
+
+  Comparison comparison( base, current );
+  comparison.value() = "cost";
+
+  ASSERT_EQ( comparison.differences().size(), 1 );
+  EXPECT_EQ( comparison.differences()[ 0 ].path, "loop" );
+  EXPECT_FALSE( comparison.differences()[ 0 ].significant );
+  EXPECT_EQ( comparison.significantDifferences().size(), 0 );
+}
+
+TEST_F( ComparisonTest, Regression )
+{
+  fill( base, "loop", 0 );
+  fill( current, "loop", 10 );
+
+  Comparison comparison( base, current );
+  comparison.value() = "cost";
+
+  ASSERT_EQ( comparison.significantDifferences().size(), 1 );
+  EXPECT_GT( comparison.differences()[ 0 ].ratio, 1.0 );
+  EXPECT_GT( comparison.differences()[ 0 ].effect, 0.0 );
+  EXPECT_GT( comparison.differences()[ 0 ].lower, 1.0 );
+
+  comparison.method() = Comparison::bootstrapMethod;
+  EXPECT_EQ( comparison.significantDifferences().size(), 1 );
+}
+
+TEST_F( ComparisonTest, TooFewSamples )
+{
+  fill( base, "loop", 0, 3 );
+  fill( current, "loop", 10, 3 );
+
+  Comparison comparison( base, current );
+  comparison.value() = "cost";
+
+  EXPECT_EQ( comparison.differences().size(), 0 );
+}
+
+TEST_F( ComparisonTest, DifferentMeasures )
+{
+  fill( base, "loop", 0 );
+
+  current.beginLoop( "loop" );
+  for( int i=0; i<50; i++ )
+  {
+    current.beginIteration( i );
+    current.addValue( "cost", Value( ( 100 + ( i * 7 ) % 13 ) * 1000, "mcs" ) );
+    current.endIteration();
+  }
+  current.endLoop();
+
+  Comparison comparison( base, current );
+  comparison.value() = "cost";
+
+  ASSERT_EQ( comparison.differences().size(), 1 );
+  EXPECT_DOUBLE_EQ( comparison.differences()[ 0 ].ratio, 1.0 );
+}
+
+TEST_F( ComparisonTest, Print )
+{
+  fill( base, "loop", 0 );
+  fill( current, "loop", 10 );
+
+  Comparison comparison( base, current );
+  comparison.value() = "cost";
+
+  std::stringstream stream;
+  comparison.print( stream );
+
+  EXPECT_NE( stream.str().find( "loop" ), string::npos );
+  EXPECT_NE( stream.str().find( "yes" ), string::npos );
+}
@@ -0,0 +1,190 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <gtest/gtest.h>
+#include <Profiling/Profile.hpp>
+#include <Profiling/Table.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+class FlowTest : public testing::Test
+{
+public:
+  Profile profile;
+};
+
+static void* finishTask( void* argument )
+{
+  static_cast< Task* >( argument )->finish();
+  return NULL;
+}
+
+static void finishOnThread( Task& task )
+{
+  pthread_t thread;
+  pthread_create( &thread, NULL, finishTask, &task );
+  pthread_join( thread, NULL );
+}
+
+TEST_F( FlowTest, EmptyTask )
+{
+  Task task;
+
+  EXPECT_FALSE( task.active() );
+  task.finish();
+  EXPECT_EQ( profile.tasks().size(), 0 );
+}
+
+TEST_F( FlowTest, CrossThreadTask )
+{
+  Task task;
+
+  profile.beginLoop( "loop" );
+  for( int i=0; i<3; i++ )
+  {
+    profile.beginIteration( i );
+    if( i == 1 )
+      task = profile.beginTask( "io" );
+    profile.endIteration();
+  }
+  profile.endLoop();
+
+  EXPECT_TRUE( task.active() );
+  EXPECT_EQ( profile.tasks().size(), 0 );
+
+  finishOnThread( task );
+  EXPECT_FALSE( task.active() );
+
+  vector< TaskRecord > tasks( profile.tasks() );
+  ASSERT_EQ( tasks.size(), 1 );
+  EXPECT_EQ( tasks[ 0 ].flow, "io" );
+  EXPECT_EQ( tasks[ 0 ].spawner, "loop" );
+  EXPECT_EQ( tasks[ 0 ].iteration, 1 );
+  EXPECT_EQ( tasks[ 0 ].spawnThread, currentThread() );
+  EXPECT_NE( tasks[ 0 ].finishThread, currentThread() );
+  EXPECT_GE( tasks[ 0 ].duration(), 0 );
+}
+
+TEST_F( FlowTest, FinishOnce )
+{
+  Task task( profile.beginTask( "once" ) );
+  Task copy( task );
+
+  copy.finish();
+  task.finish();
+
+  EXPECT_FALSE( task.active() );
+  EXPECT_EQ( profile.tasks().size(), 1 );
+}
+
+TEST_F( FlowTest, TaskOutlivesProfile )
+{
+  Task task;
+  {
+    Profile temporary;
+    task = temporary.beginTask( "orphan" );
+  }
+
+  task.finish();
+  EXPECT_FALSE( task.active() );
+}
+
+TEST_F( FlowTest, Xml )
+{
+  profile.beginPhase( "spawner" );
+  Task first( profile.beginTask( "io" ) );
+  Task second( profile.beginTask( "compute" ) );
+  profile.endPhase();
+
+  first.finish();
+  finishOnThread( second );
+
+  xml::NodePtr xml( profile.toXml() );
+  EXPECT_EQ( xml->childs( "flow" ).count(), 2 );
+
+  ProfilePtr restored( Profile::fromXml( *xml ) );
+  ASSERT_FALSE( restored == NULL );
+  EXPECT_EQ( restored->rootPhase().phases().count( "spawner" ), 1 );
+
+  vector< TaskRecord > tasks( restored->tasks() );
+  ASSERT_EQ( tasks.size(), 2 );
+  size_t compute( tasks[ 0 ].flow == "compute" ? 0 : 1 );
+  EXPECT_EQ( tasks[ compute ].flow, "compute" );
+  EXPECT_EQ( tasks[ compute ].spawner, "spawner" );
+  EXPECT_NE( tasks[ compute ].spawnThread, tasks[ compute ].finishThread );
+  EXPECT_EQ( tasks[ 1 - compute ].flow, "io" );
+  EXPECT_EQ( tasks[ 1 - compute ].duration(), profile.tasks()[ 0 ].duration() );
+}
+
+TEST_F( FlowTest, Table )
+{
+  profile.beginPhase( "first" );
+  Task io( profile.beginTask( "io" ) );
+  profile.endPhase();
+
+  profile.beginPhase( "second" );
+  Task other( profile.beginTask( "io" ) );
+  profile.endPhase();
+
+  io.finish();
+  finishOnThread( other );
+
+  Table table;
+  profile.flowsToTable( &table );
+
+  ASSERT_EQ( table.rows(), 1 );
+  ASSERT_EQ( table.columns(), 6 );
+  EXPECT_EQ( table[ 0 ][ 0 ].value(), "io" );
+  EXPECT_EQ( table[ 0 ][ 1 ].value(), 2 );
+  EXPECT_EQ( table[ 0 ][ 2 ].value(), 1 );
+  EXPECT_EQ( table[ 0 ][ 3 ].measure(), "ns" );
+  EXPECT_EQ( table[ 0 ][ 5 ].value(), "first, second" );
+}
+
+TEST_F( FlowTest, DroppedTasks )
+{
+  profile.setMaximalTasks( 2 );
+
+  profile.beginPhase( "spawner" );
+  for( int i=0; i<5; i++ )
+    profile.beginTask( i < 3 ? "io" : "compute" ).finish();
+  profile.endPhase();
+
+  vector< TaskRecord > tasks( profile.tasks() );
+  ASSERT_EQ( tasks.size(), 2 );
+  EXPECT_EQ( tasks[ 0 ].flow, "compute" );
+  ASSERT_EQ( profile.droppedTasks().size(), 1 );
+  EXPECT_EQ( profile.droppedTasks().find( "io" )->second, 3 );
+
+  Table table;
+  profile.flowsToTable( &table );
+  ASSERT_EQ( table.rows(), 2 );
+  ASSERT_EQ( table.columns(), 7 );
+  EXPECT_EQ( table[ 1 ][ 0 ].value(), "io" );
+  EXPECT_EQ( table[ 1 ][ 1 ].value(), 0 );
+  EXPECT_EQ( table[ 1 ][ 6 ].value(), 3 );
+
+  xml::NodePtr xml( profile.toXml() );
+  ProfilePtr restored( Profile::fromXml( *xml ) );
+  ASSERT_FALSE( restored == NULL );
+  EXPECT_EQ( restored->tasks().size(), 2 );
+  ASSERT_EQ( restored->droppedTasks().count( "io" ), 1 );
+  EXPECT_EQ( restored->droppedTasks().find( "io" )->second, 3 );
+}
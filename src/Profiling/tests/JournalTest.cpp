@@ -0,0 +1,207 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <boost/lexical_cast.hpp>
+#include <Profiling/Journal.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+class JournalTest : public testing::Test
+{
+public:
+  JournalTest() : path( "/tmp/burningJournalTest." + boost::lexical_cast< string >( getpid() ) )
+  {
+  }
+
+  ~JournalTest()
+  {
+    unlink( path.c_str() );
+  }
+
+  void recordLoop( const string& name, size_t iterations );
+
+  Profile profile;
+  string path;
+};
+
+void JournalTest::recordLoop( const string& name, size_t iterations )
+{
+  profile.beginLoop( name );
+  for( size_t i=0; i<iterations; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addValue( "size", Value( i * 10, "items" ) );
+    profile.endIteration();
+  }
+  profile.endLoop();
+}
+
+static const Phase& subphase( const Phase& phase, const string& name, size_t iteration = 0 )
+{
+  return *phase.phases().find( name )->second[ iteration ];
+}
+
+TEST_F( JournalTest, RoundTrip )
+{
+  {
+    Journal journal( path );
+    profile.addListener( &journal );
+
+    profile.addValue( "mode", "test" );
+    profile.beginPhase( "main" );
+    recordLoop( "loop", 3 );
+    profile.endPhase();
+
+    profile.removeListener( &journal );
+  }
+
+  ProfilePtr recovered( Journal::recover( path ) );
+  ASSERT_FALSE( recovered == NULL );
+  EXPECT_EQ( recovered->rootPhase().values().count( "crashed in" ), 0 );
+  EXPECT_EQ( recovered->rootPhase().values().find( "mode" )->second[ 0 ].value(), "test" );
+
+  const Phase& loop( subphase( subphase( recovered->rootPhase(), "main" ), "loop" ) );
+  const Phase& original( subphase( subphase( profile.rootPhase(), "main" ), "loop" ) );
+  ASSERT_EQ( loop.iterations().size(), 3 );
+  EXPECT_EQ( loop.iterations()[ 2 ].as< int >(), 2 );
+  EXPECT_EQ( loop.values().find( "size" )->second[ 2 ].value(), 20 );
+  EXPECT_EQ( loop.values().find( "size" )->second[ 2 ].measure(), "items" );
+  EXPECT_EQ( loop.values().find( "time" )->second[ 1 ].measure(), "ns" );
+  EXPECT_EQ( loop.values().find( "time" )->second[ 2 ].value().as< long long >(), original.lastDuration() );
+
+  xml::NodePtr xml( recovered->toXml() );
+  EXPECT_FALSE( Profile::fromXml( *xml ) == NULL );
+}
+
+TEST_F( JournalTest, AddedIterations )
+{
+  {
+    Journal journal( path );
+    profile.addListener( &journal );
+
+    profile.beginLoop( "added" );
+    profile.setRetention( retainSlowest, 1 );
+    Phase::ValueList values;
+    values.push_back( std::make_pair( string( "size" ), Value( 10 ) ) );
+    profile.addIteration( "slow", 5000000, values, nanoseconds );
+    profile.addIteration( "fast", 3000000, values, nanoseconds );
+    profile.endLoop();
+
+    profile.removeListener( &journal );
+  }
+
+  ProfilePtr recovered( Journal::recover( path ) );
+  ASSERT_FALSE( recovered == NULL );
+
+  const Phase& loop( subphase( recovered->rootPhase(), "added" ) );
+  ASSERT_EQ( loop.iterations().size(), 2 );
+  EXPECT_EQ( loop.iterations()[ 0 ].as< string >(), "slow" );
+  EXPECT_EQ( loop.iterations()[ 1 ].as< string >(), "fast" );
+  EXPECT_EQ( loop.values().find( "size" )->second[ 1 ].value(), 10 );
+  EXPECT_EQ( loop.values().find( "time" )->second[ 1 ].value().as< long long >(), 3000000 );
+}
+
+TEST_F( JournalTest, CrashedProcess )
+{
+  pid_t child( fork() );
+  ASSERT_GE( child, 0 );
+  if( child == 0 )
+  {
+    Journal* journal( new Journal( path ) );
+    profile.addListener( journal );
+
+    profile.beginLoop( "requests" );
+    for( int i=0; i<3; i++ )
+    {
+      profile.beginIteration( i );
+      profile.addValue( "bytes", 100 * i );
+      profile.beginPhase( "parse" );
+      if( i == 2 )
+	break;
+      profile.endPhase();
+      profile.beginPhase( "query" );
+      profile.endPhase();
+      profile.addValue( "rows", i );
+      profile.endIteration();
+    }
+
+    kill( getpid(), SIGKILL );
+  }
+
+  int status;
+  waitpid( child, &status, 0 );
+  ASSERT_TRUE( WIFSIGNALED( status ) );
+
+  ProfilePtr recovered( Journal::recover( path ) );
+  ASSERT_FALSE( recovered == NULL );
+  ASSERT_EQ( recovered->rootPhase().values().count( "crashed in" ), 1 );
+  EXPECT_EQ( recovered->rootPhase().values().find( "crashed in" )->second[ 0 ].value(), "requests[2]/parse" );
+
+  const Phase& requests( subphase( recovered->rootPhase(), "requests" ) );
+  ASSERT_EQ( requests.iterations().size(), 3 );
+  EXPECT_EQ( requests.values().find( "bytes" )->second[ 2 ].value(), 200 );
+  EXPECT_EQ( requests.values().find( "rows" )->second[ 2 ].value(), "" );
+  EXPECT_EQ( subphase( requests, "parse", 2 ).iterations().size(), 1 );
+  ASSERT_EQ( requests.phases().find( "query" )->second.size(), 3 );
+  EXPECT_EQ( subphase( requests, "query", 1 ).iterations().size(), 1 );
+  EXPECT_EQ( subphase( requests, "query", 2 ).iterations().size(), 0 );
+
+  xml::NodePtr xml( recovered->toXml() );
+  EXPECT_EQ( xml->childs( "loop" ).count(), 1 );
+}
+
+TEST_F( JournalTest, WrappedRing )
+{
+  Journal journal( path, 16 );
+  profile.addListener( &journal );
+
+  profile.beginPhase( "main" );
+  profile.beginLoop( "outer" );
+  profile.beginIteration( "only" );
+  recordLoop( "loop", 100 );
+  recordLoop( "tail", 2 );
+
+  ProfilePtr recovered( Journal::recover( path ) );
+  profile.removeListener( &journal );
+  ASSERT_FALSE( recovered == NULL );
+  EXPECT_EQ( recovered->rootPhase().values().find( "crashed in" )->second[ 0 ].value(), "main/outer[only]" );
+
+  const Phase& outer( subphase( subphase( recovered->rootPhase(), "main" ), "outer" ) );
+  ASSERT_EQ( outer.iterations().size(), 1 );
+  EXPECT_EQ( outer.iterations()[ 0 ], string( "only" ) );
+  EXPECT_EQ( outer.phases().count( "loop" ), 0 );
+  ASSERT_EQ( outer.phases().count( "tail" ), 1 );
+  EXPECT_EQ( subphase( outer, "tail" ).iterations().size(), 2 );
+}
+
+TEST_F( JournalTest, NotJournal )
+{
+  {
+    std::ofstream stream( path.c_str() );
+    stream << "<profile/>";
+  }
+
+  EXPECT_TRUE( Journal::recover( path ) == NULL );
+  EXPECT_TRUE( Journal::recover( path + ".missing" ) == NULL );
+}
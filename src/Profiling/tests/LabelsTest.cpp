@@ -0,0 +1,231 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <time.h>
+#include <sstream>
+#include <gtest/gtest.h>
+#include <Profiling/Grouping.hpp>
+#include <Profiling/MetricsExporter.hpp>
+#include <Profiling/Table.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+class LabelsTest : public testing::Test
+{
+public:
+  void recordQueries();
+  
+  Profile profile;
+};
+
+// Queries of tenant 1 take 10-19 ms, of tenant 2 take 100-109 ms
+void LabelsTest::recordQueries()
+{
+  profile.beginLoop( "requests" );
+  for( int i=0; i<20; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addLabel( "shard", i % 2 == 0 ? "even" : "odd" );
+    profile.beginPhase( "query" );
+    profile.addLabel( "tenant", i < 10 ? "1" : "2" );
+    profile.addValue( "cost", Value( ( i < 10 ? 10 : 100 ) + i % 10, "ms" ) );
+    profile.endPhase();
+    profile.endIteration();
+  }
+  profile.endLoop();
+}
+
+TEST_F( LabelsTest, Interning )
+{
+  EXPECT_EQ( internLabel( "tenant" ), internLabel( "tenant" ) );
+  EXPECT_NE( internLabel( "tenant" ), internLabel( "shard" ) );
+  EXPECT_EQ( labelText( internLabel( "tenant" ) ), "tenant" );
+}
+
+TEST_F( LabelsTest, LabelSet )
+{
+  LabelSet labels;
+  EXPECT_TRUE( labels.empty() );
+  
+  labels.set( "tenant", "42" );
+  labels.set( "shard", "3" );
+  labels.set( "tenant", "43" );
+  
+  EXPECT_EQ( labels.labels().size(), 2 );
+  EXPECT_TRUE( labels.has( "shard" ) );
+  EXPECT_FALSE( labels.has( "unknown key" ) );
+  EXPECT_EQ( labels.value( "tenant" ), "43" );
+  EXPECT_EQ( labels.value( "region" ), "" );
+  EXPECT_EQ( labels.toString(), "shard=3,tenant=43" );
+  
+  LabelSet shard;
+  shard.set( "shard", "3" );
+  EXPECT_TRUE( labels.contains( shard ) );
+  EXPECT_TRUE( labels.contains( LabelSet() ) );
+  EXPECT_FALSE( shard.contains( labels ) );
+}
+
+TEST_F( LabelsTest, PhaseLabels )
+{
+  Phase phase;
+  EXPECT_EXIT( phase.addLabel( "tenant", "1" ), testing::ExitedWithCode( EXIT_FAILURE ), "" );
+  
+  for( int i=0; i<3; i++ )
+  {
+    phase.beginIteration( i );
+    if( i != 1 )
+      phase.addLabel( "tenant", boost::lexical_cast< string >( i ) );
+    phase.endIteration();
+    EXPECT_EQ( phase.labels( i ).value( "tenant" ), i != 1 ? boost::lexical_cast< string >( i ) : "" );
+  }
+  
+  EXPECT_TRUE( phase.labelled() );
+  EXPECT_EQ( phase.labels( 0 ).value( "tenant" ), "0" );
+  EXPECT_TRUE( phase.labels( 1 ).empty() );
+  EXPECT_EQ( phase.labels( 2 ).value( "tenant" ), "2" );
+  EXPECT_TRUE( phase.labels( 5 ).empty() );
+  
+  Table table;
+  phase.toTable( &table );
+  EXPECT_EQ( table[ 0 ][ table.columns() - 1 ].value(), "tenant=0" );
+}
+
+TEST_F( LabelsTest, LabelsWithRetention )
+{
+  Phase phase;
+  phase.setRetention( retainSlowest, 1 );
+  for( int i=0; i<4; i++ )
+    phase.addIteration( i, i == 2 ? 1000000 : 1000, Phase::ValueList(), nanoseconds );
+  
+  phase.beginIteration( 4 );
+  phase.addLabel( "tenant", "slow" );
+  timespec delay = { 0, 5000000 };
+  nanosleep( &delay, NULL );
+  phase.endIteration();
+  
+  ASSERT_EQ( phase.iterations().size(), 1 );
+  EXPECT_EQ( phase.iterations()[ 0 ], 4 );
+  EXPECT_EQ( phase.labels( 0 ).value( "tenant" ), "slow" );
+}
+
+TEST_F( LabelsTest, Xml )
+{
+  recordQueries();
+  
+  xml::NodePtr xml( profile.toXml() );
+  ProfilePtr restored( Profile::fromXml( *xml ) );
+  ASSERT_FALSE( restored == NULL );
+  
+  const Phase& requests( *restored->rootPhase().phases().find( "requests" )->second[ 0 ] );
+  EXPECT_EQ( requests.labels( 3 ).value( "shard" ), "odd" );
+  
+  const Phase& query( *requests.phases().find( "query" )->second[ 12 ] );
+  EXPECT_EQ( query.iterations().size(), 1 );
+  EXPECT_EQ( query.labels( 0 ).toString(), "tenant=2" );
+}
+
+TEST_F( LabelsTest, Grouping )
+{
+  recordQueries();
+  
+  Grouping grouping( profile, "tenant" );
+  grouping.value() = "cost";
+  grouping.path() = "requests/query";
+  
+  const Grouping::GroupVector& groups( grouping.groups() );
+  ASSERT_EQ( groups.size(), 2 );
+  EXPECT_EQ( groups[ 0 ].path, "requests/query" );
+  EXPECT_EQ( groups[ 0 ].label, "1" );
+  EXPECT_EQ( groups[ 0 ].count, 10 );
+  EXPECT_EQ( groups[ 0 ].measure, "ms" );
+  EXPECT_DOUBLE_EQ( groups[ 0 ].maximum, 19 );
+  EXPECT_DOUBLE_EQ( groups[ 0 ].median, 14.5 );
+  EXPECT_EQ( groups[ 1 ].label, "2" );
+  EXPECT_GT( groups[ 1 ].percentile99, 108 );
+  EXPECT_LE( groups[ 1 ].percentile99, 109 );
+}
+
+TEST_F( LabelsTest, GroupingWithoutLabel )
+{
+  recordQueries();
+  
+  Grouping grouping( profile, "shard" );
+  
+  const Grouping::GroupVector& groups( grouping.groups() );
+  ASSERT_EQ( groups.size(), 3 );
+  EXPECT_EQ( groups[ 0 ].path, "requests" );
+  EXPECT_EQ( groups[ 0 ].label, "even" );
+  EXPECT_EQ( groups[ 1 ].label, "odd" );
+  EXPECT_EQ( groups[ 2 ].path, "requests/query" );
+  EXPECT_EQ( groups[ 2 ].label, "" );
+  EXPECT_EQ( groups[ 2 ].count, 20 );
+}
+
+TEST_F( LabelsTest, Filter )
+{
+  recordQueries();
+  
+  Grouping grouping( profile, "tenant" );
+  grouping.value() = "cost";
+  grouping.filter( "tenant", "2" );
+  
+  ASSERT_EQ( grouping.groups().size(), 1 );
+  EXPECT_EQ( grouping.groups()[ 0 ].label, "2" );
+  EXPECT_EQ( grouping.groups()[ 0 ].count, 10 );
+  
+  Table table;
+  grouping.toTable( &table );
+  ASSERT_EQ( table.rows(), 1 );
+  EXPECT_EQ( table[ 0 ][ 1 ].value(), "2" );
+  EXPECT_EQ( table[ 0 ][ 3 ].measure(), "ms" );
+}
+
+TEST_F( LabelsTest, Exporter )
+{
+  LiveStatistics statistics;
+  MetricsExporter exporter( statistics.segment() );
+  profile.addListener( &statistics );
+  
+  profile.beginLoop( "requests" );
+  for( int i=0; i<4; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addLabel( "tenant", i < 3 ? "1" : "2" );
+    profile.addLabel( "request type", "get" );
+    profile.endIteration();
+  }
+  profile.endLoop();
+  
+  ASSERT_EQ( statistics.segment().phases, 2 );
+  live::PhaseRecord record;
+  ASSERT_TRUE( live::read( statistics.segment(), 0, record ) );
+  
+  live::Summary summary( live::summarize( record ) );
+  EXPECT_EQ( summary.count, 3 );
+  ASSERT_EQ( summary.labels.size(), 2 );
+  EXPECT_EQ( summary.labels[ 0 ].first, "request type" );
+  EXPECT_EQ( summary.name(), "requests{request type=get,tenant=1}" );
+  
+  std::ostringstream stream;
+  exporter.writeMetrics( stream );
+  EXPECT_NE( stream.str().find( "burning_phase_duration_seconds_count{phase=\"requests\",request_type=\"get\",tenant=\"1\"} 3\n" ),
+	     string::npos );
+  EXPECT_NE( stream.str().find( "burning_phase_duration_seconds_count{phase=\"requests\",request_type=\"get\",tenant=\"2\"} 1\n" ),
+	     string::npos );
+}
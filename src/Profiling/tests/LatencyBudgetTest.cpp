@@ -0,0 +1,183 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+#include <Profiling/LatencyBudget.hpp>
+#include <Profiling/Profile.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+/*! Collects reported violations */
+struct ViolationRecorder
+{
+  ViolationRecorder( vector< LatencyBudget::Violation >* violations ) : violations( violations )
+  {
+  }
+  
+  void operator()( const LatencyBudget::Violation& violation )
+  {
+    violations->push_back( violation );
+  }
+  
+  vector< LatencyBudget::Violation >* violations;
+};
+
+class LatencyBudgetTest : public testing::Test
+{
+public:
+  void SetUp();
+  void recordLoop( const string& name, size_t iterations );
+  
+  Profile profile;
+  LatencyBudget budget;
+  vector< LatencyBudget::Violation > violations;
+};
+
+void LatencyBudgetTest::SetUp()
+{
+  budget.setCallback( ViolationRecorder( &violations ) );
+  profile.addListener( &budget );
+}
+
+void LatencyBudgetTest::recordLoop( const string& name, size_t iterations )
+{
+  profile.beginLoop( name );
+  for( size_t i=0; i<iterations; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addValue( "value", i * 10 );
+    profile.beginPhase( "inner" );
+    profile.endPhase();
+    profile.endIteration();
+  }
+  profile.endLoop();
+}
+
+TEST_F( LatencyBudgetTest, WithinBudget )
+{
+  budget.setBudget( "inner", 100.0 );
+  budget.setBudget( "loop", 100.0 );
+  recordLoop( "loop", 3 );
+  
+  EXPECT_EQ( budget.violations(), 0 );
+  EXPECT_TRUE( violations.empty() );
+}
+
+TEST_F( LatencyBudgetTest, PhaseName )
+{
+  budget.setBudget( "inner", 1e-9 );
+  recordLoop( "loop", 2 );
+  
+  ASSERT_EQ( violations.size(), 2 );
+  EXPECT_EQ( violations[ 0 ].path, "loop/inner" );
+  EXPECT_EQ( violations[ 0 ].iteration, "" );
+  EXPECT_EQ( violations[ 0 ].budget, 1 );
+  EXPECT_GT( violations[ 0 ].duration, violations[ 0 ].budget );
+  
+  ASSERT_EQ( violations[ 0 ].values.size(), 1 );
+  EXPECT_EQ( violations[ 0 ].values[ 0 ].first, "time" );
+}
+
+TEST_F( LatencyBudgetTest, IterationValues )
+{
+  budget.setBudget( "loop", 1e-9 );
+  recordLoop( "loop", 2 );
+  
+  ASSERT_EQ( violations.size(), 2 );
+  EXPECT_EQ( violations[ 1 ].path, "loop" );
+  EXPECT_EQ( violations[ 1 ].iteration, "1" );
+  
+  ASSERT_EQ( violations[ 1 ].values.size(), 2 );
+  EXPECT_EQ( violations[ 1 ].values[ 1 ].first, "value" );
+  EXPECT_EQ( violations[ 1 ].values[ 1 ].second.value(), 10 );
+}
+
+TEST_F( LatencyBudgetTest, PathBudget )
+{
+  budget.setBudget( "inner", 100.0 );
+  budget.setBudget( "loop/inner", 1e-9 );
+  recordLoop( "loop", 1 );
+  
+  ASSERT_EQ( violations.size(), 1 );
+  EXPECT_EQ( violations[ 0 ].path, "loop/inner" );
+  
+  budget.setBudget( "inner", 1e-9 );
+  budget.setBudget( "loop/inner", 0.0 );
+  recordLoop( "other", 1 );
+  ASSERT_EQ( violations.size(), 2 );
+  EXPECT_EQ( violations[ 1 ].path, "other/inner" );
+}
+
+TEST_F( LatencyBudgetTest, RateLimit )
+{
+  budget.rate() = 0.0;
+  budget.burst() = 1.0;
+  budget.setBudget( "inner", 1e-9 );
+  recordLoop( "loop", 3 );
+  
+  EXPECT_EQ( budget.violations(), 3 );
+  ASSERT_EQ( violations.size(), 1 );
+  EXPECT_EQ( violations[ 0 ].suppressed, 0 );
+  
+  budget.rate() = 1e9;
+  recordLoop( "other", 1 );
+  ASSERT_EQ( violations.size(), 2 );
+  EXPECT_EQ( violations[ 1 ].suppressed, 2 );
+}
+
+TEST_F( LatencyBudgetTest, RetainedIterations )
+{
+  budget.setBudget( "loop", 1e-9 );
+  profile.beginLoop( "loop" );
+  profile.setRetention( retainSlowest, 1 );
+  
+  Phase::ValueList values;
+  values.push_back( std::make_pair( string( "v" ), Value( 111 ) ) );
+  profile.addIteration( 1, 5000000, values );
+  values[ 0 ].second = Value( 222 );
+  profile.addIteration( 2, 3000000, values );
+  profile.endLoop();
+  
+  ASSERT_EQ( violations.size(), 2 );
+  EXPECT_EQ( violations[ 1 ].iteration, "2" );
+  EXPECT_EQ( violations[ 1 ].duration, 3000000 );
+  ASSERT_EQ( violations[ 1 ].values.size(), 2 );
+  EXPECT_EQ( violations[ 1 ].values[ 0 ].first, "time" );
+  EXPECT_EQ( violations[ 1 ].values[ 0 ].second.value(), 3 );
+  EXPECT_EQ( violations[ 1 ].values[ 1 ].second.value(), 222 );
+}
+
+TEST_F( LatencyBudgetTest, RemovedIterations )
+{
+  budget.setBudget( "loop", 1e-9 );
+  profile.beginLoop( "loop" );
+  profile.setRetention( retainNone );
+  for( int i=0; i<2; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addValue( "value", i * 10 );
+    profile.endIteration();
+  }
+  profile.endLoop();
+  
+  ASSERT_EQ( violations.size(), 2 );
+  EXPECT_EQ( violations[ 1 ].iteration, "1" );
+  ASSERT_EQ( violations[ 1 ].values.size(), 2 );
+  EXPECT_EQ( violations[ 1 ].values[ 1 ].second.value(), 10 );
+}
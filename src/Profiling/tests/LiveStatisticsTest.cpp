@@ -0,0 +1,210 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include <boost/lexical_cast.hpp>
+#include <Profiling/LiveStatistics.hpp>
+#include <Profiling/Profile.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+class LiveStatisticsTest : public testing::Test
+{
+public:
+  void recordLoop( size_t iterations );
+  
+  Profile profile;
+};
+
+void LiveStatisticsTest::recordLoop( size_t iterations )
+{
+  profile.beginLoop( "loop" );
+  for( size_t i=0; i<iterations; i++ )
+  {
+    profile.beginIteration( i );
+    profile.beginPhase( "inner" );
+    profile.endPhase();
+    profile.endIteration();
+  }
+  profile.endLoop();
+}
+
+class RecordingListener : public Listener
+{
+public:
+  void loopBegan( const Profile& profile, size_t path )
+  {
+    events.push_back( "loop " + profile.pathName( path ) );
+  }
+  
+  void valueAdded( const Profile& profile, size_t path, const string& name, const Value& )
+  {
+    events.push_back( "value " + profile.pathName( path ) + " " + name );
+  }
+  
+  void iterationEnded( const Profile& profile, size_t path, long long duration )
+  {
+    events.push_back( "end " + profile.pathName( path ) );
+    EXPECT_GE( duration, 0 );
+  }
+  
+  vector< string > events;
+};
+
+TEST_F( LiveStatisticsTest, ListenerEvents )
+{
+  RecordingListener listener;
+  profile.addListener( &listener );
+  
+  profile.beginPhase( "outer" );
+  profile.beginPhase( "inner" );
+  profile.addValue( "value", 1 );
+  profile.endPhase();
+  profile.endPhase();
+  
+  profile.removeListener( &listener );
+  profile.beginPhase( "ignored" );
+  profile.endPhase();
+  
+  ASSERT_EQ( listener.events.size(), 5 );
+  EXPECT_EQ( listener.events[ 0 ], "loop outer" );
+  EXPECT_EQ( listener.events[ 1 ], "loop outer/inner" );
+  EXPECT_EQ( listener.events[ 2 ], "value outer/inner value" );
+  EXPECT_EQ( listener.events[ 3 ], "end outer/inner" );
+  EXPECT_EQ( listener.events[ 4 ], "end outer" );
+}
+
+TEST_F( LiveStatisticsTest, PathIds )
+{
+  profile.beginPhase( "phase" );
+  size_t path( profile.currentPath() );
+  profile.endPhase();
+  
+  profile.beginLoop( "loop" );
+  profile.beginIteration( 1 );
+  profile.beginPhase( "phase" );
+  EXPECT_NE( profile.currentPath(), path );
+  EXPECT_EQ( profile.pathName( profile.currentPath() ), "loop/phase" );
+  profile.endPhase();
+  profile.endIteration();
+  profile.endLoop();
+  
+  EXPECT_EQ( profile.currentPath(), 0 );
+  EXPECT_EQ( profile.pathName( path ), "phase" );
+  EXPECT_EQ( profile.paths(), 4 );
+}
+
+TEST_F( LiveStatisticsTest, Aggregates )
+{
+  LiveStatistics statistics;
+  profile.addListener( &statistics );
+  recordLoop( 3 );
+  
+  const live::Segment& segment( statistics.segment() );
+  EXPECT_EQ( segment.magic, live::magic );
+  EXPECT_EQ( segment.version, live::layoutVersion );
+  ASSERT_EQ( segment.phases, 2 );
+  
+  live::PhaseRecord record;
+  ASSERT_TRUE( live::read( segment, 0, record ) );
+  live::Summary inner( live::summarize( record ) );
+  EXPECT_EQ( inner.path, "loop/inner" );
+  EXPECT_EQ( inner.count, 3 );
+  EXPECT_LE( inner.maximalTime, inner.totalTime );
+  EXPECT_LE( inner.median, inner.maximalTime );
+  
+  ASSERT_TRUE( live::read( segment, 1, record ) );
+  EXPECT_EQ( string( record.path ), "loop" );
+  EXPECT_EQ( record.count, 3 );
+  EXPECT_FALSE( live::read( segment, 2, record ) );
+}
+
+TEST_F( LiveStatisticsTest, SharedSegment )
+{
+  string name( "/burningLiveStatisticsTest." + boost::lexical_cast< string >( getpid() ) );
+  {
+    LiveStatistics statistics( name );
+    profile.addListener( &statistics );
+    recordLoop( 2 );
+    profile.removeListener( &statistics );
+    
+    const live::Segment* segment( live::attach( name ) );
+    ASSERT_FALSE( segment == NULL );
+    
+    live::PhaseRecord record;
+    ASSERT_TRUE( live::read( *segment, 1, record ) );
+    EXPECT_EQ( string( record.path ), "loop" );
+    EXPECT_EQ( record.count, 2 );
+    
+    live::detach( segment );
+  }
+  
+  EXPECT_TRUE( live::attach( name ) == NULL );
+}
+
+TEST_F( LiveStatisticsTest, LabelledRecords )
+{
+  LiveStatistics statistics;
+  profile.addListener( &statistics );
+  
+  profile.beginLoop( "loop" );
+  for( int i=0; i<6; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addLabel( "tenant", i % 2 == 0 ? "even" : "odd" );
+    profile.beginPhase( "inner" );
+    profile.addLabel( "tenant", "even" );
+    profile.endPhase();
+    profile.endIteration();
+  }
+  profile.endLoop();
+  
+  const live::Segment& segment( statistics.segment() );
+  ASSERT_EQ( segment.phases, 3 );
+  EXPECT_EQ( segment.dropped, 0 );
+  
+  live::PhaseRecord record;
+  ASSERT_TRUE( live::read( segment, 0, record ) );
+  EXPECT_EQ( live::summarize( record ).name(), "loop/inner{tenant=even}" );
+  EXPECT_EQ( record.count, 6 );
+  ASSERT_TRUE( live::read( segment, 1, record ) );
+  EXPECT_EQ( live::summarize( record ).name(), "loop{tenant=even}" );
+  EXPECT_EQ( record.count, 3 );
+}
+
+TEST_F( LiveStatisticsTest, DroppedIterations )
+{
+  LiveStatistics statistics;
+  profile.addListener( &statistics );
+  
+  size_t iterations( live::maximalPhases + 10 );
+  profile.beginLoop( "loop" );
+  for( size_t i=0; i<iterations; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addLabel( "request", boost::lexical_cast< string >( i ) );
+    profile.endIteration();
+  }
+  profile.endLoop();
+  
+  const live::Segment& segment( statistics.segment() );
+  EXPECT_EQ( segment.phases, live::maximalPhases );
+  EXPECT_EQ( segment.dropped, 10 );
+}
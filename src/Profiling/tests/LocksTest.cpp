@@ -0,0 +1,333 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <gtest/gtest.h>
+#include <Profiling/Locks.hpp>
+#include <Profiling/Profile.hpp>
+#include <Profiling/Table.hpp>
+#include "Sleep.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+class LocksTest : public testing::Test
+{
+public:
+  void SetUp();
+  void TearDown();
+
+  LockStatistics statistics( const string& name );
+  const Phase& loop();
+
+  Profile profile;
+};
+
+void LocksTest::SetUp()
+{
+  resetLockStatistics();
+  profile.attach();
+}
+
+void LocksTest::TearDown()
+{
+  Profile::detach();
+}
+
+LockStatistics LocksTest::statistics( const string& name )
+{
+  vector< LockStatistics > all( lockStatistics() );
+  for( size_t i=0; i<all.size(); i++ )
+    if( all[ i ].name == name )
+      return all[ i ];
+
+  return LockStatistics();
+}
+
+const Phase& LocksTest::loop()
+{
+  return *profile.rootPhase().phases().find( "loop" )->second[ 0 ];
+}
+
+struct Holder
+{
+  Holder( Mutex& mutex ) : mutex( mutex ), locked( false )
+  {
+  }
+
+  Mutex& mutex;
+  volatile bool locked;
+};
+
+static void* holdMutex( void* argument )
+{
+  Holder* holder( static_cast< Holder* >( argument ) );
+
+  holder->mutex.lock();
+  holder->locked = true;
+  sleepMilliseconds( 20 );
+  holder->mutex.unlock();
+
+  return NULL;
+}
+
+TEST_F( LocksTest, Uncontended )
+{
+  Mutex mutex( "uncontended" );
+
+  profile.beginLoop( "loop" );
+  for( int i=0; i<3; i++ )
+  {
+    profile.beginIteration( i );
+    Mutex::Lock lock( mutex );
+    profile.endIteration();
+  }
+  profile.endLoop();
+
+  LockStatistics locks( statistics( "uncontended" ) );
+  EXPECT_EQ( locks.acquisitions, 3 );
+  EXPECT_EQ( locks.contended, 0 );
+  EXPECT_EQ( locks.waitTime, 0 );
+  EXPECT_GE( locks.holdTime, 0 );
+
+  EXPECT_EQ( loop().values().count( "lock uncontended wait" ), 0 );
+}
+
+TEST_F( LocksTest, Contended )
+{
+  Mutex mutex( "contended" );
+  Holder holder( mutex );
+
+  pthread_t thread;
+  pthread_create( &thread, NULL, holdMutex, &holder );
+  while( !holder.locked )
+    sleepMilliseconds( 1 );
+
+  profile.beginLoop( "loop" );
+  profile.beginIteration( 0 );
+  mutex.lock();
+  mutex.unlock();
+  profile.endIteration();
+  profile.endLoop();
+  pthread_join( thread, NULL );
+
+  LockStatistics locks( statistics( "contended" ) );
+  EXPECT_EQ( locks.acquisitions, 2 );
+  EXPECT_EQ( locks.contended, 1 );
+  EXPECT_GT( locks.waitTime, 0 );
+  EXPECT_EQ( locks.maximalWait, locks.waitTime );
+
+  ASSERT_EQ( loop().values().count( "lock contended wait" ), 1 );
+  EXPECT_EQ( loop().values().find( "lock contended wait" )->second[ 0 ].measure(), "ns" );
+  EXPECT_GT( loop().values().find( "lock contended wait" )->second[ 0 ].value().as< double >(), 0 );
+  EXPECT_EQ( loop().values().count( "lock contended hold" ), 1 );
+}
+
+TEST_F( LocksTest, AccumulatedValues )
+{
+  Mutex mutex( "accumulated" );
+
+  profile.beginLoop( "loop" );
+  profile.beginIteration( 0 );
+  profile.endIteration();
+
+  profile.beginIteration( 1 );
+  mutex.lock();
+  mutex.unlock();
+  mutex.lock();
+  mutex.unlock();
+  profile.endIteration();
+
+  profile.beginIteration( 2 );
+  profile.endIteration();
+  profile.endLoop();
+
+  ASSERT_EQ( loop().values().count( "lock accumulated hold" ), 1 );
+  const vector< Value >& holds( loop().values().find( "lock accumulated hold" )->second );
+  ASSERT_EQ( holds.size(), 3 );
+  EXPECT_EQ( holds[ 0 ].value(), 0 );
+  EXPECT_EQ( holds[ 2 ].value(), 0 );
+  EXPECT_EQ( statistics( "accumulated" ).acquisitions, 2 );
+
+  xml::NodePtr xml( profile.toXml() );
+  EXPECT_EQ( xml->childs( "loop" ).count(), 1 );
+}
+
+TEST_F( LocksTest, NotAttached )
+{
+  Profile::detach();
+  Mutex mutex( "detached" );
+
+  profile.beginLoop( "loop" );
+  profile.beginIteration( 0 );
+  mutex.lock();
+  mutex.unlock();
+  profile.endIteration();
+  profile.endLoop();
+
+  EXPECT_EQ( loop().values().count( "lock detached hold" ), 0 );
+  EXPECT_EQ( statistics( "detached" ).acquisitions, 1 );
+}
+
+TEST_F( LocksTest, TryLock )
+{
+  Mutex mutex( "try" );
+
+  EXPECT_TRUE( mutex.try_lock() );
+  mutex.unlock();
+
+  Holder holder( mutex );
+  pthread_t thread;
+  pthread_create( &thread, NULL, holdMutex, &holder );
+  while( !holder.locked )
+    sleepMilliseconds( 1 );
+
+  EXPECT_FALSE( mutex.try_lock() );
+  pthread_join( thread, NULL );
+
+  EXPECT_EQ( statistics( "try" ).acquisitions, 2 );
+  EXPECT_EQ( statistics( "try" ).contended, 0 );
+}
+
+struct SharedHolder
+{
+  SharedMutex* mutex;
+  volatile bool locked;
+};
+
+static void* holdExclusive( void* argument )
+{
+  SharedHolder* holder( static_cast< SharedHolder* >( argument ) );
+
+  holder->mutex->lock();
+  holder->locked = true;
+  sleepMilliseconds( 20 );
+  holder->mutex->unlock();
+
+  return NULL;
+}
+
+TEST_F( LocksTest, SharedMutex )
+{
+  SharedMutex mutex( "shared" );
+
+  mutex.lock_shared();
+  EXPECT_TRUE( mutex.try_lock_shared() );
+  EXPECT_FALSE( mutex.try_lock() );
+  mutex.unlock_shared();
+  mutex.unlock_shared();
+
+  SharedHolder holder = { &mutex, false };
+  pthread_t thread;
+  pthread_create( &thread, NULL, holdExclusive, &holder );
+  while( !holder.locked )
+    sleepMilliseconds( 1 );
+
+  mutex.lock_shared();
+  mutex.unlock_shared();
+  pthread_join( thread, NULL );
+
+  LockStatistics locks( statistics( "shared" ) );
+  EXPECT_EQ( locks.acquisitions, 4 );
+  EXPECT_EQ( locks.contended, 1 );
+  EXPECT_GT( locks.waitTime, 0 );
+  EXPECT_GT( locks.holdTime, 0 );
+}
+
+struct Notifier
+{
+  Mutex* mutex;
+  ConditionVariable* condition;
+  volatile bool ready;
+};
+
+static void* notify( void* argument )
+{
+  Notifier* notifier( static_cast< Notifier* >( argument ) );
+
+  sleepMilliseconds( 10 );
+  notifier->mutex->lock();
+  notifier->ready = true;
+  notifier->condition->notifyAll();
+  notifier->mutex->unlock();
+
+  return NULL;
+}
+
+TEST_F( LocksTest, ConditionVariable )
+{
+  Mutex mutex( "condition mutex" );
+  ConditionVariable condition( "ready" );
+  Notifier notifier = { &mutex, &condition, false };
+
+  pthread_t thread;
+  pthread_create( &thread, NULL, notify, &notifier );
+
+  profile.beginLoop( "loop" );
+  profile.beginIteration( 0 );
+  mutex.lock();
+  while( !notifier.ready )
+    condition.wait( mutex );
+  mutex.unlock();
+  profile.endIteration();
+  profile.endLoop();
+  pthread_join( thread, NULL );
+
+  EXPECT_GE( statistics( "ready" ).acquisitions, 1 );
+  EXPECT_GT( statistics( "ready" ).waitTime, 0 );
+  ASSERT_EQ( loop().values().count( "condition ready wait" ), 1 );
+  EXPECT_GT( loop().values().find( "condition ready wait" )->second[ 0 ].value().as< double >(), 0 );
+}
+
+TEST_F( LocksTest, TimedWait )
+{
+  Mutex mutex( "timed mutex" );
+  ConditionVariable condition( "timed" );
+
+  mutex.lock();
+  EXPECT_FALSE( condition.timedWait( mutex, 0.005 ) );
+  mutex.unlock();
+
+  EXPECT_GE( statistics( "timed" ).waitTime, 5000000 );
+}
+
+TEST_F( LocksTest, Table )
+{
+  Mutex first( "first" );
+  Mutex second( "second" );
+  first.lock();
+  first.unlock();
+
+  Table table;
+  locksToTable( &table );
+
+  ASSERT_EQ( table.columns(), 6 );
+  ASSERT_GE( table.rows(), 2 );
+  EXPECT_EQ( table.column( 0 ).name(), "lock" );
+  EXPECT_EQ( table.column( 4 ).name(), "maximal wait" );
+
+  bool found( false );
+  for( size_t i=0; i<table.rows(); i++ )
+    if( table[ i ][ 0 ].value() == "first" )
+    {
+      found = true;
+      EXPECT_EQ( table[ i ][ 1 ].value(), 1 );
+      EXPECT_EQ( table[ i ][ 3 ].measure(), "ns" );
+    }
+  EXPECT_TRUE( found );
+}
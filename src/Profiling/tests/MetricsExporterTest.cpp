@@ -0,0 +1,138 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#include <sstream>
+#include <gtest/gtest.h>
+#include <Profiling/MetricsExporter.hpp>
+#include <Profiling/Profile.hpp>
+
+using std::string;
+using namespace burning;
+using namespace burning::profiling;
+
+class MetricsExporterTest : public testing::Test
+{
+public:
+  MetricsExporterTest() : exporter( statistics.segment() )
+  {
+  }
+  
+  void SetUp();
+  
+  Profile profile;
+  LiveStatistics statistics;
+  MetricsExporter exporter;
+};
+
+void MetricsExporterTest::SetUp()
+{
+  profile.addListener( &statistics );
+  profile.beginLoop( "requests" );
+  for( int i=0; i<3; i++ )
+  {
+    profile.beginIteration( i );
+    profile.endIteration();
+  }
+  profile.endLoop();
+}
+
+// Sends request to connected socket and reads whole response
+static string request( int descriptor, const string& path )
+{
+  string request( "GET " + path + " HTTP/1.0\r\n\r\n" );
+  EXPECT_EQ( send( descriptor, request.data(), request.size(), 0 ), static_cast< ssize_t >( request.size() ) );
+  
+  string ret;
+  char buffer[ 1024 ];
+  ssize_t size;
+  while( ( size = recv( descriptor, buffer, sizeof( buffer ), 0 ) ) > 0 )
+    ret.append( buffer, size );
+  
+  close( descriptor );
+  return ret;
+}
+
+static string requestTcp( unsigned short port, const string& path )
+{
+  sockaddr_in address;
+  memset( &address, 0, sizeof( address ) );
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+  address.sin_port = htons( port );
+  
+  int descriptor( socket( AF_INET, SOCK_STREAM, 0 ) );
+  EXPECT_EQ( connect( descriptor, reinterpret_cast< sockaddr* >( &address ), sizeof( address ) ), 0 );
+  
+  return request( descriptor, path );
+}
+
+TEST_F( MetricsExporterTest, OpenMetricsText )
+{
+  std::ostringstream stream;
+  exporter.writeMetrics( stream );
+  string text( stream.str() );
+  
+  EXPECT_NE( text.find( "# TYPE burning_phase_duration_seconds histogram\n" ), string::npos );
+  EXPECT_NE( text.find( "burning_phase_duration_seconds_bucket{phase=\"requests\",le=\"+Inf\"} 3\n" ), string::npos );
+  EXPECT_NE( text.find( "burning_phase_duration_seconds_count{phase=\"requests\"} 3\n" ), string::npos );
+  EXPECT_NE( text.find( "burning_phase_duration_seconds_sum{phase=\"requests\"} 0." ), string::npos );
+  EXPECT_NE( text.find( "burning_phase_recent_duration_seconds{phase=\"requests\",quantile=\"0.99\"}" ), string::npos );
+  
+  ASSERT_GE( text.size(), 6 );
+  EXPECT_EQ( text.substr( text.size() - 6 ), "# EOF\n" );
+}
+
+TEST_F( MetricsExporterTest, TcpScrape )
+{
+  ASSERT_TRUE( exporter.listen( 0 ) );
+  ASSERT_NE( exporter.port(), 0 );
+  
+  string response( requestTcp( exporter.port(), "/metrics" ) );
+  EXPECT_EQ( response.find( "HTTP/1.0 200 OK\r\n" ), 0 );
+  EXPECT_NE( response.find( "application/openmetrics-text" ), string::npos );
+  EXPECT_NE( response.find( "_count{phase=\"requests\"} 3\n" ), string::npos );
+  
+  response = requestTcp( exporter.port(), "/unknown" );
+  EXPECT_EQ( response.find( "HTTP/1.0 404" ), 0 );
+  
+  exporter.stop();
+}
+
+TEST_F( MetricsExporterTest, UnixSocketScrape )
+{
+  string path( "MetricsExporterTest.socket" );
+  ASSERT_TRUE( exporter.listen( path ) );
+  EXPECT_EQ( exporter.port(), 0 );
+  
+  sockaddr_un address;
+  memset( &address, 0, sizeof( address ) );
+  address.sun_family = AF_UNIX;
+  strcpy( address.sun_path, path.c_str() );
+  
+  int descriptor( socket( AF_UNIX, SOCK_STREAM, 0 ) );
+  ASSERT_EQ( connect( descriptor, reinterpret_cast< sockaddr* >( &address ), sizeof( address ) ), 0 );
+  
+  string response( request( descriptor, "/metrics" ) );
+  EXPECT_NE( response.find( "# EOF\n" ), string::npos );
+  
+  exporter.stop();
+  EXPECT_NE( access( path.c_str(), F_OK ), 0 );
+}
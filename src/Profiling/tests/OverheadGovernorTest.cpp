@@ -0,0 +1,231 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <time.h>
+#include <gtest/gtest.h>
+#include <Profiling/OverheadGovernor.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+class OverheadGovernorTest : public testing::Test
+{
+public:
+  void recordFlat( const string& name, size_t iterations );
+  void recordNested( size_t iterations );
+  
+  const Phase& loop( const string& name );
+  
+  Profile profile;
+};
+
+void OverheadGovernorTest::recordFlat( const string& name, size_t iterations )
+{
+  profile.beginLoop( name );
+  for( size_t i=0; i<iterations; i++ )
+  {
+    profile.beginIteration( static_cast< int >( i ) );
+    profile.addValue( "index", i );
+    profile.endIteration();
+  }
+  profile.endLoop();
+}
+
+void OverheadGovernorTest::recordNested( size_t iterations )
+{
+  profile.beginLoop( "requests" );
+  for( size_t i=0; i<iterations; i++ )
+  {
+    profile.beginIteration( static_cast< int >( i ) );
+    profile.beginLoop( "items" );
+    for( int j=0; j<3; j++ )
+    {
+      profile.beginIteration( j );
+      profile.beginPhase( "parse" );
+      profile.addValue( "bytes", j );
+      profile.endPhase();
+      profile.endIteration();
+    }
+    profile.endLoop();
+    profile.endIteration();
+  }
+  profile.endLoop();
+}
+
+const Phase& OverheadGovernorTest::loop( const string& name )
+{
+  return *profile.rootPhase().phases().find( name )->second.back();
+}
+
+static long long threadTime()
+{
+  timespec time;
+  clock_gettime( CLOCK_THREAD_CPUTIME_ID, &time );
+  
+  return time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+// Processor time is what governor compares overhead with, so work must spin rather than sleep
+static void spinMicroseconds( long long duration )
+{
+  long long end( threadTime() + duration * 1000 );
+  while( threadTime() < end )
+    ;
+}
+
+class CostlyEnds : public Listener
+{
+public:
+  void iterationEnded( const Profile&, size_t, long long )
+  {
+    spinMicroseconds( 20 );
+  }
+};
+
+// With zero window and zero budget every timed call lowers detail
+TEST_F( OverheadGovernorTest, LowersDetail )
+{
+  OverheadGovernor governor( profile, 0.0, 0.0, 2 );
+  recordFlat( "hot", 200 );
+  
+  EXPECT_EQ( governor.level(), noDetail );
+  ASSERT_EQ( governor.changes().size(), 3 );
+  EXPECT_EQ( governor.changes()[ 0 ].level, sampledDetail );
+  EXPECT_EQ( governor.changes()[ 2 ].level, noDetail );
+  ASSERT_EQ( governor.changes()[ 0 ].loops.size(), 1 );
+  EXPECT_EQ( profile.pathName( governor.changes()[ 0 ].loops[ 0 ] ), "hot" );
+  EXPECT_GT( governor.overhead(), 0.0 );
+  
+  const Phase& hot( loop( "hot" ) );
+  EXPECT_LT( hot.iterations().size(), 20 );
+  EXPECT_FALSE( hot.labelled() );
+  ASSERT_EQ( hot.values().count( "sampled" ), 1 );
+  const vector< Value >& sampled( hot.values().find( "sampled" )->second );
+  ASSERT_EQ( sampled.size(), hot.iterations().size() );
+  EXPECT_EQ( sampled[ 0 ].value(), 0 );
+  EXPECT_EQ( sampled.back().value(), 1 );
+  
+  // Iterations aggregated at aggregated level
+  ASSERT_EQ( hot.aggregates().count( "time" ), 1 );
+  EXPECT_GT( hot.aggregates().find( "time" )->second.count, hot.iterations().size() );
+  EXPECT_LT( hot.aggregates().find( "time" )->second.count, 200 );
+  
+  governor.end();
+  const Phase& levels( loop( "detail levels" ) );
+  ASSERT_EQ( levels.iterations().size(), 3 );
+  EXPECT_EQ( levels.values().find( "level" )->second[ 0 ].value(), "sampled" );
+  EXPECT_EQ( levels.values().find( "level" )->second[ 2 ].value(), "off" );
+  EXPECT_EQ( levels.values().find( "loops" )->second[ 2 ].value(), "hot" );
+  EXPECT_GT( levels.values().find( "skipped" )->second[ 2 ].value().as< int >(), 100 );
+  EXPECT_EQ( levels.values().find( "overhead" )->second[ 0 ].measure(), "%" );
+}
+
+// Loop makes two calls per iteration and only the second one is costly
+TEST_F( OverheadGovernorTest, CostInIterationEnd )
+{
+  CostlyEnds listener;
+  profile.addListener( &listener );
+  OverheadGovernor governor( profile, 0.5, 0.05 );
+  
+  long long end( threadTime() + 300000000LL );
+  profile.beginLoop( "hot" );
+  for( int i=0; threadTime() < end; i++ )
+  {
+    profile.beginIteration( i );
+    spinMicroseconds( 10 );
+    profile.endIteration();
+  }
+  profile.endLoop();
+  profile.removeListener( &listener );
+  
+  ASSERT_FALSE( governor.changes().empty() );
+  EXPECT_EQ( governor.changes()[ 0 ].level, sampledDetail );
+  EXPECT_GT( governor.changes()[ 0 ].overhead, 0.5 );
+}
+
+TEST_F( OverheadGovernorTest, RestoresDetail )
+{
+  OverheadGovernor governor( profile, 0.0, 0.0 );
+  recordFlat( "hot", 100 );
+  ASSERT_EQ( governor.level(), noDetail );
+  
+  governor.setBudget( 1e9 );
+  recordFlat( "calm", 100 );
+  
+  EXPECT_EQ( governor.level(), fullDetail );
+  ASSERT_EQ( governor.changes().size(), 6 );
+  EXPECT_EQ( governor.changes()[ 3 ].level, aggregatedDetail );
+  EXPECT_EQ( governor.changes()[ 5 ].level, fullDetail );
+  EXPECT_TRUE( governor.changes()[ 5 ].loops.empty() );
+  
+  // Iterations after restoring are kept
+  const Phase& calm( loop( "calm" ) );
+  EXPECT_GT( calm.iterations().size(), 50 );
+  EXPECT_EQ( calm.iterations().back(), 99 );
+  EXPECT_FALSE( calm.detailPaused() );
+}
+
+TEST_F( OverheadGovernorTest, NestedLoops )
+{
+  OverheadGovernor governor( profile, 0.0, 0.0 );
+  profile.beginLoop( "runs" );
+  for( int i=0; i<2; i++ )
+  {
+    profile.beginIteration( i );
+    recordNested( 50 );
+    profile.endIteration();
+    governor.setBudget( 1e9 );
+  }
+  profile.endLoop();
+  governor.end();
+  
+  EXPECT_EQ( profile.currentPath(), 0 );
+  EXPECT_GE( governor.changes().size(), 6 );
+  EXPECT_EQ( governor.level(), fullDetail );
+  
+  xml::NodePtr xml( profile.toXml() );
+  ASSERT_FALSE( xml == NULL );
+  ProfilePtr restored( Profile::fromXml( *xml ) );
+  ASSERT_FALSE( restored == NULL );
+  EXPECT_EQ( restored->rootPhase().phases().count( "runs" ), 1 );
+  EXPECT_EQ( restored->rootPhase().phases().count( "detail levels" ), 1 );
+}
+
+TEST_F( OverheadGovernorTest, WithinBudget )
+{
+  OverheadGovernor governor( profile, 1e9, 0.0 );
+  recordNested( 20 );
+  
+  EXPECT_EQ( governor.level(), fullDetail );
+  EXPECT_TRUE( governor.changes().empty() );
+  EXPECT_EQ( loop( "requests" ).iterations().size(), 20 );
+}
+
+TEST_F( OverheadGovernorTest, EndedByDestructor )
+{
+  {
+    OverheadGovernor governor( profile, 0.0, 0.0 );
+    recordFlat( "hot", 50 );
+  }
+  
+  EXPECT_EQ( profile.rootPhase().phases().count( "detail levels" ), 1 );
+  
+  // Profile records fully without governor
+  recordFlat( "calm", 10 );
+  EXPECT_EQ( loop( "calm" ).iterations().size(), 10 );
+}
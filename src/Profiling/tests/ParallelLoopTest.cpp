@@ -0,0 +1,220 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <sstream>
+#include <gtest/gtest.h>
+#include <Profiling/ParallelLoop.hpp>
+#include "Sleep.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+class ParallelLoopTest : public testing::Test
+{
+public:
+  const Phase& loop( const string& name );
+
+  Profile profile;
+};
+
+const Phase& ParallelLoopTest::loop( const string& name )
+{
+  return *profile.rootPhase().phases().find( name )->second[ 0 ];
+}
+
+struct Worker
+{
+  ParallelLoop* loop;
+  size_t index;
+  size_t iterations;
+  long sleep;
+};
+
+static void* work( void* argument )
+{
+  Worker* worker( static_cast< Worker* >( argument ) );
+
+  for( size_t i=0; i<worker->iterations; i++ )
+  {
+    worker->loop->beginIteration( worker->index, static_cast< int >( worker->index * 100 + i ) );
+    worker->loop->addValue( worker->index, "square", static_cast< int >( i * i ) );
+    sleepMilliseconds( worker->sleep );
+    worker->loop->endIteration( worker->index );
+  }
+
+  return NULL;
+}
+
+static void runWorkers( ParallelLoop& loop, const vector< size_t >& iterations, long sleep )
+{
+  vector< Worker > workers( iterations.size() );
+  vector< pthread_t > threads( iterations.size() );
+  for( size_t i=0; i<iterations.size(); i++ )
+  {
+    Worker worker = { &loop, i, iterations[ i ], sleep };
+    workers[ i ] = worker;
+    pthread_create( &threads[ i ], NULL, work, &workers[ i ] );
+  }
+
+  for( size_t i=0; i<threads.size(); i++ )
+    pthread_join( threads[ i ], NULL );
+}
+
+TEST_F( ParallelLoopTest, MergedIterations )
+{
+  ParallelLoop parallel( profile, "parallel", 3, microseconds );
+  EXPECT_EQ( parallel.workers(), 3 );
+
+  vector< size_t > iterations( 3, 4 );
+  runWorkers( parallel, iterations, 1 );
+  parallel.end();
+
+  const Phase& merged( loop( "parallel" ) );
+  ASSERT_EQ( merged.iterations().size(), 12 );
+  ASSERT_EQ( merged.values().count( "worker" ), 1 );
+  ASSERT_EQ( merged.values().count( "square" ), 1 );
+  ASSERT_EQ( merged.values().find( "time" )->second.size(), 12 );
+  EXPECT_EQ( merged.values().find( "time" )->second[ 0 ].measure(), "mcs" );
+
+  vector< size_t > perWorker( 3, 0 );
+  for( size_t i=0; i<merged.iterations().size(); i++ )
+  {
+    int worker( merged.values().find( "worker" )->second[ i ].value().as< int >() );
+    ASSERT_LT( worker, 3 );
+    perWorker[ worker ]++;
+
+    int name( merged.iterations()[ i ].as< int >() );
+    EXPECT_EQ( name / 100, worker );
+    EXPECT_EQ( merged.values().find( "square" )->second[ i ].value(), ( name % 100 ) * ( name % 100 ) );
+    EXPECT_GE( merged.values().find( "time" )->second[ i ].value().as< int >(), 1000 );
+  }
+  EXPECT_EQ( perWorker[ 0 ], 4 );
+  EXPECT_EQ( perWorker[ 2 ], 4 );
+
+  EXPECT_EQ( profile.currentPath(), 0 );
+  EXPECT_EQ( profile.rootPhase().values().size(), 0 );
+  ASSERT_EQ( merged.aggregates().count( "worker busy" ), 1 );
+  const Aggregate& busy( merged.aggregates().find( "worker busy" )->second );
+  EXPECT_EQ( busy.count, 3 );
+  EXPECT_EQ( busy.maximum, parallel.loadBalance().maximum );
+  EXPECT_EQ( busy.measure, "ns" );
+
+  ASSERT_EQ( merged.aggregates().count( "worker busy deviation" ), 1 );
+  EXPECT_DOUBLE_EQ( merged.aggregates().find( "worker busy deviation" )->second.sum, parallel.loadBalance().deviation );
+  ASSERT_EQ( merged.aggregates().count( "worker imbalance" ), 1 );
+  EXPECT_DOUBLE_EQ( merged.aggregates().find( "worker imbalance" )->second.maximum, parallel.loadBalance().imbalance() );
+}
+
+TEST_F( ParallelLoopTest, LoadImbalance )
+{
+  ParallelLoop parallel( profile, "unbalanced", 2 );
+
+  vector< size_t > iterations;
+  iterations.push_back( 6 );
+  iterations.push_back( 1 );
+  runWorkers( parallel, iterations, 2 );
+  parallel.end();
+
+  const LoadBalance& balance( parallel.loadBalance() );
+  EXPECT_GE( balance.maximum, 12000000 );
+  EXPECT_GT( balance.mean, 0.0 );
+  EXPECT_LT( balance.mean, balance.maximum );
+  EXPECT_GT( balance.deviation, 0.0 );
+  EXPECT_GT( balance.imbalance(), 1.2 );
+}
+
+TEST_F( ParallelLoopTest, IdleWorkers )
+{
+  ParallelLoop parallel( profile, "idle", 4 );
+  parallel.end();
+
+  EXPECT_EQ( loop( "idle" ).iterations().size(), 0 );
+  EXPECT_EQ( parallel.loadBalance().maximum, 0.0 );
+  EXPECT_EQ( parallel.loadBalance().imbalance(), 1.0 );
+}
+
+TEST_F( ParallelLoopTest, EndedByDestructor )
+{
+  {
+    ParallelLoop parallel( profile, "scoped", 1 );
+    parallel.beginIteration( 0, "only" );
+    parallel.endIteration( 0 );
+  }
+
+  EXPECT_EQ( profile.currentPath(), 0 );
+  EXPECT_EQ( loop( "scoped" ).iterations().size(), 1 );
+}
+
+TEST_F( ParallelLoopTest, WrongWorker )
+{
+  ParallelLoop parallel( profile, "wrong", 2 );
+
+  EXPECT_EXIT( parallel.beginIteration( 2, "" ), testing::ExitedWithCode( EXIT_FAILURE ), "" );
+  EXPECT_EXIT( parallel.endIteration( 1 ), testing::ExitedWithCode( EXIT_FAILURE ), "" );
+}
+
+TEST_F( ParallelLoopTest, RepeatedLoop )
+{
+  profile.beginLoop( "runs" );
+  for( int run=0; run<2; run++ )
+  {
+    profile.beginIteration( run );
+    ParallelLoop parallel( profile, "repeated", 2 );
+    vector< size_t > iterations( 2, run + 1 );
+    runWorkers( parallel, iterations, 0 );
+    parallel.end();
+    profile.endIteration();
+  }
+  profile.endLoop();
+
+  const Phase& runs( loop( "runs" ) );
+  EXPECT_EQ( runs.values().size(), 1 );
+  const vector< PhasePtr >& repeated( runs.phases().find( "repeated" )->second );
+  ASSERT_EQ( repeated.size(), 2 );
+  EXPECT_EQ( repeated[ 1 ]->iterations().size(), 4 );
+  EXPECT_EQ( repeated[ 1 ]->aggregates().find( "worker busy" )->second.count, 2 );
+
+  xml::NodePtr xml( profile.toXml() );
+  ProfilePtr restored( Profile::fromXml( *xml ) );
+  ASSERT_FALSE( restored == NULL );
+  const Phase& restoredRuns( *restored->rootPhase().phases().find( "runs" )->second[ 0 ] );
+  const Phase& restoredLoop( *restoredRuns.phases().find( "repeated" )->second[ 0 ] );
+  EXPECT_EQ( restoredLoop.iterations().size(), 2 );
+  EXPECT_EQ( restoredLoop.aggregates().find( "worker busy" )->second.count, 2 );
+  ASSERT_EQ( restoredLoop.aggregates().count( "worker imbalance" ), 1 );
+  EXPECT_NEAR( restoredLoop.aggregates().find( "worker imbalance" )->second.sum,
+	       repeated[ 0 ]->aggregates().find( "worker imbalance" )->second.sum, 1e-3 );
+
+  std::ostringstream printed;
+  profile.print( printed );
+  EXPECT_NE( printed.str().find( "worker busy deviation" ), string::npos );
+}
+
+TEST_F( ParallelLoopTest, Xml )
+{
+  ParallelLoop parallel( profile, "xml", 2 );
+  vector< size_t > iterations( 2, 2 );
+  runWorkers( parallel, iterations, 0 );
+  parallel.end();
+
+  xml::NodePtr xml( profile.toXml() );
+  ProfilePtr restored( Profile::fromXml( *xml ) );
+  ASSERT_FALSE( restored == NULL );
+  EXPECT_EQ( restored->rootPhase().phases().find( "xml" )->second[ 0 ]->iterations().size(), 4 );
+}
@@ -15,6 +15,7 @@
 */
 
 #include <sstream>
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <boost/tr1/memory.hpp>
 #include <boost/assign/std/vector.hpp>
@@ -22,6 +23,7 @@
 #include <boost/foreach.hpp>
 #include <Profiling/Table.hpp>
 #include <Profiling/Phase.hpp>
+#include "Sleep.hpp"
 
 using std::string;
 using std::vector;
@@ -554,3 +556,282 @@ TEST_F( PhaseTest, IterationsTable )
   EXPECT_EQ( table[ 0 ][ 0 ].value(), "first" );
   EXPECT_EQ( table[ 1 ][ 0 ].value(), "second" );
 }
+
+static void runSlowIterations( Phase& phase, size_t count, size_t slowEvery )
+{
+  for( size_t i=0; i<count; i++ )
+  {
+    phase.beginIteration( i );
+    phase.addValue( "value", i );
+    if( i % slowEvery == slowEvery - 1 )
+      sleepMilliseconds( 2 );
+    phase.endIteration( nanoseconds );
+  }
+}
+
+TEST_F( PhaseTest, RetainSlowest )
+{
+  phase.setRetention( retainSlowest, 2 );
+  runSlowIterations( phase, 8, 4 );
+  
+  EXPECT_EQ( phase.retention(), retainSlowest );
+  EXPECT_EQ( phase.slowest(), 2 );
+  ASSERT_EQ( phase.iterations().size(), 2 );
+  ASSERT_EQ( phase.values().find( "value" )->second.size(), 2 );
+  ASSERT_EQ( phase.values().find( "time" )->second.size(), 2 );
+  
+  vector< int > kept;
+  for( size_t i=0; i<phase.iterations().size(); i++ )
+  {
+    kept.push_back( phase.iterations()[ i ].as< int >() );
+    EXPECT_EQ( phase.values().find( "value" )->second[ i ].value(), kept.back() );
+  }
+  std::sort( kept.begin(), kept.end() );
+  EXPECT_EQ( kept[ 0 ], 3 );
+  EXPECT_EQ( kept[ 1 ], 7 );
+  
+  ASSERT_EQ( phase.aggregates().count( "value" ), 1 );
+  const Aggregate& value( phase.aggregates().find( "value" )->second );
+  EXPECT_EQ( value.count, 8 );
+  EXPECT_EQ( value.sum, 28 );
+  EXPECT_EQ( value.minimum, 0 );
+  EXPECT_EQ( value.maximum, 7 );
+  
+  ASSERT_EQ( phase.aggregates().count( "time" ), 1 );
+  EXPECT_EQ( phase.aggregates().find( "time" )->second.count, 8 );
+  EXPECT_EQ( phase.aggregates().find( "time" )->second.measure, "ns" );
+}
+
+TEST_F( PhaseTest, RetainNone )
+{
+  phase.setRetention( retainNone );
+  runSlowIterations( phase, 5, 5 );
+  
+  EXPECT_EQ( phase.iterations().size(), 0 );
+  EXPECT_EQ( phase.values().find( "value" )->second.size(), 0 );
+  ASSERT_EQ( phase.aggregates().count( "value" ), 1 );
+  EXPECT_EQ( phase.aggregates().find( "value" )->second.count, 5 );
+  EXPECT_EQ( phase.aggregates().find( "value" )->second.sum, 10 );
+}
+
+TEST_F( PhaseTest, RetentionOfCompletedIterations )
+{
+  runSlowIterations( phase, 6, 3 );
+  ASSERT_EQ( phase.iterations().size(), 6 );
+  
+  phase.setRetention( retainSlowest, 2 );
+  EXPECT_EQ( phase.iterations().size(), 2 );
+  EXPECT_EQ( phase.aggregates().find( "value" )->second.count, 6 );
+  
+  runSlowIterations( phase, 3, 10 );
+  EXPECT_EQ( phase.iterations().size(), 2 );
+  EXPECT_EQ( phase.aggregates().find( "value" )->second.count, 9 );
+  
+  phase.setRetention( retainAll );
+  runSlowIterations( phase, 3, 10 );
+  EXPECT_EQ( phase.iterations().size(), 5 );
+  EXPECT_EQ( phase.aggregates().find( "value" )->second.count, 12 );
+}
+
+TEST_F( PhaseTest, RetentionInIteration )
+{
+  phase.beginIteration( 0 );
+  
+  EXPECT_EXIT( phase.setRetention( retainNone ), testing::ExitedWithCode( EXIT_FAILURE ), "" );
+}
+
+TEST_F( PhaseTest, RetentionXml )
+{
+  phase.setRetention( retainSlowest, 2 );
+  runSlowIterations( phase, 5, 2 );
+  
+  xml::NodePtr xml( phase.toXml() );
+  EXPECT_EQ( xml->name(), "loop" );
+  EXPECT_EQ( xml->attr( "retention" ), "slowest" );
+  EXPECT_EQ( xml->attr( "slowest" ), 2 );
+  EXPECT_EQ( xml->childs( "iteration" ).count(), 2 );
+  EXPECT_EQ( xml->childs( "aggregate" ).count(), 2 );
+  
+  PhasePtr restored( Phase::fromXml( *xml ) );
+  ASSERT_FALSE( restored == NULL );
+  EXPECT_EQ( restored->retention(), retainSlowest );
+  EXPECT_EQ( restored->slowest(), 2 );
+  EXPECT_EQ( restored->iterations().size(), 2 );
+  ASSERT_EQ( restored->aggregates().count( "value" ), 1 );
+  EXPECT_EQ( restored->aggregates().find( "value" )->second.count, 5 );
+  EXPECT_EQ( restored->aggregates().find( "value" )->second.sum, 10 );
+  EXPECT_EQ( restored->aggregates().find( "value" )->second.maximum, 4 );
+  
+  runSlowIterations( *restored, 1, 10 );
+  EXPECT_EQ( restored->iterations().size(), 2 );
+  EXPECT_EQ( restored->aggregates().find( "value" )->second.count, 6 );
+}
+
+TEST_F( PhaseTest, CpuTracking )
+{
+  phase.setCpuTracking( true );
+  EXPECT_TRUE( phase.cpuTracking() );
+  
+  phase.beginIteration( 0 );
+  phase.observeCpu( 1000 );
+  phase.observeCpu( 1000 );
+  phase.observeCpu( 1001 );
+  phase.endIteration();
+  
+  ASSERT_EQ( phase.values().count( "begin cpu" ), 1 );
+  ASSERT_EQ( phase.values().count( "end cpu" ), 1 );
+  ASSERT_EQ( phase.values().count( "migrations" ), 1 );
+  
+  // Real processors are sampled at iteration's begin and end
+  int begin( phase.values().find( "begin cpu" )->second[ 0 ].value().as< int >() );
+  int end( phase.values().find( "end cpu" )->second[ 0 ].value().as< int >() );
+  EXPECT_GE( begin, 0 );
+  EXPECT_NE( begin, 1000 );
+  EXPECT_GE( end, 0 );
+  EXPECT_NE( end, 1001 );
+  EXPECT_EQ( phase.values().find( "migrations" )->second[ 0 ].value(), 3 );
+  ASSERT_EQ( phase.values().count( "begin node" ), 1 );
+  ASSERT_EQ( phase.values().count( "end node" ), 1 );
+}
+
+TEST_F( PhaseTest, CpuTrackingAddedIterations )
+{
+  phase.setCpuTracking( true );
+  phase.beginIteration( 0 );
+  phase.endIteration();
+  phase.addIteration( 1, 1000, Phase::ValueList() );
+  phase.beginIteration( 2 );
+  phase.endIteration();
+  
+  ASSERT_EQ( phase.values().find( "begin node" )->second.size(), 3 );
+  ASSERT_EQ( phase.values().find( "end node" )->second.size(), 3 );
+  EXPECT_EQ( phase.values().find( "begin cpu" )->second[ 1 ].value(), -1 );
+  EXPECT_EQ( phase.values().find( "begin node" )->second[ 1 ].value(), -1 );
+  
+  xml::NodePtr xml( phase.toXml() );
+  PhasePtr restored( Phase::fromXml( *xml ) );
+  ASSERT_FALSE( restored == NULL );
+  EXPECT_EQ( restored->values().find( "end node" )->second.size(), 3 );
+}
+
+TEST_F( PhaseTest, CpuTrackingXml )
+{
+  phase.setCpuTracking( true );
+  phase.beginIteration( 0 );
+  phase.endIteration();
+  phase.beginIteration( 1 );
+  phase.endIteration();
+  
+  xml::NodePtr xml( phase.toXml() );
+  PhasePtr restored( Phase::fromXml( *xml ) );
+  ASSERT_FALSE( restored == NULL );
+  ASSERT_EQ( restored->values().count( "migrations" ), 1 );
+  EXPECT_EQ( restored->values().find( "migrations" )->second.size(), 2 );
+}
+
+TEST_F( PhaseTest, CpuTrackingAfterIterations )
+{
+  phase.beginIteration( 0 );
+  phase.endIteration();
+  
+  EXPECT_EXIT( phase.setCpuTracking( true ), testing::ExitedWithCode( EXIT_FAILURE ), "" );
+}
+
+TEST_F( PhaseTest, CpuNotTracked )
+{
+  phase.beginIteration( 0 );
+  phase.observeCpu( 1 );
+  phase.endIteration();
+  
+  EXPECT_EQ( phase.values().count( "begin cpu" ), 0 );
+  EXPECT_EQ( phase.values().count( "migrations" ), 0 );
+}
+
+// Durations falling from 5000 to 300 nanoseconds followed by steady durations around 100
+static void addWarmingIterations( Phase& phase, int steady )
+{
+  const long long warmup[] = { 5000, 4000, 3000, 2000, 1000, 500, 300 };
+  int index( 0 );
+  for( size_t i=0; i<sizeof( warmup ) / sizeof( warmup[ 0 ] ); i++ )
+  {
+    Phase::ValueList values;
+    values.push_back( std::make_pair( string( "value" ), Value( index ) ) );
+    phase.addIteration( index++, warmup[ i ], values, nanoseconds );
+  }
+  
+  for( int i=0; i<steady; i++ )
+  {
+    Phase::ValueList values;
+    values.push_back( std::make_pair( string( "value" ), Value( index ) ) );
+    phase.addIteration( index++, 100 + ( i % 3 ) * 2, values, nanoseconds );
+  }
+}
+
+TEST_F( PhaseTest, SteadyStateDetection )
+{
+  phase.setSteadyStateDetection( 5 );
+  EXPECT_EQ( phase.steadyStateWindow(), 5 );
+  EXPECT_FALSE( phase.steady() );
+  
+  addWarmingIterations( phase, 30 );
+  
+  EXPECT_TRUE( phase.steady() );
+  EXPECT_EQ( phase.warmupTime().count, 7 );
+  EXPECT_EQ( phase.warmupTime().maximum, 5000 );
+  EXPECT_EQ( phase.warmupTime().minimum, 300 );
+  EXPECT_EQ( phase.warmupTime().measure, "ns" );
+  EXPECT_EQ( phase.steadyTime().count, 30 );
+  EXPECT_EQ( phase.steadyTime().minimum, 100 );
+  EXPECT_EQ( phase.steadyTime().maximum, 104 );
+  EXPECT_EQ( phase.iterations().size(), 37 );
+}
+
+TEST_F( PhaseTest, SteadyStateNotReached )
+{
+  phase.setSteadyStateDetection( 4, 0.01 );
+  for( int i=0; i<20; i++ )
+    phase.addIteration( i, 100 + i * i * 10, Phase::ValueList(), nanoseconds );
+  
+  EXPECT_FALSE( phase.steady() );
+  EXPECT_EQ( phase.warmupTime().count, 12 );
+  EXPECT_EQ( phase.steadyTime().count, 0 );
+}
+
+TEST_F( PhaseTest, SteadyStateStopsDetail )
+{
+  phase.setSteadyStateDetection( 5, 0.05, true );
+  addWarmingIterations( phase, 30 );
+  
+  EXPECT_TRUE( phase.steady() );
+  EXPECT_EQ( phase.steadyTime().count, 30 );
+  EXPECT_EQ( phase.iterations().size(), 17 );
+  ASSERT_EQ( phase.values().find( "time" )->second.size(), 17 );
+  ASSERT_EQ( phase.aggregates().count( "time" ), 1 );
+  EXPECT_EQ( phase.aggregates().find( "time" )->second.count, 37 );
+  EXPECT_EQ( phase.aggregates().find( "value" )->second.count, 37 );
+}
+
+TEST_F( PhaseTest, SteadyStateXml )
+{
+  phase.setSteadyStateDetection( 5, 0.05, true );
+  addWarmingIterations( phase, 20 );
+  
+  xml::NodePtr xml( phase.toXml() );
+  ASSERT_EQ( xml->childs( "steady-state" ).count(), 1 );
+  
+  PhasePtr restored( Phase::fromXml( *xml ) );
+  ASSERT_FALSE( restored == NULL );
+  EXPECT_EQ( restored->steadyStateWindow(), 5 );
+  EXPECT_TRUE( restored->steady() );
+  EXPECT_EQ( restored->warmupTime().count, 7 );
+  EXPECT_EQ( restored->warmupTime().sum, phase.warmupTime().sum );
+  EXPECT_EQ( restored->steadyTime().count, 20 );
+  EXPECT_EQ( restored->steadyTime().measure, "ns" );
+  EXPECT_EQ( restored->iterations().size(), 17 );
+  
+  Phase::ValueList values;
+  values.push_back( std::make_pair( string( "value" ), Value( 0 ) ) );
+  restored->addIteration( "more", 100, values, nanoseconds );
+  EXPECT_EQ( restored->iterations().size(), 17 );
+  EXPECT_EQ( restored->steadyTime().count, 21 );
+}
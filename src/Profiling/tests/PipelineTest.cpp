@@ -0,0 +1,214 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <deque>
+#include <sstream>
+#include <gtest/gtest.h>
+#include <Profiling/Locks.hpp>
+#include <Profiling/Pipeline.hpp>
+#include "Sleep.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+class PipelineTest : public testing::Test
+{
+public:
+  PipelineTest();
+
+  Pipeline pipeline;
+  size_t parse;
+  size_t compute;
+};
+
+PipelineTest::PipelineTest() : pipeline( "pipeline" )
+{
+  parse = pipeline.addStage( "parse" );
+  compute = pipeline.addStage( "compute" );
+}
+
+TEST_F( PipelineTest, Stages )
+{
+  EXPECT_EQ( pipeline.stages(), 2 );
+  EXPECT_EQ( parse, 0 );
+  EXPECT_EQ( compute, 1 );
+
+  vector< StageStatistics > stages( pipeline.statistics() );
+  ASSERT_EQ( stages.size(), 2 );
+  EXPECT_EQ( stages[ 0 ].name, "parse" );
+  EXPECT_EQ( stages[ 1 ].items, 0 );
+  EXPECT_EQ( stages[ 1 ].throughput(), 0.0 );
+}
+
+TEST_F( PipelineTest, ServiceAndQueueing )
+{
+  vector< Pipeline::Stamp > stamps( 3 );
+  for( size_t i=0; i<stamps.size(); i++ )
+    pipeline.enqueue( stamps[ i ], parse );
+
+  for( size_t i=0; i<stamps.size(); i++ )
+  {
+    pipeline.dequeue( stamps[ i ] );
+    pipeline.pass( stamps[ i ], compute );
+  }
+
+  for( size_t i=0; i<stamps.size(); i++ )
+  {
+    pipeline.dequeue( stamps[ i ] );
+    sleepMilliseconds( 2 );
+    pipeline.finish( stamps[ i ] );
+  }
+
+  vector< StageStatistics > stages( pipeline.statistics() );
+  EXPECT_EQ( stages[ parse ].items, 3 );
+  EXPECT_EQ( stages[ compute ].items, 3 );
+  EXPECT_EQ( stages[ parse ].maximalQueueLength, 3 );
+  EXPECT_EQ( stages[ compute ].maximalQueueLength, 3 );
+  EXPECT_GE( stages[ compute ].serviceTime, 6000000 );
+  EXPECT_GE( stages[ compute ].maximalService, 2000000 );
+  EXPECT_GE( stages[ compute ].maximalQueueTime, 4000000 );
+  EXPECT_GT( stages[ compute ].throughput(), 0.0 );
+  EXPECT_LE( stages[ compute ].utilization(), 1.0 );
+
+  EXPECT_EQ( pipeline.bottleneck(), compute );
+}
+
+TEST_F( PipelineTest, DequeueWithoutEnqueue )
+{
+  Pipeline::Stamp stamp;
+
+  EXPECT_EXIT( pipeline.dequeue( stamp ), testing::ExitedWithCode( EXIT_FAILURE ), "" );
+}
+
+TEST_F( PipelineTest, UnknownStage )
+{
+  Pipeline::Stamp stamp;
+
+  EXPECT_EXIT( pipeline.enqueue( stamp, 2 ), testing::ExitedWithCode( EXIT_FAILURE ), "" );
+}
+
+struct Queue
+{
+  Queue() : mutex( "queue" ), filled( "queue filled" ), closed( false )
+  {
+  }
+
+  Mutex mutex;
+  ConditionVariable filled;
+  std::deque< Pipeline::Stamp > items;
+  bool closed;
+};
+
+struct Consumer
+{
+  Pipeline* pipeline;
+  Queue* queue;
+};
+
+static void* consume( void* argument )
+{
+  Consumer* consumer( static_cast< Consumer* >( argument ) );
+  Queue& queue( *consumer->queue );
+
+  for(;;)
+  {
+    Mutex::Lock lock( queue.mutex );
+    while( queue.items.empty() && !queue.closed )
+      queue.filled.wait( queue.mutex );
+    if( queue.items.empty() )
+      break;
+
+    Pipeline::Stamp stamp( queue.items.front() );
+    queue.items.pop_front();
+    consumer->pipeline->dequeue( stamp );
+    sleepMilliseconds( 1 );
+    consumer->pipeline->finish( stamp );
+  }
+
+  return NULL;
+}
+
+TEST_F( PipelineTest, AcrossThreads )
+{
+  Queue queue;
+  Consumer consumer = { &pipeline, &queue };
+
+  pthread_t thread;
+  pthread_create( &thread, NULL, consume, &consumer );
+
+  for( int i=0; i<10; i++ )
+  {
+    Pipeline::Stamp stamp;
+    pipeline.enqueue( stamp, parse );
+    pipeline.dequeue( stamp );
+    pipeline.finish( stamp );
+
+    Mutex::Lock lock( queue.mutex );
+    pipeline.enqueue( stamp, compute );
+    queue.items.push_back( stamp );
+    queue.filled.notifyOne();
+  }
+
+  {
+    Mutex::Lock lock( queue.mutex );
+    queue.closed = true;
+    queue.filled.notifyAll();
+  }
+  pthread_join( thread, NULL );
+
+  vector< StageStatistics > stages( pipeline.statistics() );
+  EXPECT_EQ( stages[ parse ].items, 10 );
+  EXPECT_EQ( stages[ compute ].items, 10 );
+  EXPECT_GE( stages[ compute ].serviceTime, 10000000 );
+  EXPECT_EQ( pipeline.bottleneck(), compute );
+}
+
+TEST_F( PipelineTest, Record )
+{
+  Pipeline::Stamp stamp;
+  pipeline.enqueue( stamp, parse );
+  pipeline.dequeue( stamp );
+  pipeline.pass( stamp, compute );
+  pipeline.dequeue( stamp );
+  sleepMilliseconds( 1 );
+  pipeline.finish( stamp );
+
+  Profile profile;
+  pipeline.record( profile );
+
+  ASSERT_EQ( profile.rootPhase().phases().count( "pipeline" ), 1 );
+  const Phase& loop( *profile.rootPhase().phases().find( "pipeline" )->second[ 0 ] );
+  ASSERT_EQ( loop.iterations().size(), 2 );
+  EXPECT_EQ( loop.iterations()[ 0 ], "parse" );
+  EXPECT_EQ( loop.iterations()[ 1 ], "compute" );
+
+  ASSERT_EQ( loop.values().count( "bottleneck" ), 1 );
+  EXPECT_EQ( loop.values().find( "bottleneck" )->second[ 1 ].value(), "yes" );
+  EXPECT_EQ( loop.values().find( "throughput" )->second[ 1 ].measure(), "items/s" );
+  EXPECT_EQ( loop.values().find( "items" )->second[ 0 ].value(), 1 );
+
+  const vector< Value >& times( loop.values().find( "time" )->second );
+  EXPECT_EQ( times[ 1 ].measure(), "mcs" );
+  EXPECT_GE( times[ 1 ].value().as< int >(), 1000 );
+  EXPECT_EQ( times[ 1 ].value().as< long long >(), pipeline.statistics()[ compute ].serviceTime / 1000 );
+
+  std::stringstream stream;
+  pipeline.print( stream );
+  EXPECT_NE( stream.str().find( "Bottleneck: compute" ), string::npos );
+}
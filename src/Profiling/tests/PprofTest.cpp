@@ -0,0 +1,231 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <zlib.h>
+#include <sstream>
+#include <gtest/gtest.h>
+#include <Profiling/Pprof.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+/*! Field of protocol buffers message with varint or length delimited value */
+struct Field
+{
+  uint32_t number;
+  uint64_t value;
+  string bytes;
+};
+
+static string gunzip( const string& data )
+{
+  z_stream stream;
+  stream.zalloc = Z_NULL;
+  stream.zfree = Z_NULL;
+  stream.opaque = Z_NULL;
+  stream.next_in = reinterpret_cast< Bytef* >( const_cast< char* >( data.data() ) );
+  stream.avail_in = data.size();
+  inflateInit2( &stream, 15 + 32 );
+
+  string ret;
+  char buffer[ 4096 ];
+  int result;
+  do
+  {
+    stream.next_out = reinterpret_cast< Bytef* >( buffer );
+    stream.avail_out = sizeof( buffer );
+    result = inflate( &stream, Z_NO_FLUSH );
+    ret.append( buffer, sizeof( buffer ) - stream.avail_out );
+  }
+  while( result == Z_OK );
+  inflateEnd( &stream );
+
+  EXPECT_EQ( result, Z_STREAM_END );
+  return ret;
+}
+
+static uint64_t readVarint( const string& data, size_t& offset )
+{
+  uint64_t ret( 0 );
+  for( int shift=0; offset<data.size(); shift += 7 )
+  {
+    unsigned char byte( data[ offset++ ] );
+    ret |= uint64_t( byte & 0x7f ) << shift;
+    if( byte < 0x80 )
+      break;
+  }
+  return ret;
+}
+
+static vector< Field > decode( const string& data )
+{
+  vector< Field > ret;
+  for( size_t offset=0; offset<data.size(); )
+  {
+    uint64_t key( readVarint( data, offset ) );
+    Field field = { uint32_t( key >> 3 ), 0, "" };
+    if( ( key & 7 ) == 0 )
+      field.value = readVarint( data, offset );
+    else
+    {
+      size_t size( readVarint( data, offset ) );
+      field.bytes = data.substr( offset, size );
+      offset += size;
+    }
+    ret.push_back( field );
+  }
+  return ret;
+}
+
+static vector< uint64_t > unpack( const string& data )
+{
+  vector< uint64_t > ret;
+  for( size_t offset=0; offset<data.size(); )
+    ret.push_back( readVarint( data, offset ) );
+  return ret;
+}
+
+class PprofTest : public testing::Test
+{
+public:
+  void decodeProfile();
+
+  const Field* field( const vector< Field >& fields, uint32_t number );
+
+  Profile profile;
+
+  vector< string > strings;
+  vector< vector< Field > > samples;
+  size_t sampleTypes;
+  size_t functions;
+};
+
+void PprofTest::decodeProfile()
+{
+  std::ostringstream stream;
+  ASSERT_TRUE( Pprof( profile ).write( stream ) );
+
+  sampleTypes = functions = 0;
+  vector< Field > fields( decode( gunzip( stream.str() ) ) );
+  for( size_t i=0; i<fields.size(); i++ )
+    if( fields[ i ].number == 1 )
+      sampleTypes++;
+    else if( fields[ i ].number == 2 )
+      samples.push_back( decode( fields[ i ].bytes ) );
+    else if( fields[ i ].number == 5 )
+      functions++;
+    else if( fields[ i ].number == 6 )
+      strings.push_back( fields[ i ].bytes );
+}
+
+const Field* PprofTest::field( const vector< Field >& fields, uint32_t number )
+{
+  for( size_t i=0; i<fields.size(); i++ )
+    if( fields[ i ].number == number )
+      return &fields[ i ];
+  return NULL;
+}
+
+TEST_F( PprofTest, PhaseSamples )
+{
+  profile.beginLoop( "outer" );
+  for( int i=0; i<2; i++ )
+  {
+    profile.beginIteration( i );
+    profile.beginPhase( "inner" );
+    profile.addValue( "bytes", Value( 10 * i, "bytes" ) );
+    profile.endMeasuredIteration( 3000000, nanoseconds );
+    profile.endLoop();
+    profile.endMeasuredIteration( 10000000, nanoseconds );
+  }
+  profile.endLoop();
+
+  decodeProfile();
+
+  ASSERT_FALSE( strings.empty() );
+  EXPECT_EQ( strings[ 0 ], "" );
+  EXPECT_EQ( sampleTypes, 2 );
+  EXPECT_EQ( functions, 2 );
+  ASSERT_EQ( samples.size(), 4 );
+
+  uint64_t total( 0 );
+  for( size_t i=0; i<samples.size(); i++ )
+  {
+    vector< uint64_t > locations( unpack( field( samples[ i ], 1 )->bytes ) );
+    vector< uint64_t > values( unpack( field( samples[ i ], 2 )->bytes ) );
+    ASSERT_EQ( values.size(), 2 );
+    total += values[ 0 ];
+
+    if( locations.size() == 2 )
+    {
+      EXPECT_EQ( values[ 0 ], 3000000 );
+      EXPECT_EQ( field( samples[ i ], 3 ), static_cast< const Field* >( NULL ) );
+    }
+    else
+    {
+      ASSERT_EQ( locations.size(), 1 );
+      EXPECT_EQ( values[ 0 ], 7000000 );
+
+      // Numeric iteration name is a numeric label
+      vector< Field > label( decode( field( samples[ i ], 3 )->bytes ) );
+      EXPECT_EQ( strings[ field( label, 1 )->value ], "iteration" );
+      EXPECT_LT( field( label, 3 )->value, 2 );
+    }
+  }
+  EXPECT_EQ( total, 20000000 );
+
+  EXPECT_NE( std::find( strings.begin(), strings.end(), "outer/inner" ), strings.end() );
+  EXPECT_NE( std::find( strings.begin(), strings.end(), "bytes" ), strings.end() );
+}
+
+TEST_F( PprofTest, StringLabels )
+{
+  profile.beginLoop( "requests" );
+  profile.beginIteration( "get" );
+  profile.addLabel( "tenant", "42" );
+  profile.endIteration();
+  profile.endLoop();
+
+  decodeProfile();
+
+  ASSERT_EQ( samples.size(), 1 );
+  vector< string > labels;
+  for( size_t i=0; i<samples[ 0 ].size(); i++ )
+    if( samples[ 0 ][ i ].number == 3 )
+    {
+      vector< Field > label( decode( samples[ 0 ][ i ].bytes ) );
+      labels.push_back( strings[ field( label, 1 )->value ] + "=" + strings[ field( label, 2 )->value ] );
+    }
+
+  ASSERT_EQ( labels.size(), 2 );
+  EXPECT_EQ( labels[ 0 ], "iteration=get" );
+  EXPECT_EQ( labels[ 1 ], "tenant=42" );
+}
+
+TEST_F( PprofTest, WrittenByProfile )
+{
+  profile.beginPhase( "phase" );
+  profile.endPhase();
+
+  std::ostringstream stream;
+  profile.write( stream, pprofFormat );
+  ASSERT_GE( stream.str().size(), 2 );
+  EXPECT_EQ( static_cast< unsigned char >( stream.str()[ 0 ] ), 0x1f );
+  EXPECT_EQ( static_cast< unsigned char >( stream.str()[ 1 ] ), 0x8b );
+}
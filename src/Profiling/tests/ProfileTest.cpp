@@ -14,8 +14,12 @@
    this library. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 #include <gtest/gtest.h>
 #include <Profiling/Profile.hpp>
+#include <Profiling/Table.hpp>
 
 using std::string;
 using namespace burning;
@@ -180,3 +184,317 @@ TEST_F( ProfileTest, ComplexFromXml )
   EXPECT_EQ( profile->rootPhase().iterations().size(), 1 );
   EXPECT_EQ( profile->rootPhase().phases().size(), 1 );
 }
+
+TEST_F( ProfileTest, MergeLoops )
+{
+  Profile other;
+  for( int i=0; i<2; i++ )
+  {
+    Profile& current( i == 0 ? profile : other );
+    current.beginLoop( "loop" );
+    current.beginIteration( i );
+    current.addValue( "value", i );
+    current.endIteration();
+    current.endLoop();
+  }
+  
+  profile.merge( other );
+  
+  ASSERT_EQ( root->phases().count( "loop" ), 1 );
+  const Phase& loop( *root->phases().find( "loop" )->second[ 0 ] );
+  ASSERT_EQ( loop.iterations().size(), 2 );
+  
+  const std::vector< Value >& sources( loop.values().find( "source" )->second );
+  ASSERT_EQ( sources.size(), 2 );
+  EXPECT_EQ( sources[ 0 ].value(), 0 );
+  EXPECT_EQ( sources[ 1 ].value(), 1 );
+  EXPECT_EQ( profile.sources(), 2 );
+}
+
+TEST_F( ProfileTest, MergeNewPhase )
+{
+  Profile other;
+  other.beginPhase( "phase" );
+  other.endPhase();
+  
+  profile.merge( other );
+  profile.merge( other );
+  
+  ASSERT_EQ( root->phases().count( "phase" ), 1 );
+  const Phase& phase( *root->phases().find( "phase" )->second[ 0 ] );
+  ASSERT_EQ( phase.iterations().size(), 2 );
+  EXPECT_EQ( phase.values().find( "source" )->second[ 0 ].value(), 1 );
+  EXPECT_EQ( phase.values().find( "source" )->second[ 1 ].value(), 2 );
+  
+  xml::NodePtr xml( profile.toXml() );
+  ProfilePtr restored( Profile::fromXml( *xml ) );
+  EXPECT_EQ( restored->sources(), 3 );
+}
+
+TEST_F( ProfileTest, MergeDifferentStructure )
+{
+  Profile other;
+  other.beginPhase( "phase" );
+  other.addValue( "value", 1 );
+  other.endPhase();
+  
+  profile.beginPhase( "phase" );
+  profile.endPhase();
+  profile.merge( other );
+  
+  EXPECT_EQ( root->phases().find( "phase" )->second[ 0 ]->iterations().size(), 1 );
+}
+
+TEST_F( ProfileTest, SnapshotOfRunningLoop )
+{
+  profile.beginLoop( "loop" );
+  profile.beginIteration( 1 );
+  profile.addValue( "value", 1 );
+  profile.beginPhase( "inner" );
+  profile.endPhase();
+  profile.endIteration();
+  profile.beginIteration( 2 );
+  profile.addValue( "value", 2 );
+  profile.beginPhase( "inner" );
+  
+  ProfilePtr snapshot( profile.snapshot() );
+  
+  ASSERT_EQ( snapshot->rootPhase().phases().count( "loop" ), 1 );
+  const Phase& loop( *snapshot->rootPhase().phases().find( "loop" )->second[ 0 ] );
+  EXPECT_EQ( loop.iterations().size(), 1 );
+  EXPECT_EQ( loop.values().find( "value" )->second.size(), 1 );
+  EXPECT_EQ( loop.phases().find( "inner" )->second.size(), 1 );
+  
+  profile.endPhase();
+  profile.endIteration();
+  profile.endLoop();
+  
+  EXPECT_EQ( loop.iterations().size(), 1 );
+  EXPECT_EQ( root->phases().find( "loop" )->second[ 0 ]->iterations().size(), 2 );
+  
+  xml::NodePtr xml( snapshot->toXml() );
+  EXPECT_EQ( xml->childs( "loop" ).count(), 1 );
+}
+
+TEST_F( ProfileTest, SnapshotOfRunningPhases )
+{
+  profile.beginPhase( "outer" );
+  profile.beginPhase( "completed" );
+  profile.endPhase();
+  profile.beginPhase( "running" );
+  profile.addValue( "value", 42 );
+  
+  ProfilePtr snapshot( profile.snapshot() );
+  const Phase& outer( *snapshot->rootPhase().phases().find( "outer" )->second[ 0 ] );
+  ASSERT_EQ( outer.phases().size(), 2 );
+  EXPECT_EQ( outer.values().count( "time" ), 1 );
+  
+  const Phase& running( *outer.phases().find( "running" )->second[ 0 ] );
+  EXPECT_TRUE( const_cast< Phase& >( running ).finished() );
+  EXPECT_EQ( running.values().find( "value" )->second.size(), 1 );
+  EXPECT_EQ( running.values().count( "time" ), 1 );
+  
+  const Phase& completed( *root->phases().find( "outer" )->second[ 0 ]->phases().find( "completed" )->second[ 0 ] );
+  EXPECT_EQ( outer.phases().find( "completed" )->second[ 0 ].get(), &completed );
+  
+  std::ostringstream stream;
+  snapshot->write( stream, xmlFormat );
+  EXPECT_FALSE( stream.str().empty() );
+  
+  profile.endPhase();
+  profile.endPhase();
+}
+
+TEST_F( ProfileTest, SnapshotOfLongLoop )
+{
+  const int count( 100000 );
+  profile.beginLoop( "long" );
+  for( int i = 0; i < count; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addValue( "value", i );
+    profile.beginPhase( "inner" );
+    profile.endPhase();
+    profile.endIteration();
+  }
+  profile.beginIteration( count );
+  
+  ProfilePtr snapshot( profile.snapshot( 100 ) );
+  
+  const Phase& loop( *snapshot->rootPhase().phases().find( "long" )->second[ 0 ] );
+  ASSERT_EQ( loop.iterations().size(), 100 );
+  EXPECT_EQ( loop.iterations().front().as< int >(), count - 100 );
+  EXPECT_EQ( loop.iterations().back().as< int >(), count - 1 );
+  ASSERT_EQ( loop.values().find( "value" )->second.size(), 100 );
+  EXPECT_EQ( loop.values().find( "value" )->second.front().value(), count - 100 );
+  EXPECT_EQ( loop.values().find( "time" )->second.size(), 100 );
+  ASSERT_EQ( loop.phases().find( "inner" )->second.size(), 100 );
+  EXPECT_EQ( loop.phases().find( "inner" )->second.back().get(),
+	     root->phases().find( "long" )->second[ 0 ]->phases().find( "inner" )->second[ count - 1 ].get() );
+  
+  profile.endIteration();
+  profile.endLoop();
+  
+  EXPECT_EQ( root->phases().find( "long" )->second[ 0 ]->iterations().size(), count + 1 );
+  
+  xml::NodePtr xml( snapshot->toXml() );
+  ProfilePtr restored( Profile::fromXml( *xml ) );
+  EXPECT_EQ( restored->rootPhase().phases().find( "long" )->second[ 0 ]->iterations().size(), 100 );
+}
+
+// Snapshots are taken after profiling calls, so they often land between iterations
+TEST_F( ProfileTest, SnapshotOfLongLoopBetweenIterations )
+{
+  const int count( 100000 );
+  profile.beginLoop( "long" );
+  for( int i = 0; i < count; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addValue( "value", i );
+    profile.endIteration();
+  }
+  
+  ProfilePtr snapshot( profile.snapshot( 100 ) );
+  
+  const Phase& loop( *snapshot->rootPhase().phases().find( "long" )->second[ 0 ] );
+  ASSERT_EQ( loop.iterations().size(), 100 );
+  EXPECT_EQ( loop.iterations().front().as< int >(), count - 100 );
+  EXPECT_EQ( loop.values().find( "value" )->second.size(), 100 );
+  EXPECT_EQ( loop.values().find( "value" )->second.back().value(), count - 1 );
+  
+  profile.endLoop();
+  EXPECT_EQ( root->phases().find( "long" )->second[ 0 ]->iterations().size(), count );
+}
+
+TEST_F( ProfileTest, SnapshotsOfGlobalProfile )
+{
+  string path( "ProfileTest.snapshot.xml" );
+  std::remove( path.c_str() );
+  
+  enableSnapshots( path );
+  beginProfiling();
+  
+  profiling::beginLoop( "snapshotLoop" );
+  profiling::beginIteration( 1 );
+  profiling::endIteration( milliseconds );
+  
+  raise( SIGUSR1 );
+  profiling::beginIteration( 2 );
+  
+  disableSnapshots();
+  profiling::endIteration( milliseconds );
+  profiling::endLoop();
+  endProfiling();
+  
+  std::ifstream stream( path.c_str() );
+  xml::NodePtr xml( xml::Node::parse( stream ) );
+  ASSERT_FALSE( xml == NULL );
+  ASSERT_EQ( xml->childs( "loop" ).count(), 1 );
+  EXPECT_EQ( ( *xml->childs( "loop" ).begin() )->childs( "iteration" ).count(), 1 );
+  
+  std::remove( path.c_str() );
+}
+
+TEST_F( ProfileTest, CpuTracking )
+{
+  profile.beginLoop( "untracked" );
+  profile.beginIteration( 0 );
+  profile.endIteration();
+  profile.endLoop();
+  
+  profile.setCpuTracking( true );
+  profile.beginLoop( "loop" );
+  for( int i=0; i<3; i++ )
+  {
+    profile.beginIteration( i );
+    profile.beginPhase( "inner" );
+    profile.endPhase();
+    profile.endIteration();
+  }
+  profile.endLoop();
+  profile.setCpuTracking( false );
+  
+  const Phase& loop( *root->phases().find( "loop" )->second[ 0 ] );
+  ASSERT_EQ( loop.values().count( "migrations" ), 1 );
+  EXPECT_EQ( loop.values().find( "migrations" )->second.size(), 3 );
+  EXPECT_EQ( root->phases().find( "untracked" )->second[ 0 ]->values().count( "migrations" ), 0 );
+  
+  Table table;
+  profile.cpusToTable( &table );
+  ASSERT_EQ( table.rows(), 2 );
+  ASSERT_EQ( table.columns(), 6 );
+  EXPECT_EQ( table[ 0 ][ 0 ].value(), "loop" );
+  EXPECT_EQ( table[ 0 ][ 1 ].value(), 3 );
+  EXPECT_EQ( table[ 1 ][ 0 ].value(), "loop/inner" );
+  EXPECT_EQ( table[ 1 ][ 1 ].value(), 3 );
+}
+
+static void addCpuIteration( xml::Node& loop, int begin, int end, int migrations )
+{
+  xml::NodePtr iteration( xml::Node::create( "iteration" ) );
+  iteration->attr( "name" ) = begin;
+  
+  const char* names[] = { "time", "begin cpu", "end cpu", "migrations" };
+  int values[] = { 1, begin, end, migrations };
+  for( size_t i=0; i<4; i++ )
+  {
+    xml::NodePtr value( xml::Node::create( "value" ) );
+    value->attr( "name" ) = names[ i ];
+    value->attr( "value" ) = values[ i ];
+    iteration->childs() += value;
+  }
+  
+  loop.childs() += iteration;
+}
+
+TEST_F( ProfileTest, CpuRanges )
+{
+  xml::Node xml( "profile" );
+  xml::NodePtr loop( xml::Node::create( "loop" ) );
+  loop->attr( "name" ) = "loop";
+  addCpuIteration( *loop, 0, 1, 1 );
+  addCpuIteration( *loop, 2, 2, 0 );
+  addCpuIteration( *loop, 5, 7, 2 );
+  xml.childs() += loop;
+  
+  ProfilePtr restored( Profile::fromXml( xml ) );
+  ASSERT_FALSE( restored == NULL );
+  
+  Table table;
+  restored->cpusToTable( &table );
+  ASSERT_EQ( table.rows(), 1 );
+  EXPECT_EQ( table[ 0 ][ 1 ].value(), 3 );
+  EXPECT_EQ( table[ 0 ][ 2 ].value(), "0-2,5,7" );
+  EXPECT_EQ( table[ 0 ][ 3 ].value(), "" );
+  EXPECT_EQ( table[ 0 ][ 4 ].value(), 3 );
+  EXPECT_EQ( table[ 0 ][ 5 ].value(), 2 );
+}
+
+TEST_F( ProfileTest, SteadyStateTable )
+{
+  profile.beginLoop( "outer" );
+  for( int loop=0; loop<2; loop++ )
+  {
+    profile.beginIteration( loop );
+    profile.beginLoop( "loop" );
+    profile.setSteadyStateDetection( 3 );
+    for( int i=0; i<10; i++ )
+      profile.addIteration( i, i < 2 ? 1000 : 100, Phase::ValueList(), nanoseconds );
+    profile.endLoop();
+    profile.endIteration();
+  }
+  profile.endLoop();
+  
+  Table table;
+  profile.steadyStateToTable( &table );
+  
+  ASSERT_EQ( table.rows(), 1 );
+  EXPECT_EQ( table[ 0 ][ 0 ].value(), "outer/loop" );
+  EXPECT_EQ( table[ 0 ][ 1 ].value(), 3 );
+  EXPECT_EQ( table[ 0 ][ 2 ].value(), "2 of 2" );
+  EXPECT_EQ( table[ 0 ][ 3 ].value(), 4 );
+  EXPECT_EQ( table[ 0 ][ 4 ].value(), 1000 );
+  EXPECT_EQ( table[ 0 ][ 4 ].measure(), "ns" );
+  EXPECT_EQ( table[ 0 ][ 6 ].value(), 16 );
+  EXPECT_EQ( table[ 0 ][ 7 ].value(), 100 );
+}
@@ -0,0 +1,210 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sstream>
+#include <gtest/gtest.h>
+#include <Profiling/Query.hpp>
+#include <Profiling/Table.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+class QueryTest : public testing::Test
+{
+public:
+  void recordProfile();
+  
+  Profile profile;
+};
+
+// Parse of request i costs i ms, parse of batch j costs j seconds
+void QueryTest::recordProfile()
+{
+  profile.beginPhase( "main" );
+  
+  profile.beginLoop( "requests" );
+  for( int i=1; i<=10; i++ )
+  {
+    profile.beginIteration( i );
+    profile.addLabel( "tenant", i <= 4 ? "1" : "2" );
+    profile.beginPhase( "parse" );
+    profile.addValue( "cost", Value( i, "ms" ) );
+    profile.endPhase();
+    profile.endIteration();
+  }
+  profile.endLoop();
+  
+  profile.beginLoop( "batches" );
+  for( int i=1; i<=2; i++ )
+  {
+    profile.beginIteration( i == 1 ? "first" : "second" );
+    profile.beginPhase( "parse" );
+    profile.addValue( "cost", Value( i, "s" ) );
+    profile.endPhase();
+    profile.endIteration();
+  }
+  profile.endLoop();
+  
+  profile.endPhase();
+}
+
+TEST_F( QueryTest, Index )
+{
+  recordProfile();
+  ProfileIndex index( profile );
+  
+  ASSERT_EQ( index.paths().size(), 5 );
+  EXPECT_EQ( index.paths()[ 0 ].path, "main" );
+  
+  vector< size_t > parses( index.match( "main/*/parse" ) );
+  ASSERT_EQ( parses.size(), 2 );
+  const ProfileIndex::Path& requests( index.paths()[ parses[ 1 ] ] );
+  EXPECT_EQ( requests.path, "main/requests/parse" );
+  EXPECT_EQ( requests.iterations.size(), 10 );
+  EXPECT_EQ( requests.values.find( "cost" )->second[ 9 ], 10.0 );
+  EXPECT_EQ( requests.measures.find( "cost" )->second, "ms" );
+  
+  // Requests are labelled with two tenants, other iterations are unlabelled
+  ASSERT_EQ( index.labelSets().size(), 3 );
+  EXPECT_TRUE( index.labelSets()[ 0 ].empty() );
+  const ProfileIndex::Path& labelled( index.paths()[ index.match( "main/requests" )[ 0 ] ] );
+  ASSERT_EQ( labelled.labels.size(), 10 );
+  EXPECT_EQ( index.labelSets()[ labelled.labels[ 0 ] ].value( "tenant" ), "1" );
+  EXPECT_EQ( index.labelSets()[ labelled.labels[ 9 ] ].value( "tenant" ), "2" );
+  EXPECT_EQ( requests.labels[ 0 ], 0 );
+  
+  EXPECT_EQ( index.match( "**/parse" ).size(), 2 );
+  EXPECT_EQ( index.match( "**" ).size(), 5 );
+  EXPECT_EQ( index.match( "main/re*" ).size(), 1 );
+  EXPECT_EQ( index.match( "main/requests" ).size(), 1 );
+  EXPECT_EQ( index.match( "requests" ).size(), 0 );
+}
+
+TEST_F( QueryTest, Aggregates )
+{
+  recordProfile();
+  ProfileIndex index( profile );
+  
+  Query query( index );
+  query.select( "main/requests/parse" ).value( "cost" ).aggregate( "count, sum, mean, min, max, p50" );
+  
+  Query::ResultVector results( query.run() );
+  ASSERT_EQ( results.size(), 1 );
+  EXPECT_EQ( results[ 0 ].group, "main/requests/parse" );
+  EXPECT_EQ( results[ 0 ].measure, "ms" );
+  ASSERT_EQ( results[ 0 ].aggregates.size(), 6 );
+  EXPECT_EQ( results[ 0 ].aggregates[ 0 ], 10 );
+  EXPECT_DOUBLE_EQ( results[ 0 ].aggregates[ 1 ], 55.0 );
+  EXPECT_DOUBLE_EQ( results[ 0 ].aggregates[ 2 ], 5.5 );
+  EXPECT_DOUBLE_EQ( results[ 0 ].aggregates[ 3 ], 1.0 );
+  EXPECT_DOUBLE_EQ( results[ 0 ].aggregates[ 4 ], 10.0 );
+  EXPECT_DOUBLE_EQ( results[ 0 ].aggregates[ 5 ], 5.5 );
+}
+
+TEST_F( QueryTest, GroupByName )
+{
+  recordProfile();
+  ProfileIndex index( profile );
+  
+  Query query( index );
+  query.select( "**/parse" ).value( "cost" ).groupBy( Query::byName ).aggregate( "count,sum" );
+  
+  Query::ResultVector results( query.run() );
+  ASSERT_EQ( results.size(), 1 );
+  EXPECT_EQ( results[ 0 ].group, "parse" );
+  EXPECT_EQ( results[ 0 ].aggregates[ 0 ], 12 );
+  
+  // Milliseconds of requests are converted to seconds of batches indexed first
+  EXPECT_EQ( results[ 0 ].measure, "s" );
+  EXPECT_DOUBLE_EQ( results[ 0 ].aggregates[ 1 ], 3.055 );
+}
+
+TEST_F( QueryTest, GroupByLabel )
+{
+  recordProfile();
+  ProfileIndex index( profile );
+  
+  Query query( index );
+  query.select( "main/requests" ).groupBy( Query::byLabel, "tenant" ).aggregate( "count" );
+  
+  Query::ResultVector results( query.run() );
+  ASSERT_EQ( results.size(), 2 );
+  EXPECT_EQ( results[ 0 ].group, "1" );
+  EXPECT_EQ( results[ 0 ].aggregates[ 0 ], 4 );
+  EXPECT_EQ( results[ 1 ].group, "2" );
+  EXPECT_EQ( results[ 1 ].aggregates[ 0 ], 6 );
+  
+  query.where( "tenant", "2" );
+  EXPECT_EQ( query.run().size(), 1 );
+}
+
+TEST_F( QueryTest, GroupByIteration )
+{
+  recordProfile();
+  ProfileIndex index( profile );
+  
+  Query query( index );
+  query.select( "main/batches" ).groupBy( Query::byIteration ).aggregate( "count" );
+  
+  Query::ResultVector results( query.run() );
+  ASSERT_EQ( results.size(), 2 );
+  EXPECT_EQ( results[ 0 ].group, "first" );
+  EXPECT_EQ( results[ 1 ].group, "second" );
+}
+
+TEST_F( QueryTest, UnknownFunction )
+{
+  ProfileIndex index( profile );
+  Query query( index );
+  
+  EXPECT_TRUE( query.aggregate( "count,max" ) );
+  EXPECT_FALSE( query.aggregate( "median" ) );
+  EXPECT_FALSE( query.aggregate( "count,p101" ) );
+  
+  // Previous functions are kept
+  recordProfile();
+  ProfileIndex recorded( profile );
+  Query kept( recorded );
+  kept.select( "main/requests" );
+  EXPECT_TRUE( kept.aggregate( "count,max" ) );
+  EXPECT_FALSE( kept.aggregate( "p5x" ) );
+  Query::ResultVector results( kept.run() );
+  ASSERT_EQ( results.size(), 1 );
+  EXPECT_EQ( results[ 0 ].aggregates.size(), 2 );
+}
+
+TEST_F( QueryTest, Table )
+{
+  recordProfile();
+  ProfileIndex index( profile );
+  
+  Query query( index );
+  query.select( "**/parse" ).value( "cost" ).aggregate( "count,p99" );
+  
+  Table table;
+  query.toTable( &table );
+  ASSERT_EQ( table.rows(), 2 );
+  ASSERT_EQ( table.columns(), 3 );
+  EXPECT_EQ( table[ 0 ][ 0 ].value(), "main/batches/parse" );
+  EXPECT_EQ( table[ 0 ][ 1 ].value(), 2 );
+  EXPECT_EQ( table[ 0 ][ 2 ].measure(), "s" );
+  
+  std::ostringstream stream;
+  query.print( stream );
+  EXPECT_NE( stream.str().find( "p99" ), string::npos );
+}
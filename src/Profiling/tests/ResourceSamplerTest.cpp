@@ -0,0 +1,149 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include <Profiling/ResourceSampler.hpp>
+#include "Sleep.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+class ResourceSamplerTest : public testing::Test
+{
+public:
+  Profile profile;
+};
+
+static size_t countSamples( const vector< ResourceBucket >& buckets )
+{
+  size_t ret( 0 );
+  for( size_t i=0; i<buckets.size(); i++ )
+    ret += buckets[ i ].samples;
+  return ret;
+}
+
+TEST_F( ResourceSamplerTest, MergedBucket )
+{
+  ResourceSample first = { 100, 1, { 10, 1, 3, 0.5, 0, 0 } };
+  ResourceSample second = { 200, 2, { 20, 1, 2, 0.25, 0, 0 } };
+
+  ResourceBucket bucket( first, 0 );
+  bucket.add( second );
+
+  EXPECT_EQ( bucket.samples, 2 );
+  EXPECT_EQ( bucket.path, 2 );
+  EXPECT_EQ( bucket.minimum[ residentSize ], 10 );
+  EXPECT_EQ( bucket.maximum[ residentSize ], 20 );
+  EXPECT_EQ( bucket.last[ openDescriptors ], 2 );
+  EXPECT_EQ( bucket.minimum[ cpuUsage ], 0.25 );
+}
+
+TEST_F( ResourceSamplerTest, SamplesInPhases )
+{
+  ResourceSampler sampler( profile, 0.002 );
+
+  profile.beginPhase( "work" );
+  vector< char > memory( 1 << 24, 1 );
+  sleepMicroseconds( 30000 );
+  profile.endPhase();
+  sampler.end();
+
+  ASSERT_TRUE( sampler.available( residentSize ) );
+  const Phase& resources( *profile.rootPhase().phases().find( "resources" )->second[ 0 ] );
+  ASSERT_GE( resources.iterations().size(), 1 );
+  ASSERT_EQ( resources.values().count( "resident maximum" ), 1 );
+  EXPECT_EQ( resources.values().find( "resident maximum" )->second[ 0 ].measure(), "bytes" );
+  EXPECT_GT( resources.values().find( "resident maximum" )->second[ 0 ].value().as< double >(), 0.0 );
+
+  const vector< Value >& phases( resources.values().find( "phase" )->second );
+  size_t work( 0 );
+  for( size_t i=0; i<phases.size(); i++ )
+    if( phases[ i ].value() == string( "work" ) )
+      work++;
+  EXPECT_GT( work, 0 );
+  EXPECT_GE( countSamples( sampler.buckets() ), 2 );
+}
+
+TEST_F( ResourceSamplerTest, RunningPhase )
+{
+  ResourceSampler sampler( profile, 10.0 );
+  size_t root( profile.currentPath() );
+
+  profile.beginLoop( "loop" );
+  size_t loop( profile.currentPath() );
+  sampler.sample();
+  EXPECT_EQ( sampler.buckets().back().path, root );
+
+  profile.beginIteration( 0 );
+  sampler.sample();
+  EXPECT_EQ( sampler.buckets().back().path, loop );
+
+  profile.beginPhase( "single" );
+  size_t single( profile.currentPath() );
+  sampler.sample();
+  EXPECT_EQ( sampler.buckets().back().path, single );
+  profile.endPhase();
+
+  sampler.sample();
+  EXPECT_EQ( sampler.buckets().back().path, loop );
+  profile.endIteration();
+
+  sampler.sample();
+  EXPECT_EQ( sampler.buckets().back().path, root );
+  profile.endLoop();
+  sampler.end();
+}
+
+TEST_F( ResourceSamplerTest, BoundedBuckets )
+{
+  ResourceSampler sampler( profile, 0.0001, 4 );
+  for( int i=0; i<40; i++ )
+  {
+    sampler.sample();
+    sleepMicroseconds( 200 );
+  }
+
+  vector< ResourceBucket > buckets( sampler.buckets() );
+  EXPECT_LE( buckets.size(), 4 );
+  EXPECT_GE( countSamples( buckets ), 40 );
+  EXPECT_GT( sampler.bucketWidth(), 100000 );
+  for( size_t i=1; i<buckets.size(); i++ )
+  {
+    EXPECT_LT( buckets[ i - 1 ].begin, buckets[ i ].begin );
+    EXPECT_EQ( buckets[ i ].begin % sampler.bucketWidth(), 0 );
+  }
+}
+
+TEST_F( ResourceSamplerTest, OpenDescriptors )
+{
+  ResourceSampler sampler( profile, 10.0 );
+  if( !sampler.available( openDescriptors ) )
+    return;
+
+  sampler.sample();
+  double before( sampler.buckets().back().last[ openDescriptors ] );
+
+  int descriptor( open( "/dev/null", O_RDONLY ) );
+  sampler.sample();
+  double after( sampler.buckets().back().last[ openDescriptors ] );
+  close( descriptor );
+
+  EXPECT_EQ( after, before + 1 );
+}
@@ -0,0 +1,182 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <sstream>
+#include <gtest/gtest.h>
+#include <Profiling/Scaling.hpp>
+#include <Profiling/Table.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+class ScalingTest : public testing::Test
+{
+public:
+  void fill( const string& name, Scaling::Complexity complexity, double factor, int sizes = 5 );
+
+  Profile profile;
+};
+
+void ScalingTest::fill( const string& name, Scaling::Complexity complexity, double factor, int sizes )
+{
+  profile.beginLoop( name );
+  int size( 1000 );
+  for( int i=0; i<sizes; i++, size *= 4 )
+  {
+    long long duration( static_cast< long long >( factor * Scaling::complexityFunction( complexity, size ) ) );
+    profile.addIteration( size, duration, Phase::ValueList(), nanoseconds );
+  }
+  profile.endLoop();
+}
+
+TEST_F( ScalingTest, ExactFit )
+{
+  vector< double > sizes;
+  vector< double > values;
+  for( double size = 10; size < 1e6; size *= 10 )
+  {
+    sizes.push_back( size );
+    values.push_back( 2.5 * size * size );
+  }
+
+  Scaling::Fit fit( Scaling::fit( sizes, values, Scaling::quadraticComplexity ) );
+  EXPECT_EQ( fit.complexity, Scaling::quadraticComplexity );
+  EXPECT_NEAR( fit.factor, 2.5, 1e-9 );
+  EXPECT_NEAR( fit.error, 0.0, 1e-9 );
+  ASSERT_EQ( fit.residuals.size(), sizes.size() );
+
+  Scaling::Fit linear( Scaling::fit( sizes, values, Scaling::linearComplexity ) );
+  EXPECT_GT( linear.error, 0.5 );
+  EXPECT_GT( linear.residuals.back(), 0.0 );
+  EXPECT_LT( linear.residuals.front(), 0.0 );
+}
+
+TEST_F( ScalingTest, BestModels )
+{
+  fill( "linear", Scaling::linearComplexity, 20.0 );
+  fill( "sort", Scaling::linearithmicComplexity, 3.0 );
+  fill( "pairs", Scaling::quadraticComplexity, 0.5 );
+
+  Scaling scaling( profile );
+  const Scaling::CurveVector& curves( scaling.curves() );
+  ASSERT_EQ( curves.size(), 3 );
+
+  EXPECT_EQ( curves[ 0 ].path, "linear" );
+  EXPECT_EQ( curves[ 0 ].bestFit().complexity, Scaling::linearComplexity );
+  EXPECT_NEAR( curves[ 0 ].bestFit().factor, 20.0, 0.01 );
+  EXPECT_EQ( curves[ 0 ].measure, "ns" );
+
+  EXPECT_EQ( curves[ 1 ].path, "pairs" );
+  EXPECT_EQ( curves[ 1 ].bestFit().complexity, Scaling::quadraticComplexity );
+  EXPECT_NEAR( curves[ 1 ].bestFit().factor, 0.5, 0.01 );
+
+  EXPECT_EQ( curves[ 2 ].path, "sort" );
+  EXPECT_EQ( curves[ 2 ].bestFit().complexity, Scaling::linearithmicComplexity );
+  EXPECT_NEAR( curves[ 2 ].bestFit().factor, 3.0, 0.01 );
+  EXPECT_LT( curves[ 2 ].bestFit().error, 0.001 );
+  ASSERT_EQ( curves[ 2 ].sizes.size(), 5 );
+  EXPECT_EQ( curves[ 2 ].sizes[ 0 ], 1000 );
+}
+
+TEST_F( ScalingTest, MedianOfRepeatedSizes )
+{
+  profile.beginLoop( "repeated" );
+  for( int size = 10; size <= 1000; size *= 10 )
+  {
+    profile.addIteration( size, size * 100, Phase::ValueList(), nanoseconds );
+    profile.addIteration( size, size * 1000, Phase::ValueList(), nanoseconds );
+    profile.addIteration( size, size * 110, Phase::ValueList(), nanoseconds );
+  }
+  profile.endLoop();
+
+  Scaling scaling( profile );
+  ASSERT_EQ( scaling.curves().size(), 1 );
+
+  const Scaling::Curve& curve( scaling.curves()[ 0 ] );
+  ASSERT_EQ( curve.sizes.size(), 3 );
+  EXPECT_DOUBLE_EQ( curve.values[ 1 ], 11000 );
+  EXPECT_EQ( curve.bestFit().complexity, Scaling::linearComplexity );
+}
+
+TEST_F( ScalingTest, SkippedLoops )
+{
+  profile.beginLoop( "names" );
+  profile.addIteration( "first", 10, Phase::ValueList(), nanoseconds );
+  profile.addIteration( "second", 20, Phase::ValueList(), nanoseconds );
+  profile.addIteration( "third", 30, Phase::ValueList(), nanoseconds );
+  profile.endLoop();
+
+  fill( "short", Scaling::linearComplexity, 1.0, 2 );
+
+  Scaling scaling( profile );
+  EXPECT_EQ( scaling.curves().size(), 0 );
+
+  scaling.minimalSizes() = 2;
+  ASSERT_EQ( scaling.curves().size(), 1 );
+  EXPECT_EQ( scaling.curves()[ 0 ].path, "short" );
+}
+
+TEST_F( ScalingTest, OtherValue )
+{
+  profile.beginPhase( "outer" );
+  profile.beginLoop( "cubes" );
+  for( int size = 1; size <= 16; size *= 2 )
+  {
+    Phase::ValueList values;
+    values.push_back( std::make_pair( string( "cost" ), Value( size * size * size, "ms" ) ) );
+    profile.addIteration( size, 1, values );
+  }
+  profile.endLoop();
+  profile.endPhase();
+
+  Scaling scaling( profile );
+  scaling.value() = "cost";
+  ASSERT_EQ( scaling.curves().size(), 1 );
+  EXPECT_EQ( scaling.curves()[ 0 ].path, "outer/cubes" );
+  EXPECT_EQ( scaling.curves()[ 0 ].measure, "ms" );
+  EXPECT_EQ( scaling.curves()[ 0 ].bestFit().complexity, Scaling::cubicComplexity );
+}
+
+TEST_F( ScalingTest, Table )
+{
+  fill( "pairs", Scaling::quadraticComplexity, 2.0 );
+
+  Table table;
+  Scaling( profile ).toTable( &table );
+
+  ASSERT_EQ( table.rows(), 1 );
+  ASSERT_EQ( table.columns(), 7 );
+  EXPECT_EQ( table[ 0 ][ 0 ].value(), "pairs" );
+  EXPECT_EQ( table[ 0 ][ 1 ].value(), 5 );
+  EXPECT_EQ( table[ 0 ][ 2 ].value(), "O(n^2)" );
+  EXPECT_EQ( table[ 0 ][ 3 ].measure(), "ns" );
+  EXPECT_FALSE( table[ 0 ][ 5 ].value() == "O(n^2)" );
+  EXPECT_GT( table[ 0 ][ 6 ].value().as< double >(), table[ 0 ][ 4 ].value().as< double >() );
+}
+
+TEST_F( ScalingTest, Write )
+{
+  fill( "sort", Scaling::linearithmicComplexity, 1.0 );
+
+  std::ostringstream stream;
+  profile.write( stream, scalingFormat );
+
+  EXPECT_NE( stream.str().find( "Scaling of loops" ), string::npos );
+  EXPECT_NE( stream.str().find( "Residuals of sort by O(n log n)" ), string::npos );
+}
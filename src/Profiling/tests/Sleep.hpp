@@ -0,0 +1,39 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_TESTS_SLEEP_HPP
+#define BURNING_PROFILING_TESTS_SLEEP_HPP
+
+#include <time.h>
+
+/*! Sleeps for given count of nanoseconds */
+inline void sleepNanoseconds( long long time )
+{
+  timespec delay = { static_cast< time_t >( time / 1000000000 ), static_cast< long >( time % 1000000000 ) };
+  nanosleep( &delay, NULL );
+}
+
+inline void sleepMicroseconds( long time )
+{
+  sleepNanoseconds( time * 1000LL );
+}
+
+inline void sleepMilliseconds( long time )
+{
+  sleepNanoseconds( time * 1000000LL );
+}
+
+#endif
@@ -0,0 +1,466 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <vector>
+#include "Instrument.hpp"
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::profiling;
+
+namespace
+{
+  struct CallContext;
+  
+  /*! Calls of a function in calling context of its parent */
+  struct CallNode
+  {
+    CallNode( void* function, CallNode* parent, CallContext* context ) : function( function ),
+                                                                         parent( parent ),
+                                                                         context( context ),
+                                                                         children(),
+                                                                         calls( 0 ),
+                                                                         total( 0 ),
+                                                                         begin( 0 ),
+                                                                         depth( parent == NULL ? 0 : parent->depth + 1 )
+    {
+    }
+    
+    CallNode* child( void* function )
+    {
+      for( size_t i=0; i<children.size(); i++ )
+	if( children[ i ]->function == function )
+	  return children[ i ];
+      
+      children.push_back( new CallNode( function, this, context ) );
+      return children.back();
+    }
+    
+    void* function;
+    CallNode* parent;
+    CallContext* context;
+    vector< CallNode* > children;
+    
+    unsigned long calls;
+    long long total;
+    long long begin;
+    size_t depth;
+  };
+  
+  /*! Calls made in a phase of a profile */
+  struct CallContext
+  {
+    CallContext( Profile* profile, size_t path ) : profile( profile ),
+                                                   path( path ),
+                                                   root( NULL, NULL, this )
+    {
+    }
+    
+    Profile* profile;
+    size_t path;
+    CallNode root;
+  };
+  
+  /*! Calls recorded by a thread. Kept after thread exits so its calls are reported. */
+  struct ThreadCalls
+  {
+    ThreadCalls() : contexts(), stack(), inside( false )
+    {
+    }
+    
+    CallNode* enter( void* function, Profile* profile );
+    
+    vector< CallContext* > contexts;
+    /*! Nodes of calls in progress, NULL for calls not recorded */
+    vector< CallNode* > stack;
+    /*! True while hooks run, so functions they call are not recorded */
+    bool inside;
+  };
+  
+  enum Decision
+  {
+    undecided,
+    included,
+    excluded
+  };
+  
+  /*! Decision of filters about function */
+  struct CacheEntry
+  {
+    void* volatile function;
+    volatile int decision;
+  };
+}
+
+// Deeper calls are not recorded
+static const size_t maximalDepth = 256;
+static const size_t cacheSize = 1 << 14;
+
+static volatile bool recording = true;
+
+static vector< string > includes;
+static vector< string > excludes;
+static CacheEntry cache[ cacheSize ];
+
+static pthread_mutex_t threadsLock = PTHREAD_MUTEX_INITIALIZER;
+static vector< ThreadCalls* > threads;
+static __thread ThreadCalls* currentCalls = NULL;
+
+// Demangled name of function or its address if it has no symbol
+static string functionName( void* function )
+{
+  Dl_info info;
+  if( dladdr( function, &info ) != 0 && info.dli_sname != NULL )
+  {
+    int status;
+    char* demangled( abi::__cxa_demangle( info.dli_sname, NULL, NULL, &status ) );
+    string ret( status == 0 && demangled != NULL ? demangled : info.dli_sname );
+    free( demangled );
+    
+    return ret;
+  }
+  
+  std::ostringstream ret;
+  ret << function;
+  return ret.str();
+}
+
+static bool matches( const string& name, const vector< string >& patterns )
+{
+  for( size_t i=0; i<patterns.size(); i++ )
+    if( name.find( patterns[ i ] ) != string::npos )
+      return true;
+  return false;
+}
+
+static Decision decideByName( void* function )
+{
+  string name( functionName( function ) );
+  if( ( !includes.empty() && !matches( name, includes ) ) || matches( name, excludes ) )
+    return excluded;
+  return included;
+}
+
+// Applies filters through cache of decisions keyed by function address
+static Decision decide( void* function )
+{
+  if( includes.empty() && excludes.empty() )
+    return included;
+  
+  size_t index( ( reinterpret_cast< size_t >( function ) >> 4 ) * 2654435761u % cacheSize );
+  for( size_t probes=0; probes<cacheSize; )
+  {
+    CacheEntry& entry( cache[ index ] );
+    void* cached( entry.function );
+    
+    if( cached == function )
+    {
+      int decision( entry.decision );
+      return decision == undecided ? decideByName( function ) : Decision( decision );
+    }
+    
+    if( cached == NULL )
+    {
+      if( !__sync_bool_compare_and_swap( &entry.function, static_cast< void* >( NULL ), function ) )
+	// Entry was taken by other thread, it is checked again
+	continue;
+      
+      Decision decision( decideByName( function ) );
+      __sync_synchronize();
+      entry.decision = decision;
+      return decision;
+    }
+    
+    index = ( index + 1 ) % cacheSize;
+    probes++;
+  }
+  
+  return decideByName( function );
+}
+
+static void clearCache()
+{
+  for( size_t i=0; i<cacheSize; i++ )
+  {
+    cache[ i ].function = NULL;
+    cache[ i ].decision = undecided;
+  }
+}
+
+static ThreadCalls* threadCalls()
+{
+  if( currentCalls == NULL )
+  {
+    currentCalls = new ThreadCalls();
+    
+    pthread_mutex_lock( &threadsLock );
+    threads.push_back( currentCalls );
+    pthread_mutex_unlock( &threadsLock );
+  }
+  
+  return currentCalls;
+}
+
+CallNode* ThreadCalls::enter( void* function, Profile* profile )
+{
+  size_t path( profile->currentPath() );
+  
+  CallNode* parent( NULL );
+  for( size_t i=stack.size(); i>0 && parent == NULL; i-- )
+    parent = stack[ i - 1 ];
+  
+  // Calls made after a phase began inside caller belong to context of that phase
+  if( parent == NULL || parent->context->profile != profile || parent->context->path != path )
+  {
+    parent = NULL;
+    for( size_t i=0; i<contexts.size() && parent == NULL; i++ )
+      if( contexts[ i ]->profile == profile && contexts[ i ]->path == path )
+	parent = &contexts[ i ]->root;
+    
+    if( parent == NULL )
+    {
+      contexts.push_back( new CallContext( profile, path ) );
+      parent = &contexts.back()->root;
+    }
+  }
+  
+  if( parent->depth >= maximalDepth )
+    return NULL;
+  return parent->child( function );
+}
+
+void __cyg_profile_func_enter( void* function, void* )
+{
+  if( currentCalls == NULL && !recording )
+    return;
+  
+  ThreadCalls& calls( *threadCalls() );
+  if( calls.inside )
+    return;
+  calls.inside = true;
+  
+  CallNode* node( NULL );
+  Profile* profile( Profile::attached() );
+  if( recording && profile != NULL && decide( function ) == included )
+    node = calls.enter( function, profile );
+  calls.stack.push_back( node );
+  
+  calls.inside = false;
+  
+  if( node != NULL )
+    node->begin = clockNanoseconds( CLOCK_MONOTONIC );
+}
+
+void __cyg_profile_func_exit( void*, void* )
+{
+  long long end( clockNanoseconds( CLOCK_MONOTONIC ) );
+  
+  ThreadCalls* calls( currentCalls );
+  if( calls == NULL || calls->inside || calls->stack.empty() )
+    return;
+  
+  CallNode* node( calls->stack.back() );
+  calls->stack.pop_back();
+  
+  if( node != NULL )
+  {
+    node->calls++;
+    node->total += end - node->begin;
+  }
+}
+
+void instrument::include( const string& pattern )
+{
+  includes.push_back( pattern );
+  clearCache();
+}
+
+void instrument::exclude( const string& pattern )
+{
+  excludes.push_back( pattern );
+  clearCache();
+}
+
+void instrument::clearFilters()
+{
+  includes.clear();
+  excludes.clear();
+  clearCache();
+}
+
+void instrument::setEnabled( bool enabled )
+{
+  recording = enabled;
+}
+
+bool instrument::enabled()
+{
+  return recording;
+}
+
+static void resetCalls( CallNode& node )
+{
+  node.calls = 0;
+  node.total = 0;
+  for( size_t i=0; i<node.children.size(); i++ )
+    resetCalls( *node.children[ i ] );
+}
+
+void instrument::reset()
+{
+  pthread_mutex_lock( &threadsLock );
+  for( size_t i=0; i<threads.size(); i++ )
+    for( size_t j=0; j<threads[ i ]->contexts.size(); j++ )
+      resetCalls( threads[ i ]->contexts[ j ]->root );
+  pthread_mutex_unlock( &threadsLock );
+}
+
+/*
+ * Report
+ */
+
+namespace
+{
+  /*! Calls of function merged from threads */
+  struct ReportNode
+  {
+    ReportNode() : calls( 0 ), total( 0 ), children()
+    {
+    }
+    
+    ~ReportNode()
+    {
+      for( std::map< void*, ReportNode* >::const_iterator child = children.begin(); child != children.end(); ++child )
+	delete child->second;
+    }
+    
+    void merge( const CallNode& node )
+    {
+      for( size_t i=0; i<node.children.size(); i++ )
+      {
+	ReportNode*& child( children[ node.children[ i ]->function ] );
+	if( child == NULL )
+	  child = new ReportNode();
+	
+	child->calls += node.children[ i ]->calls;
+	child->total += node.children[ i ]->total;
+	child->merge( *node.children[ i ] );
+      }
+    }
+    
+    long long childrenTotal() const
+    {
+      long long ret( 0 );
+      for( std::map< void*, ReportNode* >::const_iterator child = children.begin(); child != children.end(); ++child )
+	ret += child->second->total;
+      return ret;
+    }
+    
+    unsigned long calls;
+    long long total;
+    std::map< void*, ReportNode* > children;
+    
+  private:
+    ReportNode( const ReportNode& );
+    void operator=( const ReportNode& );
+  };
+}
+
+static void reportFunctions( Profile& profile, const ReportNode& node )
+{
+  std::map< string, size_t > names;
+  for( std::map< void*, ReportNode* >::const_iterator child = node.children.begin(); child != node.children.end(); ++child )
+  {
+    if( child->second->total == 0 )
+      continue;
+    
+    // Different functions may have same names, e.g. static functions of different files
+    string name( functionName( child->first ) );
+    if( names[ name ]++ > 0 )
+    {
+      std::ostringstream address;
+      address << name << '@' << child->first;
+      name = address.str();
+    }
+    
+    profile.beginPhase( name );
+    profile.addValue( "calls", child->second->calls );
+    profile.addValue( "self time", Value( static_cast< long >( child->second->total - child->second->childrenTotal() ), "ns" ) );
+    reportFunctions( profile, *child->second );
+    profile.endMeasuredIteration( child->second->total, nanoseconds );
+    profile.endLoop();
+  }
+}
+
+void instrument::report( Profile& profile )
+{
+  std::map< size_t, ReportNode* > phases;
+  
+  // Calls in progress on this thread are accounted up to now
+  if( currentCalls != NULL )
+  {
+    long long time( clockNanoseconds( CLOCK_MONOTONIC ) );
+    for( size_t i=0; i<currentCalls->stack.size(); i++ )
+      if( currentCalls->stack[ i ] != NULL )
+      {
+	currentCalls->stack[ i ]->total += time - currentCalls->stack[ i ]->begin;
+	currentCalls->stack[ i ]->begin = time;
+      }
+  }
+  
+  pthread_mutex_lock( &threadsLock );
+  for( size_t i=0; i<threads.size(); i++ )
+    for( size_t j=0; j<threads[ i ]->contexts.size(); j++ )
+    {
+      const CallContext& context( *threads[ i ]->contexts[ j ] );
+      if( context.profile != &profile )
+	continue;
+      
+      ReportNode*& phase( phases[ context.path ] );
+      if( phase == NULL )
+	phase = new ReportNode();
+      phase->merge( context.root );
+    }
+  pthread_mutex_unlock( &threadsLock );
+  
+  long long total( 0 );
+  profile.beginPhase( "functions" );
+  for( std::map< size_t, ReportNode* >::const_iterator phase = phases.begin(); phase != phases.end(); ++phase )
+  {
+    if( phase->second->childrenTotal() == 0 )
+    {
+      delete phase->second;
+      continue;
+    }
+    
+    profile.beginPhase( phase->first == 0 ? string( "root" ) : profile.pathName( phase->first ) );
+    reportFunctions( profile, *phase->second );
+    profile.endMeasuredIteration( phase->second->childrenTotal(), nanoseconds );
+    profile.endLoop();
+    
+    total += phase->second->childrenTotal();
+    delete phase->second;
+  }
+  profile.endMeasuredIteration( total, nanoseconds );
+  profile.endLoop();
+}
@@ -0,0 +1,71 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BURNING_PROFILING_INSTRUMENT_HPP
+#define BURNING_PROFILING_INSTRUMENT_HPP
+
+#include <string>
+#include <Profiling/Profile.hpp>
+
+/*! Hooks called by code compiled with -finstrument-functions */
+extern "C"
+{
+  void __cyg_profile_func_enter( void* function, void* caller ) __attribute__(( no_instrument_function ));
+  void __cyg_profile_func_exit( void* function, void* caller ) __attribute__(( no_instrument_function ));
+}
+
+namespace burning
+{
+  namespace profiling
+  {
+    /*! Function level profiling of modules compiled with -finstrument-functions and linked with this library.
+     *  Calls of instrumented functions are recorded per thread in a calling context tree rooted in the phase of
+     *  thread's attached profile the outermost call was made in. Recording does not touch the profile,
+     *  so call patterns need not be the same in each iteration of a loop.
+     *  Function addresses are filtered once through a lock-free cache, names are resolved at report time.
+     *  Functions of executable get names only if it is linked with -rdynamic.
+     */
+    namespace instrument
+    {
+      /*! Records only functions whose names contain one of included patterns. All functions are included
+       *  if there are no such patterns. Filters must be set before instrumented code runs.
+       */
+      void include( const std::string& pattern );
+      /*! Skips functions whose names contain pattern */
+      void exclude( const std::string& pattern );
+      /*! Removes filters */
+      void clearFilters();
+      
+      /*! Starts or stops recording of calls. Recording is enabled by default. */
+      void setEnabled( bool enabled );
+      bool enabled();
+      
+      /*! Forgets calls recorded so far */
+      void reset();
+      
+      /*! Adds calls recorded for profile by all threads as phase "functions" in profile's current phase.
+       *  It has a phase for each phase calls were made in, named by its path or "root", with phases of
+       *  called functions nested as in calling context. Function phases have "calls" and "self time" values,
+       *  their time is total time of calls. Time of calls in progress on this thread is counted up to now,
+       *  but they are not counted in "calls".
+       *  Must be called on profile's thread when other threads do not record calls for it.
+       */
+      void report( Profile& profile );
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,143 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+#include <ProfilingInstrument/Instrument.hpp>
+
+using std::string;
+using namespace burning;
+using namespace burning::profiling;
+
+int instrumentedLeaf( int value );
+int instrumentedWork( int calls );
+
+class InstrumentTest : public testing::Test
+{
+public:
+  InstrumentTest()
+  {
+    instrument::reset();
+    profile.attach();
+  }
+
+  ~InstrumentTest()
+  {
+    Profile::detach();
+    instrument::clearFilters();
+    instrument::setEnabled( true );
+  }
+
+  const Phase& functions( const string& phase );
+  
+  Profile profile;
+};
+
+const Phase& InstrumentTest::functions( const string& phase )
+{
+  const Phase& functions( *profile.rootPhase().phases().find( "functions" )->second[ 0 ] );
+  return *functions.phases().find( phase )->second[ 0 ];
+}
+
+static const Phase& subphase( const Phase& phase, const string& name )
+{
+  Phase::PhaseMap::const_iterator ret( phase.phases().find( name ) );
+  if( ret == phase.phases().end() )
+  {
+    ADD_FAILURE() << "Phase " << name << " missed.";
+    return phase;
+  }
+  return *ret->second[ 0 ];
+}
+
+TEST_F( InstrumentTest, CallingContext )
+{
+  instrumentedWork( 3 );
+  Profile::detach();
+  instrument::report( profile );
+
+  const Phase& work( subphase( functions( "root" ), "instrumentedWork(int)" ) );
+  EXPECT_EQ( work.values().find( "calls" )->second[ 0 ].value(), 1 );
+  EXPECT_EQ( work.values().find( "self time" )->second[ 0 ].measure(), "ns" );
+
+  const Phase& leaf( subphase( work, "instrumentedLeaf(int)" ) );
+  EXPECT_EQ( leaf.values().find( "calls" )->second[ 0 ].value(), 3 );
+  EXPECT_EQ( leaf.phases().size(), 0 );
+}
+
+TEST_F( InstrumentTest, PhaseContexts )
+{
+  profile.beginPhase( "setup" );
+  instrumentedLeaf( 1 );
+  profile.endPhase();
+  instrumentedWork( 2 );
+  Profile::detach();
+  instrument::report( profile );
+
+  EXPECT_EQ( subphase( functions( "setup" ), "instrumentedLeaf(int)" ).values().find( "calls" )->second[ 0 ].value(), 1 );
+  EXPECT_EQ( functions( "root" ).phases().count( "instrumentedLeaf(int)" ), 0 );
+}
+
+TEST_F( InstrumentTest, Filters )
+{
+  instrument::exclude( "Leaf" );
+  instrumentedWork( 2 );
+  Profile::detach();
+  instrument::report( profile );
+
+  const Phase& work( subphase( functions( "root" ), "instrumentedWork(int)" ) );
+  EXPECT_EQ( work.phases().size(), 0 );
+
+  instrument::clearFilters();
+  instrument::include( "Leaf" );
+  profile.attach();
+  instrumentedWork( 1 );
+  Profile::detach();
+  instrument::reset();
+  EXPECT_TRUE( instrument::enabled() );
+}
+
+TEST_F( InstrumentTest, Disabled )
+{
+  instrument::setEnabled( false );
+  instrumentedWork( 2 );
+  Profile::detach();
+  instrument::report( profile );
+
+  const Phase& functions( *profile.rootPhase().phases().find( "functions" )->second[ 0 ] );
+  EXPECT_EQ( functions.phases().size(), 0 );
+}
+
+TEST_F( InstrumentTest, VaryingCallsInLoop )
+{
+  profile.beginLoop( "loop" );
+  for( int i=0; i<4; i++ )
+  {
+    profile.beginIteration( i );
+    if( i % 2 == 1 )
+      instrumentedWork( i );
+    profile.endIteration();
+  }
+  profile.endLoop();
+  Profile::detach();
+  instrument::report( profile );
+
+  const Phase& work( subphase( functions( "loop" ), "instrumentedWork(int)" ) );
+  EXPECT_EQ( work.values().find( "calls" )->second[ 0 ].value(), 2 );
+  EXPECT_EQ( subphase( work, "instrumentedLeaf(int)" ).values().find( "calls" )->second[ 0 ].value(), 4 );
+
+  xml::NodePtr xml( profile.toXml() );
+  EXPECT_FALSE( Profile::fromXml( *xml ) == NULL );
+}
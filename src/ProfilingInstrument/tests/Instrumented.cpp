@@ -0,0 +1,30 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compiled with -finstrument-functions
+
+int instrumentedLeaf( int value )
+{
+  return value * 2;
+}
+
+int instrumentedWork( int calls )
+{
+  int ret( 0 );
+  for( int i=0; i<calls; i++ )
+    ret += instrumentedLeaf( i );
+  return ret;
+}
@@ -0,0 +1,160 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#include <glog/logging.h>
+#include <CommandLine/CommandLine.hpp>
+#include <CommandLine/FilesystemCheck.hpp>
+#include <Profiling/ColumnExport.hpp>
+#include <Profiling/Profile.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::commandLine;
+
+/*! Profiles loaded by a pool of threads */
+struct Loader
+{
+  Loader( const vector< string >& files ) : files( files ),
+                                            profiles( files.size() ),
+                                            next( 0 )
+  {
+  }
+
+  const vector< string >& files;
+  vector< ProfilePtr > profiles;
+  size_t next;
+};
+
+static ProfilePtr loadProfile( const string& file )
+{
+  std::ifstream stream( file.c_str() );
+  if( !stream )
+  {
+    LOG( ERROR ) << "Cannot open " << file << '.';
+    return ProfilePtr();
+  }
+
+  xml::NodePtr node( xml::Node::parse( stream ) );
+  if( !node )
+  {
+    LOG( ERROR ) << "Cannot parse " << file << '.';
+    return ProfilePtr();
+  }
+
+  return Profile::fromXml( *node );
+}
+
+static void* loadProfiles( void* data )
+{
+  Loader& loader( *static_cast< Loader* >( data ) );
+
+  for(;;)
+  {
+    size_t index( __sync_fetch_and_add( &loader.next, 1 ) );
+    if( index >= loader.files.size() )
+      break;
+
+    loader.profiles[ index ] = loadProfile( loader.files[ index ] );
+  }
+
+  return NULL;
+}
+
+static profiling::OutputFormat outputFormat( const string& format )
+{
+  if( format == "xml" )
+    return profiling::xmlFormat;
+  else if( format == "table" )
+    return profiling::tableFormat;
+  else if( format == "html" )
+    return profiling::htmlFormat;
+  else if( format == "scaling" )
+    return profiling::scalingFormat;
+  else if( format == "pprof" )
+    return profiling::pprofFormat;
+
+  LOG( ERROR ) << "Unknown output format " << format << '.';
+  exit( EXIT_FAILURE );
+}
+
+int main( int argc, const char* argv[] )
+{
+  CommandLine commandLine( "burning-profmerge" );
+  commandLine.arguments() += Key< string >( "output", 'o', "File for merged profile. Standard output by default." ),
+                             Key< string >( "format", 'f', "Format of merged profile: xml, table, html, scaling or pprof. xml by default." ),
+                             Key< string >( "columns", 'c', "Directory for .npy columns of merged profile's iterations." ),
+                             Key< size_t >( "jobs", 'j', "Count of threads loading profiles. Count of processors by default." );
+  commandLine.positionals() += Key< vector< string > >( "profiles", "Profiles to merge.", ExistingFileCheck() );
+  commandLine.parse( argc, argv );
+
+  vector< string > files( commandLine.positional( "profiles" ).as< vector< string > >() );
+  if( files.empty() )
+  {
+    commandLine.printHelp();
+    return EXIT_FAILURE;
+  }
+
+  size_t jobs( sysconf( _SC_NPROCESSORS_ONLN ) );
+  if( commandLine[ "jobs" ].isSet() )
+    jobs = commandLine[ "jobs" ].as< size_t >();
+  jobs = std::max< size_t >( 1, std::min( jobs, files.size() ) );
+
+  Loader loader( files );
+  vector< pthread_t > threads( jobs );
+  for( size_t i=0; i<jobs; i++ )
+    if( pthread_create( &threads[ i ], NULL, loadProfiles, &loader ) != 0 )
+    {
+      LOG( ERROR ) << "Cannot create loading thread.";
+      return EXIT_FAILURE;
+    }
+  for( size_t i=0; i<jobs; i++ )
+    pthread_join( threads[ i ], NULL );
+
+  ProfilePtr merged;
+  for( size_t i=0; i<files.size(); i++ )
+  {
+    if( !loader.profiles[ i ] )
+      return EXIT_FAILURE;
+
+    if( !merged )
+      merged = loader.profiles[ i ];
+    else
+      merged->merge( *loader.profiles[ i ] );
+  }
+
+  profiling::OutputFormat format( profiling::xmlFormat );
+  if( commandLine[ "format" ].isSet() )
+    format = outputFormat( commandLine[ "format" ].as< string >() );
+
+  if( commandLine[ "output" ].isSet() )
+  {
+    std::ofstream stream( commandLine[ "output" ].as< string >().c_str() );
+    merged->write( stream, format );
+  }
+  else
+    merged->write( std::cout, format );
+
+  if( commandLine[ "columns" ].isSet() && !profiling::ColumnExport( *merged ).write( commandLine[ "columns" ].as< string >() ) )
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <glog/logging.h>
+#include <CommandLine/CommandLine.hpp>
+#include <CommandLine/FilesystemCheck.hpp>
+#include <Profiling/Query.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::commandLine;
+using namespace burning::profiling;
+
+static ProfilePtr loadProfile( const string& file )
+{
+  std::ifstream stream( file.c_str() );
+  if( !stream )
+  {
+    LOG( ERROR ) << "Cannot open " << file << '.';
+    return ProfilePtr();
+  }
+
+  xml::NodePtr node( xml::Node::parse( stream ) );
+  if( !node )
+  {
+    LOG( ERROR ) << "Cannot parse " << file << '.';
+    return ProfilePtr();
+  }
+
+  return Profile::fromXml( *node );
+}
+
+/*! Applies query option, returns false for unknown option or wrong value */
+static bool setOption( Query& query, const string& name, const string& value )
+{
+  if( name == "select" )
+    query.select( value );
+  else if( name == "value" )
+    query.value( value );
+  else if( name == "aggregate" )
+    return query.aggregate( value );
+  else if( name == "where" )
+  {
+    size_t separator( value.find( '=' ) );
+    if( separator == string::npos )
+    {
+      LOG( ERROR ) << "Filter " << value << " is not key=value.";
+      return false;
+    }
+    query.where( value.substr( 0, separator ), value.substr( separator + 1 ) );
+  }
+  else if( name == "group" )
+  {
+    if( value == "path" )
+      query.groupBy( Query::byPath );
+    else if( value == "name" )
+      query.groupBy( Query::byName );
+    else if( value == "iteration" )
+      query.groupBy( Query::byIteration );
+    else if( value.compare( 0, 6, "label:" ) == 0 && value.size() > 6 )
+      query.groupBy( Query::byLabel, value.substr( 6 ) );
+    else
+    {
+      LOG( ERROR ) << "Unknown grouping " << value << '.';
+      return false;
+    }
+  }
+  else
+  {
+    LOG( ERROR ) << "Unknown query option " << name << '.';
+    return false;
+  }
+
+  return true;
+}
+
+/*! Runs queries read from standard input, one per line as name=value options, e.g.
+ *  "select=main/requests group=label:tenant aggregate=count,p99". Options of a line
+ *  override options of command line.
+ */
+static void runInteractive( const Query& base, bool html )
+{
+  string line;
+  while( std::cout << "> " << std::flush, std::getline( std::cin, line ) )
+  {
+    Query query( base );
+    bool valid( true );
+
+    std::istringstream options( line );
+    string option;
+    while( valid && options >> option )
+    {
+      size_t separator( option.find( '=' ) );
+      valid = separator != string::npos && setOption( query, option.substr( 0, separator ), option.substr( separator + 1 ) );
+      if( separator == string::npos )
+	LOG( ERROR ) << "Option " << option << " is not name=value.";
+    }
+
+    if( valid )
+      query.print( std::cout, html );
+  }
+}
+
+int main( int argc, const char* argv[] )
+{
+  CommandLine commandLine( "burning-profquery" );
+  commandLine.arguments() += Key< string >( "select", 's', "Pattern of phase paths, e.g. main/*/parse or **/parse. All phases by default." ),
+                             Key< string >( "value", 'v', "Aggregated value. time by default." ),
+                             Key< string >( "group", 'g', "Grouping of iterations: path, name, iteration or label:KEY. path by default." ),
+                             Key< vector< string > >( "where", 'w', "Label filters as key=value." ),
+                             Key< string >( "aggregate", 'a', "Comma separated count, sum, mean, min, max and percentiles like p99. count,sum,mean,p50,p99 by default." ),
+                             Flag( "html", 'H', "Print results as html table." ),
+                             Flag( "interactive", 'i', "Read queries from standard input, one per line as name=value options." );
+  commandLine.positionals() += Key< string >( "profile", "Profile to query.", ExistingFileCheck() );
+  commandLine.parse( argc, argv );
+
+  if( !commandLine.positional( "profile" ).isSet() )
+  {
+    commandLine.printHelp();
+    return EXIT_FAILURE;
+  }
+
+  ProfilePtr profile( loadProfile( commandLine.positional( "profile" ).as< string >() ) );
+  if( !profile )
+    return EXIT_FAILURE;
+
+  ProfileIndex index( *profile );
+  Query query( index );
+
+  const char* options[] = { "select", "value", "group", "aggregate" };
+  for( size_t i=0; i<sizeof( options ) / sizeof( options[ 0 ] ); i++ )
+    if( commandLine[ options[ i ] ].isSet() && !setOption( query, options[ i ], commandLine[ options[ i ] ].as< string >() ) )
+      return EXIT_FAILURE;
+
+  if( commandLine[ "where" ].isSet() )
+  {
+    vector< string > filters( commandLine[ "where" ].as< vector< string > >() );
+    for( size_t i=0; i<filters.size(); i++ )
+      if( !setOption( query, "where", filters[ i ] ) )
+	return EXIT_FAILURE;
+  }
+
+  bool html( commandLine[ "html" ].isSet() );
+  if( commandLine[ "interactive" ].isSet() )
+    runInteractive( query, html );
+  else
+    query.print( std::cout, html );
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <glog/logging.h>
+#include <CommandLine/CommandLine.hpp>
+#include <CommandLine/FilesystemCheck.hpp>
+#include <Profiling/Journal.hpp>
+
+using std::string;
+using namespace burning;
+using namespace burning::commandLine;
+
+static profiling::OutputFormat outputFormat( const string& format )
+{
+  if( format == "xml" )
+    return profiling::xmlFormat;
+  else if( format == "table" )
+    return profiling::tableFormat;
+  else if( format == "html" )
+    return profiling::htmlFormat;
+  else if( format == "scaling" )
+    return profiling::scalingFormat;
+  else if( format == "pprof" )
+    return profiling::pprofFormat;
+
+  LOG( ERROR ) << "Unknown output format " << format << '.';
+  exit( EXIT_FAILURE );
+}
+
+int main( int argc, const char* argv[] )
+{
+  CommandLine commandLine( "burning-profrecover" );
+  commandLine.arguments() += Key< string >( "output", 'o', "File for recovered profile. Standard output by default." ),
+                             Key< string >( "format", 'f', "Format of recovered profile: xml, table, html, scaling or pprof. xml by default." );
+  commandLine.positionals() += Key< string >( "journal", "Journal written by profiling::enableJournal.", ExistingFileCheck() );
+  commandLine.parse( argc, argv );
+
+  if( !commandLine.positional( "journal" ).isSet() )
+  {
+    commandLine.printHelp();
+    return EXIT_FAILURE;
+  }
+
+  ProfilePtr profile( profiling::Journal::recover( commandLine.positional( "journal" ).as< string >() ) );
+  if( !profile )
+    return EXIT_FAILURE;
+
+  profiling::OutputFormat format( profiling::xmlFormat );
+  if( commandLine[ "format" ].isSet() )
+    format = outputFormat( commandLine[ "format" ].as< string >() );
+
+  if( commandLine[ "output" ].isSet() )
+  {
+    std::ofstream stream( commandLine[ "output" ].as< string >().c_str() );
+    profile->write( stream, format );
+  }
+  else
+    profile->write( std::cout, format );
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+/*
+   Copyright (c)  2011   Dmitry Sopin <sopindm@gmail.com>
+
+   This library is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <time.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <glog/logging.h>
+#include <CommandLine/CommandLine.hpp>
+#include <Profiling/LiveStatistics.hpp>
+#include <Profiling/Table.hpp>
+
+using std::string;
+using std::vector;
+using namespace burning;
+using namespace burning::commandLine;
+using namespace burning::profiling;
+
+/*! Orders summaries by chosen column, largest first */
+class SummaryOrder
+{
+public:
+  SummaryOrder( const string& column ) : _column( column )
+  {
+  }
+  
+  bool operator()( const live::Summary& left, const live::Summary& right ) const
+  {
+    return key( left ) > key( right );
+  }
+  
+private:
+  uint64_t key( const live::Summary& summary ) const
+  {
+    if( _column == "count" )
+      return summary.count;
+    if( _column == "max" )
+      return summary.maximalTime;
+    if( _column == "p99" )
+      return summary.percentile99;
+    
+    return summary.totalTime;
+  }
+  
+  string _column;
+};
+
+static vector< live::Summary > readSummaries( const live::Segment& segment )
+{
+  vector< live::Summary > ret;
+  
+  live::PhaseRecord record;
+  for( size_t i=0; i<segment.phases; i++ )
+    if( live::read( segment, i, record ) )
+      ret.push_back( live::summarize( record ) );
+  
+  return ret;
+}
+
+static void printSummaries( const live::Segment& segment, vector< live::Summary >& summaries,
+                            std::map< string, uint64_t >& previousCounts, double interval )
+{
+  Table table;
+  table.column( 0 ).name() = "phase";
+  table.column( 1 ).name() = "count";
+  table.column( 2 ).name() = "rate (1/s)";
+  table.column( 3 ).name() = "total (ms)";
+  table.column( 4 ).name() = "mean (ns)";
+  table.column( 5 ).name() = "max (ns)";
+  table.column( 6 ).name() = "p50 (ns)";
+  table.column( 7 ).name() = "p90 (ns)";
+  table.column( 8 ).name() = "p99 (ns)";
+  
+  for( size_t i=0; i<summaries.size(); i++ )
+  {
+    const live::Summary& summary( summaries[ i ] );
+    
+    string name( summary.name() );
+    
+    uint64_t previous( previousCounts.count( name ) ? previousCounts[ name ] : summary.count );
+    previousCounts[ name ] = summary.count;
+    
+    Table::RowProxy row( table.newRow() );
+    row.pushBack( name );
+    row.pushBack( static_cast< size_t >( summary.count ) );
+    row.pushBack( static_cast< size_t >( ( summary.count - previous ) / interval ) );
+    row.pushBack( static_cast< size_t >( summary.totalTime / 1000000 ) );
+    row.pushBack( static_cast< size_t >( summary.count > 0 ? summary.totalTime / summary.count : 0 ) );
+    row.pushBack( static_cast< size_t >( summary.maximalTime ) );
+    row.pushBack( static_cast< size_t >( summary.median ) );
+    row.pushBack( static_cast< size_t >( summary.percentile90 ) );
+    row.pushBack( static_cast< size_t >( summary.percentile99 ) );
+  }
+  
+  // Clears terminal and moves cursor home
+  std::cout << "\033[H\033[2J";
+  std::cout << "pid " << segment.pid << ", " << segment.phases << " phases";
+  if( segment.dropped > 0 )
+    std::cout << ", " << segment.dropped << " iterations dropped for lack of records";
+  std::cout << std::endl << std::endl;
+  table.print( std::cout );
+  std::cout.flush();
+}
+
+int main( int argc, const char* argv[] )
+{
+  CommandLine commandLine( "burning-proftop" );
+  commandLine.arguments() += Key< double >( "interval", 'i', "Seconds between updates. 1 by default." ),
+                             Key< size_t >( "count", 'n', "Count of updates. Runs until interrupted by default." ),
+                             Key< string >( "sort", 's', "Column to sort phases by: total, count, max or p99. total by default." );
+  commandLine.positionals() += Key< string >( "segment", "Name of statistics segment, for example /burning.1234." );
+  commandLine.parse( argc, argv );
+  
+  if( !commandLine.positional( "segment" ).isSet() )
+  {
+    commandLine.printHelp();
+    return EXIT_FAILURE;
+  }
+  
+  double interval( 1.0 );
+  if( commandLine[ "interval" ].isSet() )
+    interval = commandLine[ "interval" ].as< double >();
+  if( interval <= 0.0 )
+  {
+    LOG( ERROR ) << "Interval must be positive.";
+    return EXIT_FAILURE;
+  }
+  
+  string sort( "total" );
+  if( commandLine[ "sort" ].isSet() )
+    sort = commandLine[ "sort" ].as< string >();
+  if( sort != "total" && sort != "count" && sort != "max" && sort != "p99" )
+  {
+    LOG( ERROR ) << "Unknown sort column " << sort << '.';
+    return EXIT_FAILURE;
+  }
+  
+  const live::Segment* segment( live::attach( commandLine.positional( "segment" ).as< string >() ) );
+  if( segment == NULL )
+    return EXIT_FAILURE;
+  
+  timespec pause;
+  pause.tv_sec = static_cast< time_t >( interval );
+  pause.tv_nsec = static_cast< long >( ( interval - pause.tv_sec ) * 1e9 );
+  
+  std::map< string, uint64_t > previousCounts;
+  for( size_t i=0; !commandLine[ "count" ].isSet() || i < commandLine[ "count" ].as< size_t >(); i++ )
+  {
+    if( i > 0 )
+      nanosleep( &pause, NULL );
+    
+    vector< live::Summary > summaries( readSummaries( *segment ) );
+    std::sort( summaries.begin(), summaries.end(), SummaryOrder( sort ) );
+    printSummaries( *segment, summaries, previousCounts, interval );
+  }
+  
+  live::detach( segment );
+  return EXIT_SUCCESS;
+}